@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# Microbenchmark of the serial sample decoder:
+# sync search, crc and full decode throughput
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       -= widgets
+
+TARGET = DecoderBench
+TEMPLATE = app
+CONFIG += console c++11 release
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# AVX2 path of the sync search: qmake "CONFIG+=avx2"
+avx2 {
+    gcc|clang: QMAKE_CXXFLAGS += -mavx2
+    msvc: QMAKE_CXXFLAGS += /arch:AVX2
+}
+
+SOURCES += \
+        ../Lib/sampledecoder.cpp \
+        main.cpp
+
+HEADERS += \
+        ../Lib/sampledecoder.h
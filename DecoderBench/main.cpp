@@ -0,0 +1,117 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QVector3D>
+#include <cstdio>
+
+#include "../Lib/sampledecoder.h"
+
+#define CHUNK_SIZE (64 * 1024)
+#define FRAME_POINTS 256
+
+// побайтовый crc для сравнения со slicing-by-8
+static quint16 crc16Bytewise(const uchar *data, int size)
+{
+    quint16 crc = 0xFFFF;
+    for (int i = 0; i < size; i++) {
+        crc ^= quint16(data[i] << 8);
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 0x8000) ? quint16((crc << 1) ^ 0x1021) : quint16(crc << 1);
+    }
+    return crc;
+}
+
+static void report(const char *name, qint64 bytes, qint64 ns, int rounds)
+{
+    double gbs = ns > 0 ? double(bytes) * rounds / double(ns) : 0.0;
+    printf("%-24s %8.3f GB/s\n", name, gbs);
+}
+
+static QByteArray makeStream(int megabytes, int *points)
+{
+    QByteArray stream;
+    stream.reserve(megabytes * 1024 * 1024 + CHUNK_SIZE);
+
+    QVector<QVector3D> frame(FRAME_POINTS);
+    quint32 seed = 1;
+    *points = 0;
+    while (stream.size() < megabytes * 1024 * 1024) {
+        for (int i = 0; i < FRAME_POINTS; i++)
+            frame[i] = QVector3D(i, *points % 1000, 0.5f * i);
+        stream.append(SampleDecoder::encodeFrame(frame.constData(), FRAME_POINTS));
+        *points += FRAME_POINTS;
+
+        // немного мусора между кадрами, как после потери синхронизации
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 16 == 0)
+            stream.append(QByteArray(int((seed >> 8) % 64) + 1, char(0x5A)));
+    }
+    return stream;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("DecoderBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the serial sample decoder throughput");
+    parser.addHelpOption();
+    QCommandLineOption sizeOption(QStringList() << "s" << "size", "Test stream size, MB.", "mb", "64");
+    QCommandLineOption roundsOption(QStringList() << "r" << "rounds", "Rounds per measurement.", "count", "5");
+    parser.addOption(sizeOption);
+    parser.addOption(roundsOption);
+    parser.process(a);
+
+    const int megabytes = qMax(1, parser.value(sizeOption).toInt());
+    const int rounds = qMax(1, parser.value(roundsOption).toInt());
+
+    int expectedPoints = 0;
+    const QByteArray stream = makeStream(megabytes, &expectedPoints);
+    const uchar *data = reinterpret_cast<const uchar*>(stream.constData());
+    const int size = stream.size();
+    printf("stream: %d bytes, %d points, %d rounds\n", size, expectedPoints, rounds);
+
+    QElapsedTimer timer;
+    volatile int sink = 0;
+
+    // поиск синхрослова по данным без него
+    QByteArray noise(size, char(0x5A));
+    timer.start();
+    for (int r = 0; r < rounds; r++)
+        sink += SampleDecoder::findSync(reinterpret_cast<const uchar*>(noise.constData()), noise.size());
+    report("sync search", size, timer.nsecsElapsed(), rounds);
+
+    timer.restart();
+    for (int r = 0; r < rounds; r++)
+        sink += crc16Bytewise(data, size);
+    report("crc16 bitwise", size, timer.nsecsElapsed(), rounds);
+
+    timer.restart();
+    for (int r = 0; r < rounds; r++)
+        sink += SampleDecoder::crc16(data, size);
+    report("crc16 slicing-by-8", size, timer.nsecsElapsed(), rounds);
+
+    QVector<QVector3D> points;
+    points.reserve(expectedPoints);
+    int decoded = 0;
+    timer.restart();
+    for (int r = 0; r < rounds; r++) {
+        SampleDecoder decoder;
+        points.clear();
+        decoded = 0;
+        for (int pos = 0; pos < size; pos += CHUNK_SIZE)
+            decoded += decoder.feed(stream.constData() + pos, qMin(CHUNK_SIZE, size - pos), points);
+    }
+    qint64 ns = timer.nsecsElapsed();
+    report("decode", size, ns, rounds);
+    printf("%-24s %8.2f Mpoints/s\n", "", ns > 0 ? double(decoded) * rounds * 1000.0 / double(ns) : 0.0);
+
+    if (decoded != expectedPoints) {
+        printf("decoded %d points, expected %d\n", decoded, expectedPoints);
+        return 1;
+    }
+    Q_UNUSED(sink);
+    return 0;
+}
@@ -1,8 +1,7 @@
-#version 430
+#version 120
 uniform vec3 color;
-out vec4 FragColor;
 
 void main(void)
 {
-	FragColor = vec4(color, 1.0);
+	gl_FragColor = vec4(color, 1.0);
 }
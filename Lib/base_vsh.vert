@@ -1,3 +1,4 @@
+#version 120
 attribute vec3 qt_Vertex;
 uniform mat4 Matrix;
 
@@ -6,616 +6,529 @@
 #include <QMetaProperty>
 #include <QDesktopWidget>
 #include <QLabel>
+#include <QOpenGLTextureBlitter>
+#include <QDebug>
 #include "varianteditor.h"
+#include "scenerenderer.h"
 
-#define LOGICAL_COEF 100.0f
-#define EPSILON 0.00001f
+#define AUTOFIT_TICKS 10            // делений шкалы на ось
+#define AUTOFIT_SHRINK 0.5f         // доля пространства, ниже которой оно сужается
 
-const QColor BackgroundColor = Qt::white;
-const QColor ScaleMarkColor = Qt::black;
+BaseScene3D::BaseScene3D(QWidget* pwgt) : QOpenGLWidget(pwgt), fSettings("view3DSettings", QStringLiteral("3D view settings"))
+{    
+    rBut = false;    
+    light = false;
+    fSmooth = false;
+    fMoveMode = mmObjectMode;
+    isMouseMove = false;
+    fWheelSteps = 0;
+    fCapture = nullptr;
+    fThreaded = false;
+    fRenderer = nullptr;
+    fBlitter = nullptr;
+    fRenderScale = 1.0f;
+    fAutoFit = false;
+    fAutoFitMargin = 0.1f;
+
+    fScheduler = new FrameScheduler(this);
+    connect(fScheduler, SIGNAL(frameDue(FrameScheduler::UpdateReasons)), this, SLOT(frameDue(FrameScheduler::UpdateReasons)));
 
-void BaseScene3D::qgluPerspective(GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar)
-{
-    const GLdouble ymax = zNear * tan(fovy * M_PI / 360.0);
-    const GLdouble ymin = -ymax;
-    const GLdouble xmin = ymin * aspect;
-    const GLdouble xmax = ymax * aspect;
-    glFrustum(xmin, xmax, ymin, ymax, zNear, zFar);
+    setFocusPolicy(Qt::StrongFocus);
+
+    setSpaceData(-3, -3, -3, 6, 6, 6);
 }
 
-void BaseScene3D::updateXScaleValues(float start, float end, float step, int precision)
+BaseScene3D::~BaseScene3D()
 {
-    fScalesSettings[slX].start = start;
-    fScalesSettings[slX].length = end - start;
-    fScalesSettings[slX].step = step;
-    fScalesSettings[slX].precision = precision;
+    makeCurrent();
+    stopRenderer();
+    if (fCapture)
+        delete fCapture;
+    for (DataSeries *series : fSeries) {
+        series->releaseGL();
+        delete series;
+    }
+    releaseScene();
+    doneCurrent();
+}
 
-    {
-        QPainter painter;
-        int imageH = LOGICAL_COEF * fSpaceData.xLength;
-        int w = LOGICAL_COEF;
-
-        QStringList viList;
-        float v = start;
-        while (v <= end + EPSILON /*|| v <= end - EPSILON*/) {
-            viList.append(QString("%1").arg(v, 0, 'f', precision));
-            v += step;
-        }
+void BaseScene3D::initializeGL() // инициализация
+{
+    initializeScene();
+    if (fThreaded)
+        startRenderer();
+}
 
-        QImage imageR(w, imageH, QImage::Format_ARGB32);
-        imageR.fill(QColor(255,255,255,0));
-
-        float h = imageH * (step / fScalesSettings[slX].length);
-        painter.begin(&imageR);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-
-        for (int i = 0; i < viList.count(); i++) {
-            float y = imageH - h * i;
-            Qt::Alignment tAlign = Qt::AlignRight;
-            if (i == 0) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else if (i == viList.count() - 1) {
-                tAlign |= Qt::AlignTop;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(0, y, w - 2, h);
-            painter.drawText(r, tAlign, viList[i]);
-        }
-        painter.end();
-
-        QImage imageL(w, imageH, QImage::Format_ARGB32);
-        imageL.fill(QColor(255,255,255,0));
-        painter.begin(&imageL);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-        for (int i = 0; i < viList.count(); i++) {
-            float y = imageH - h * i;
-            Qt::Alignment tAlign = Qt::AlignLeft;
-            if (i == 0) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else if (i == viList.count() - 1) {
-                tAlign |= Qt::AlignTop;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(2, y, w - 2, h);
-            painter.drawText(r, tAlign, viList[i]);
-        }
-        painter.end();
-
-        QImage imageIR(w, imageH, QImage::Format_ARGB32);
-        imageIR.fill(QColor(255,255,255,0));
-        painter.begin(&imageIR);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-        for (int i = 0; i < viList.count(); i++) {
-            float y = h * i;
-            Qt::Alignment tAlign = Qt::AlignRight;
-            if (i == 0) {
-                tAlign |= Qt::AlignTop;
-            }
-            else if (i == viList.count() - 1) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(0, y, w - 2, h);
-            painter.drawText(r, tAlign, viList[i]);
-        }
-        painter.end();
-
-        QImage imageIL(w, imageH, QImage::Format_ARGB32);
-        imageIL.fill(QColor(255,255,255,0));
-        painter.begin(&imageIL);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-        for (int i = 0; i < viList.count(); i++) {
-            float y = h * i;
-            Qt::Alignment tAlign = Qt::AlignLeft;
-            if (i == 0) {
-                tAlign |= Qt::AlignTop;
-            }
-            else if (i == viList.count() - 1) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(2, y, w - 2, h);
-            painter.drawText(r, tAlign, viList[i]);
-        }
-        painter.end();
+void BaseScene3D::setThreadedRendering(bool enabled)
+{
+    fThreaded = enabled;
+    if (!context())
+        return;     // поток будет запущен в initializeGL
+
+    makeCurrent();
+    if (enabled)
+        startRenderer();
+    else
+        stopRenderer();
+    doneCurrent();
+    requestFrame(FrameScheduler::urView);
+}
 
-        if (xScaleTextureRight) {
-            xScaleTextureRight->destroy();
-            delete xScaleTextureRight;
-        }
+void BaseScene3D::setRenderScale(float scale)
+{
+    fRenderScale = qBound(0.1f, scale, 1.0f);
+    requestFrame(FrameScheduler::urView);
+}
 
-        xScaleTextureRight = new QOpenGLTexture(imageR.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        xScaleTextureRight->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
+void BaseScene3D::startRenderer()
+{
+    if (fRenderer)
+        return;
 
-        if (xScaleTextureLeft) {
-            xScaleTextureLeft->destroy();
-            delete xScaleTextureLeft;
-        }
+    if (!QOpenGLContext::supportsThreadedOpenGL()) {
+        qDebug() << "Threaded OpenGL is not supported, the scene is rendered in paintGL";
+        fThreaded = false;
+        return;
+    }
 
-        xScaleTextureLeft = new QOpenGLTexture(imageL.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        xScaleTextureLeft->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
+    fRenderer = new SceneRenderer(context(), [this](const QMatrix4x4 &pmvMatrix) { drawSeries(pmvMatrix); paintData(pmvMatrix); }, this);
+    connect(fRenderer, SIGNAL(frameReady()), this, SLOT(update()));
 
-        if (xInverseScaleTextureRight) {
-            xInverseScaleTextureRight->destroy();
-            delete xInverseScaleTextureRight;
-        }
+    fBlitter = new QOpenGLTextureBlitter();
+    if (!fBlitter->create())
+        qDebug() << "Cannot create QOpenGLTextureBlitter!";
+}
 
-        xInverseScaleTextureRight = new QOpenGLTexture(imageIR.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        xInverseScaleTextureRight->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
+void BaseScene3D::stopRenderer()
+{
+    if (!fRenderer)
+        return;
 
-        if (xInverseScaleTextureLeft) {
-            xInverseScaleTextureLeft->destroy();
-            delete xInverseScaleTextureLeft;
-        }
+    delete fRenderer;   // дожидается завершения потока
+    fRenderer = nullptr;
 
-        xInverseScaleTextureLeft = new QOpenGLTexture(imageIL.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        xInverseScaleTextureLeft->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
-    }
+    fBlitter->destroy();
+    delete fBlitter;
+    fBlitter = nullptr;
 }
 
-void BaseScene3D::updateYScaleValues()
+void BaseScene3D::compositeFrame()
 {
-    updateYScaleValues(fScalesSettings[slY].start, fScalesSettings[slY].start + fScalesSettings[slY].length, fScalesSettings[slY].step, fScalesSettings[slY].precision);
+    QColor clearColor = Qt::white;
+    glClearColor(clearColor.redF(), clearColor.greenF(), clearColor.blueF(), clearColor.alphaF());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    GLuint texture = fRenderer->acquireFrame();
+    if (texture && fBlitter->isCreated()) {
+        QSize viewport = size() * devicePixelRatioF();
+        glViewport(0, 0, viewport.width(), viewport.height());
+        glDisable(GL_DEPTH_TEST);
+        fBlitter->bind();
+        fBlitter->blit(texture, QMatrix4x4(), QOpenGLTextureBlitter::OriginBottomLeft);
+        fBlitter->release();
+        glEnable(GL_DEPTH_TEST);
+    }
+    fRenderer->releaseFrame();
 }
 
-void BaseScene3D::updateYScaleValues(float start, float end, float step, int precision)
+void BaseScene3D::resizeGL(int nWidth, int nHeight) // окно виджета
 {
-    fScalesSettings[slY].start = start;
-    fScalesSettings[slY].length = end - start;
-    fScalesSettings[slY].step = step;
-    fScalesSettings[slY].precision = precision;
-
-    {
-        QPainter painter;
-        int imageH = LOGICAL_COEF * fSpaceData.yLength;
-        int w = LOGICAL_COEF;
-        QStringList vList;
-        QStringList viList;
-        float v = start;
-        while (v <= end + EPSILON) {
-            viList.append(QString("%1").arg(v, 0, 'f', precision));
-            v += step;
-        }
-
-        QImage imageR(w, imageH, QImage::Format_ARGB32);
-        imageR.fill(QColor(255,255,255,0));
-        float h = imageH * (step / fScalesSettings[slY].length);
-        painter.begin(&imageR);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-        for (int i = 0; i < viList.count(); i++) {
-            float y = imageH - h * i;
-            Qt::Alignment tAlign = Qt::AlignRight;
-            if (i == 0) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else if (i == viList.count() - 1) {
-                tAlign |= Qt::AlignTop;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(0, y, w - 2, h);
-            painter.drawText(r, tAlign, viList[i]);
-        }
-        painter.end();
-
-        QImage imageL(w, imageH, QImage::Format_ARGB32);
-        imageL.fill(QColor(255,255,255,0));
-        painter.begin(&imageL);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-        for (int i = 0; i < viList.count(); i++) {
-            float y = imageH - h * i;
-            Qt::Alignment tAlign = Qt::AlignLeft;
-            if (i == 0) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else if (i == viList.count() - 1) {
-                tAlign |= Qt::AlignTop;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(2, y, w - 2, h);
-            painter.drawText(r, tAlign, viList[i]);
-        }
-        painter.end();
-
-        QImage imageIR(w, imageH, QImage::Format_ARGB32);
-        imageIR.fill(QColor(255,255,255,0));
-        painter.begin(&imageIR);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-        for (int i = 0; i < viList.count(); i++) {
-            float y = /*delta +*/ h * i;
-            Qt::Alignment tAlign = Qt::AlignRight;
-            if (i == 0)
-                tAlign |= Qt::AlignTop;
-            else if (i == viList.count() - 1) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(0, y, w - 2, h);
-            painter.drawText(r, tAlign, viList[i]);
-        }
-        painter.end();
-
-        QImage imageIL(w, imageH, QImage::Format_ARGB32);
-        imageIL.fill(QColor(255,255,255,0));
-        painter.begin(&imageIL);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-        for (int i = 0; i < viList.count(); i++) {
-            float y = h * i;
-            Qt::Alignment tAlign = Qt::AlignLeft;
-            if (i == 0)
-                tAlign |= Qt::AlignTop;
-            else if (i == viList.count() - 1) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(2, y, w - 2, h);
-            painter.drawText(r, tAlign, viList[i]);
-        }
-        painter.end();
+   glMatrixMode(GL_PROJECTION);                     // устанавливает текущей проекционную матрицу
+   glLoadIdentity();                                // присваивает проекционной матрице единичную матрицу
 
-        if (yScaleTextureRight)
-            delete yScaleTextureRight;
+   GLfloat aspect = (GLfloat)nWidth / (GLfloat)nHeight;
 
-        yScaleTextureRight = new QOpenGLTexture(imageR.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        yScaleTextureRight->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
+   // поле просмотра
+   glViewport(0, 0, (GLint)nWidth, (GLint)nHeight);
+   qgluPerspective(60.0, aspect, 1.0, 250.0);
 
-        if (yScaleTextureLeft)
-            delete yScaleTextureLeft;
+   if (fRenderer)
+       requestFrame(FrameScheduler::urView);
+}
 
-        yScaleTextureLeft = new QOpenGLTexture(imageL.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        yScaleTextureLeft->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
+void BaseScene3D::paintGL()
+{
+   if (fRenderer)
+       compositeFrame();
+   else
+       renderScene(this, size());
 
-        if (yInverseScaleTextureRight)
-            delete yInverseScaleTextureRight;
+   if (fCapture)
+       fCapture->capture(defaultFramebufferObject(), size() * devicePixelRatioF(), format().samples());
 
-        yInverseScaleTextureRight = new QOpenGLTexture(imageIR.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        yInverseScaleTextureRight->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
+   fScheduler->frameRendered();
+}
 
-        if (yInverseScaleTextureLeft)
-            delete yInverseScaleTextureLeft;
+PointSeries *BaseScene3D::addPointSeries(const QString &name)
+{
+    QMutexLocker locker(&fSeriesMutex);
+    if (fSeries.contains(name))
+        return dynamic_cast<PointSeries*>(fSeries.value(name));
 
-        yInverseScaleTextureLeft = new QOpenGLTexture(imageIL.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        yInverseScaleTextureLeft->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
-    }
+    PointSeries *series = new PointSeries(name);
+    fSeries.insert(name, series);
+    return series;
 }
 
-void BaseScene3D::updateZScaleValues()
+PointSeries *BaseScene3D::pointSeries(const QString &name) const
 {
-    updateZScaleValues(fScalesSettings[slZ].start, fScalesSettings[slZ].start + fScalesSettings[slZ].length, fScalesSettings[slZ].step, fScalesSettings[slZ].precision);
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<PointSeries*>(fSeries.value(name));
 }
 
-void BaseScene3D::updateZScaleValues(float start, float end, float step, int precision)
+RollingSeries *BaseScene3D::addRollingSeries(const QString &name, int capacity)
 {
-    fScalesSettings[slZ].start = start;
-    fScalesSettings[slZ].length = end - start;
-    fScalesSettings[slZ].step = step;
-    fScalesSettings[slZ].precision = precision;
-
-    {
-        QPainter painter;
-        int imageH = LOGICAL_COEF * fSpaceData.zLength;
-        int w = LOGICAL_COEF;
-        QStringList vList;
-        float v = start;
-        while (v <= end + EPSILON) {
-            vList.append(QString("%1").arg(v, 0, 'f', precision));
-            v += step;
-        }
+    QMutexLocker locker(&fSeriesMutex);
+    if (fSeries.contains(name))
+        return dynamic_cast<RollingSeries*>(fSeries.value(name));
 
-        QImage image(w, imageH, QImage::Format_ARGB32);
-        image.fill(QColor(255,255,255,0));
-        float h = imageH * (step / fScalesSettings[slZ].length);
-        painter.begin(&image);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-        for (int i = 0; i < vList.count(); i++) {
-            float y = imageH - h * i;
-            Qt::Alignment tAlign = Qt::AlignRight;
-            if (i == 0) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else if (i == vList.count() - 1) {
-                tAlign |= Qt::AlignTop;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(0, y, w - 2, h);
-            painter.drawText(r, tAlign, vList[i]);
-        }
-        painter.end();
-
-        QImage inverseImage(w, imageH, QImage::Format_ARGB32);
-        inverseImage.fill(QColor(255,255,255,0));
-        painter.begin(&inverseImage);
-        painter.setFont(fScaleFont);
-        painter.setPen(fScaleColor);
-        for (int i = 0; i < vList.count(); i++) {
-            float y = imageH - h * i;
-            Qt::Alignment tAlign = Qt::AlignLeft;
-            if (i == 0) {
-                tAlign |= Qt::AlignBottom;
-                y -= h;
-            }
-            else if (i == vList.count() - 1) {
-                tAlign |= Qt::AlignTop;
-            }
-            else {
-                tAlign |= Qt::AlignVCenter;
-                y -= (h / 2);
-            }
-
-            QRectF r(2, y, w - 2, h);
-            painter.drawText(r, tAlign, vList[i]);
-        }
-        painter.end();
+    RollingSeries *series = new RollingSeries(name, capacity);
+    fSeries.insert(name, series);
+    return series;
+}
 
-        if (zScaleTextureRight)
-            delete zScaleTextureRight;
+RollingSeries *BaseScene3D::rollingSeries(const QString &name) const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<RollingSeries*>(fSeries.value(name));
+}
 
-        zScaleTextureRight = new QOpenGLTexture(image.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        zScaleTextureRight->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
-        if (zScaleTextureLeft)
-            delete zScaleTextureLeft;
+SpriteSeries *BaseScene3D::addSpriteSeries(const QString &name)
+{
+    QMutexLocker locker(&fSeriesMutex);
+    if (fSeries.contains(name))
+        return dynamic_cast<SpriteSeries*>(fSeries.value(name));
 
-        zScaleTextureLeft = new QOpenGLTexture(inverseImage.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
-        zScaleTextureLeft->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
-    }
+    SpriteSeries *series = new SpriteSeries(name);
+    fSeries.insert(name, series);
+    return series;
 }
 
-void BaseScene3D::setXScaleRange(GLfloat start, GLfloat end)
+SpriteSeries *BaseScene3D::spriteSeries(const QString &name) const
 {
-    axisXStart = start;
-    axisXEnd = end;
-    if (fArrowX) {
-        fArrowX->setStart(axisXEnd, 0, 0);
-        fArrowX->setLength(axisXEnd - axisXStart);
-    }
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<SpriteSeries*>(fSeries.value(name));
 }
 
-void BaseScene3D::updateXScaleValues()
+PolylineSeries *BaseScene3D::addPolylineSeries(const QString &name)
 {
-    updateXScaleValues(fScalesSettings[slX].start, fScalesSettings[slX].start + fScalesSettings[slX].length, fScalesSettings[slX].step, fScalesSettings[slX].precision);
-}
+    QMutexLocker locker(&fSeriesMutex);
+    if (fSeries.contains(name))
+        return dynamic_cast<PolylineSeries*>(fSeries.value(name));
 
-BaseScene3D::BaseScene3D(QWidget* pwgt) : QOpenGLWidget(pwgt), fSettings("view3DSettings", QStringLiteral("3D view settings")), fScaleFont("Arial",10),
-	xRotate(-45), yRotate(0), zRotate(45), zTransl(0), nScale(1), xTransl(0), yTransl(0), zCam(-6), axisXStart(-3.0f), axisXEnd(3.0f)
-{    
-    rBut = false;    
-    light = false;
-    fSmooth = false;
-    pManager = nullptr;
-    fArrowX = nullptr;
-    fMoveMode = mmObjectMode;
+    PolylineSeries *series = new PolylineSeries(name);
+    fSeries.insert(name, series);
+    return series;
+}
 
-    setFocusPolicy(Qt::StrongFocus);
+PolylineSeries *BaseScene3D::polylineSeries(const QString &name) const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<PolylineSeries*>(fSeries.value(name));
+}
 
-    xScaleTextureRight = nullptr;
-    xScaleTextureLeft = nullptr;
-    xInverseScaleTextureRight = nullptr;
-    xInverseScaleTextureLeft = nullptr;
+WaterfallSeries *BaseScene3D::addWaterfallSeries(const QString &name, int columns, int rows)
+{
+    QMutexLocker locker(&fSeriesMutex);
+    if (fSeries.contains(name))
+        return dynamic_cast<WaterfallSeries*>(fSeries.value(name));
 
-    yScaleTextureRight = nullptr;
-    yScaleTextureLeft = nullptr;
-    yInverseScaleTextureRight = nullptr;
-    yInverseScaleTextureLeft = nullptr;
+    WaterfallSeries *series = new WaterfallSeries(name, columns, rows);
+    fSeries.insert(name, series);
+    return series;
+}
 
-    zScaleTextureRight = nullptr;
-    zScaleTextureLeft = nullptr;
+WaterfallSeries *BaseScene3D::waterfallSeries(const QString &name) const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<WaterfallSeries*>(fSeries.value(name));
+}
 
-    fScalesPlaneSettings[spXY].visible = true;
-    fScalesPlaneSettings[spXY].offset = 2.995f;
+OctreeSeries *BaseScene3D::addOctreeSeries(const QString &name, const QString &path)
+{
+    OctreeSeries *series;
+    {
+        QMutexLocker locker(&fSeriesMutex);
+        if (fSeries.contains(name))
+            return dynamic_cast<OctreeSeries*>(fSeries.value(name));
+
+        series = new OctreeSeries(name);
+        if (!series->open(path)) {
+            delete series;
+            return nullptr;
+        }
+        series->setLoadedCallback([this]() { postDataChanged(); });
+        fSeries.insert(name, series);
+    }
 
-    fScalesPlaneSettings[spYZ].visible = true;
-    fScalesPlaneSettings[spYZ].offset = 5.995f;
+    // куб октодерева становится пространством сцены
+    const QVector3D min = series->octree().boundsMin();
+    const float size = series->octree().boundsSize();
+    setSpaceData(min.x(), min.y(), min.z(), size, size, size);
+    return series;
+}
 
-    fScalesPlaneSettings[spXZ].visible = true;
-    fScalesPlaneSettings[spXZ].offset = 2.995f;
+OctreeSeries *BaseScene3D::octreeSeries(const QString &name) const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<OctreeSeries*>(fSeries.value(name));
+}
 
-    fScalesSettings[slX].start = -3.0f;
-    fScalesSettings[slX].length = 6.0f;
-    fScalesSettings[slX].step = 0.25f;
+IsoSurfaceSeries *BaseScene3D::addIsoSurfaceSeries(const QString &name)
+{
+    QMutexLocker locker(&fSeriesMutex);
+    if (fSeries.contains(name))
+        return dynamic_cast<IsoSurfaceSeries*>(fSeries.value(name));
+
+    IsoSurfaceSeries *series = new IsoSurfaceSeries(name);
+    const SpaceData space = spaceData();
+    series->setGeometry(QVector3D(space.x, space.y, space.z), QVector3D(space.xLength, space.yLength, space.zLength));
+    series->setExtractedCallback([this]() { postDataChanged(); });
+    fSeries.insert(name, series);
+    return series;
+}
 
-    fScalesSettings[slY].start = -3.0f;
-    fScalesSettings[slY].length = 6.0f;
-    fScalesSettings[slY].step = 0.25f;
+IsoSurfaceSeries *BaseScene3D::isoSurfaceSeries(const QString &name) const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<IsoSurfaceSeries*>(fSeries.value(name));
+}
 
-    fScalesSettings[slZ].start = -3.0f;
-    fScalesSettings[slZ].length = 6.0f;
-    fScalesSettings[slZ].step = 0.25f;
+VolumeSliceSeries *BaseScene3D::addVolumeSliceSeries(const QString &name)
+{
+    QMutexLocker locker(&fSeriesMutex);
+    if (fSeries.contains(name))
+        return dynamic_cast<VolumeSliceSeries*>(fSeries.value(name));
+
+    VolumeSliceSeries *series = new VolumeSliceSeries(name);
+    const SpaceData space = spaceData();
+    series->setGeometry(QVector3D(space.x, space.y, space.z), QVector3D(space.xLength, space.yLength, space.zLength));
+    series->setLoadedCallback([this]() { postDataChanged(); });
+    fSeries.insert(name, series);
+    return series;
+}
 
-    setSpaceData(-3, -3, -3, 6, 6, 6);
+VolumeSliceSeries *BaseScene3D::volumeSliceSeries(const QString &name) const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<VolumeSliceSeries*>(fSeries.value(name));
 }
 
-BaseScene3D::~BaseScene3D()
+VoxelGridSeries *BaseScene3D::addVoxelGridSeries(const QString &name, int nx, int ny, int nz)
 {
-    if (pManager)
-        delete pManager;
+    QMutexLocker locker(&fSeriesMutex);
+    if (fSeries.contains(name))
+        return dynamic_cast<VoxelGridSeries*>(fSeries.value(name));
+
+    VoxelGridSeries *series = new VoxelGridSeries(name, nx, ny, nz);
+    const SpaceData space = spaceData();
+    series->setGeometry(QVector3D(space.x, space.y, space.z), QVector3D(space.xLength, space.yLength, space.zLength));
+    fSeries.insert(name, series);
+    return series;
+}
 
-    if (xScaleTextureRight)
-        delete xScaleTextureRight;
-    if (xScaleTextureLeft)
-        delete xScaleTextureLeft;
+VoxelGridSeries *BaseScene3D::voxelGridSeries(const QString &name) const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<VoxelGridSeries*>(fSeries.value(name));
+}
 
-    if (xInverseScaleTextureRight)
-        delete xInverseScaleTextureRight;
-    if (xInverseScaleTextureLeft)
-        delete xInverseScaleTextureLeft;
+SnapshotSeries *BaseScene3D::addSnapshotSeries(const QString &name)
+{
+    QMutexLocker locker(&fSeriesMutex);
+    if (fSeries.contains(name))
+        return dynamic_cast<SnapshotSeries*>(fSeries.value(name));
 
-    if (yScaleTextureRight)
-        delete yScaleTextureRight;
-    if (yScaleTextureLeft)
-        delete yScaleTextureLeft;
+    SnapshotSeries *series = new SnapshotSeries(name);
+    fSeries.insert(name, series);
+    return series;
+}
 
-    if (yInverseScaleTextureRight)
-        delete yInverseScaleTextureRight;
-    if (yInverseScaleTextureLeft)
-        delete yInverseScaleTextureLeft;
+SnapshotSeries *BaseScene3D::snapshotSeries(const QString &name) const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    return dynamic_cast<SnapshotSeries*>(fSeries.value(name));
+}
 
-    if (zScaleTextureRight)
-        delete zScaleTextureRight;
-    if (zScaleTextureLeft)
-        delete zScaleTextureLeft;
+QStringList BaseScene3D::seriesNames() const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    return fSeries.keys();
 }
 
-void BaseScene3D::initializeGL() // инициализация
+void BaseScene3D::setTimeWindow(double from, double to)
 {
-   initializeOpenGLFunctions();
-
-   QColor clearColor = BackgroundColor;
-   glClearColor(clearColor.redF(),clearColor.greenF(),clearColor.blueF(),clearColor.alphaF());         // цвет для очистки буфера изображения - здесь просто фон окна
-   glEnable(GL_DEPTH_TEST);          // устанавливает режим проверки глубины объектов   
-   glFrontFace(GL_CW);               // обход вершин против часовой стрелки (GL_CCW - по часовой)
-
-   fShaderAvailable = hasOpenGLFeature(QOpenGLFunctions::Shaders);
-   fVertexBufferAvailable = hasOpenGLFeature(QOpenGLFunctions::Buffers);
-
-#ifdef QT_DEBUG
-   if (!fVertexBufferAvailable)
-       qDebug() << "!!! Vertex and index buffer functions are NOT available!!!";
-
-   if (!hasOpenGLFeature(QOpenGLFunctions::FixedFunctionPipeline))
-       qDebug() << "!!! The fixed function pipeline is NOT available.";
-
-   if (!fShaderAvailable)
-       qDebug() << "!!! Shader functions are NOT available!!!";
-
-   qDebug() << format();
-   QString vendor, renderer, version, glslVersion;
-   const GLubyte *p;
-   if ((p = glGetString(GL_VENDOR)))
-       vendor = QString::fromLatin1(reinterpret_cast<const char *>(p));
-   if ((p = glGetString(GL_RENDERER)))
-       renderer = QString::fromLatin1(reinterpret_cast<const char *>(p));
-   if ((p = glGetString(GL_VERSION)))
-       version = QString::fromLatin1(reinterpret_cast<const char *>(p));
-   if ((p = glGetString(GL_SHADING_LANGUAGE_VERSION)))
-       glslVersion = QString::fromLatin1(reinterpret_cast<const char *>(p));
-   qDebug() << "vendor:" << vendor;
-   qDebug() << "renderer:" << renderer;
-   qDebug() << "version:" << version;
-   qDebug() << "glslVersion:" << glslVersion;
-#endif
-
-   if (fShaderAvailable && fVertexBufferAvailable) {
-       pManager = new PrimitiveManager();
-       pManager->compileShaders(":/BaseShaders/Lib/base_vsh.vert", ":/BaseShaders/Lib/base_fsh.frag");
-
-       fArrowX = dynamic_cast<PrimitiveSimpleArrow*>(pManager->addSimpleArrow(6,  axisXEnd - axisXStart, 0.20f, 0.05f, QVector3D(1,0,0)));
-       fArrowX->setPos(QVector3D(axisXStart,0,0));
-       fArrowX->setColor(Qt::gray);
-
-       Primitive *p = pManager->addSimpleArrow(6, 6, 0.20f, 0.05f, QVector3D(0,1,0));
-       p->setPos(QVector3D(0,-3,0));
-       p->setColor(Qt::gray);
-       p->setDrawType(dtWireFrame);
-
-       p = pManager->addSimpleArrow(6, 6, 0.20f, 0.05f);
-       p->setPos(QVector3D(0,0,-3));
-       p->setColor(Qt::gray);
-       p->setDrawType(dtWireFrame);
-   }
-   updateXScaleValues(-6, 6, 0.5f, 2);
-   updateYScaleValues(-3, 3, 0.25f, 2);
-   updateZScaleValues(-3, 3, 0.25f, 2);
+    {
+        QMutexLocker locker(&fSeriesMutex);
+        for (DataSeries *series : fSeries) {
+            PointSeries *points = dynamic_cast<PointSeries*>(series);
+            if (points)
+                points->setTimeWindow(from, to);
+        }
+    }
+    requestFrame(FrameScheduler::urData);
 }
 
-void BaseScene3D::resizeGL(int nWidth, int nHeight) // окно виджета
+void BaseScene3D::clearTimeWindow()
 {
-   glMatrixMode(GL_PROJECTION);                     // устанавливает текущей проекционную матрицу
-   glLoadIdentity();                                // присваивает проекционной матрице единичную матрицу
+    {
+        QMutexLocker locker(&fSeriesMutex);
+        for (DataSeries *series : fSeries) {
+            PointSeries *points = dynamic_cast<PointSeries*>(series);
+            if (points)
+                points->clearTimeWindow();
+        }
+    }
+    requestFrame(FrameScheduler::urData);
+}
 
-   GLfloat aspect = (GLfloat)nWidth / (GLfloat)nHeight;
+bool BaseScene3D::seriesBounds(QVector3D *min, QVector3D *max) const
+{
+    QMutexLocker locker(&fSeriesMutex);
+    bool found = false;
+    for (DataSeries *series : fSeries) {
+        QVector3D lo, hi;
+        if (!series->isVisible() || !series->bounds(&lo, &hi))
+            continue;
+        if (!found) {
+            *min = lo;
+            *max = hi;
+            found = true;
+            continue;
+        }
+        *min = QVector3D(qMin(min->x(), lo.x()), qMin(min->y(), lo.y()), qMin(min->z(), lo.z()));
+        *max = QVector3D(qMax(max->x(), hi.x()), qMax(max->y(), hi.y()), qMax(max->z(), hi.z()));
+    }
+    return found;
+}
 
-   // поле просмотра
-   glViewport(0, 0, (GLint)nWidth, (GLint)nHeight);
-   qgluPerspective(60.0, aspect, 1.0, 250.0);
+bool BaseScene3D::fitSpaceData()
+{
+    QVector3D min, max;
+    if (!seriesBounds(&min, &max))
+        return false;
+
+    // вырожденная ось получает небольшую толщину
+    const QVector3D size = max - min;
+    const float minLength = qMax(1e-3f, qMax(size.x(), qMax(size.y(), size.z())) * 1e-3f);
+    setSpaceData(min.x(), min.y(), min.z(), qMax(size.x(), minLength), qMax(size.y(), minLength), qMax(size.z(), minLength));
+    return true;
 }
 
-void BaseScene3D::paintGL()
+void BaseScene3D::setAutoFit(bool enabled, float margin)
 {
-    {
-        QPainter painter(this);
-        painter.beginNativePainting();
+    fAutoFit = enabled;
+    fAutoFitMargin = qBound(0.0f, margin, 1.0f);
+    if (enabled)
+        requestFrame(FrameScheduler::urData);
+}
 
-        prepareView();
+// шаг 1, 2 или 5 * 10^n, не меньше value
+static float niceStep(float value)
+{
+    const float decade = std::pow(10.0f, std::floor(std::log10(value)));
+    const float f = value / decade;
+    return (f <= 1.0f ? 1.0f : f <= 2.0f ? 2.0f : f <= 5.0f ? 5.0f : 10.0f) * decade;
+}
 
-        QMatrix4x4 pmvMatrix;
-        pmvMatrix.perspective(60.0, (GLfloat)width() / (GLfloat)height(), 1.0, 250.0);
-        pmvMatrix.translate(0.0f, 0.0f, zCam);
-        pmvMatrix.rotate(xRotate, 1.0f, 0.0f, 0.0f);            // поворот вокруг оси X
-        pmvMatrix.rotate(yRotate, 0.0f, 1.0f, 0.0f);            // поворот вокруг оси Y
-        pmvMatrix.rotate(zRotate, 0.0f, 0.0f, 1.0f);            // поворот вокруг оси Z
-        pmvMatrix.translate(xTransl, yTransl, zTransl);
-        pmvMatrix.scale(nScale, nScale, nScale);
+void BaseScene3D::autoFitSpace()
+{
+    QVector3D min, max;
+    if (!seriesBounds(&min, &max))
+        return;
+
+    const SpaceData space = spaceData();
+    const float lo[3] = { min.x(), min.y(), min.z() };
+    const float hi[3] = { max.x(), max.y(), max.z() };
+    const float spaceStart[3] = { space.x, space.y, space.z };
+    const float spaceLength[3] = { space.xLength, space.yLength, space.zLength };
+    const float largest = qMax(hi[0] - lo[0], qMax(hi[1] - lo[1], hi[2] - lo[2]));
+    const float minLength = qMax(1e-3f, largest * 1e-3f);
+
+    float start[3], length[3], step[3];
+    bool refit = false;
+    for (int k = 0; k < 3; k++) {
+        const float span = qMax(hi[k] - lo[k], minLength);
+        const float margin = span * fAutoFitMargin;
+        step[k] = niceStep(span * (1.0f + 2.0f * fAutoFitMargin) / AUTOFIT_TICKS);
+        start[k] = std::floor((lo[k] - margin) / step[k]) * step[k];
+        length[k] = std::ceil((hi[k] + margin) / step[k]) * step[k] - start[k];
+
+        // полоса гистерезиса: данные внутри пространства и занимают заметную его часть
+        const bool outside = lo[k] < spaceStart[k] || hi[k] > spaceStart[k] + spaceLength[k];
+        const bool small = span < spaceLength[k] * AUTOFIT_SHRINK;
+        refit = refit || outside || small;
+    }
+    if (!refit)
+        return;
+
+    const bool same = start[0] == space.x && start[1] == space.y && start[2] == space.z
+            && length[0] == space.xLength && length[1] == space.yLength && length[2] == space.zLength;
+    if (same)
+        return;
+
+    setSpaceData(start[0], start[1], start[2], length[0], length[1], length[2]);
+    for (int k = 0; k < slCount; k++) {
+        fScalesSettings[k].start = start[k];
+        fScalesSettings[k].length = length[k];
+        fScalesSettings[k].step = step[k];
+        fScalesSettings[k].precision = qMax(0, -int(std::floor(std::log10(step[k]))));
+    }
+    update3DView();
+}
 
-        drawAxis(pmvMatrix);                                      // рисование осей координат
-        drawScales(pmvMatrix);
+void BaseScene3D::removeSeries(const QString &name)
+{
+    DataSeries *series;
+    {
+        // после удаления из списка поток отрисовки серию уже не увидит
+        QMutexLocker locker(&fSeriesMutex);
+        series = fSeries.take(name);
+    }
+    if (!series)
+        return;
+
+    makeCurrent();
+    series->releaseGL();
+    doneCurrent();
+    delete series;
+    requestFrame(FrameScheduler::urData);
+}
 
-        paintData(pmvMatrix);
+void BaseScene3D::drawSeries(const QMatrix4x4 &pmvMatrix)
+{
+    // программа и буферы общие для контекстов виджета и потока отрисовки
+    QMutexLocker locker(&fSeriesMutex);
+    for (DataSeries *series : fSeries)
+        series->draw(baseProgram(), pmvMatrix);
+}
 
-        drawScales(pmvMatrix);
+void BaseScene3D::postDataChanged()
+{
+    if (fDataPosted.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(this, "dataChanged", Qt::QueuedConnection);
+}
 
+void BaseScene3D::startCapture(FrameCapture::FrameCallback callback)
+{
+    makeCurrent();
+    if (!fCapture) {
+        fCapture = new FrameCapture();
+        fCapture->initialize();
     }
-   QFont font("Arial", 14);
-   QColor textColor = ScaleMarkColor;
-   renderText(axisXEnd + 0.1f, 0, 0, "X", font, textColor);
-   renderText(0, 3 + 0.1f, 0, "Y", font, textColor);
-   renderText(0, 0, 3 + 0.2f, "Z", font, textColor);
+    fCapture->setFrameCallback(callback);
+    doneCurrent();
+}
 
-   drawText();
+void BaseScene3D::stopCapture()
+{
+    if (!fCapture)
+        return;
+
+    makeCurrent();
+    delete fCapture;   // отдаёт оставшиеся кадры
+    fCapture = nullptr;
+    doneCurrent();
 }
 
 void BaseScene3D::mousePressEvent(QMouseEvent* pe)
@@ -637,19 +550,16 @@ void BaseScene3D::mouseReleaseEvent(QMouseEvent* pe)
 
 void BaseScene3D::mouseMoveEvent(QMouseEvent* pe)
 {
-    if (rBut){
-        xRotate += 180 / nScale * (GLfloat)(pe->y() - ptrMousePosition.y()) / height();
-        zRotate += 180 / nScale * (GLfloat)(pe->x() - ptrMousePosition.x()) / width();
-        ptrMousePosition = pe->pos();
-
-        if (xRotate > 0.0f)
-            xRotate = 0.0f;
-        else if (xRotate < -180.0f)
-            xRotate = -180.0f;
-    }
     isMouseMove = true;
 
-   update();
+    // без нажатой правой кнопки сцена не меняется
+    if (!rBut || !(pe->buttons() & Qt::RightButton))
+        return;
+
+    fMouseDelta += pe->pos() - ptrMousePosition;
+    ptrMousePosition = pe->pos();
+
+    requestFrame(FrameScheduler::urInput);
 }
 
 void BaseScene3D::wheelEvent(QWheelEvent* pe)
@@ -657,11 +567,46 @@ void BaseScene3D::wheelEvent(QWheelEvent* pe)
     int delta = (pe->modifiers() & Qt::ControlModifier) ? 10 : 1;
 
    if (pe->delta() > 0)
-       zCam = zCam + 0.10 * delta;
+       fWheelSteps += delta;
    else if ((pe->delta()) < 0)
-       zCam = zCam - 0.10 * delta;
+       fWheelSteps -= delta;
+   else
+       return;
+
+   requestFrame(FrameScheduler::urInput);
+}
+
+void BaseScene3D::applyPendingInput()
+{
+    if (!fMouseDelta.isNull()) {
+        fCamera.xRotate += 180 / fCamera.nScale * (GLfloat)fMouseDelta.y() / height();
+        fCamera.zRotate += 180 / fCamera.nScale * (GLfloat)fMouseDelta.x() / width();
+        fMouseDelta = QPoint();
+
+        if (fCamera.xRotate > 0.0f)
+            fCamera.xRotate = 0.0f;
+        else if (fCamera.xRotate < -180.0f)
+            fCamera.xRotate = -180.0f;
+    }
+
+    if (fWheelSteps) {
+        fCamera.zCam = fCamera.zCam + 0.10 * fWheelSteps;
+        fWheelSteps = 0;
+    }
+}
 
-   update();
+void BaseScene3D::frameDue(FrameScheduler::UpdateReasons reasons)
+{
+    if (reasons & FrameScheduler::urInput)
+        applyPendingInput();
+    if (fAutoFit && (reasons & FrameScheduler::urData))
+        autoFitSpace();
+
+    // кадр будет показан по сигналу frameReady
+    if (fRenderer)
+        fRenderer->render(viewState(), (size() * devicePixelRatioF() * fRenderScale).expandedTo(QSize(1, 1)));
+    else
+        update();
 }
 
 void BaseScene3D::keyPressEvent(QKeyEvent* pe)
@@ -743,65 +688,69 @@ void BaseScene3D::keyPressEvent(QKeyEvent* pe)
         case Qt::Key_M:
             fSmooth = !fSmooth;
         break;
+
+        default:
+            QOpenGLWidget::keyPressEvent(pe);
+            return;
    }
 
-   update();
+   requestFrame(FrameScheduler::urInput);
 }
 
 void BaseScene3D::scale_plus() // приблизить сцену
 {
-   nScale = nScale * 1.1f;
+   fCamera.nScale = fCamera.nScale * 1.1f;
 }
 
 void BaseScene3D::scale_minus() // удалиться от сцены
 {
-   nScale = nScale / 1.1f;
+   fCamera.nScale = fCamera.nScale / 1.1f;
 }
 
 void BaseScene3D::rotate_up() // повернуть сцену вверх
 {
-   xRotate += 1.0f;
-   if (xRotate > 0.0f)
-       xRotate = 0.0f;
+   fCamera.xRotate += 1.0f;
+   if (fCamera.xRotate > 0.0f)
+       fCamera.xRotate = 0.0f;
 }
 
 void BaseScene3D::rotate_down() // повернуть сцену вниз
 {
-   xRotate -= 1.0f;
-   if (xRotate < -180.0f)
-       xRotate = -180.0f;
+   fCamera.xRotate -= 1.0f;
+   if (fCamera.xRotate < -180.0f)
+       fCamera.xRotate = -180.0f;
 }
 
 void BaseScene3D::rotate_forward() // повернуть сцену вперёд
 {
-   yRotate += 1.0f;
+   fCamera.yRotate += 1.0f;
 }
 
 void BaseScene3D::rotate_backward() // повернуть сцену назад
 {
-   yRotate -= 1.0f;
+   fCamera.yRotate -= 1.0f;
 }
 
 void BaseScene3D::rotate_left() // повернуть сцену влево
 {
-   zRotate += 1.0f;
+   fCamera.zRotate += 1.0f;
 }
 
 void BaseScene3D::rotate_right() // повернуть сцену вправо
 {
-   zRotate -= 1.0f;
+   fCamera.zRotate -= 1.0f;
 }
 
 void BaseScene3D::translate_down() // транслировать сцену вниз
 {
     switch (fMoveMode) {
     case mmFirstPersonMode: {
-        yTransl += 0.05f;
+        fCamera.yTransl += 0.05f;
     }
         break;
     case mmObjectMode:
     default: {
-        yTransl -= 0.05f;
+        fCamera.yTransl -= 0.05f;
     }
         break;
     }
@@ -811,12 +760,12 @@ void BaseScene3D::translate_up() // транслировать сцену вве
 {
     switch (fMoveMode) {
     case mmFirstPersonMode: {
-        yTransl -= 0.05f;
+        fCamera.yTransl -= 0.05f;
     }
         break;
     case mmObjectMode:
     default: {
-        yTransl += 0.05f;
+        fCamera.yTransl += 0.05f;
     }
         break;
     }
@@ -826,19 +775,19 @@ void BaseScene3D::translate_left() // транслировать сцену вн
 {
     switch (fMoveMode) {
     case mmFirstPersonMode: {
-        QQuaternion zRot(qCos(qDegreesToRadians(-zRotate) / 2.0), 0, 0, qSin(qDegreesToRadians(-zRotate) / 2.0));
-        QQuaternion xRot(qCos(qDegreesToRadians(-xRotate) / 2.0), qSin(qDegreesToRadians(-xRotate) / 2.0),0,0);
-        QVector3D p = xRot.rotatedVector(QVector3D(0.0f, 0.0f, zCam)); // this
+        QQuaternion zRot(qCos(qDegreesToRadians(-fCamera.zRotate) / 2.0), 0, 0, qSin(qDegreesToRadians(-fCamera.zRotate) / 2.0));
+        QQuaternion xRot(qCos(qDegreesToRadians(-fCamera.xRotate) / 2.0), qSin(qDegreesToRadians(-fCamera.xRotate) / 2.0),0,0);
+        QVector3D p = xRot.rotatedVector(QVector3D(0.0f, 0.0f, fCamera.zCam)); // this
         p = zRot.rotatedVector(p);
         QQuaternion vRot = QQuaternion::rotationTo(QVector3D(0, 1, 0), QVector3D(1, 0, 0));
         QVector3D pT = vRot.rotatedVector(-p).normalized() * 0.05f;
-        xTransl -= pT.x();
-        yTransl -= pT.y();
+        fCamera.xTransl -= pT.x();
+        fCamera.yTransl -= pT.y();
     }
         break;
     case mmObjectMode:
     default: {
-        xTransl -= 0.05f;
+        fCamera.xTransl -= 0.05f;
     }
         break;
     }
@@ -848,844 +797,50 @@ void BaseScene3D::translate_right() // транслировать сцену в
 {
     switch (fMoveMode) {
     case mmFirstPersonMode: {
-        QQuaternion zRot(qCos(qDegreesToRadians(-zRotate) / 2.0), 0, 0, qSin(qDegreesToRadians(-zRotate) / 2.0));
-        QQuaternion xRot(qCos(qDegreesToRadians(-xRotate) / 2.0), qSin(qDegreesToRadians(-xRotate) / 2.0),0,0);
-        QVector3D p = xRot.rotatedVector(QVector3D(0.0f, 0.0f, zCam)); // this
+        QQuaternion zRot(qCos(qDegreesToRadians(-fCamera.zRotate) / 2.0), 0, 0, qSin(qDegreesToRadians(-fCamera.zRotate) / 2.0));
+        QQuaternion xRot(qCos(qDegreesToRadians(-fCamera.xRotate) / 2.0), qSin(qDegreesToRadians(-fCamera.xRotate) / 2.0),0,0);
+        QVector3D p = xRot.rotatedVector(QVector3D(0.0f, 0.0f, fCamera.zCam)); // this
         p = zRot.rotatedVector(p);
         QQuaternion vRot = QQuaternion::rotationTo(QVector3D(0, 1, 0), QVector3D(1, 0, 0));
         QVector3D pT = vRot.rotatedVector(-p).normalized() * 0.05f;
-        xTransl += pT.x();
-        yTransl += pT.y();
+        fCamera.xTransl += pT.x();
+        fCamera.yTransl += pT.y();
     }
         break;
     case mmObjectMode:
     default: {
-        xTransl += 0.05f;
+        fCamera.xTransl += 0.05f;
     }
         break;
     }
 }
 void BaseScene3D::translate_forward() // транслировать сцену вниз
 {
-   zTransl -= 0.05f;
+   fCamera.zTransl -= 0.05f;
 }
 
 void BaseScene3D::translate_backward() // транслировать сцену вверх
 {
-   zTransl += 0.05f;
+   fCamera.zTransl += 0.05f;
 }
 
 
 void BaseScene3D::defaultScene() // наблюдение сцены по умолчанию
 {
-   xRotate = -45;
-   yRotate = 0;
-   zRotate = 45;
-   zTransl = 0;
-   nScale = 1;
-   xTransl = 0;
-   yTransl = 0;
-   zCam = -6;
+   fCamera = CameraState();
 }
 
 void BaseScene3D::update3DView()
 {
+    // подписи шкал - текстуры, их пересоздание требует контекста
+    makeCurrent();
     updateXScaleValues();
     updateYScaleValues();
     updateZScaleValues();
-    update();
-}
-
-void BaseScene3D::drawAxis(const QMatrix4x4 &pmvMatrix) // построить оси координат
-{
-    if (pManager)
-        pManager->drawPrimitives(pmvMatrix);
+    doneCurrent();
+    requestFrame(FrameScheduler::urView);
 }
 
-float BaseScene3D::normalizeAngle(float angle) {
-    float a = angle;
-    if (angle < 0.0f) {
-        int m = -angle / 360.0f;
-        a = 360.0f + (a + m * 360.0f);
-    }
-    else {
-        int m = angle / 360.0f;
-        a = a - m * 360.0f;
-    }
-    return a;
-}
-
-void BaseScene3D::setCamTarget(float x, float y, float z)
-{
-    xTransl = -x;
-    yTransl = -y;
-    zTransl = -z;
-}
-
-void BaseScene3D::drawScales(const QMatrix4x4 &pvmMatrix)
-{
-    Q_UNUSED(pvmMatrix);
-
-    float zRot = normalizeAngle(zRotate);
-    float xRot = normalizeAngle(xRotate);
-
-    float xMin = qMin(fSpaceData.x, fSpaceData.x + fSpaceData.xLength);
-    float xMax = qMax(fSpaceData.x, fSpaceData.x + fSpaceData.xLength);
-
-    float yMin = qMin(fSpaceData.y, fSpaceData.y + fSpaceData.yLength);
-    float yMax = qMax(fSpaceData.y, fSpaceData.y + fSpaceData.yLength);
-
-    float zMin = qMin(fSpaceData.z, fSpaceData.z + fSpaceData.zLength);
-    float zMax = qMax(fSpaceData.z, fSpaceData.z + fSpaceData.zLength);
-
-    { //drawLines
-        glBegin(GL_LINES);
-        glLineWidth(1);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glEnable(GL_BLEND);
-        glEnable(GL_LINE_SMOOTH);
-        glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-
-        glColor3f(fGridColor.redF(), fGridColor.greenF(), fGridColor.blueF());
-
-        float xStep = fScalesSettings[slX].step / fScalesSettings[slX].length * fSpaceData.xLength;
-        float yStep = fScalesSettings[slY].step / fScalesSettings[slY].length * fSpaceData.yLength;
-        float zStep = fScalesSettings[slZ].step / fScalesSettings[slZ].length * fSpaceData.zLength;
-
-        if (fScalesPlaneSettings[spXZ].visible) {
-            // along X from Y
-            float x = fSpaceData.x;
-            while (x <= xMax  + EPSILON) { // vertucal lines
-                if (zRot < 90.0f || zRot > 270.0f) {
-                    glVertex3f(x, yMax, zMin);
-                    glVertex3f(x, yMax, zMax);
-                }
-                else {
-                    glVertex3f(x, yMin, zMin);
-                    glVertex3f(x, yMin, zMax);
-                }
-                x += xStep;
-            }
-
-            float z = fSpaceData.z;
-            while (z <= zMax  + EPSILON) { // horizontal lines
-                if (zRot < 90.0f || zRot > 270.0f) {
-                    glVertex3f(xMin, yMax, z);
-                    glVertex3f(xMax, yMax, z);
-                }
-                else {
-                    glVertex3f(xMin, yMin, z);
-                    glVertex3f(xMax, yMin, z);
-                }
-                z += zStep;
-            }
-        }
-
-        if (fScalesPlaneSettings[spYZ].visible) {
-            float y = fSpaceData.y;
-            while (fScalesSettings[slY].step > 0.0f ? y <= yMax + EPSILON : y >= yMin + EPSILON) { // vertucal lines
-                if (zRot < 180.0f) {
-                    glVertex3f(xMax, y, zMin);
-                    glVertex3f(xMax, y, zMax);
-                }
-                else {
-                    glVertex3f(xMin, y, zMin);
-                    glVertex3f(xMin, y, zMax);
-                }
-                y += yStep;
-            }
-
-            float z = fSpaceData.z;
-            while (z <= zMax + EPSILON) { // horizontal lines
-                if (zRot < 180.0f) {
-                    glVertex3f(xMax, yMin, z);
-                    glVertex3f(xMax, yMax, z);
-                }
-                else {
-                    glVertex3f(xMin, yMin, z);
-                    glVertex3f(xMin, yMax, z);
-                }
-                z += zStep;
-            }
-        }
-
-        if (fScalesPlaneSettings[spXY].visible) {
-            float y = fSpaceData.y;
-            while (fScalesSettings[slY].step > 0.0f ? y <= yMax + EPSILON : y >= yMin + EPSILON) { // vertucal lines
-                if (xRot < 90.0f || xRot > 270.0f) {
-                    glVertex3f(xMin, y, zMin);
-                    glVertex3f(xMax, y, zMin);
-                }
-                else {
-                    glVertex3f(xMin, y, zMax);
-                    glVertex3f(xMax, y, zMax);
-                }
-                y += yStep;
-            }
-
-            float x = fSpaceData.x;
-            while (x <= xMax + EPSILON) { // horizontal lines
-                if (xRot < 90.0f || xRot > 270.0f)  {
-                    glVertex3f(x, yMin, zMin);
-                    glVertex3f(x, yMax, zMin);
-                }
-                else {
-                    glVertex3f(x, yMin, zMax);
-                    glVertex3f(x, yMax, zMax);
-                }
-                x += xStep;
-            }
-        }
-
-        glDisable(GL_LINE_SMOOTH);
-        glDisable(GL_BLEND);
-        glEnd();
-    }
-
-
-    if (xScaleTextureRight) {
-        glEnable(GL_TEXTURE_2D);
-        glShadeModel(GL_SMOOTH/*GL_FLAT*/);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glBlendEquation(GL_FUNC_ADD);
-        glColor3f(fScaleColor.redF(), fScaleColor.greenF(), fScaleColor.blueF());
-        bool viewFromTopToBottom = (xRot == 0.0f || xRot >= 270.0f);
-        float delta = 1.0f;
-
-        if (fScalesPlaneSettings[spXZ].visible)  {
-            if (zRot < 90.0f) {
-                if (viewFromTopToBottom) {
-                    if (xScaleTextureRight) {
-                        xScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMax, zMax);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMax, zMax + delta);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMax, zMax + delta);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMax, zMax);
-                        glEnd();
-                        xScaleTextureRight->release();
-                    }
-                }
-                else {
-                    if (xScaleTextureLeft) {
-                        xScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMax, zMin);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMax, zMin - delta);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMax, zMin - delta);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMax, zMin);
-                        glEnd();
-                        xScaleTextureLeft->release();
-                    }
-                }
-
-                if (zScaleTextureRight) {
-                    zScaleTextureRight->bind();
-                    glBegin(GL_QUADS);
-                    glTexCoord2f(1,0); glVertex3f(xMin,         yMax, zMin);
-                    glTexCoord2f(0,0); glVertex3f(xMin - delta, yMax, zMin);
-                    glTexCoord2f(0,1); glVertex3f(xMin - delta, yMax, zMax);
-                    glTexCoord2f(1,1); glVertex3f(xMin,         yMax, zMax);
-                    glEnd();
-                    zScaleTextureRight->release();
-                }
-            }
-            else if (zRot < 180.0f) {
-                if (viewFromTopToBottom) {
-                    if (xScaleTextureLeft) {
-                        xScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMin, zMax);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMin, zMax + delta);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMin, zMax + delta);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMin, zMax);
-                        glEnd();
-                        xScaleTextureLeft->release();
-                    }
-                }
-                else {
-                    if (xScaleTextureRight) {
-                        xScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMin, zMin);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMin, zMin - delta);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMin, zMin - delta);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMin, zMin);
-                        glEnd();
-                        xScaleTextureRight->release();
-                    }
-                }
-
-                if (zScaleTextureLeft) {
-                    zScaleTextureLeft->bind();
-                    glBegin(GL_QUADS);
-                    glTexCoord2f(0,0); glVertex3f(xMin,         yMin, zMin);
-                    glTexCoord2f(1,0); glVertex3f(xMin - delta, yMin, zMin);
-                    glTexCoord2f(1,1); glVertex3f(xMin - delta, yMin, zMax);
-                    glTexCoord2f(0,1); glVertex3f(xMin,         yMin, zMax);
-                    glEnd();
-                    zScaleTextureLeft->release();
-                }
-            }
-            else if (zRot < 270.0f) {
-                if (viewFromTopToBottom) {
-                    if (xInverseScaleTextureRight) {
-                        xInverseScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMin, zMax);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMin, zMax + delta);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMin, zMax + delta);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMin, zMax);
-                        glEnd();
-                        xInverseScaleTextureRight->release();
-                    }
-                }
-                else {
-                    if (xInverseScaleTextureLeft) {
-                        xInverseScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMin, zMin);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMin, zMin - delta);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMin, zMin - delta);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMin, zMin);
-                        glEnd();
-                        xInverseScaleTextureLeft->release();
-                    }
-                }
-
-                if (zScaleTextureRight) {
-                    zScaleTextureRight->bind();
-                    glBegin(GL_QUADS);
-                    glTexCoord2f(1,0); glVertex3f(xMax,         yMin, zMin);
-                    glTexCoord2f(0,0); glVertex3f(xMax + delta, yMin, zMin);
-                    glTexCoord2f(0,1); glVertex3f(xMax + delta, yMin, zMax);
-                    glTexCoord2f(1,1); glVertex3f(xMax,         yMin, zMax);
-                    glEnd();
-                    zScaleTextureRight->release();
-                }
-            }
-            else /*if (zRot < 360.0f)*/ {
-                if (viewFromTopToBottom) {
-                    if (xInverseScaleTextureLeft) {
-                        xInverseScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMax, zMax);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMax, zMax + delta);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMax, zMax + delta);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMax, zMax);
-                        glEnd();
-                        xInverseScaleTextureLeft->release();
-                    }
-                }
-                else {
-                    if (xInverseScaleTextureRight) {
-                        xInverseScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMax, zMin);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMax, zMin - delta);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMax, zMin - delta);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMax, zMin);
-                        glEnd();
-                        xInverseScaleTextureRight->release();
-                    }
-                }
-
-                if (zScaleTextureLeft) {
-                    zScaleTextureLeft->bind();
-                    glBegin(GL_QUADS);
-                    glTexCoord2f(0,0); glVertex3f(xMax,         yMax, zMin);
-                    glTexCoord2f(1,0); glVertex3f(xMax + delta, yMax, zMin);
-                    glTexCoord2f(1,1); glVertex3f(xMax + delta, yMax, zMax);
-                    glTexCoord2f(0,1); glVertex3f(xMax,         yMax, zMax);
-                    glEnd();
-                    zScaleTextureLeft->release();
-                }
-            }
-        }
-
-        if (fScalesPlaneSettings[spYZ].visible) {
-            if (zRot < 90.0f) {
-                if (viewFromTopToBottom) {
-                    if (yScaleTextureLeft) {
-                        yScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMin, zMax + delta);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMin, zMax);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMax, zMax);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMax, zMax + delta);
-                        glEnd();
-                        yScaleTextureLeft->release();
-                    }
-                }
-                else {
-                    if (yScaleTextureRight) {
-                        yScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMin, zMin - delta);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMin, zMin);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMax, zMin);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMax, zMin - delta);
-                        glEnd();
-                        yScaleTextureRight->release();
-                    }
-                }
-
-                if (zScaleTextureLeft) {
-                    zScaleTextureLeft->bind();
-                    glBegin(GL_QUADS);
-                    glTexCoord2f(0,0); glVertex3f(xMax, yMin,         zMin);
-                    glTexCoord2f(1,0); glVertex3f(xMax, yMin - delta, zMin);
-                    glTexCoord2f(1,1); glVertex3f(xMax, yMin - delta, zMax);
-                    glTexCoord2f(0,1); glVertex3f(xMax, yMin,         zMax);
-                    glEnd();
-                    zScaleTextureLeft->release();
-                }
-            }
-            else if (zRot < 180.0f) {
-                if (viewFromTopToBottom) {
-                    if (yInverseScaleTextureRight) {
-                        yInverseScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMin, zMax + delta);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMin, zMax);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMax, zMax);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMax, zMax + delta);
-                        glEnd();
-                        yInverseScaleTextureRight->release();
-                    }
-                }
-                else {
-                    if (yInverseScaleTextureLeft) {
-                        yInverseScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMin, zMin - delta);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMin, zMin);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMax, zMin);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMax, zMin - delta);
-                        glEnd();
-                        yInverseScaleTextureLeft->release();
-                    }
-                }
-
-                if (zScaleTextureRight) {
-                    zScaleTextureRight->bind();
-                    glBegin(GL_QUADS);
-                    glTexCoord2f(1,0); glVertex3f(xMax, yMax,         zMin);
-                    glTexCoord2f(0,0); glVertex3f(xMax, yMax + delta, zMin);
-                    glTexCoord2f(0,1); glVertex3f(xMax, yMax + delta, zMax);
-                    glTexCoord2f(1,1); glVertex3f(xMax, yMax,         zMax);
-                    glEnd();
-                    zScaleTextureRight->release();
-                }
-            }
-            else if (zRot < 270.0f) {
-                if (viewFromTopToBottom) {
-                    if (yInverseScaleTextureLeft) {
-                        yInverseScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMin, zMax + delta);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMin, zMax);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMax, zMax);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMax, zMax + delta);
-                        glEnd();
-                        yInverseScaleTextureLeft->release();
-                    }
-                }
-                else {
-                    if (yInverseScaleTextureRight) {
-                        yInverseScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMin, zMin - delta);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMin, zMin);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMax, zMin);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMax, zMin - delta);
-                        glEnd();
-                        yInverseScaleTextureRight->release();
-                    }
-                }
-
-                if (zScaleTextureLeft) {
-                    zScaleTextureLeft->bind();
-                    glBegin(GL_QUADS);
-                    glTexCoord2f(0,0); glVertex3f(xMin, yMax,         zMin);
-                    glTexCoord2f(1,0); glVertex3f(xMin, yMax + delta, zMin);
-                    glTexCoord2f(1,1); glVertex3f(xMin, yMax + delta, zMax);
-                    glTexCoord2f(0,1); glVertex3f(xMin, yMax,         zMax);
-                    glEnd();
-                    zScaleTextureLeft->release();
-                }
-            }
-            else {
-                if (viewFromTopToBottom) {
-                    if (yScaleTextureRight) {
-                        yScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMin, zMax + delta);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMin, zMax);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMax, zMax);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMax, zMax + delta);
-                        glEnd();
-                        yScaleTextureRight->release();
-                    }
-                }
-                else {
-                    if (yScaleTextureLeft) {
-                        yScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMin, zMin - delta);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMin, zMin);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMax, zMin);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMax, zMin - delta);
-                        glEnd();
-                        yScaleTextureLeft->release();
-                    }
-                }
-
-                if (zScaleTextureRight) {
-                    zScaleTextureRight->bind();
-                    glBegin(GL_QUADS);
-                    glTexCoord2f(1,0); glVertex3f(xMin, yMin,         zMin);
-                    glTexCoord2f(0,0); glVertex3f(xMin, yMin - delta, zMin);
-                    glTexCoord2f(0,1); glVertex3f(xMin, yMin - delta, zMax);
-                    glTexCoord2f(1,1); glVertex3f(xMin, yMin,         zMax);
-                    glEnd();
-                    zScaleTextureRight->release();
-                }
-            }
-        }
-
-        if (fScalesPlaneSettings[spXY].visible) {
-            if (zRot < 90.0f) {
-                if (viewFromTopToBottom) {
-                    if (yScaleTextureRight) {
-                        yScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,0); glVertex3f(xMin - delta, yMin, zMin);
-                        glTexCoord2f(1,0); glVertex3f(xMin,         yMin, zMin);
-                        glTexCoord2f(1,1); glVertex3f(xMin,         yMax, zMin);
-                        glTexCoord2f(0,1); glVertex3f(xMin - delta, yMax, zMin);
-                        glEnd();
-                        yScaleTextureRight->release();
-                    }
-                    if (xScaleTextureLeft) {
-                        xScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMin,         zMin);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMin - delta, zMin);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMin - delta, zMin);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMin,         zMin);
-                        glEnd();
-                        xScaleTextureLeft->release();
-                    }
-                }
-                else {
-                    if (yInverseScaleTextureRight) {
-                        yInverseScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,1); glVertex3f(xMin - delta, yMin, zMax);
-                        glTexCoord2f(1,1); glVertex3f(xMin,         yMin, zMax);
-                        glTexCoord2f(1,0); glVertex3f(xMin,         yMax, zMax);
-                        glTexCoord2f(0,0); glVertex3f(xMin - delta, yMax, zMax);
-                        glEnd();
-                        yInverseScaleTextureRight->release();
-                    }
-                    if (xInverseScaleTextureLeft) {
-                        xInverseScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMin,         zMax);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMin - delta, zMax);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMin - delta, zMax);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMin,         zMax);
-                        glEnd();
-                        xInverseScaleTextureLeft->release();
-                    }
-                }
-            }
-            else if (zRot < 180.0f) {
-                if (viewFromTopToBottom) {
-                    if (yInverseScaleTextureLeft) {
-                        yInverseScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,1); glVertex3f(xMin - delta, yMin, zMin);
-                        glTexCoord2f(0,1); glVertex3f(xMin,         yMin, zMin);
-                        glTexCoord2f(0,0); glVertex3f(xMin,         yMax, zMin);
-                        glTexCoord2f(1,0); glVertex3f(xMin - delta, yMax, zMin);
-                        glEnd();
-                        yInverseScaleTextureLeft->release();
-                    }
-
-                    if (xScaleTextureRight) {
-                        xScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMax,         zMin);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMax + delta, zMin);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMax + delta, zMin);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMax,         zMin);
-                        glEnd();
-                        xScaleTextureRight->release();
-                    }
-                }
-                else {
-                    if (yScaleTextureLeft) {
-                        yScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,0); glVertex3f(xMin - delta, yMin, zMax);
-                        glTexCoord2f(0,0); glVertex3f(xMin,         yMin, zMax);
-                        glTexCoord2f(0,1); glVertex3f(xMin,         yMax, zMax);
-                        glTexCoord2f(1,1); glVertex3f(xMin - delta, yMax, zMax);
-                        glEnd();
-                        yScaleTextureLeft->release();
-                    }
-                    if (xInverseScaleTextureRight) {
-                        xInverseScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMax,         zMax);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMax + delta, zMax);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMax + delta, zMax);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMax,         zMax);
-                        glEnd();
-                        xInverseScaleTextureRight->release();
-                    }
-                }
-            }
-            else if (zRot < 270.0f) {
-                if (viewFromTopToBottom) {
-                    if (yInverseScaleTextureRight) {
-                        yInverseScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,1); glVertex3f(xMax + delta, yMin, zMin);
-                        glTexCoord2f(1,1); glVertex3f(xMax,         yMin, zMin);
-                        glTexCoord2f(1,0); glVertex3f(xMax,         yMax, zMin);
-                        glTexCoord2f(0,0); glVertex3f(xMax + delta, yMax, zMin);
-                        glEnd();
-                        yInverseScaleTextureRight->release();
-                    }
-                    if (xInverseScaleTextureLeft) {
-                        xInverseScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMax,         zMin);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMax + delta, zMin);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMax + delta, zMin);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMax,         zMin);
-                        glEnd();
-                        xInverseScaleTextureLeft->release();
-                    }
-                }
-                else {
-                    if (yScaleTextureRight) {
-                        yScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,0); glVertex3f(xMax + delta, yMin, zMax);
-                        glTexCoord2f(1,0); glVertex3f(xMax,         yMin, zMax);
-                        glTexCoord2f(1,1); glVertex3f(xMax,         yMax, zMax);
-                        glTexCoord2f(0,1); glVertex3f(xMax + delta, yMax, zMax);
-                        glEnd();
-                        yScaleTextureRight->release();
-                    }
-                    if (xScaleTextureLeft) {
-                        xScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMax,         zMax);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMax + delta, zMax);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMax + delta, zMax);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMax,         zMax);
-                        glEnd();
-                        xScaleTextureLeft->release();
-                    }
-                }
-            }
-            else {
-                if (viewFromTopToBottom) {
-                    if (yScaleTextureLeft) {
-                        yScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,0); glVertex3f(xMax + delta, yMin, zMin);
-                        glTexCoord2f(0,0); glVertex3f(xMax,         yMin, zMin);
-                        glTexCoord2f(0,1); glVertex3f(xMax,         yMax, zMin);
-                        glTexCoord2f(1,1); glVertex3f(xMax + delta, yMax, zMin);
-                        glEnd();
-                        yScaleTextureLeft->release();
-                    }
-                    if (xInverseScaleTextureRight) {
-                        xInverseScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,1); glVertex3f(xMin, yMin,         zMin);
-                        glTexCoord2f(0,1); glVertex3f(xMin, yMin - delta, zMin);
-                        glTexCoord2f(0,0); glVertex3f(xMax, yMin - delta, zMin);
-                        glTexCoord2f(1,0); glVertex3f(xMax, yMin,         zMin);
-                        glEnd();
-                        xInverseScaleTextureRight->release();
-                    }
-                }
-                else {
-                    if (yInverseScaleTextureLeft) {
-                        yInverseScaleTextureLeft->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,1); glVertex3f(xMax + delta, yMin, zMax);
-                        glTexCoord2f(0,1); glVertex3f(xMax,         yMin, zMax);
-                        glTexCoord2f(0,0); glVertex3f(xMax,         yMax, zMax);
-                        glTexCoord2f(1,0); glVertex3f(xMax + delta, yMax, zMax);
-                        glEnd();
-                        yInverseScaleTextureLeft->release();
-                    }
-                    if (xScaleTextureRight) {
-                        xScaleTextureRight->bind();
-                        glBegin(GL_QUADS);
-                        glTexCoord2f(1,0); glVertex3f(xMin, yMin,         zMax);
-                        glTexCoord2f(0,0); glVertex3f(xMin, yMin - delta, zMax);
-                        glTexCoord2f(0,1); glVertex3f(xMax, yMin - delta, zMax);
-                        glTexCoord2f(1,1); glVertex3f(xMax, yMin,         zMax);
-                        glEnd();
-                        xScaleTextureRight->release();
-                    }
-                }
-            }
-        }
-
-        glDisable(GL_BLEND);
-        glDisable(GL_TEXTURE_2D);
-    }
-}
-
-void BaseScene3D::prepareView()
-{
-    glMatrixMode(GL_PROJECTION);                     // устанавливает текущей проекционную матрицу
-    glLoadIdentity();                                // присваивает проекционной матрице единичную матрицу
-    GLfloat aspect = (GLfloat)width() / (GLfloat)height();
-
-    // поле просмотра
-    glViewport(0, 0, (GLint)width(), (GLint)height());
-    qgluPerspective(60.0, aspect, 1.0, 250.0);
-
-    glEnable(GL_DEPTH_TEST);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // очистка буфера изображения текущим цветом очистки и глубины
-
-    glMatrixMode(GL_MODELVIEW);                         // устанавливает положение и ориентацию матрице моделирования
-    setWorldTransform();
-}
-
-void BaseScene3D::setWorldTransform()
-{
-    glLoadIdentity();                                   // загружает единичную матрицу моделирования
-
-    // последовательные преобразования
-    glTranslatef(0.0f, 0.0f, zCam);
-
-    glRotatef(xRotate, 1.0f, 0.0f, 0.0f);            // поворот вокруг оси X
-    glRotatef(yRotate, 0.0f, 1.0f, 0.0f);            // поворот вокруг оси Y
-    glRotatef(zRotate, 0.0f, 0.0f, 1.0f);            // поворот вокруг оси Z
-
-    glTranslatef(xTransl, yTransl, zTransl);         // трансляция
-    glScalef(nScale, nScale, nScale);
-}
-
-void BaseScene3D::setInverseWorldTransform()
-{
-    glRotatef(-zRotate, 0.0f, 0.0f, 1.0f);            // поворот вокруг оси Z
-    glRotatef(-yRotate, 0.0f, 1.0f, 0.0f);            // поворот вокруг оси Y
-    glRotatef(-xRotate, 1.0f, 0.0f, 0.0f);            // поворот вокруг оси X
-}
-
-static void __gluMultMatrixVecd(const GLdouble matrix[16], const GLdouble in[4],
-              GLdouble out[4])
-{
-    int i;
-    for (i=0; i<4; i++) {
-    out[i] =
-        in[0] * matrix[0*4+i] +
-        in[1] * matrix[1*4+i] +
-        in[2] * matrix[2*4+i] +
-        in[3] * matrix[3*4+i];
-    }
-}
-
-int gluProject(GLdouble objx, GLdouble objy, GLdouble objz,
-          const GLdouble modelMatrix[16],
-          const GLdouble projMatrix[16],
-              const GLint viewport[4],
-          GLdouble *winx, GLdouble *winy, GLdouble *winz)
-{
-    double in[4];
-    double out[4];
-    in[0]=objx;
-    in[1]=objy;
-    in[2]=objz;
-    in[3]=1.0;
-    __gluMultMatrixVecd(modelMatrix, in, out);
-    __gluMultMatrixVecd(projMatrix, out, in);
-    if (in[3] == 0.0) return(GL_FALSE);
-    in[0] /= in[3];
-    in[1] /= in[3];
-    in[2] /= in[3];
-    /* Map x, y and z to range 0-1 */
-    in[0] = in[0] * 0.5 + 0.5;
-    in[1] = in[1] * 0.5 + 0.5;
-    in[2] = in[2] * 0.5 + 0.5;
-    /* Map x,y to viewport */
-    in[0] = in[0] * viewport[2] + viewport[0];
-    in[1] = in[1] * viewport[3] + viewport[1];
-    *winx=in[0];
-    *winy=in[1];
-    *winz=in[2];
-    return(GL_TRUE);
-}
-
-void BaseScene3D::renderText(float x, float y, float z, QString text, QFont &font, QColor color, Qt::Alignment textAlignment, bool scaled)
-{
-    Q_UNUSED(textAlignment);
-    GLint viewport[4];
-    GLdouble mvmatrix[16], projmatrix[16];
-    GLdouble wx,wy,wz;
-    glGetIntegerv(GL_VIEWPORT,viewport);
-    glGetDoublev(GL_MODELVIEW_MATRIX,mvmatrix);
-    glGetDoublev(GL_PROJECTION_MATRIX,projmatrix);
-    gluProject (x, y, z, mvmatrix, projmatrix, viewport, &wx, &wy, &wz);
-    wy=viewport[3]-wy;
-
-    glDisable(GL_DEPTH_TEST);
-
-    if (scaled) {
-        QPainter painter(this);
-        painter.beginNativePainting();
-        glPushMatrix();
-        glTranslatef(x, y, z);
-        setInverseWorldTransform();
-
-        glColor4f(color.redF(), color.greenF(), color.blueF(), color.alphaF());
-        font.setStyleStrategy(QFont::PreferBitmap);
-        QPainterPath path;
-        path.addText(QPointF(0, 0), font, text);
-        QList<QPolygonF> poly = path.toSubpathPolygons();
-        for (QList<QPolygonF>::iterator i = poly.begin(); i != poly.end(); ++i){
-            glBegin(GL_LINE_LOOP);
-            for (QPolygonF::iterator p = (*i).begin(); p != i->end(); ++p)
-                glVertex3f(p->rx()*0.1f, -p->ry()*0.1f, 0);
-            glEnd();
-        }
-
-        glPopMatrix();
-        painter.endNativePainting();
-    }
-    else {
-        QPainter painter(this);
-        painter.setPen(color);
-        painter.setFont(font);
-        int h = painter.fontMetrics().height();
-        int w = painter.fontMetrics().width(text);
-        QImage image(w,h,QImage::Format_ARGB32);
-        {
-            image.fill(QColor::fromRgbF(0.00f, 0.00f, 0.00f, 0.0f));
-            QPainter pi(&image);
-            pi.setPen(color);
-            pi.setFont(font);
-            pi.drawText(0,h,text);
-        }
-        painter.drawImage(wx,wy,image);
-        painter.end();
-    }
-    glEnable(GL_DEPTH_TEST);
-}
 
 void BaseScene3D::contextMenuEvent(QContextMenuEvent *event)
 {
@@ -2,13 +2,22 @@
 #define BASESCENE3D_H
 
 #include <QOpenGLWidget>
-#include <QOpenGLFunctions>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLBuffer>
-#include <QOpenGLTexture>
 
 #include "ui_basesettingswindow.h"
-#include "gl_primitives.h"
+#include "basescenecore.h"
+#include "framescheduler.h"
+#include "framecapture.h"
+#include "dataseries.h"
+#include "pointoctree.h"
+#include "isosurface.h"
+#include "volumeslice.h"
+#include "voxelgrid.h"
+#include "snapshotseries.h"
+
+class SceneRenderer;
+class QOpenGLTextureBlitter;
 
 class BaseSettings : public QObject
 {
@@ -78,7 +87,10 @@ private:
     void addSettingsItem(QString name, QVariant value, void *source);
 };
 
-class BaseScene3D : public QOpenGLWidget, protected QOpenGLFunctions
+// Data that a producer thread replaces as a whole goes to a SnapshotSeries: the
+// producer fills writeBuffer(), calls publish() and postDataChanged(), the render
+// path draws the latest published version without waiting for the producer.
+class BaseScene3D : public QOpenGLWidget, public BaseSceneCore
 {
     Q_OBJECT
 public:
@@ -90,89 +102,82 @@ public:
    BaseScene3D(QWidget* pwgt = 0);
    ~BaseScene3D();
 
-   enum ScaleLines {
-       slX = 0,
-       slY = 1,
-       slZ = 2,
-       slCount = 3
-   };
-   enum ScalePlanes {
-       spXY = 0,
-       spYZ = 1,
-       spXZ = 2,
-       spCount = 3
-   };
-
-   struct ScalePlaneSettings {
-       bool visible;
-       float offset;
-       ScalePlaneSettings() : visible(false), offset(1) {}
-   };
-
-   struct ScaleSettings {
-       float start;
-       float length;
-       float step;
-       int precision;
-       ScaleSettings() : start(1), length(1), step(1) {}
-   };
-
-   struct SpaceData {
-       float x;
-       float xLength;
-       float y;
-       float yLength;
-       float z;
-       float zLength;
-       SpaceData() : x(0), y(0), z(0), xLength(3), yLength(3), zLength(3) {}
-       SpaceData(float x, float y, float z, float xLen, float yLen, float zLen) : x(x), y(y), z(z), xLength(xLen), yLength(yLen), zLength(zLen) {}
-       SpaceData& operator=(const SpaceData& right) {
-           x = right.x;
-           xLength = right.xLength;
-           y = right.y;
-           yLength = right.yLength;
-           z = right.z;
-           zLength = right.zLength;
-           return *this;
-       }
-   };
-
-   bool shaderIsAvailable() { return fShaderAvailable; }
-   bool vertexBufferIsAvailable() { return fVertexBufferAvailable; }
-   void qgluPerspective(GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar);
-   void setXScaleRange(GLfloat start, GLfloat end);
    void setMoveMode(MoveMode mode) { fMoveMode = mode; }
-   void updateXScaleValues();
-   void updateXScaleValues(float start, float end, float step, int precision);
-   void updateYScaleValues();
-   void updateYScaleValues(float start, float end, float step, int precision);
-   void updateZScaleValues();
-   void updateZScaleValues(float start, float end, float step, int precision);
-   float normalizeAngle(float angle);
-   void setSpaceData(float x, float y, float z, float xLen, float yLen, float zLen) { fSpaceData = SpaceData(x, y, z, xLen, yLen, zLen); update(); }
-   void setCamTarget(float x, float y, float z);
+
+   FrameScheduler *frameScheduler() { return fScheduler; }
+   void setMaxFps(int fps) { fScheduler->setMaxFps(fps); }
+   void setRenderMode(FrameScheduler::RenderMode mode) { fScheduler->setRenderMode(mode); }
+   void requestFrame(FrameScheduler::UpdateReason reason) { fScheduler->requestFrame(reason); }
+
+   // захват отрисованных кадров без остановки конвейера
+   void startCapture(FrameCapture::FrameCallback callback = FrameCapture::FrameCallback());
+   void stopCapture();
+   FrameCapture *frameCapture() { return fCapture; }
+
+   // сцена рисуется в отдельном потоке, виджет только выводит готовый кадр;
+   // paintData() вызывается в потоке отрисовки, drawText() не вызывается
+   void setThreadedRendering(bool enabled);
+   bool threadedRendering() const { return fThreaded; }
+   SceneRenderer *sceneRenderer() { return fRenderer; }
+   // доля разрешения кадра в потоке отрисовки (0.1..1), кадр растягивается на виджет
+   void setRenderScale(float scale);
+   float renderScale() const { return fRenderScale; }
+
+   // серии данных, хранимые сценой; после append() вызывать dataChanged()/postDataChanged()
+   PointSeries *addPointSeries(const QString &name);   // existing series if the name is taken
+   PointSeries *pointSeries(const QString &name) const;
+   RollingSeries *addRollingSeries(const QString &name, int capacity);
+   RollingSeries *rollingSeries(const QString &name) const;
+   SpriteSeries *addSpriteSeries(const QString &name);
+   SpriteSeries *spriteSeries(const QString &name) const;
+   PolylineSeries *addPolylineSeries(const QString &name);
+   PolylineSeries *polylineSeries(const QString &name) const;
+   WaterfallSeries *addWaterfallSeries(const QString &name, int columns, int rows);
+   WaterfallSeries *waterfallSeries(const QString &name) const;
+   // файл PointOctreeBuilder; границы октодерева задают SpaceData, nullptr если файл не открыт
+   OctreeSeries *addOctreeSeries(const QString &name, const QString &path);
+   OctreeSeries *octreeSeries(const QString &name) const;
+   // изоповерхность объёма в коробке SpaceData; поверхность появляется после извлечения в фоне
+   IsoSurfaceSeries *addIsoSurfaceSeries(const QString &name);
+   IsoSurfaceSeries *isoSurfaceSeries(const QString &name) const;
+   // срез объёма с диска в коробке SpaceData; файл открывается openRaw()/openBricked() серии
+   VolumeSliceSeries *addVolumeSliceSeries(const QString &name);
+   VolumeSliceSeries *volumeSliceSeries(const QString &name) const;
+   // гистограмма точек по вокселам коробки SpaceData
+   VoxelGridSeries *addVoxelGridSeries(const QString &name, int nx, int ny, int nz);
+   VoxelGridSeries *voxelGridSeries(const QString &name) const;
+   // набор точек, заменяемый целиком потоком-производителем (снимки через тройной буфер)
+   SnapshotSeries *addSnapshotSeries(const QString &name);
+   SnapshotSeries *snapshotSeries(const QString &name) const;
+   QStringList seriesNames() const;
+   void removeSeries(const QString &name);
+
+   // просмотр истории: точечные серии рисуют только точки из окна времени
+   void setTimeWindow(double from, double to);
+   void clearTimeWindow();
+   // SpaceData по границам видимых серий (сводки кусков, точки не перебираются)
+   bool fitSpaceData();
+   // SpaceData и шкалы следуют за данными в кадрах с новыми данными: границы округляются
+   // до шага шкалы с запасом margin и меняются, только когда данные выходят за них
+   // или занимают меньше половины - подписи шкал не пересоздаются на каждом кадре
+   void setAutoFit(bool enabled, float margin = 0.1f);
+   bool autoFit() const { return fAutoFit; }
+
+   // may be called from any thread, repeated calls before the frame are merged
+   void postDataChanged();
+
+public slots:
+   void dataChanged() { fDataPosted.storeRelease(0); requestFrame(FrameScheduler::urData); }
 
 protected:
-    ScaleSettings fScalesSettings[slCount];
-    ScalePlaneSettings fScalesPlaneSettings[spCount];
     BaseSettings fSettings;
-    QFont fScaleFont;
-    QColor fScaleColor;
-    QColor fGridColor;
 
     void initializeGL();                     // метод для проведения инициализаций, связанных с OpenGL
     void resizeGL(int nWidth, int nHeight);  // метод вызывается при изменении размеров окна виджета
     void paintGL();                          // метод, чтобы заново перерисовать содержимое виджета
-    virtual void paintData(const QMatrix4x4 &pmvMatrix) { Q_UNUSED(pmvMatrix); }
-    virtual void drawText() {}
-
-    virtual void drawAxis(const QMatrix4x4 &pmvMatrix);          // построить оси координат
-    void drawScales(const QMatrix4x4&);
+    void sceneChanged() override { requestFrame(FrameScheduler::urView); }
+    void drawSeries(const QMatrix4x4 &pmvMatrix) override;
 
-    void prepareView();
-    void setWorldTransform();
-    void setInverseWorldTransform();
-    void renderText(float x, float y, float z, QString text, QFont &font, QColor color, Qt::Alignment textAlignment = Qt::AlignCenter, bool scaled = false);
     void contextMenuEvent(QContextMenuEvent *event) override;
     virtual void createViewSettings();
 
@@ -185,49 +190,28 @@ protected:
 
 private:
       MoveMode fMoveMode;
-      GLfloat xRotate;   // переменная хранит угол поворота вокруг оси X
-      GLfloat yRotate;   // переменная хранит угол поворота вокруг оси Y
-      GLfloat zRotate;   // переменная хранит угол поворота вокруг оси Z
-      GLfloat xTransl;   // переменная хранит величину трансляции оси X
-      GLfloat yTransl;   // переменная хранит величину трансляции оси Y
-      GLfloat zTransl;   // переменная хранит величину трансляции оси Z
-      GLfloat nScale;    // переменная отвечает за масштабирование обьекта
-      GLfloat zCam;
       bool light;
       bool fSmooth;
-      GLfloat axisXStart;
-      GLfloat axisXEnd;
-
-      bool fShaderAvailable;
-      bool fVertexBufferAvailable;
-
-      QOpenGLTexture *xScaleTextureRight;
-      QOpenGLTexture *xScaleTextureLeft;
-      QOpenGLTexture *xInverseScaleTextureRight;
-      QOpenGLTexture *xInverseScaleTextureLeft;
-
-      QOpenGLTexture *yScaleTextureRight;
-      QOpenGLTexture *yScaleTextureLeft;
-      QOpenGLTexture *yInverseScaleTextureRight;
-      QOpenGLTexture *yInverseScaleTextureLeft;
-
-      QOpenGLTexture *zScaleTextureRight;
-      QOpenGLTexture *zScaleTextureLeft;
-
-//	  QOpenGLShader *vertexShader;
-//	  QOpenGLShader *fragmentShader;
-//	  QOpenGLShaderProgram *program;
 
       QPoint ptrMousePosition; // переменная хранит координату указателя мыши в момент нажатия
       bool rBut;
       bool isMouseMove;
-      PrimitiveManager *pManager;
-      PrimitiveSimpleArrow *fArrowX;
+      QPoint fMouseDelta;      // перемещение мыши, накопленное до следующего кадра
+      int fWheelSteps;         // шаги колесика, накопленные до следующего кадра
+      FrameScheduler *fScheduler;
+      FrameCapture *fCapture;
+      QAtomicInt fDataPosted;  // dataChanged() is queued to the GUI thread
+      QMap<QString, DataSeries*> fSeries;
+      mutable QMutex fSeriesMutex;
+      bool fThreaded;
+      SceneRenderer *fRenderer;
+      QOpenGLTextureBlitter *fBlitter;
+      float fRenderScale;
+      bool fAutoFit;
+      float fAutoFitMargin;
 
 //      void doSelect2(int x, int y, bool multiSelect = false);
 
-      SpaceData fSpaceData;
-
       void scale_plus();       // приблизить сцену
       void scale_minus();      // удалиться от сцены
       void rotate_up();        // повернуть сцену вверх
@@ -243,9 +227,16 @@ private:
       void translate_forward(); // транслировать сцену вниз
       void translate_backward();// транслировать сцену вверх
       void defaultScene();      // наблюдение сцены по умолчанию
+      void applyPendingInput();
+      void startRenderer();
+      void stopRenderer();
+      void compositeFrame();
+      bool seriesBounds(QVector3D *min, QVector3D *max) const;
+      void autoFitSpace();
 
 private slots:
       void update3DView();
+      void frameDue(FrameScheduler::UpdateReasons reasons);
 
 signals:
       void settingsChanged(QString,QVariant);
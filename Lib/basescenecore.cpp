@@ -0,0 +1,1563 @@
+#include "basescenecore.h"
+
+#include <QPainter>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QtMath>
+#include <cstring>
+
+#include "sceneresources.h"
+#include "gl_streambuffer.h"
+
+#define LOGICAL_COEF 100.0f
+#define EPSILON 0.00001f
+
+#define BASE_VERTEX_SHADER ":/BaseShaders/Lib/base_vsh.vert"
+#define BASE_FRAGMENT_SHADER ":/BaseShaders/Lib/base_fsh.frag"
+
+const QColor BackgroundColor = Qt::white;
+const QColor ScaleMarkColor = Qt::black;
+
+QMatrix4x4 BaseSceneCore::CameraState::pmvMatrix(const QSize &viewportSize) const
+{
+    QMatrix4x4 m;
+    m.perspective(60.0, (GLfloat)viewportSize.width() / (GLfloat)viewportSize.height(), 1.0, 250.0);
+    m.translate(0.0f, 0.0f, zCam);
+    m.rotate(xRotate, 1.0f, 0.0f, 0.0f);            // поворот вокруг оси X
+    m.rotate(yRotate, 0.0f, 1.0f, 0.0f);            // поворот вокруг оси Y
+    m.rotate(zRotate, 0.0f, 0.0f, 1.0f);            // поворот вокруг оси Z
+    m.translate(xTransl, yTransl, zTransl);
+    m.scale(nScale, nScale, nScale);
+    return m;
+}
+
+BaseSceneCore::BaseSceneCore() : fScaleFont("Arial",10), axisXStart(-3.0f), axisXEnd(3.0f)
+{
+    fShaderAvailable = false;
+    fVertexBufferAvailable = false;
+    fPaintDevice = nullptr;
+    pManager = nullptr;
+    fProgram = nullptr;
+    fAxisDirty = false;
+    fStream = nullptr;
+
+    xScaleTextureRight = nullptr;
+    xScaleTextureLeft = nullptr;
+    xInverseScaleTextureRight = nullptr;
+    xInverseScaleTextureLeft = nullptr;
+
+    yScaleTextureRight = nullptr;
+    yScaleTextureLeft = nullptr;
+    yInverseScaleTextureRight = nullptr;
+    yInverseScaleTextureLeft = nullptr;
+
+    zScaleTextureRight = nullptr;
+    zScaleTextureLeft = nullptr;
+
+    fScalesPlaneSettings[spXY].visible = true;
+    fScalesPlaneSettings[spXY].offset = 2.995f;
+
+    fScalesPlaneSettings[spYZ].visible = true;
+    fScalesPlaneSettings[spYZ].offset = 5.995f;
+
+    fScalesPlaneSettings[spXZ].visible = true;
+    fScalesPlaneSettings[spXZ].offset = 2.995f;
+
+    fScalesSettings[slX].start = -3.0f;
+    fScalesSettings[slX].length = 6.0f;
+    fScalesSettings[slX].step = 0.25f;
+
+    fScalesSettings[slY].start = -3.0f;
+    fScalesSettings[slY].length = 6.0f;
+    fScalesSettings[slY].step = 0.25f;
+
+    fScalesSettings[slZ].start = -3.0f;
+    fScalesSettings[slZ].length = 6.0f;
+    fScalesSettings[slZ].step = 0.25f;
+
+    fSpaceData = SpaceData(-3, -3, -3, 6, 6, 6);
+}
+
+BaseSceneCore::~BaseSceneCore()
+{
+    releaseScene();
+}
+
+void BaseSceneCore::initializeScene()
+{
+   initializeOpenGLFunctions();
+
+   QColor clearColor = BackgroundColor;
+   glClearColor(clearColor.redF(),clearColor.greenF(),clearColor.blueF(),clearColor.alphaF());         // цвет для очистки буфера изображения - здесь просто фон окна
+   glEnable(GL_DEPTH_TEST);          // устанавливает режим проверки глубины объектов
+   glFrontFace(GL_CW);               // обход вершин против часовой стрелки (GL_CCW - по часовой)
+
+   fShaderAvailable = hasOpenGLFeature(QOpenGLFunctions::Shaders);
+   fVertexBufferAvailable = hasOpenGLFeature(QOpenGLFunctions::Buffers);
+
+#ifdef QT_DEBUG
+   if (!fVertexBufferAvailable)
+       qDebug() << "!!! Vertex and index buffer functions are NOT available!!!";
+
+   if (!hasOpenGLFeature(QOpenGLFunctions::FixedFunctionPipeline))
+       qDebug() << "!!! The fixed function pipeline is NOT available.";
+
+   if (!fShaderAvailable)
+       qDebug() << "!!! Shader functions are NOT available!!!";
+
+   qDebug() << QOpenGLContext::currentContext()->format();
+   QString vendor, renderer, version, glslVersion;
+   const GLubyte *p;
+   if ((p = glGetString(GL_VENDOR)))
+       vendor = QString::fromLatin1(reinterpret_cast<const char *>(p));
+   if ((p = glGetString(GL_RENDERER)))
+       renderer = QString::fromLatin1(reinterpret_cast<const char *>(p));
+   if ((p = glGetString(GL_VERSION)))
+       version = QString::fromLatin1(reinterpret_cast<const char *>(p));
+   if ((p = glGetString(GL_SHADING_LANGUAGE_VERSION)))
+       glslVersion = QString::fromLatin1(reinterpret_cast<const char *>(p));
+   qDebug() << "vendor:" << vendor;
+   qDebug() << "renderer:" << renderer;
+   qDebug() << "version:" << version;
+   qDebug() << "glslVersion:" << glslVersion;
+#endif
+
+   if (fShaderAvailable && fVertexBufferAvailable)
+       updateAxis();
+
+   if (fVertexBufferAvailable && !fStream) {
+       fStream = new StreamBuffer();
+       fStream->initialize();
+   }
+
+   updateXScaleValues(-6, 6, 0.5f, 2);
+   updateYScaleValues(-3, 3, 0.25f, 2);
+   updateZScaleValues(-3, 3, 0.25f, 2);
+}
+
+void BaseSceneCore::releaseScene()
+{
+    delete fStream;     // без контекста освобождается только память
+    fStream = nullptr;
+
+    SceneResources *resources = SceneResources::current();
+    if (!resources)
+        return;
+
+    // оси держат указатель на программу, поэтому освобождаются первыми
+    resources->release(fAxisKey);
+    fAxisKey.clear();
+    pManager = nullptr;
+
+    resources->release(fProgramKey);
+    fProgramKey.clear();
+    fProgram = nullptr;
+
+    for (int i = 0; i < slCount; i++) {
+        resources->release(fScaleLabelsKey[i]);
+        fScaleLabelsKey[i].clear();
+        setScaleTextures(ScaleLines(i), nullptr);
+    }
+}
+
+static PrimitiveManager *createAxis(QOpenGLShaderProgram *program, GLfloat axisXStart, GLfloat axisXEnd)
+{
+    PrimitiveManager *axis = new PrimitiveManager(program);
+
+    Primitive *p = axis->addSimpleArrow(6,  axisXEnd - axisXStart, 0.20f, 0.05f, QVector3D(1,0,0));
+    p->setPos(QVector3D(axisXStart,0,0));
+    p->setColor(Qt::gray);
+
+    p = axis->addSimpleArrow(6, 6, 0.20f, 0.05f, QVector3D(0,1,0));
+    p->setPos(QVector3D(0,-3,0));
+    p->setColor(Qt::gray);
+    p->setDrawType(dtWireFrame);
+
+    p = axis->addSimpleArrow(6, 6, 0.20f, 0.05f);
+    p->setPos(QVector3D(0,0,-3));
+    p->setColor(Qt::gray);
+    p->setDrawType(dtWireFrame);
+
+    return axis;
+}
+
+static QOpenGLShaderProgram *createProgram(const QString &vertexShaderPath, const QString &fragmentShaderPath)
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, vertexShaderPath))
+        qDebug() << "VertexShader:" << program->log();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, fragmentShaderPath))
+        qDebug() << "FragmentShader:" << program->log();
+    program->link();
+    return program;
+}
+
+void BaseSceneCore::updateAxis()
+{
+    fAxisDirty = false;
+
+    SceneResources *resources = SceneResources::current();
+    if (!resources || !fShaderAvailable || !fVertexBufferAvailable)
+        return;
+
+    if (!fProgram) {
+        fProgramKey = QByteArray("program:" BASE_VERTEX_SHADER ":" BASE_FRAGMENT_SHADER);
+        fProgram = resources->acquire<QOpenGLShaderProgram>(fProgramKey, []() { return createProgram(BASE_VERTEX_SHADER, BASE_FRAGMENT_SHADER); });
+    }
+
+    QByteArray key = QString("axis:%1:%2").arg(axisXStart).arg(axisXEnd).toUtf8();
+    QOpenGLShaderProgram *program = fProgram;
+    GLfloat start = axisXStart;
+    GLfloat end = axisXEnd;
+    PrimitiveManager *axis = resources->acquire<PrimitiveManager>(key, [=]() { return createAxis(program, start, end); });
+
+    resources->release(fAxisKey);
+    fAxisKey = key;
+    pManager = axis;
+}
+
+QByteArray BaseSceneCore::scaleLabelsKey(ScaleLines line, float start, float end, float step, int precision) const
+{
+    const float lengths[slCount] = { fSpaceData.xLength, fSpaceData.yLength, fSpaceData.zLength };
+    return QString("labels:%1:%2:%3:%4:%5:%6:%7:%8").arg(line).arg(start).arg(end).arg(step).arg(precision)
+            .arg(lengths[line]).arg(fScaleFont.toString()).arg(fScaleColor.rgba()).toUtf8();
+}
+
+void BaseSceneCore::setScaleLabels(ScaleLines line, const QByteArray &key, std::function<ScaleLabelSet*()> create)
+{
+    SceneResources *resources = SceneResources::current();
+    if (!resources)
+        return;     // нет контекста - подписи будут созданы в initializeScene
+
+    // сначала захватываем новые подписи: при том же ключе они не пересоздаются
+    ScaleLabelSet *labels = resources->acquire<ScaleLabelSet>(key, create);
+    resources->release(fScaleLabelsKey[line]);
+    fScaleLabelsKey[line] = key;
+    setScaleTextures(line, labels);
+}
+
+void BaseSceneCore::setScaleTextures(ScaleLines line, ScaleLabelSet *labels)
+{
+    QOpenGLTexture *t[ScaleLabelSet::ltCount] = { nullptr, nullptr, nullptr, nullptr };
+    if (labels)
+        for (int i = 0; i < ScaleLabelSet::ltCount; i++)
+            t[i] = labels->textures[i];
+
+    switch (line) {
+    case slX:
+        xScaleTextureRight = t[ScaleLabelSet::ltRight];
+        xScaleTextureLeft = t[ScaleLabelSet::ltLeft];
+        xInverseScaleTextureRight = t[ScaleLabelSet::ltInverseRight];
+        xInverseScaleTextureLeft = t[ScaleLabelSet::ltInverseLeft];
+        break;
+    case slY:
+        yScaleTextureRight = t[ScaleLabelSet::ltRight];
+        yScaleTextureLeft = t[ScaleLabelSet::ltLeft];
+        yInverseScaleTextureRight = t[ScaleLabelSet::ltInverseRight];
+        yInverseScaleTextureLeft = t[ScaleLabelSet::ltInverseLeft];
+        break;
+    default:
+        zScaleTextureRight = t[ScaleLabelSet::ltRight];
+        zScaleTextureLeft = t[ScaleLabelSet::ltLeft];
+        break;
+    }
+}
+
+static QOpenGLTexture *createScaleTexture(const QImage &image)
+{
+    QOpenGLTexture *texture = new QOpenGLTexture(image.mirrored(), QOpenGLTexture::DontGenerateMipMaps);
+    texture->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear,QOpenGLTexture::LinearMipMapLinear);
+    return texture;
+}
+
+void BaseSceneCore::renderScene(QPaintDevice *device, const QSize &size)
+{
+    if (fAxisDirty)
+        updateAxis();
+    if (fStream)
+        fStream->beginFrame();
+
+    fPaintDevice = device;
+    fViewportSize = size;
+    {
+        QPainter painter(fPaintDevice);
+        painter.beginNativePainting();
+
+        prepareView();
+
+        QMatrix4x4 pmvMatrix = fCamera.pmvMatrix(fViewportSize);
+
+        drawAxis(pmvMatrix);                                      // рисование осей координат
+        drawScales(pmvMatrix);
+
+        drawSeries(pmvMatrix);
+        paintData(pmvMatrix);
+
+        drawScales(pmvMatrix);
+
+    }
+   QFont font("Arial", 14);
+   QColor textColor = ScaleMarkColor;
+   renderText(axisXEnd + 0.1f, 0, 0, "X", font, textColor);
+   renderText(0, 3 + 0.1f, 0, "Y", font, textColor);
+   renderText(0, 0, 3 + 0.2f, "Z", font, textColor);
+
+   drawText();
+   fPaintDevice = nullptr;
+
+   if (fStream)
+       fStream->endFrame();
+}
+
+void BaseSceneCore::qgluPerspective(GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar)
+{
+    const GLdouble ymax = zNear * tan(fovy * M_PI / 360.0);
+    const GLdouble ymin = -ymax;
+    const GLdouble xmin = ymin * aspect;
+    const GLdouble xmax = ymax * aspect;
+    glFrustum(xmin, xmax, ymin, ymax, zNear, zFar);
+}
+
+void BaseSceneCore::updateXScaleValues(float start, float end, float step, int precision)
+{
+    fScalesSettings[slX].start = start;
+    fScalesSettings[slX].length = end - start;
+    fScalesSettings[slX].step = step;
+    fScalesSettings[slX].precision = precision;
+
+    setScaleLabels(slX, scaleLabelsKey(slX, start, end, step, precision), [=]() { return createXScaleLabels(start, end, step, precision); });
+}
+
+ScaleLabelSet *BaseSceneCore::createXScaleLabels(float start, float end, float step, int precision)
+{
+    ScaleLabelSet *labels = new ScaleLabelSet();
+    {
+        QPainter painter;
+        int imageH = LOGICAL_COEF * fSpaceData.xLength;
+        int w = LOGICAL_COEF;
+
+        QStringList viList;
+        float v = start;
+        while (v <= end + EPSILON /*|| v <= end - EPSILON*/) {
+            viList.append(QString("%1").arg(v, 0, 'f', precision));
+            v += step;
+        }
+
+        QImage imageR(w, imageH, QImage::Format_ARGB32);
+        imageR.fill(QColor(255,255,255,0));
+
+        float h = imageH * (step / fScalesSettings[slX].length);
+        painter.begin(&imageR);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+
+        for (int i = 0; i < viList.count(); i++) {
+            float y = imageH - h * i;
+            Qt::Alignment tAlign = Qt::AlignRight;
+            if (i == 0) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else if (i == viList.count() - 1) {
+                tAlign |= Qt::AlignTop;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(0, y, w - 2, h);
+            painter.drawText(r, tAlign, viList[i]);
+        }
+        painter.end();
+
+        QImage imageL(w, imageH, QImage::Format_ARGB32);
+        imageL.fill(QColor(255,255,255,0));
+        painter.begin(&imageL);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+        for (int i = 0; i < viList.count(); i++) {
+            float y = imageH - h * i;
+            Qt::Alignment tAlign = Qt::AlignLeft;
+            if (i == 0) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else if (i == viList.count() - 1) {
+                tAlign |= Qt::AlignTop;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(2, y, w - 2, h);
+            painter.drawText(r, tAlign, viList[i]);
+        }
+        painter.end();
+
+        QImage imageIR(w, imageH, QImage::Format_ARGB32);
+        imageIR.fill(QColor(255,255,255,0));
+        painter.begin(&imageIR);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+        for (int i = 0; i < viList.count(); i++) {
+            float y = h * i;
+            Qt::Alignment tAlign = Qt::AlignRight;
+            if (i == 0) {
+                tAlign |= Qt::AlignTop;
+            }
+            else if (i == viList.count() - 1) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(0, y, w - 2, h);
+            painter.drawText(r, tAlign, viList[i]);
+        }
+        painter.end();
+
+        QImage imageIL(w, imageH, QImage::Format_ARGB32);
+        imageIL.fill(QColor(255,255,255,0));
+        painter.begin(&imageIL);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+        for (int i = 0; i < viList.count(); i++) {
+            float y = h * i;
+            Qt::Alignment tAlign = Qt::AlignLeft;
+            if (i == 0) {
+                tAlign |= Qt::AlignTop;
+            }
+            else if (i == viList.count() - 1) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(2, y, w - 2, h);
+            painter.drawText(r, tAlign, viList[i]);
+        }
+        painter.end();
+
+        labels->textures[ScaleLabelSet::ltRight] = createScaleTexture(imageR);
+        labels->textures[ScaleLabelSet::ltLeft] = createScaleTexture(imageL);
+        labels->textures[ScaleLabelSet::ltInverseRight] = createScaleTexture(imageIR);
+        labels->textures[ScaleLabelSet::ltInverseLeft] = createScaleTexture(imageIL);
+    }
+    return labels;
+}
+
+void BaseSceneCore::updateYScaleValues()
+{
+    updateYScaleValues(fScalesSettings[slY].start, fScalesSettings[slY].start + fScalesSettings[slY].length, fScalesSettings[slY].step, fScalesSettings[slY].precision);
+}
+
+void BaseSceneCore::updateYScaleValues(float start, float end, float step, int precision)
+{
+    fScalesSettings[slY].start = start;
+    fScalesSettings[slY].length = end - start;
+    fScalesSettings[slY].step = step;
+    fScalesSettings[slY].precision = precision;
+
+    setScaleLabels(slY, scaleLabelsKey(slY, start, end, step, precision), [=]() { return createYScaleLabels(start, end, step, precision); });
+}
+
+ScaleLabelSet *BaseSceneCore::createYScaleLabels(float start, float end, float step, int precision)
+{
+    ScaleLabelSet *labels = new ScaleLabelSet();
+    {
+        QPainter painter;
+        int imageH = LOGICAL_COEF * fSpaceData.yLength;
+        int w = LOGICAL_COEF;
+        QStringList vList;
+        QStringList viList;
+        float v = start;
+        while (v <= end + EPSILON) {
+            viList.append(QString("%1").arg(v, 0, 'f', precision));
+            v += step;
+        }
+
+        QImage imageR(w, imageH, QImage::Format_ARGB32);
+        imageR.fill(QColor(255,255,255,0));
+        float h = imageH * (step / fScalesSettings[slY].length);
+        painter.begin(&imageR);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+        for (int i = 0; i < viList.count(); i++) {
+            float y = imageH - h * i;
+            Qt::Alignment tAlign = Qt::AlignRight;
+            if (i == 0) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else if (i == viList.count() - 1) {
+                tAlign |= Qt::AlignTop;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(0, y, w - 2, h);
+            painter.drawText(r, tAlign, viList[i]);
+        }
+        painter.end();
+
+        QImage imageL(w, imageH, QImage::Format_ARGB32);
+        imageL.fill(QColor(255,255,255,0));
+        painter.begin(&imageL);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+        for (int i = 0; i < viList.count(); i++) {
+            float y = imageH - h * i;
+            Qt::Alignment tAlign = Qt::AlignLeft;
+            if (i == 0) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else if (i == viList.count() - 1) {
+                tAlign |= Qt::AlignTop;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(2, y, w - 2, h);
+            painter.drawText(r, tAlign, viList[i]);
+        }
+        painter.end();
+
+        QImage imageIR(w, imageH, QImage::Format_ARGB32);
+        imageIR.fill(QColor(255,255,255,0));
+        painter.begin(&imageIR);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+        for (int i = 0; i < viList.count(); i++) {
+            float y = /*delta +*/ h * i;
+            Qt::Alignment tAlign = Qt::AlignRight;
+            if (i == 0)
+                tAlign |= Qt::AlignTop;
+            else if (i == viList.count() - 1) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(0, y, w - 2, h);
+            painter.drawText(r, tAlign, viList[i]);
+        }
+        painter.end();
+
+        QImage imageIL(w, imageH, QImage::Format_ARGB32);
+        imageIL.fill(QColor(255,255,255,0));
+        painter.begin(&imageIL);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+        for (int i = 0; i < viList.count(); i++) {
+            float y = h * i;
+            Qt::Alignment tAlign = Qt::AlignLeft;
+            if (i == 0)
+                tAlign |= Qt::AlignTop;
+            else if (i == viList.count() - 1) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(2, y, w - 2, h);
+            painter.drawText(r, tAlign, viList[i]);
+        }
+        painter.end();
+
+        labels->textures[ScaleLabelSet::ltRight] = createScaleTexture(imageR);
+        labels->textures[ScaleLabelSet::ltLeft] = createScaleTexture(imageL);
+        labels->textures[ScaleLabelSet::ltInverseRight] = createScaleTexture(imageIR);
+        labels->textures[ScaleLabelSet::ltInverseLeft] = createScaleTexture(imageIL);
+    }
+    return labels;
+}
+
+void BaseSceneCore::updateZScaleValues()
+{
+    updateZScaleValues(fScalesSettings[slZ].start, fScalesSettings[slZ].start + fScalesSettings[slZ].length, fScalesSettings[slZ].step, fScalesSettings[slZ].precision);
+}
+
+void BaseSceneCore::updateZScaleValues(float start, float end, float step, int precision)
+{
+    fScalesSettings[slZ].start = start;
+    fScalesSettings[slZ].length = end - start;
+    fScalesSettings[slZ].step = step;
+    fScalesSettings[slZ].precision = precision;
+
+    setScaleLabels(slZ, scaleLabelsKey(slZ, start, end, step, precision), [=]() { return createZScaleLabels(start, end, step, precision); });
+}
+
+ScaleLabelSet *BaseSceneCore::createZScaleLabels(float start, float end, float step, int precision)
+{
+    ScaleLabelSet *labels = new ScaleLabelSet();
+    {
+        QPainter painter;
+        int imageH = LOGICAL_COEF * fSpaceData.zLength;
+        int w = LOGICAL_COEF;
+        QStringList vList;
+        float v = start;
+        while (v <= end + EPSILON) {
+            vList.append(QString("%1").arg(v, 0, 'f', precision));
+            v += step;
+        }
+
+        QImage image(w, imageH, QImage::Format_ARGB32);
+        image.fill(QColor(255,255,255,0));
+        float h = imageH * (step / fScalesSettings[slZ].length);
+        painter.begin(&image);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+        for (int i = 0; i < vList.count(); i++) {
+            float y = imageH - h * i;
+            Qt::Alignment tAlign = Qt::AlignRight;
+            if (i == 0) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else if (i == vList.count() - 1) {
+                tAlign |= Qt::AlignTop;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(0, y, w - 2, h);
+            painter.drawText(r, tAlign, vList[i]);
+        }
+        painter.end();
+
+        QImage inverseImage(w, imageH, QImage::Format_ARGB32);
+        inverseImage.fill(QColor(255,255,255,0));
+        painter.begin(&inverseImage);
+        painter.setFont(fScaleFont);
+        painter.setPen(fScaleColor);
+        for (int i = 0; i < vList.count(); i++) {
+            float y = imageH - h * i;
+            Qt::Alignment tAlign = Qt::AlignLeft;
+            if (i == 0) {
+                tAlign |= Qt::AlignBottom;
+                y -= h;
+            }
+            else if (i == vList.count() - 1) {
+                tAlign |= Qt::AlignTop;
+            }
+            else {
+                tAlign |= Qt::AlignVCenter;
+                y -= (h / 2);
+            }
+
+            QRectF r(2, y, w - 2, h);
+            painter.drawText(r, tAlign, vList[i]);
+        }
+        painter.end();
+
+        labels->textures[ScaleLabelSet::ltRight] = createScaleTexture(image);
+        labels->textures[ScaleLabelSet::ltLeft] = createScaleTexture(inverseImage);
+    }
+    return labels;
+}
+
+void BaseSceneCore::setXScaleRange(GLfloat start, GLfloat end)
+{
+    axisXStart = start;
+    axisXEnd = end;
+    // оси могут быть общими с другими сценами, новая сетка создаётся при отрисовке
+    if (pManager)
+        fAxisDirty = true;
+}
+
+BaseSceneCore::ViewState BaseSceneCore::viewState() const
+{
+    ViewState state;
+    state.camera = fCamera;
+    state.space = fSpaceData;
+    for (int i = 0; i < slCount; i++)
+        state.scales[i] = fScalesSettings[i];
+    for (int i = 0; i < spCount; i++)
+        state.planes[i] = fScalesPlaneSettings[i];
+    state.scaleFont = fScaleFont;
+    state.scaleColor = fScaleColor;
+    state.gridColor = fGridColor;
+    state.axisXStart = axisXStart;
+    state.axisXEnd = axisXEnd;
+    return state;
+}
+
+static bool sameScale(const BaseSceneCore::ScaleSettings &a, const BaseSceneCore::ScaleSettings &b)
+{
+    return a.start == b.start && a.length == b.length && a.step == b.step && a.precision == b.precision;
+}
+
+void BaseSceneCore::setViewState(const ViewState &state)
+{
+    bool labelsChanged = state.scaleFont != fScaleFont || state.scaleColor != fScaleColor
+            || state.space.xLength != fSpaceData.xLength || state.space.yLength != fSpaceData.yLength
+            || state.space.zLength != fSpaceData.zLength;
+
+    fCamera = state.camera;
+    fSpaceData = state.space;
+    for (int i = 0; i < spCount; i++)
+        fScalesPlaneSettings[i] = state.planes[i];
+    fScaleFont = state.scaleFont;
+    fScaleColor = state.scaleColor;
+    fGridColor = state.gridColor;
+
+    if (state.axisXStart != axisXStart || state.axisXEnd != axisXEnd)
+        setXScaleRange(state.axisXStart, state.axisXEnd);
+
+    // подписи шкал - текстуры, пересоздаём только изменившиеся
+    const ScaleSettings &x = state.scales[slX];
+    const ScaleSettings &y = state.scales[slY];
+    const ScaleSettings &z = state.scales[slZ];
+    if (labelsChanged || !sameScale(x, fScalesSettings[slX]) || fScaleLabelsKey[slX].isEmpty())
+        updateXScaleValues(x.start, x.start + x.length, x.step, x.precision);
+    if (labelsChanged || !sameScale(y, fScalesSettings[slY]) || fScaleLabelsKey[slY].isEmpty())
+        updateYScaleValues(y.start, y.start + y.length, y.step, y.precision);
+    if (labelsChanged || !sameScale(z, fScalesSettings[slZ]) || fScaleLabelsKey[slZ].isEmpty())
+        updateZScaleValues(z.start, z.start + z.length, z.step, z.precision);
+}
+
+void BaseSceneCore::updateXScaleValues()
+{
+    updateXScaleValues(fScalesSettings[slX].start, fScalesSettings[slX].start + fScalesSettings[slX].length, fScalesSettings[slX].step, fScalesSettings[slX].precision);
+}
+
+void BaseSceneCore::drawAxis(const QMatrix4x4 &pmvMatrix) // построить оси координат
+{
+    if (pManager)
+        pManager->drawPrimitives(pmvMatrix);
+}
+
+float BaseSceneCore::normalizeAngle(float angle) {
+    float a = angle;
+    if (angle < 0.0f) {
+        int m = -angle / 360.0f;
+        a = 360.0f + (a + m * 360.0f);
+    }
+    else {
+        int m = angle / 360.0f;
+        a = a - m * 360.0f;
+    }
+    return a;
+}
+
+void BaseSceneCore::setCamTarget(float x, float y, float z)
+{
+    fCamera.xTransl = -x;
+    fCamera.yTransl = -y;
+    fCamera.zTransl = -z;
+}
+
+void BaseSceneCore::drawStreamed(GLenum mode, const QVector<GLfloat> &vertices)
+{
+    if (vertices.isEmpty())
+        return;
+
+    const GLsizeiptr bytes = vertices.count() * sizeof(GLfloat);
+    StreamBuffer::Allocation a;
+    if (fStream)
+        a = fStream->allocate(bytes);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (a.isValid()) {
+        memcpy(a.data, vertices.constData(), size_t(bytes));
+        fStream->commit(a);
+        glBindBuffer(GL_ARRAY_BUFFER, fStream->buffer());
+        glVertexPointer(3, GL_FLOAT, 0, reinterpret_cast<const GLvoid*>(a.offset));
+    }
+    else
+        glVertexPointer(3, GL_FLOAT, 0, vertices.constData());   // буфер кадра переполнен
+
+    glDrawArrays(mode, 0, vertices.count() / 3);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void BaseSceneCore::drawScales(const QMatrix4x4 &pvmMatrix)
+{
+    Q_UNUSED(pvmMatrix);
+
+    float zRot = normalizeAngle(fCamera.zRotate);
+    float xRot = normalizeAngle(fCamera.xRotate);
+
+    float xMin = qMin(fSpaceData.x, fSpaceData.x + fSpaceData.xLength);
+    float xMax = qMax(fSpaceData.x, fSpaceData.x + fSpaceData.xLength);
+
+    float yMin = qMin(fSpaceData.y, fSpaceData.y + fSpaceData.yLength);
+    float yMax = qMax(fSpaceData.y, fSpaceData.y + fSpaceData.yLength);
+
+    float zMin = qMin(fSpaceData.z, fSpaceData.z + fSpaceData.zLength);
+    float zMax = qMax(fSpaceData.z, fSpaceData.z + fSpaceData.zLength);
+
+    { //drawLines
+        // сетка зависит от камеры и строится каждый кадр
+        fGridVertices.clear();
+        auto gridVertex = [this](float x, float y, float z) { fGridVertices.append(x); fGridVertices.append(y); fGridVertices.append(z); };
+
+        float xStep = fScalesSettings[slX].step / fScalesSettings[slX].length * fSpaceData.xLength;
+        float yStep = fScalesSettings[slY].step / fScalesSettings[slY].length * fSpaceData.yLength;
+        float zStep = fScalesSettings[slZ].step / fScalesSettings[slZ].length * fSpaceData.zLength;
+
+        if (fScalesPlaneSettings[spXZ].visible) {
+            // along X from Y
+            float x = fSpaceData.x;
+            while (x <= xMax  + EPSILON) { // vertucal lines
+                if (zRot < 90.0f || zRot > 270.0f) {
+                    gridVertex(x, yMax, zMin);
+                    gridVertex(x, yMax, zMax);
+                }
+                else {
+                    gridVertex(x, yMin, zMin);
+                    gridVertex(x, yMin, zMax);
+                }
+                x += xStep;
+            }
+
+            float z = fSpaceData.z;
+            while (z <= zMax  + EPSILON) { // horizontal lines
+                if (zRot < 90.0f || zRot > 270.0f) {
+                    gridVertex(xMin, yMax, z);
+                    gridVertex(xMax, yMax, z);
+                }
+                else {
+                    gridVertex(xMin, yMin, z);
+                    gridVertex(xMax, yMin, z);
+                }
+                z += zStep;
+            }
+        }
+
+        if (fScalesPlaneSettings[spYZ].visible) {
+            float y = fSpaceData.y;
+            while (fScalesSettings[slY].step > 0.0f ? y <= yMax + EPSILON : y >= yMin + EPSILON) { // vertucal lines
+                if (zRot < 180.0f) {
+                    gridVertex(xMax, y, zMin);
+                    gridVertex(xMax, y, zMax);
+                }
+                else {
+                    gridVertex(xMin, y, zMin);
+                    gridVertex(xMin, y, zMax);
+                }
+                y += yStep;
+            }
+
+            float z = fSpaceData.z;
+            while (z <= zMax + EPSILON) { // horizontal lines
+                if (zRot < 180.0f) {
+                    gridVertex(xMax, yMin, z);
+                    gridVertex(xMax, yMax, z);
+                }
+                else {
+                    gridVertex(xMin, yMin, z);
+                    gridVertex(xMin, yMax, z);
+                }
+                z += zStep;
+            }
+        }
+
+        if (fScalesPlaneSettings[spXY].visible) {
+            float y = fSpaceData.y;
+            while (fScalesSettings[slY].step > 0.0f ? y <= yMax + EPSILON : y >= yMin + EPSILON) { // vertucal lines
+                if (xRot < 90.0f || xRot > 270.0f) {
+                    gridVertex(xMin, y, zMin);
+                    gridVertex(xMax, y, zMin);
+                }
+                else {
+                    gridVertex(xMin, y, zMax);
+                    gridVertex(xMax, y, zMax);
+                }
+                y += yStep;
+            }
+
+            float x = fSpaceData.x;
+            while (x <= xMax + EPSILON) { // horizontal lines
+                if (xRot < 90.0f || xRot > 270.0f)  {
+                    gridVertex(x, yMin, zMin);
+                    gridVertex(x, yMax, zMin);
+                }
+                else {
+                    gridVertex(x, yMin, zMax);
+                    gridVertex(x, yMax, zMax);
+                }
+                x += xStep;
+            }
+        }
+
+        glLineWidth(1);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_BLEND);
+        glEnable(GL_LINE_SMOOTH);
+        glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+
+        glColor3f(fGridColor.redF(), fGridColor.greenF(), fGridColor.blueF());
+        drawStreamed(GL_LINES, fGridVertices);
+
+        glDisable(GL_LINE_SMOOTH);
+        glDisable(GL_BLEND);
+    }
+
+
+    if (xScaleTextureRight) {
+        glEnable(GL_TEXTURE_2D);
+        glShadeModel(GL_SMOOTH/*GL_FLAT*/);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBlendEquation(GL_FUNC_ADD);
+        glColor3f(fScaleColor.redF(), fScaleColor.greenF(), fScaleColor.blueF());
+        bool viewFromTopToBottom = (xRot == 0.0f || xRot >= 270.0f);
+        float delta = 1.0f;
+
+        if (fScalesPlaneSettings[spXZ].visible)  {
+            if (zRot < 90.0f) {
+                if (viewFromTopToBottom) {
+                    if (xScaleTextureRight) {
+                        xScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMax, zMax);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMax, zMax + delta);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMax, zMax + delta);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMax, zMax);
+                        glEnd();
+                        xScaleTextureRight->release();
+                    }
+                }
+                else {
+                    if (xScaleTextureLeft) {
+                        xScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMax, zMin);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMax, zMin - delta);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMax, zMin - delta);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMax, zMin);
+                        glEnd();
+                        xScaleTextureLeft->release();
+                    }
+                }
+
+                if (zScaleTextureRight) {
+                    zScaleTextureRight->bind();
+                    glBegin(GL_QUADS);
+                    glTexCoord2f(1,0); glVertex3f(xMin,         yMax, zMin);
+                    glTexCoord2f(0,0); glVertex3f(xMin - delta, yMax, zMin);
+                    glTexCoord2f(0,1); glVertex3f(xMin - delta, yMax, zMax);
+                    glTexCoord2f(1,1); glVertex3f(xMin,         yMax, zMax);
+                    glEnd();
+                    zScaleTextureRight->release();
+                }
+            }
+            else if (zRot < 180.0f) {
+                if (viewFromTopToBottom) {
+                    if (xScaleTextureLeft) {
+                        xScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMin, zMax);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMin, zMax + delta);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMin, zMax + delta);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMin, zMax);
+                        glEnd();
+                        xScaleTextureLeft->release();
+                    }
+                }
+                else {
+                    if (xScaleTextureRight) {
+                        xScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMin, zMin);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMin, zMin - delta);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMin, zMin - delta);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMin, zMin);
+                        glEnd();
+                        xScaleTextureRight->release();
+                    }
+                }
+
+                if (zScaleTextureLeft) {
+                    zScaleTextureLeft->bind();
+                    glBegin(GL_QUADS);
+                    glTexCoord2f(0,0); glVertex3f(xMin,         yMin, zMin);
+                    glTexCoord2f(1,0); glVertex3f(xMin - delta, yMin, zMin);
+                    glTexCoord2f(1,1); glVertex3f(xMin - delta, yMin, zMax);
+                    glTexCoord2f(0,1); glVertex3f(xMin,         yMin, zMax);
+                    glEnd();
+                    zScaleTextureLeft->release();
+                }
+            }
+            else if (zRot < 270.0f) {
+                if (viewFromTopToBottom) {
+                    if (xInverseScaleTextureRight) {
+                        xInverseScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMin, zMax);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMin, zMax + delta);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMin, zMax + delta);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMin, zMax);
+                        glEnd();
+                        xInverseScaleTextureRight->release();
+                    }
+                }
+                else {
+                    if (xInverseScaleTextureLeft) {
+                        xInverseScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMin, zMin);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMin, zMin - delta);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMin, zMin - delta);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMin, zMin);
+                        glEnd();
+                        xInverseScaleTextureLeft->release();
+                    }
+                }
+
+                if (zScaleTextureRight) {
+                    zScaleTextureRight->bind();
+                    glBegin(GL_QUADS);
+                    glTexCoord2f(1,0); glVertex3f(xMax,         yMin, zMin);
+                    glTexCoord2f(0,0); glVertex3f(xMax + delta, yMin, zMin);
+                    glTexCoord2f(0,1); glVertex3f(xMax + delta, yMin, zMax);
+                    glTexCoord2f(1,1); glVertex3f(xMax,         yMin, zMax);
+                    glEnd();
+                    zScaleTextureRight->release();
+                }
+            }
+            else /*if (zRot < 360.0f)*/ {
+                if (viewFromTopToBottom) {
+                    if (xInverseScaleTextureLeft) {
+                        xInverseScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMax, zMax);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMax, zMax + delta);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMax, zMax + delta);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMax, zMax);
+                        glEnd();
+                        xInverseScaleTextureLeft->release();
+                    }
+                }
+                else {
+                    if (xInverseScaleTextureRight) {
+                        xInverseScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMax, zMin);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMax, zMin - delta);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMax, zMin - delta);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMax, zMin);
+                        glEnd();
+                        xInverseScaleTextureRight->release();
+                    }
+                }
+
+                if (zScaleTextureLeft) {
+                    zScaleTextureLeft->bind();
+                    glBegin(GL_QUADS);
+                    glTexCoord2f(0,0); glVertex3f(xMax,         yMax, zMin);
+                    glTexCoord2f(1,0); glVertex3f(xMax + delta, yMax, zMin);
+                    glTexCoord2f(1,1); glVertex3f(xMax + delta, yMax, zMax);
+                    glTexCoord2f(0,1); glVertex3f(xMax,         yMax, zMax);
+                    glEnd();
+                    zScaleTextureLeft->release();
+                }
+            }
+        }
+
+        if (fScalesPlaneSettings[spYZ].visible) {
+            if (zRot < 90.0f) {
+                if (viewFromTopToBottom) {
+                    if (yScaleTextureLeft) {
+                        yScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMin, zMax + delta);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMin, zMax);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMax, zMax);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMax, zMax + delta);
+                        glEnd();
+                        yScaleTextureLeft->release();
+                    }
+                }
+                else {
+                    if (yScaleTextureRight) {
+                        yScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMin, zMin - delta);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMin, zMin);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMax, zMin);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMax, zMin - delta);
+                        glEnd();
+                        yScaleTextureRight->release();
+                    }
+                }
+
+                if (zScaleTextureLeft) {
+                    zScaleTextureLeft->bind();
+                    glBegin(GL_QUADS);
+                    glTexCoord2f(0,0); glVertex3f(xMax, yMin,         zMin);
+                    glTexCoord2f(1,0); glVertex3f(xMax, yMin - delta, zMin);
+                    glTexCoord2f(1,1); glVertex3f(xMax, yMin - delta, zMax);
+                    glTexCoord2f(0,1); glVertex3f(xMax, yMin,         zMax);
+                    glEnd();
+                    zScaleTextureLeft->release();
+                }
+            }
+            else if (zRot < 180.0f) {
+                if (viewFromTopToBottom) {
+                    if (yInverseScaleTextureRight) {
+                        yInverseScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMin, zMax + delta);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMin, zMax);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMax, zMax);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMax, zMax + delta);
+                        glEnd();
+                        yInverseScaleTextureRight->release();
+                    }
+                }
+                else {
+                    if (yInverseScaleTextureLeft) {
+                        yInverseScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMin, zMin - delta);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMin, zMin);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMax, zMin);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMax, zMin - delta);
+                        glEnd();
+                        yInverseScaleTextureLeft->release();
+                    }
+                }
+
+                if (zScaleTextureRight) {
+                    zScaleTextureRight->bind();
+                    glBegin(GL_QUADS);
+                    glTexCoord2f(1,0); glVertex3f(xMax, yMax,         zMin);
+                    glTexCoord2f(0,0); glVertex3f(xMax, yMax + delta, zMin);
+                    glTexCoord2f(0,1); glVertex3f(xMax, yMax + delta, zMax);
+                    glTexCoord2f(1,1); glVertex3f(xMax, yMax,         zMax);
+                    glEnd();
+                    zScaleTextureRight->release();
+                }
+            }
+            else if (zRot < 270.0f) {
+                if (viewFromTopToBottom) {
+                    if (yInverseScaleTextureLeft) {
+                        yInverseScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMin, zMax + delta);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMin, zMax);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMax, zMax);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMax, zMax + delta);
+                        glEnd();
+                        yInverseScaleTextureLeft->release();
+                    }
+                }
+                else {
+                    if (yInverseScaleTextureRight) {
+                        yInverseScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMin, zMin - delta);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMin, zMin);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMax, zMin);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMax, zMin - delta);
+                        glEnd();
+                        yInverseScaleTextureRight->release();
+                    }
+                }
+
+                if (zScaleTextureLeft) {
+                    zScaleTextureLeft->bind();
+                    glBegin(GL_QUADS);
+                    glTexCoord2f(0,0); glVertex3f(xMin, yMax,         zMin);
+                    glTexCoord2f(1,0); glVertex3f(xMin, yMax + delta, zMin);
+                    glTexCoord2f(1,1); glVertex3f(xMin, yMax + delta, zMax);
+                    glTexCoord2f(0,1); glVertex3f(xMin, yMax,         zMax);
+                    glEnd();
+                    zScaleTextureLeft->release();
+                }
+            }
+            else {
+                if (viewFromTopToBottom) {
+                    if (yScaleTextureRight) {
+                        yScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMin, zMax + delta);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMin, zMax);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMax, zMax);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMax, zMax + delta);
+                        glEnd();
+                        yScaleTextureRight->release();
+                    }
+                }
+                else {
+                    if (yScaleTextureLeft) {
+                        yScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMin, zMin - delta);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMin, zMin);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMax, zMin);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMax, zMin - delta);
+                        glEnd();
+                        yScaleTextureLeft->release();
+                    }
+                }
+
+                if (zScaleTextureRight) {
+                    zScaleTextureRight->bind();
+                    glBegin(GL_QUADS);
+                    glTexCoord2f(1,0); glVertex3f(xMin, yMin,         zMin);
+                    glTexCoord2f(0,0); glVertex3f(xMin, yMin - delta, zMin);
+                    glTexCoord2f(0,1); glVertex3f(xMin, yMin - delta, zMax);
+                    glTexCoord2f(1,1); glVertex3f(xMin, yMin,         zMax);
+                    glEnd();
+                    zScaleTextureRight->release();
+                }
+            }
+        }
+
+        if (fScalesPlaneSettings[spXY].visible) {
+            if (zRot < 90.0f) {
+                if (viewFromTopToBottom) {
+                    if (yScaleTextureRight) {
+                        yScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,0); glVertex3f(xMin - delta, yMin, zMin);
+                        glTexCoord2f(1,0); glVertex3f(xMin,         yMin, zMin);
+                        glTexCoord2f(1,1); glVertex3f(xMin,         yMax, zMin);
+                        glTexCoord2f(0,1); glVertex3f(xMin - delta, yMax, zMin);
+                        glEnd();
+                        yScaleTextureRight->release();
+                    }
+                    if (xScaleTextureLeft) {
+                        xScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMin,         zMin);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMin - delta, zMin);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMin - delta, zMin);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMin,         zMin);
+                        glEnd();
+                        xScaleTextureLeft->release();
+                    }
+                }
+                else {
+                    if (yInverseScaleTextureRight) {
+                        yInverseScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,1); glVertex3f(xMin - delta, yMin, zMax);
+                        glTexCoord2f(1,1); glVertex3f(xMin,         yMin, zMax);
+                        glTexCoord2f(1,0); glVertex3f(xMin,         yMax, zMax);
+                        glTexCoord2f(0,0); glVertex3f(xMin - delta, yMax, zMax);
+                        glEnd();
+                        yInverseScaleTextureRight->release();
+                    }
+                    if (xInverseScaleTextureLeft) {
+                        xInverseScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMin,         zMax);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMin - delta, zMax);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMin - delta, zMax);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMin,         zMax);
+                        glEnd();
+                        xInverseScaleTextureLeft->release();
+                    }
+                }
+            }
+            else if (zRot < 180.0f) {
+                if (viewFromTopToBottom) {
+                    if (yInverseScaleTextureLeft) {
+                        yInverseScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,1); glVertex3f(xMin - delta, yMin, zMin);
+                        glTexCoord2f(0,1); glVertex3f(xMin,         yMin, zMin);
+                        glTexCoord2f(0,0); glVertex3f(xMin,         yMax, zMin);
+                        glTexCoord2f(1,0); glVertex3f(xMin - delta, yMax, zMin);
+                        glEnd();
+                        yInverseScaleTextureLeft->release();
+                    }
+
+                    if (xScaleTextureRight) {
+                        xScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMax,         zMin);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMax + delta, zMin);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMax + delta, zMin);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMax,         zMin);
+                        glEnd();
+                        xScaleTextureRight->release();
+                    }
+                }
+                else {
+                    if (yScaleTextureLeft) {
+                        yScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,0); glVertex3f(xMin - delta, yMin, zMax);
+                        glTexCoord2f(0,0); glVertex3f(xMin,         yMin, zMax);
+                        glTexCoord2f(0,1); glVertex3f(xMin,         yMax, zMax);
+                        glTexCoord2f(1,1); glVertex3f(xMin - delta, yMax, zMax);
+                        glEnd();
+                        yScaleTextureLeft->release();
+                    }
+                    if (xInverseScaleTextureRight) {
+                        xInverseScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMax,         zMax);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMax + delta, zMax);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMax + delta, zMax);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMax,         zMax);
+                        glEnd();
+                        xInverseScaleTextureRight->release();
+                    }
+                }
+            }
+            else if (zRot < 270.0f) {
+                if (viewFromTopToBottom) {
+                    if (yInverseScaleTextureRight) {
+                        yInverseScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,1); glVertex3f(xMax + delta, yMin, zMin);
+                        glTexCoord2f(1,1); glVertex3f(xMax,         yMin, zMin);
+                        glTexCoord2f(1,0); glVertex3f(xMax,         yMax, zMin);
+                        glTexCoord2f(0,0); glVertex3f(xMax + delta, yMax, zMin);
+                        glEnd();
+                        yInverseScaleTextureRight->release();
+                    }
+                    if (xInverseScaleTextureLeft) {
+                        xInverseScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMax,         zMin);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMax + delta, zMin);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMax + delta, zMin);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMax,         zMin);
+                        glEnd();
+                        xInverseScaleTextureLeft->release();
+                    }
+                }
+                else {
+                    if (yScaleTextureRight) {
+                        yScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,0); glVertex3f(xMax + delta, yMin, zMax);
+                        glTexCoord2f(1,0); glVertex3f(xMax,         yMin, zMax);
+                        glTexCoord2f(1,1); glVertex3f(xMax,         yMax, zMax);
+                        glTexCoord2f(0,1); glVertex3f(xMax + delta, yMax, zMax);
+                        glEnd();
+                        yScaleTextureRight->release();
+                    }
+                    if (xScaleTextureLeft) {
+                        xScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMax,         zMax);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMax + delta, zMax);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMax + delta, zMax);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMax,         zMax);
+                        glEnd();
+                        xScaleTextureLeft->release();
+                    }
+                }
+            }
+            else {
+                if (viewFromTopToBottom) {
+                    if (yScaleTextureLeft) {
+                        yScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,0); glVertex3f(xMax + delta, yMin, zMin);
+                        glTexCoord2f(0,0); glVertex3f(xMax,         yMin, zMin);
+                        glTexCoord2f(0,1); glVertex3f(xMax,         yMax, zMin);
+                        glTexCoord2f(1,1); glVertex3f(xMax + delta, yMax, zMin);
+                        glEnd();
+                        yScaleTextureLeft->release();
+                    }
+                    if (xInverseScaleTextureRight) {
+                        xInverseScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,1); glVertex3f(xMin, yMin,         zMin);
+                        glTexCoord2f(0,1); glVertex3f(xMin, yMin - delta, zMin);
+                        glTexCoord2f(0,0); glVertex3f(xMax, yMin - delta, zMin);
+                        glTexCoord2f(1,0); glVertex3f(xMax, yMin,         zMin);
+                        glEnd();
+                        xInverseScaleTextureRight->release();
+                    }
+                }
+                else {
+                    if (yInverseScaleTextureLeft) {
+                        yInverseScaleTextureLeft->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,1); glVertex3f(xMax + delta, yMin, zMax);
+                        glTexCoord2f(0,1); glVertex3f(xMax,         yMin, zMax);
+                        glTexCoord2f(0,0); glVertex3f(xMax,         yMax, zMax);
+                        glTexCoord2f(1,0); glVertex3f(xMax + delta, yMax, zMax);
+                        glEnd();
+                        yInverseScaleTextureLeft->release();
+                    }
+                    if (xScaleTextureRight) {
+                        xScaleTextureRight->bind();
+                        glBegin(GL_QUADS);
+                        glTexCoord2f(1,0); glVertex3f(xMin, yMin,         zMax);
+                        glTexCoord2f(0,0); glVertex3f(xMin, yMin - delta, zMax);
+                        glTexCoord2f(0,1); glVertex3f(xMax, yMin - delta, zMax);
+                        glTexCoord2f(1,1); glVertex3f(xMax, yMin,         zMax);
+                        glEnd();
+                        xScaleTextureRight->release();
+                    }
+                }
+            }
+        }
+
+        glDisable(GL_BLEND);
+        glDisable(GL_TEXTURE_2D);
+    }
+}
+
+void BaseSceneCore::prepareView()
+{
+    glMatrixMode(GL_PROJECTION);                     // устанавливает текущей проекционную матрицу
+    glLoadIdentity();                                // присваивает проекционной матрице единичную матрицу
+    GLfloat aspect = (GLfloat)fViewportSize.width() / (GLfloat)fViewportSize.height();
+
+    // поле просмотра
+    glViewport(0, 0, (GLint)fViewportSize.width(), (GLint)fViewportSize.height());
+    qgluPerspective(60.0, aspect, 1.0, 250.0);
+
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // очистка буфера изображения текущим цветом очистки и глубины
+
+    glMatrixMode(GL_MODELVIEW);                         // устанавливает положение и ориентацию матрице моделирования
+    setWorldTransform();
+}
+
+void BaseSceneCore::setWorldTransform()
+{
+    glLoadIdentity();                                   // загружает единичную матрицу моделирования
+
+    // последовательные преобразования
+    glTranslatef(0.0f, 0.0f, fCamera.zCam);
+
+    glRotatef(fCamera.xRotate, 1.0f, 0.0f, 0.0f);            // поворот вокруг оси X
+    glRotatef(fCamera.yRotate, 0.0f, 1.0f, 0.0f);            // поворот вокруг оси Y
+    glRotatef(fCamera.zRotate, 0.0f, 0.0f, 1.0f);            // поворот вокруг оси Z
+
+    glTranslatef(fCamera.xTransl, fCamera.yTransl, fCamera.zTransl);         // трансляция
+    glScalef(fCamera.nScale, fCamera.nScale, fCamera.nScale);
+}
+
+void BaseSceneCore::setInverseWorldTransform()
+{
+    glRotatef(-fCamera.zRotate, 0.0f, 0.0f, 1.0f);            // поворот вокруг оси Z
+    glRotatef(-fCamera.yRotate, 0.0f, 1.0f, 0.0f);            // поворот вокруг оси Y
+    glRotatef(-fCamera.xRotate, 1.0f, 0.0f, 0.0f);            // поворот вокруг оси X
+}
+
+static void __gluMultMatrixVecd(const GLdouble matrix[16], const GLdouble in[4],
+              GLdouble out[4])
+{
+    int i;
+    for (i=0; i<4; i++) {
+    out[i] =
+        in[0] * matrix[0*4+i] +
+        in[1] * matrix[1*4+i] +
+        in[2] * matrix[2*4+i] +
+        in[3] * matrix[3*4+i];
+    }
+}
+
+int gluProject(GLdouble objx, GLdouble objy, GLdouble objz,
+          const GLdouble modelMatrix[16],
+          const GLdouble projMatrix[16],
+              const GLint viewport[4],
+          GLdouble *winx, GLdouble *winy, GLdouble *winz)
+{
+    double in[4];
+    double out[4];
+    in[0]=objx;
+    in[1]=objy;
+    in[2]=objz;
+    in[3]=1.0;
+    __gluMultMatrixVecd(modelMatrix, in, out);
+    __gluMultMatrixVecd(projMatrix, out, in);
+    if (in[3] == 0.0) return(GL_FALSE);
+    in[0] /= in[3];
+    in[1] /= in[3];
+    in[2] /= in[3];
+    /* Map x, y and z to range 0-1 */
+    in[0] = in[0] * 0.5 + 0.5;
+    in[1] = in[1] * 0.5 + 0.5;
+    in[2] = in[2] * 0.5 + 0.5;
+    /* Map x,y to viewport */
+    in[0] = in[0] * viewport[2] + viewport[0];
+    in[1] = in[1] * viewport[3] + viewport[1];
+    *winx=in[0];
+    *winy=in[1];
+    *winz=in[2];
+    return(GL_TRUE);
+}
+
+void BaseSceneCore::renderText(float x, float y, float z, QString text, QFont &font, QColor color, Qt::Alignment textAlignment, bool scaled)
+{
+    Q_UNUSED(textAlignment);
+    GLint viewport[4];
+    GLdouble mvmatrix[16], projmatrix[16];
+    GLdouble wx,wy,wz;
+    glGetIntegerv(GL_VIEWPORT,viewport);
+    glGetDoublev(GL_MODELVIEW_MATRIX,mvmatrix);
+    glGetDoublev(GL_PROJECTION_MATRIX,projmatrix);
+    gluProject (x, y, z, mvmatrix, projmatrix, viewport, &wx, &wy, &wz);
+    wy=viewport[3]-wy;
+
+    glDisable(GL_DEPTH_TEST);
+
+    if (scaled) {
+        QPainter painter(fPaintDevice);
+        painter.beginNativePainting();
+        glPushMatrix();
+        glTranslatef(x, y, z);
+        setInverseWorldTransform();
+
+        glColor4f(color.redF(), color.greenF(), color.blueF(), color.alphaF());
+        font.setStyleStrategy(QFont::PreferBitmap);
+        QPainterPath path;
+        path.addText(QPointF(0, 0), font, text);
+        QList<QPolygonF> poly = path.toSubpathPolygons();
+        for (QList<QPolygonF>::iterator i = poly.begin(); i != poly.end(); ++i){
+            glBegin(GL_LINE_LOOP);
+            for (QPolygonF::iterator p = (*i).begin(); p != i->end(); ++p)
+                glVertex3f(p->rx()*0.1f, -p->ry()*0.1f, 0);
+            glEnd();
+        }
+
+        glPopMatrix();
+        painter.endNativePainting();
+    }
+    else {
+        QPainter painter(fPaintDevice);
+        painter.setPen(color);
+        painter.setFont(font);
+        int h = painter.fontMetrics().height();
+        int w = painter.fontMetrics().width(text);
+        QImage image(w,h,QImage::Format_ARGB32);
+        {
+            image.fill(QColor::fromRgbF(0.00f, 0.00f, 0.00f, 0.0f));
+            QPainter pi(&image);
+            pi.setPen(color);
+            pi.setFont(font);
+            pi.drawText(0,h,text);
+        }
+        painter.drawImage(wx,wy,image);
+        painter.end();
+    }
+    glEnable(GL_DEPTH_TEST);
+}
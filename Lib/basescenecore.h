@@ -0,0 +1,195 @@
+#ifndef BASESCENECORE_H
+#define BASESCENECORE_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLTexture>
+#include <QMatrix4x4>
+#include <QSize>
+#include <QFont>
+#include <QColor>
+#include <QVector>
+#include <functional>
+
+#include "gl_primitives.h"
+
+class QPaintDevice;
+class QOpenGLShaderProgram;
+class StreamBuffer;
+struct ScaleLabelSet;
+
+// Rendering core of the 3D scene: camera, space box, scales and axis.
+// It does not depend on a widget and renders into any current GL context,
+// so BaseScene3D and OffscreenScene3D share the same drawing code.
+// The shader program, axis meshes and scale labels are taken from
+// SceneResources and shared with other scenes of the same share group.
+class BaseSceneCore : protected QOpenGLFunctions
+{
+public:
+   enum ScaleLines {
+       slX = 0,
+       slY = 1,
+       slZ = 2,
+       slCount = 3
+   };
+   enum ScalePlanes {
+       spXY = 0,
+       spYZ = 1,
+       spXZ = 2,
+       spCount = 3
+   };
+
+   struct ScalePlaneSettings {
+       bool visible;
+       float offset;
+       ScalePlaneSettings() : visible(false), offset(1) {}
+   };
+
+   struct ScaleSettings {
+       float start;
+       float length;
+       float step;
+       int precision;
+       ScaleSettings() : start(1), length(1), step(1) {}
+   };
+
+   struct SpaceData {
+       float x;
+       float xLength;
+       float y;
+       float yLength;
+       float z;
+       float zLength;
+       SpaceData() : x(0), y(0), z(0), xLength(3), yLength(3), zLength(3) {}
+       SpaceData(float x, float y, float z, float xLen, float yLen, float zLen) : x(x), y(y), z(z), xLength(xLen), yLength(yLen), zLength(zLen) {}
+       SpaceData& operator=(const SpaceData& right) {
+           x = right.x;
+           xLength = right.xLength;
+           y = right.y;
+           yLength = right.yLength;
+           z = right.z;
+           zLength = right.zLength;
+           return *this;
+       }
+   };
+
+   struct CameraState {
+       GLfloat xRotate;   // угол поворота вокруг оси X
+       GLfloat yRotate;   // угол поворота вокруг оси Y
+       GLfloat zRotate;   // угол поворота вокруг оси Z
+       GLfloat xTransl;   // трансляция по оси X
+       GLfloat yTransl;   // трансляция по оси Y
+       GLfloat zTransl;   // трансляция по оси Z
+       GLfloat nScale;    // масштаб обьекта
+       GLfloat zCam;
+       CameraState() : xRotate(-45), yRotate(0), zRotate(45), xTransl(0), yTransl(0), zTransl(0), nScale(1), zCam(-6) {}
+       QMatrix4x4 pmvMatrix(const QSize &viewportSize) const;
+   };
+
+   // всё, что читает renderScene(): снимок для отрисовки другим ядром (в другом потоке)
+   struct ViewState {
+       CameraState camera;
+       SpaceData space;
+       ScaleSettings scales[slCount];
+       ScalePlaneSettings planes[spCount];
+       QFont scaleFont;
+       QColor scaleColor;
+       QColor gridColor;
+       GLfloat axisXStart;
+       GLfloat axisXEnd;
+       ViewState() : axisXStart(-3.0f), axisXEnd(3.0f) {}
+   };
+
+   BaseSceneCore();
+   virtual ~BaseSceneCore();
+
+   bool shaderIsAvailable() { return fShaderAvailable; }
+   bool vertexBufferIsAvailable() { return fVertexBufferAvailable; }
+   void qgluPerspective(GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar);
+   void setXScaleRange(GLfloat start, GLfloat end);
+   void updateXScaleValues();
+   void updateXScaleValues(float start, float end, float step, int precision);
+   void updateYScaleValues();
+   void updateYScaleValues(float start, float end, float step, int precision);
+   void updateZScaleValues();
+   void updateZScaleValues(float start, float end, float step, int precision);
+   float normalizeAngle(float angle);
+   void setSpaceData(float x, float y, float z, float xLen, float yLen, float zLen) { fSpaceData = SpaceData(x, y, z, xLen, yLen, zLen); sceneChanged(); }
+   SpaceData spaceData() const { return fSpaceData; }
+   void setCamTarget(float x, float y, float z);
+   CameraState cameraState() const { return fCamera; }
+   void setCameraState(const CameraState &camera) { fCamera = camera; sceneChanged(); }
+   ViewState viewState() const;
+   void setViewState(const ViewState &state);   // context must be current, labels are rebuilt only on change
+
+protected:
+    ScaleSettings fScalesSettings[slCount];
+    ScalePlaneSettings fScalesPlaneSettings[spCount];
+    QFont fScaleFont;
+    QColor fScaleColor;
+    QColor fGridColor;
+    CameraState fCamera;
+
+    void initializeScene();                  // context must be current
+    void releaseScene();                     // context must be current
+    void renderScene(QPaintDevice *device, const QSize &size);
+    virtual void paintData(const QMatrix4x4 &pmvMatrix) { Q_UNUSED(pmvMatrix); }
+    virtual void drawSeries(const QMatrix4x4 &pmvMatrix) { Q_UNUSED(pmvMatrix); }  // данные, которыми владеет сцена
+    virtual void drawText() {}
+    virtual void sceneChanged() {}           // вызывается при изменении данных сцены
+
+    virtual void drawAxis(const QMatrix4x4 &pmvMatrix);          // построить оси координат
+    void drawScales(const QMatrix4x4&);
+
+    void prepareView();
+    void setWorldTransform();
+    void setInverseWorldTransform();
+    void renderText(float x, float y, float z, QString text, QFont &font, QColor color, Qt::Alignment textAlignment = Qt::AlignCenter, bool scaled = false);
+    QSize viewportSize() const { return fViewportSize; }
+    QOpenGLShaderProgram *baseProgram() const { return fProgram; }  // общий для группы контекстов
+
+private:
+      GLfloat axisXStart;
+      GLfloat axisXEnd;
+
+      bool fShaderAvailable;
+      bool fVertexBufferAvailable;
+
+      QPaintDevice *fPaintDevice;  // valid only inside renderScene
+      QSize fViewportSize;
+
+      QOpenGLTexture *xScaleTextureRight;
+      QOpenGLTexture *xScaleTextureLeft;
+      QOpenGLTexture *xInverseScaleTextureRight;
+      QOpenGLTexture *xInverseScaleTextureLeft;
+
+      QOpenGLTexture *yScaleTextureRight;
+      QOpenGLTexture *yScaleTextureLeft;
+      QOpenGLTexture *yInverseScaleTextureRight;
+      QOpenGLTexture *yInverseScaleTextureLeft;
+
+      QOpenGLTexture *zScaleTextureRight;
+      QOpenGLTexture *zScaleTextureLeft;
+
+      PrimitiveManager *pManager;
+      QOpenGLShaderProgram *fProgram;
+      bool fAxisDirty;
+      StreamBuffer *fStream;            // геометрия, меняющаяся каждый кадр
+      QVector<GLfloat> fGridVertices;
+
+      QByteArray fProgramKey;
+      QByteArray fAxisKey;
+      QByteArray fScaleLabelsKey[slCount];
+
+      SpaceData fSpaceData;
+
+      void updateAxis();
+      void drawStreamed(GLenum mode, const QVector<GLfloat> &vertices);
+      QByteArray scaleLabelsKey(ScaleLines line, float start, float end, float step, int precision) const;
+      void setScaleLabels(ScaleLines line, const QByteArray &key, std::function<ScaleLabelSet*()> create);
+      void setScaleTextures(ScaleLines line, ScaleLabelSet *labels);
+      ScaleLabelSet *createXScaleLabels(float start, float end, float step, int precision);
+      ScaleLabelSet *createYScaleLabels(float start, float end, float step, int precision);
+      ScaleLabelSet *createZScaleLabels(float start, float end, float step, int precision);
+};
+
+#endif // BASESCENECORE_H
@@ -0,0 +1,437 @@
+#include "capturefile.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <cstring>
+#include <algorithm>
+
+#define CAPTURE_MAGIC "SCAP"
+#define CHUNK_MAGIC "CHNK"
+#define INDEX_MAGIC "SIDX"
+#define CHUNK_SPAN 1.0          // s, дольше кусок не держится в памяти писателя
+#define CHUNK_ALIGN 8
+#define PACE_SLICE 10000        // us, наибольший сон между проверками stop/seek
+
+Q_STATIC_ASSERT(sizeof(CaptureHeader) == 64);
+Q_STATIC_ASSERT(sizeof(CaptureChunkHeader) == 32);
+Q_STATIC_ASSERT(sizeof(CaptureBatch) == 16);
+Q_STATIC_ASSERT(sizeof(CaptureIndexEntry) == 32);
+Q_STATIC_ASSERT(sizeof(CaptureFooter) == 16);
+Q_STATIC_ASSERT(sizeof(QVector3D) == 12);
+
+CaptureWriter::CaptureWriter() : fPointCount(0)
+{
+    memset(&fHeader, 0, sizeof(fHeader));
+}
+
+bool CaptureWriter::open(const QString &path)
+{
+    close();
+
+    fFile.setFileName(path);
+    if (!fFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "CaptureWriter: cannot open" << path << fFile.errorString();
+        return false;
+    }
+
+    memset(&fHeader, 0, sizeof(fHeader));
+    memcpy(fHeader.magic, CAPTURE_MAGIC, 4);
+    fHeader.version = Version;
+    fHeader.startTime = QDateTime::currentMSecsSinceEpoch();
+    if (fFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(fHeader)) != qint64(sizeof(fHeader))) {
+        fFile.close();
+        return false;
+    }
+
+    fBatches.clear();
+    fPoints.clear();
+    fIndex.clear();
+    fPointCount = 0;
+    fClock.start();
+    return true;
+}
+
+bool CaptureWriter::append(const QVector3D *points, int count)
+{
+    return append(points, count, elapsed());
+}
+
+bool CaptureWriter::append(const QVector3D *points, int count, double time)
+{
+    if (!fFile.isOpen() || count <= 0)
+        return fFile.isOpen();
+
+    if (!fBatches.isEmpty() && fPoints.count() + count > ChunkPoints && !writeChunk())
+        return false;
+
+    CaptureBatch batch;
+    batch.time = time;
+    batch.first = quint32(fPoints.count());
+    batch.count = quint32(count);
+    fBatches.append(batch);
+
+    const int size = fPoints.count();
+    fPoints.resize(size + count);
+    memcpy(fPoints.data() + size, points, size_t(count) * sizeof(QVector3D));
+
+    // кусок уходит на диск не реже раза в секунду: при падении теряется немного
+    if (fBatches.count() >= ChunkBatches || fPoints.count() >= ChunkPoints || time - fBatches.first().time >= CHUNK_SPAN)
+        return writeChunk();
+    return true;
+}
+
+bool CaptureWriter::writeChunk()
+{
+    if (fBatches.isEmpty())
+        return true;
+
+    CaptureChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHUNK_MAGIC, 4);
+    header.batchCount = quint32(fBatches.count());
+    header.pointCount = quint32(fPoints.count());
+    header.firstTime = fBatches.first().time;
+    header.lastTime = fBatches.last().time;
+
+    CaptureIndexEntry entry;
+    entry.firstTime = header.firstTime;
+    entry.lastTime = header.lastTime;
+    entry.offset = quint64(fFile.pos());
+    entry.firstPoint = fPointCount;
+
+    const qint64 batchBytes = qint64(fBatches.count()) * qint64(sizeof(CaptureBatch));
+    const qint64 pointBytes = qint64(fPoints.count()) * qint64(sizeof(QVector3D));
+    const qint64 padding = (CHUNK_ALIGN - (qint64(sizeof(header)) + batchBytes + pointBytes) % CHUNK_ALIGN) % CHUNK_ALIGN;
+    static const char zeros[CHUNK_ALIGN] = {};
+
+    bool ok = fFile.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header))
+            && fFile.write(reinterpret_cast<const char*>(fBatches.constData()), batchBytes) == batchBytes
+            && fFile.write(reinterpret_cast<const char*>(fPoints.constData()), pointBytes) == pointBytes
+            && fFile.write(zeros, padding) == padding;
+    if (!ok) {
+        qDebug() << "CaptureWriter:" << fFile.errorString();
+        return false;
+    }
+
+    fIndex.append(entry);
+    fPointCount += quint64(fPoints.count());
+    fBatches.clear();   // ёмкость сохраняется
+    fPoints.clear();
+    return true;
+}
+
+bool CaptureWriter::close()
+{
+    if (!fFile.isOpen())
+        return true;
+
+    bool ok = writeChunk();
+
+    CaptureFooter footer;
+    footer.indexOffset = quint64(fFile.pos());
+    footer.chunkCount = quint32(fIndex.count());
+    memcpy(footer.magic, INDEX_MAGIC, 4);
+
+    const qint64 indexBytes = qint64(fIndex.count()) * qint64(sizeof(CaptureIndexEntry));
+    ok = ok && fFile.write(reinterpret_cast<const char*>(fIndex.constData()), indexBytes) == indexBytes
+            && fFile.write(reinterpret_cast<const char*>(&footer), sizeof(footer)) == qint64(sizeof(footer));
+
+    fHeader.indexOffset = footer.indexOffset;
+    fHeader.pointCount = fPointCount;
+    fHeader.chunkCount = footer.chunkCount;
+    ok = ok && fFile.seek(0) && fFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(fHeader)) == qint64(sizeof(fHeader));
+    if (!ok)
+        qDebug() << "CaptureWriter: cannot write index" << fFile.errorString();
+
+    fFile.close();
+    return ok;
+}
+
+CaptureFile::CaptureFile() : fMap(nullptr), fSize(0), fPointCount(0)
+{
+}
+
+bool CaptureFile::open(const QString &path)
+{
+    close();
+
+    fFile.setFileName(path);
+    if (!fFile.open(QIODevice::ReadOnly)) {
+        qDebug() << "CaptureFile: cannot open" << path << fFile.errorString();
+        return false;
+    }
+
+    // отображается весь файл, данные читаются только при обращении
+    fSize = fFile.size();
+    if (fSize < qint64(sizeof(CaptureHeader)) || !(fMap = fFile.map(0, fSize))) {
+        qDebug() << "CaptureFile: cannot map" << path;
+        close();
+        return false;
+    }
+
+    const CaptureHeader *header = reinterpret_cast<const CaptureHeader*>(fMap);
+    if (memcmp(header->magic, CAPTURE_MAGIC, 4) != 0 || header->version != CaptureWriter::Version) {
+        qDebug() << "CaptureFile: bad header" << path;
+        close();
+        return false;
+    }
+
+    if (!readIndex() && !scanChunks()) {
+        close();
+        return false;
+    }
+
+    // по индексу, из кусков читается только заголовок последнего
+    const int last = fIndex.count() - 1;
+    fPointCount = last < 0 ? 0 : fIndex[last].firstPoint + chunk(last)->pointCount;
+    return true;
+}
+
+void CaptureFile::close()
+{
+    if (fMap)
+        fFile.unmap(fMap);
+    fMap = nullptr;
+    fSize = 0;
+    fIndex.clear();
+    fPointCount = 0;
+    fFile.close();
+}
+
+qint64 CaptureFile::startTime() const
+{
+    return fMap ? reinterpret_cast<const CaptureHeader*>(fMap)->startTime : 0;
+}
+
+bool CaptureFile::readIndex()
+{
+    if (fSize < qint64(sizeof(CaptureHeader) + sizeof(CaptureFooter)))
+        return false;
+
+    const CaptureFooter *footer = reinterpret_cast<const CaptureFooter*>(fMap + fSize - sizeof(CaptureFooter));
+    const quint64 indexBytes = quint64(footer->chunkCount) * sizeof(CaptureIndexEntry);
+    const quint64 indexEnd = quint64(fSize) - sizeof(CaptureFooter);
+    if (memcmp(footer->magic, INDEX_MAGIC, 4) != 0 || footer->indexOffset > indexEnd || indexBytes != indexEnd - footer->indexOffset)
+        return false;
+
+    const CaptureIndexEntry *entries = reinterpret_cast<const CaptureIndexEntry*>(fMap + footer->indexOffset);
+    fIndex.resize(int(footer->chunkCount));
+    memcpy(fIndex.data(), entries, indexBytes);
+    // кусок со своими пакетами и точками должен уместиться до следующего куска или индекса
+    for (int i = 0; i < fIndex.count(); i++) {
+        const quint64 offset = fIndex[i].offset;
+        const quint64 end = i + 1 < fIndex.count() ? fIndex[i + 1].offset : footer->indexOffset;
+        bool valid = offset >= sizeof(CaptureHeader) && offset <= end && end - offset >= sizeof(CaptureChunkHeader);
+        if (valid) {
+            const CaptureChunkHeader *header = chunk(i);
+            const quint64 size = sizeof(CaptureChunkHeader) + quint64(header->batchCount) * sizeof(CaptureBatch) + quint64(header->pointCount) * 3 * sizeof(float);
+            valid = memcmp(header->magic, CHUNK_MAGIC, 4) == 0 && header->batchCount && size <= end - offset;
+        }
+        if (!valid) {
+            qDebug() << "CaptureFile: index does not match chunk" << i << "of" << fFile.fileName();
+            fIndex.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CaptureFile::scanChunks()
+{
+    // индекса нет - запись оборвалась, проходим по заголовкам кусков
+    qDebug() << "CaptureFile: no index, scanning chunks of" << fFile.fileName();
+    fIndex.clear();
+
+    quint64 offset = sizeof(CaptureHeader);
+    quint64 points = 0;
+    while (offset + sizeof(CaptureChunkHeader) <= quint64(fSize)) {
+        const CaptureChunkHeader *header = reinterpret_cast<const CaptureChunkHeader*>(fMap + offset);
+        quint64 size = sizeof(CaptureChunkHeader) + quint64(header->batchCount) * sizeof(CaptureBatch) + quint64(header->pointCount) * 3 * sizeof(float);
+        size = (size + CHUNK_ALIGN - 1) / CHUNK_ALIGN * CHUNK_ALIGN;
+        if (memcmp(header->magic, CHUNK_MAGIC, 4) != 0 || !header->batchCount || offset + size > quint64(fSize))
+            break;
+
+        CaptureIndexEntry entry;
+        entry.firstTime = header->firstTime;
+        entry.lastTime = header->lastTime;
+        entry.offset = offset;
+        entry.firstPoint = points;
+        fIndex.append(entry);
+
+        points += header->pointCount;
+        offset += size;
+    }
+    return true;
+}
+
+bool CaptureFile::seek(double time, int *chunkIndex, int *batchIndex) const
+{
+    // первый кусок, который кончается не раньше time
+    const CaptureIndexEntry *it = std::lower_bound(fIndex.constBegin(), fIndex.constEnd(), time,
+                                                   [](const CaptureIndexEntry &entry, double t) { return entry.lastTime < t; });
+    if (it == fIndex.constEnd())
+        return false;
+
+    const int index = int(it - fIndex.constBegin());
+    const CaptureBatch *first = batches(index);
+    const CaptureBatch *last = first + chunk(index)->batchCount;
+    const CaptureBatch *batch = std::lower_bound(first, last, time, [](const CaptureBatch &b, double t) { return b.time < t; });
+
+    *chunkIndex = index;
+    *batchIndex = int(batch - first);
+    return batch != last;
+}
+
+void CaptureReplayWorker::run()
+{
+    CaptureReplay *replay = fReplay;
+    const CaptureFile &file = replay->fFile;
+
+    int chunk;
+    int batch;
+    double speed = -1.0;
+    double baseTime = 0.0;
+    bool synced = false;
+    QElapsedTimer clock;
+    CaptureReplay::Consumer consumer;
+    {
+        // продолжение с пакета после последнего выданного
+        QMutexLocker locker(&replay->fMutex);
+        chunk = replay->fChunk;
+        batch = replay->fBatch;
+    }
+
+    while (!replay->fStop.loadAcquire()) {
+        {
+            QMutexLocker locker(&replay->fMutex);
+            if (replay->fSeekTime >= 0.0) {
+                if (!file.seek(replay->fSeekTime, &chunk, &batch))
+                    chunk = file.chunkCount();
+                replay->fSeekTime = -1.0;
+                replay->fChunk = chunk;
+                replay->fBatch = batch;
+                synced = false;
+            }
+            if (speed != replay->fSpeed) {
+                speed = replay->fSpeed;
+                synced = false;
+            }
+            consumer = replay->fConsumer;
+        }
+        if (chunk >= file.chunkCount())
+            break;
+
+        const CaptureBatch &b = file.batches(chunk)[batch];
+        if (speed > 0.0) {
+            // темп задаёт время пакета относительно первого после старта, перемотки или смены скорости
+            if (!synced) {
+                baseTime = b.time;
+                clock.start();
+                synced = true;
+            }
+            const double wait = (b.time - baseTime) / speed - clock.nsecsElapsed() / 1e9;
+            if (wait > 0.0) {
+                QThread::usleep(qMin<unsigned long>(PACE_SLICE, (unsigned long)(wait * 1e6) + 1));
+                continue;
+            }
+        }
+
+        // пакет за пределами точек куска не выдаётся
+        const bool inside = quint64(b.first) + b.count <= file.chunk(chunk)->pointCount;
+        if (consumer && inside)
+            consumer(file.points(chunk) + quint64(b.first) * 3, int(b.count), b.time);
+        if (++batch >= int(file.chunk(chunk)->batchCount)) {
+            chunk++;
+            batch = 0;
+        }
+        {
+            QMutexLocker locker(&replay->fMutex);
+            replay->fPosition = b.time;
+            replay->fChunk = chunk;
+            replay->fBatch = batch;
+        }
+    }
+
+    const bool stopped = replay->fStop.loadAcquire();
+    replay->fRunning.storeRelease(0);
+    if (!stopped)
+        emit replay->finished();
+}
+
+CaptureReplay::CaptureReplay(QObject *parent) : QObject(parent), fSpeed(1.0), fSeekTime(-1.0), fPosition(0.0), fChunk(0), fBatch(0), fRunning(0), fStop(0)
+{
+    fWorker = new CaptureReplayWorker(this);
+    fWorker->moveToThread(&fThread);
+    fThread.start();
+}
+
+CaptureReplay::~CaptureReplay()
+{
+    stop();
+    fThread.quit();
+    fThread.wait();
+    delete fWorker;
+}
+
+bool CaptureReplay::open(const QString &path)
+{
+    stop();
+    fSeekTime = -1.0;
+    fPosition = 0.0;
+    fChunk = 0;
+    fBatch = 0;
+    return fFile.open(path);
+}
+
+void CaptureReplay::setConsumer(Consumer consumer)
+{
+    QMutexLocker locker(&fMutex);
+    fConsumer = consumer;
+}
+
+void CaptureReplay::start(double speed)
+{
+    if (!fFile.isOpen() || isRunning())
+        return;
+
+    {
+        QMutexLocker locker(&fMutex);
+        fSpeed = qMax(0.0, speed);
+    }
+    fStop.storeRelease(0);
+    fRunning.storeRelease(1);
+    QMetaObject::invokeMethod(fWorker, "run", Qt::QueuedConnection);
+}
+
+void CaptureReplay::stop()
+{
+    fStop.storeRelease(1);
+    // цикл проверяет флаг не реже PACE_SLICE
+    while (fRunning.loadAcquire())
+        QThread::msleep(1);
+}
+
+void CaptureReplay::setSpeed(double speed)
+{
+    QMutexLocker locker(&fMutex);
+    fSpeed = qMax(0.0, speed);
+}
+
+double CaptureReplay::speed() const
+{
+    QMutexLocker locker(&fMutex);
+    return fSpeed;
+}
+
+void CaptureReplay::seek(double time)
+{
+    QMutexLocker locker(&fMutex);
+    fSeekTime = qMax(0.0, time);
+    fPosition = fSeekTime;
+}
+
+double CaptureReplay::position() const
+{
+    QMutexLocker locker(&fMutex);
+    return fPosition;
+}
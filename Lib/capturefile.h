@@ -0,0 +1,192 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <QObject>
+#include <QFile>
+#include <QThread>
+#include <QVector>
+#include <QVector3D>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <functional>
+
+// Capture of ingested points, little-endian:
+//   CaptureHeader | chunk ... chunk | CaptureIndexEntry[chunkCount] | CaptureFooter
+// A chunk is CaptureChunkHeader, CaptureBatch[batchCount] and the points of all
+// batches as float[3]. Batch time is in seconds from the capture start. The
+// index is written by close(); a file without it (the writer was killed) or
+// with an index that does not match the chunks is indexed by walking the chunk headers.
+struct CaptureHeader {
+    char magic[4];              // "SCAP"
+    quint32 version;
+    qint64 startTime;           // ms since epoch
+    quint64 indexOffset;        // 0 - no index
+    quint64 pointCount;
+    quint32 chunkCount;
+    quint32 reserved[7];
+};
+
+struct CaptureChunkHeader {
+    char magic[4];              // "CHNK"
+    quint32 batchCount;
+    quint32 pointCount;
+    quint32 reserved;
+    double firstTime;
+    double lastTime;
+};
+
+struct CaptureBatch {
+    double time;
+    quint32 first;              // point index in the chunk
+    quint32 count;
+};
+
+struct CaptureIndexEntry {
+    double firstTime;
+    double lastTime;
+    quint64 offset;             // of the chunk header
+    quint64 firstPoint;         // points before the chunk
+};
+
+struct CaptureFooter {
+    quint64 indexOffset;
+    quint32 chunkCount;
+    char magic[4];              // "SIDX"
+};
+
+// Append-only writer, used from one thread (the ingest thread).
+// Batches are collected into a chunk in memory and written when it is full.
+class CaptureWriter
+{
+public:
+    enum {
+        Version = 1,
+        ChunkPoints = 65536,
+        ChunkBatches = 1024
+    };
+
+    CaptureWriter();
+    ~CaptureWriter() { close(); }
+
+    bool open(const QString &path);
+    bool close();       // writes the last chunk and the index
+    bool isOpen() const { return fFile.isOpen(); }
+
+    bool append(const QVector3D *points, int count);                 // time - now
+    bool append(const QVector3D *points, int count, double time);    // s from the capture start
+    double elapsed() const { return fClock.elapsed() / 1000.0; }
+
+    quint64 pointCount() const { return fPointCount; }
+    QString errorString() const { return fFile.errorString(); }
+
+private:
+    QFile fFile;
+    QElapsedTimer fClock;
+    CaptureHeader fHeader;
+    QVector<CaptureBatch> fBatches;
+    QVector<QVector3D> fPoints;
+    QVector<CaptureIndexEntry> fIndex;
+    quint64 fPointCount;
+
+    bool writeChunk();
+};
+
+// Capture opened for reading through a memory mapping. Batches are returned
+// as pointers into the mapping, nothing is copied.
+class CaptureFile
+{
+public:
+    CaptureFile();
+    ~CaptureFile() { close(); }
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return fMap != nullptr; }
+
+    qint64 startTime() const;
+    quint64 pointCount() const { return fPointCount; }
+    int chunkCount() const { return fIndex.count(); }
+    double duration() const { return fIndex.isEmpty() ? 0.0 : fIndex.last().lastTime; }
+
+    const CaptureChunkHeader *chunk(int index) const { return reinterpret_cast<const CaptureChunkHeader*>(fMap + fIndex[index].offset); }
+    const CaptureBatch *batches(int index) const { return reinterpret_cast<const CaptureBatch*>(chunk(index) + 1); }
+    const float *points(int index) const { return reinterpret_cast<const float*>(batches(index) + chunk(index)->batchCount); }
+
+    // first batch with time >= the given one, O(log n); false after the end
+    bool seek(double time, int *chunkIndex, int *batchIndex) const;
+
+private:
+    QFile fFile;
+    uchar *fMap;
+    qint64 fSize;
+    QVector<CaptureIndexEntry> fIndex;
+    quint64 fPointCount;
+
+    bool readIndex();
+    bool scanChunks();
+
+    Q_DISABLE_COPY(CaptureFile)
+};
+
+class CaptureReplay;
+
+// Feeds batches on the replay thread, paced by the batch times.
+class CaptureReplayWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CaptureReplayWorker(CaptureReplay *replay) : fReplay(replay) {}
+
+public slots:
+    void run();
+
+private:
+    CaptureReplay *fReplay;
+};
+
+// Replay of a capture on its own thread. The consumer gets points straight
+// from the mapping (valid during the call) with the batch time; speed 1 is
+// real time, N - N times faster, 0 - as fast as the consumer takes them.
+class CaptureReplay : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(const float *xyz, int count, double time)> Consumer;
+
+    explicit CaptureReplay(QObject *parent = nullptr);
+    ~CaptureReplay();
+
+    bool open(const QString &path);
+    const CaptureFile &file() const { return fFile; }
+    void setConsumer(Consumer consumer);
+
+    void start(double speed = 1.0);
+    void stop();
+    bool isRunning() const { return fRunning.loadAcquire() != 0; }
+    void setSpeed(double speed);
+    double speed() const;
+    void seek(double time);                 // may be called while running
+    double position() const;                // time of the last fed batch
+
+signals:
+    void finished();
+
+private:
+    friend class CaptureReplayWorker;
+
+    CaptureFile fFile;
+    QThread fThread;
+    CaptureReplayWorker *fWorker;
+    Consumer fConsumer;
+    mutable QMutex fMutex;
+    double fSpeed;
+    double fSeekTime;       // < 0 - no seek requested
+    double fPosition;
+    int fChunk;             // next batch to feed, the replay resumes from it
+    int fBatch;
+    QAtomicInt fRunning;
+    QAtomicInt fStop;
+};
+
+#endif // CAPTUREFILE_H
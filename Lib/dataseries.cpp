@@ -0,0 +1,1592 @@
+#include "dataseries.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLFramebufferObject>
+#include <QDebug>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "sceneresources.h"
+#include "pointcodec.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BOUNDS_SSE2
+#endif
+
+#define POINT_BYTES (3 * sizeof(float))
+#define QUANT_POINT_BYTES (4 * sizeof(quint16))  // xyz и выравнивание до 4 байтов
+#define QUANT_MAX 65535.0f
+#define FRAME_MARGIN 0.5f           // запас рамки растущего куска с каждой стороны, доля размера
+#define FRAME_MIN_EXTENT 0.01f      // доля наибольшей стороны для плоских осей
+#define MARK_STRIDE 256             // точек на отметку времени в упакованном куске
+#define RING_POINT_BYTES (4 * sizeof(float))
+#define RING_VERTEX_SHADER ":/BaseShaders/Lib/ring_vsh.vert"
+#define RING_FRAGMENT_SHADER ":/BaseShaders/Lib/ring_fsh.frag"
+#define TIME_REBASE_INTERVAL 3600.0 // s, точность float времени не хуже миллисекунды
+#define WATERFALL_VERTEX_SHADER ":/BaseShaders/Lib/waterfall_vsh.vert"
+#define WATERFALL_FRAGMENT_SHADER ":/BaseShaders/Lib/waterfall_fsh.frag"
+#define COLORMAP_SIZE 256
+#define DENSITY_VERTEX_SHADER ":/BaseShaders/Lib/density_vsh.vert"
+#define DENSITY_FRAGMENT_SHADER ":/BaseShaders/Lib/density_fsh.frag"
+#define TONEMAP_VERTEX_SHADER ":/BaseShaders/Lib/tonemap_vsh.vert"
+#define TONEMAP_FRAGMENT_SHADER ":/BaseShaders/Lib/tonemap_fsh.frag"
+#define DENSITY_AUTO_SATURATION 8.0f    // средней плотности на пиксель
+
+#ifndef GL_R32F
+#define GL_R32F 0x822E
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+#ifndef GL_FRAMEBUFFER_BINDING
+#define GL_FRAMEBUFFER_BINDING 0x8CA6
+#endif
+
+// расширяет min/max до точек xyz; SSE2 обрабатывает по 4 точки - 3 регистра
+// с осями по дорожкам x y z x | y z x y | z x y z
+static void extendBounds(const float *xyz, size_t n, float *min, float *max)
+{
+    size_t i = 0;
+#if defined(BOUNDS_SSE2)
+    if (n >= 4) {
+        __m128 lo0 = _mm_loadu_ps(xyz), lo1 = _mm_loadu_ps(xyz + 4), lo2 = _mm_loadu_ps(xyz + 8);
+        __m128 hi0 = lo0, hi1 = lo1, hi2 = lo2;
+        for (i = 4; i + 4 <= n; i += 4) {
+            const float *p = xyz + i * 3;
+            const __m128 v0 = _mm_loadu_ps(p);
+            const __m128 v1 = _mm_loadu_ps(p + 4);
+            const __m128 v2 = _mm_loadu_ps(p + 8);
+            lo0 = _mm_min_ps(lo0, v0);
+            lo1 = _mm_min_ps(lo1, v1);
+            lo2 = _mm_min_ps(lo2, v2);
+            hi0 = _mm_max_ps(hi0, v0);
+            hi1 = _mm_max_ps(hi1, v1);
+            hi2 = _mm_max_ps(hi2, v2);
+        }
+
+        float lo[12], hi[12];
+        _mm_storeu_ps(lo, lo0);
+        _mm_storeu_ps(lo + 4, lo1);
+        _mm_storeu_ps(lo + 8, lo2);
+        _mm_storeu_ps(hi, hi0);
+        _mm_storeu_ps(hi + 4, hi1);
+        _mm_storeu_ps(hi + 8, hi2);
+        // дорожка j хранит ось j % 3
+        for (int j = 0; j < 12; j++) {
+            min[j % 3] = qMin(min[j % 3], lo[j]);
+            max[j % 3] = qMax(max[j % 3], hi[j]);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        for (int k = 0; k < 3; k++) {
+            min[k] = qMin(min[k], xyz[i * 3 + k]);
+            max[k] = qMax(max[k], xyz[i * 3 + k]);
+        }
+    }
+}
+
+DataSeries::DataSeries(const QString &name) : fColor(Qt::blue), fPointSize(2.0f), fVisible(true), fUploadedBytes(0), fName(name)
+{
+}
+
+// синий - голубой - жёлтый - красный
+QVector<QRgb> DataSeries::defaultColormap()
+{
+    QVector<QRgb> colors;
+    colors << qRgb(0, 0, 128) << qRgb(0, 96, 255) << qRgb(0, 224, 224) << qRgb(255, 224, 0) << qRgb(224, 0, 0);
+    return colors;
+}
+
+// опорные цвета растягиваются на всю таблицу из COLORMAP_SIZE цветов
+void DataSeries::uploadColormap(const QVector<QRgb> &colors)
+{
+    QVector<QRgb> table(COLORMAP_SIZE);
+    const int last = colors.count() - 1;
+    for (int i = 0; i < COLORMAP_SIZE; i++) {
+        const float t = last * float(i) / (COLORMAP_SIZE - 1);
+        const int k = qMin(int(t), qMax(last - 1, 0));
+        const float w = last ? t - k : 0.0f;
+        const QRgb a = colors[k];
+        const QRgb b = colors[qMin(k + 1, last)];
+        table[i] = qRgba(int(qRed(a) + (qRed(b) - qRed(a)) * w), int(qGreen(a) + (qGreen(b) - qGreen(a)) * w),
+                         int(qBlue(a) + (qBlue(b) - qBlue(a)) * w), int(qAlpha(a) + (qAlpha(b) - qAlpha(a)) * w));
+    }
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA, COLORMAP_SIZE, 0, GL_BGRA, GL_UNSIGNED_BYTE, table.constData());
+}
+
+void DataSeries::setColor(const QColor &color)
+{
+    QMutexLocker locker(&fMutex);
+    fColor = color;
+}
+
+QColor DataSeries::color() const
+{
+    QMutexLocker locker(&fMutex);
+    return fColor;
+}
+
+void DataSeries::setPointSize(float size)
+{
+    QMutexLocker locker(&fMutex);
+    fPointSize = size;
+}
+
+float DataSeries::pointSize() const
+{
+    QMutexLocker locker(&fMutex);
+    return fPointSize;
+}
+
+void DataSeries::setVisible(bool visible)
+{
+    QMutexLocker locker(&fMutex);
+    fVisible = visible;
+}
+
+bool DataSeries::isVisible() const
+{
+    QMutexLocker locker(&fMutex);
+    return fVisible;
+}
+
+quint64 DataSeries::uploadedBytes() const
+{
+    QMutexLocker locker(&fMutex);
+    return fUploadedBytes;
+}
+
+PointSeries::PointSeries(const QString &name) : DataSeries(name), fUsedChunks(0), fCount(0), fLastTime(0.0),
+    fWindowed(false), fWindowFrom(0.0), fWindowTo(0.0), fCompression(false), fWarmChunks(4),
+    fFormat(Float32)
+{
+    fClock.start();
+}
+
+PointSeries::~PointSeries()
+{
+    for (int i = 0; i < fChunks.count(); i++)
+        delete [] fChunks[i].data;
+}
+
+void PointSeries::append(const float *xyz, size_t n)
+{
+    append(xyz, n, now());
+}
+
+void PointSeries::append(const float *xyz, size_t n, double time)
+{
+    QMutexLocker locker(&fMutex);
+    // индекс по времени требует неубывающих отметок
+    time = qMax(time, fLastTime);
+    fLastTime = time;
+
+    while (n > 0) {
+        if (fUsedChunks == 0 || fChunks[fUsedChunks - 1].count == ChunkPoints) {
+            if (fUsedChunks == fChunks.count()) {
+                Chunk chunk;
+                chunk.data = new float[ChunkPoints * 3];
+                fChunks.append(chunk);
+            }
+            fUsedChunks++;
+        }
+
+        Chunk &chunk = fChunks[fUsedChunks - 1];
+        if (!chunk.data)
+            chunk.data = new float[ChunkPoints * 3];
+        const size_t take = qMin(n, size_t(ChunkPoints - chunk.count));
+        float *out = chunk.data + chunk.count * 3;
+        memcpy(out, xyz, take * POINT_BYTES);
+
+        if (!chunk.count) {
+            for (int k = 0; k < 3; k++)
+                chunk.min[k] = chunk.max[k] = out[k];
+        }
+        extendBounds(out, take, chunk.min, chunk.max);
+        if (chunk.marks.isEmpty() || chunk.marks.last().time < time) {
+            Mark mark;
+            mark.time = time;
+            mark.first = chunk.count;
+            chunk.marks.append(mark);
+        }
+
+        chunk.count += int(take);
+        fCount += take;
+        xyz += take * 3;
+        n -= take;
+
+        if (fCompression && chunk.count == ChunkPoints) {
+            fWarm.append(fUsedChunks - 1);
+            compressCold();
+        }
+    }
+}
+
+void PointSeries::clear()
+{
+    QMutexLocker locker(&fMutex);
+    for (int i = 0; i < fUsedChunks; i++) {
+        fChunks[i].count = 0;
+        fChunks[i].uploaded = 0;
+        fChunks[i].marks.clear();
+        fChunks[i].thinned = false;
+        fChunks[i].packed.clear();
+        fChunks[i].framed = false;
+    }
+    fWarm.clear();
+    fUsedChunks = 0;
+    fCount = 0;
+    fLastTime = 0.0;
+}
+
+double PointSeries::now() const
+{
+    return fClock.nsecsElapsed() / 1e9;
+}
+
+void PointSeries::setTimeWindow(double from, double to)
+{
+    QMutexLocker locker(&fMutex);
+    fWindowed = true;
+    fWindowFrom = qMin(from, to);
+    fWindowTo = qMax(from, to);
+}
+
+void PointSeries::clearTimeWindow()
+{
+    QMutexLocker locker(&fMutex);
+    fWindowed = false;
+}
+
+bool PointSeries::hasTimeWindow() const
+{
+    QMutexLocker locker(&fMutex);
+    return fWindowed;
+}
+
+int PointSeries::firstChunk(double time) const
+{
+    // куски упорядочены по времени: последняя отметка куска не раньше первой следующего
+    int lo = 0;
+    int hi = fUsedChunks;
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (fChunks[mid].marks.last().time < time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void PointSeries::range(const Chunk &chunk, int *first, int *count) const
+{
+    if (!fWindowed) {
+        *first = 0;
+        *count = chunk.count;
+        return;
+    }
+
+    const Mark *begin = chunk.marks.constBegin();
+    const Mark *end = chunk.marks.constEnd();
+    const Mark *from = std::lower_bound(begin, end, fWindowFrom, [](const Mark &m, double t) { return m.time < t; });
+    const Mark *to = std::upper_bound(begin, end, fWindowTo, [](double t, const Mark &m) { return t < m.time; });
+    // между прореженными отметками точки окна могут начаться раньше найденной
+    if (chunk.thinned && from != begin && from != end && from->time > fWindowFrom)
+        from--;
+    *first = from == end ? chunk.count : from->first;
+    *count = (to == end ? chunk.count : to->first) - *first;
+}
+
+QVector<PointSeries::ChunkSummary> PointSeries::summaries(double from, double to) const
+{
+    QMutexLocker locker(&fMutex);
+    QVector<ChunkSummary> result;
+    for (int i = firstChunk(from); i < fUsedChunks && fChunks[i].marks.first().time <= to; i++) {
+        const Chunk &chunk = fChunks[i];
+        ChunkSummary summary;
+        summary.firstTime = chunk.marks.first().time;
+        summary.lastTime = chunk.marks.last().time;
+        summary.min = QVector3D(chunk.min[0], chunk.min[1], chunk.min[2]);
+        summary.max = QVector3D(chunk.max[0], chunk.max[1], chunk.max[2]);
+        summary.count = chunk.count;
+        result.append(summary);
+    }
+    return result;
+}
+
+bool PointSeries::bounds(QVector3D *min, QVector3D *max) const
+{
+    QMutexLocker locker(&fMutex);
+    const int first = fWindowed ? firstChunk(fWindowFrom) : 0;
+    bool found = false;
+    for (int i = first; i < fUsedChunks; i++) {
+        const Chunk &chunk = fChunks[i];
+        if (fWindowed && chunk.marks.first().time > fWindowTo)
+            break;
+
+        // кусок, частично попавший в окно, даёт границы с запасом
+        const QVector3D lo(chunk.min[0], chunk.min[1], chunk.min[2]);
+        const QVector3D hi(chunk.max[0], chunk.max[1], chunk.max[2]);
+        if (!found) {
+            *min = lo;
+            *max = hi;
+            found = true;
+            continue;
+        }
+        *min = QVector3D(qMin(min->x(), lo.x()), qMin(min->y(), lo.y()), qMin(min->z(), lo.z()));
+        *max = QVector3D(qMax(max->x(), hi.x()), qMax(max->y(), hi.y()), qMax(max->z(), hi.z()));
+    }
+    return found;
+}
+
+void PointSeries::setCompression(bool enabled, int warmChunks)
+{
+    QMutexLocker locker(&fMutex);
+    fCompression = enabled;
+    fWarmChunks = qMax(0, warmChunks);
+    fWarm.clear();
+
+    for (int i = 0; i < fUsedChunks; i++) {
+        Chunk &chunk = fChunks[i];
+        if (!enabled) {
+            if (!chunk.data) {
+                chunk.data = new float[ChunkPoints * 3];
+                PointCodec::decode(chunk.packed, chunk.data);
+            }
+            chunk.packed.clear();
+        }
+        else if (chunk.data && chunk.count == ChunkPoints)
+            fWarm.append(i);
+    }
+    if (enabled)
+        compressCold();
+}
+
+bool PointSeries::compression() const
+{
+    QMutexLocker locker(&fMutex);
+    return fCompression;
+}
+
+quint64 PointSeries::memoryBytes() const
+{
+    QMutexLocker locker(&fMutex);
+    quint64 bytes = 0;
+    for (int i = 0; i < fChunks.count(); i++) {
+        if (fChunks[i].data)
+            bytes += ChunkPoints * POINT_BYTES;
+        bytes += quint64(fChunks[i].packed.size());
+        bytes += quint64(fChunks[i].marks.capacity()) * sizeof(Mark);
+    }
+    return bytes;
+}
+
+void PointSeries::setVertexFormat(VertexFormat format)
+{
+    QMutexLocker locker(&fMutex);
+    fFormat = format;
+}
+
+PointSeries::VertexFormat PointSeries::vertexFormat() const
+{
+    QMutexLocker locker(&fMutex);
+    return fFormat;
+}
+
+bool PointSeries::fitFrame(Chunk &chunk)
+{
+    if (chunk.framed) {
+        bool inside = true;
+        for (int k = 0; k < 3; k++)
+            inside = inside && chunk.min[k] >= chunk.origin[k] && chunk.max[k] - chunk.origin[k] <= chunk.extent[k];
+        if (inside)
+            return false;
+    }
+
+    // полный кусок больше не растёт и получает точную рамку
+    const float margin = chunk.count == ChunkPoints ? 0.0f : FRAME_MARGIN;
+    float largest = 0.0f;
+    for (int k = 0; k < 3; k++)
+        largest = qMax(largest, chunk.max[k] - chunk.min[k]);
+    for (int k = 0; k < 3; k++) {
+        float size = chunk.max[k] - chunk.min[k];
+        if (margin > 0.0f)
+            size = qMax(size, largest * FRAME_MIN_EXTENT);
+        chunk.origin[k] = chunk.min[k] - size * margin;
+        chunk.extent[k] = chunk.max[k] - chunk.origin[k] + size * margin;
+    }
+    chunk.framed = true;
+    return true;
+}
+
+void PointSeries::upload(Chunk &chunk)
+{
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    const int fresh = chunk.count - chunk.uploaded;
+    const float *in = chunk.data + chunk.uploaded * 3;
+    if (fFormat == Float32) {
+        f->glBufferSubData(GL_ARRAY_BUFFER, chunk.uploaded * POINT_BYTES, fresh * POINT_BYTES, in);
+        fUploadedBytes += fresh * POINT_BYTES;
+        chunk.uploaded = chunk.count;
+        return;
+    }
+
+    float scale[3];
+    for (int k = 0; k < 3; k++)
+        scale[k] = chunk.extent[k] > 0.0f ? QUANT_MAX / chunk.extent[k] : 0.0f;
+
+    fQuantized.resize(fresh * 4);
+    quint16 *out = fQuantized.data();
+    for (int i = 0; i < fresh; i++, in += 3, out += 4) {
+        for (int k = 0; k < 3; k++) {
+            const float q = (in[k] - chunk.origin[k]) * scale[k] + 0.5f;
+            out[k] = q <= 0.0f ? 0 : q >= QUANT_MAX ? quint16(QUANT_MAX) : quint16(q);
+        }
+        out[3] = 0;
+    }
+    f->glBufferSubData(GL_ARRAY_BUFFER, chunk.uploaded * QUANT_POINT_BYTES, fresh * QUANT_POINT_BYTES, fQuantized.constData());
+    fUploadedBytes += fresh * QUANT_POINT_BYTES;
+    chunk.uploaded = chunk.count;
+}
+
+void PointSeries::compressCold()
+{
+    while (fWarm.count() > fWarmChunks) {
+        Chunk &chunk = fChunks[fWarm.takeFirst()];
+        if (chunk.packed.isEmpty())
+            chunk.packed = PointCodec::encode(chunk.data, chunk.count, chunk.min, chunk.max);
+        delete [] chunk.data;
+        chunk.data = nullptr;
+        thinMarks(chunk);
+    }
+}
+
+void PointSeries::thinMarks(Chunk &chunk)
+{
+    if (chunk.thinned)
+        return;
+
+    // первая и последняя отметки остаются: по ним ищутся куски и строятся сводки
+    int kept = 1;
+    for (int i = 1; i < chunk.marks.count(); i++) {
+        if (i == chunk.marks.count() - 1 || chunk.marks[i].first - chunk.marks[kept - 1].first >= MARK_STRIDE)
+            chunk.marks[kept++] = chunk.marks[i];
+    }
+    chunk.marks.resize(kept);
+    chunk.marks.squeeze();
+    chunk.thinned = true;
+}
+
+quint64 PointSeries::count() const
+{
+    QMutexLocker locker(&fMutex);
+    return fCount;
+}
+
+int PointSeries::chunkCount() const
+{
+    QMutexLocker locker(&fMutex);
+    return fUsedChunks;
+}
+
+void PointSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx || !program)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fVisible || !fUsedChunks)
+        return;
+
+    program->bind();
+    program->setUniformValue("color", QVector3D(fColor.redF(), fColor.greenF(), fColor.blueF()));
+    program->setUniformValue("Matrix", pmvMatrix);
+    const int location = program->attributeLocation("qt_Vertex");
+    program->enableAttributeArray(location);
+    f->glEnable(GL_DEPTH_TEST);
+    glPointSize(fPointSize);
+
+    for (int i = fWindowed ? firstChunk(fWindowFrom) : 0; i < fUsedChunks; i++) {
+        Chunk &chunk = fChunks[i];
+        if (fWindowed && chunk.marks.first().time > fWindowTo)
+            break;
+
+        int first, count;
+        range(chunk, &first, &count);
+        if (count <= 0)
+            continue;
+
+        if (!chunk.vbo || chunk.format != fFormat) {
+            if (!chunk.vbo)
+                f->glGenBuffers(1, &chunk.vbo);
+            f->glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+            f->glBufferData(GL_ARRAY_BUFFER, ChunkPoints * (fFormat == Float32 ? POINT_BYTES : QUANT_POINT_BYTES), nullptr, GL_DYNAMIC_DRAW);
+            chunk.format = fFormat;
+            chunk.uploaded = 0;
+        }
+        else
+            f->glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+
+        if (fFormat == Normalized16 && fitFrame(chunk))
+            chunk.uploaded = 0;
+
+        // сжатый кусок распаковывается, только когда буфер нужно заполнить заново
+        if (chunk.uploaded < chunk.count && !chunk.data) {
+            chunk.data = new float[ChunkPoints * 3];
+            if (!PointCodec::decode(chunk.packed, chunk.data))
+                qDebug() << "PointSeries: broken packed chunk" << i << "of" << name();
+            fWarm.append(i);
+        }
+        else if (fCompression && chunk.data && chunk.count == ChunkPoints) {
+            fWarm.removeOne(i);
+            fWarm.append(i);
+        }
+
+        // в буфер идёт только хвост, дописанный после прошлого кадра
+        if (chunk.uploaded < chunk.count)
+            upload(chunk);
+
+        if (fFormat == Float32)
+            program->setAttributeBuffer(location, GL_FLOAT, 0, 3);
+        else {
+            // координаты 0..1 в рамке куска, рамка переносится в матрицу
+            QMatrix4x4 frame;
+            frame.translate(chunk.origin[0], chunk.origin[1], chunk.origin[2]);
+            frame.scale(chunk.extent[0], chunk.extent[1], chunk.extent[2]);
+            program->setUniformValue("Matrix", pmvMatrix * frame);
+            program->setAttributeBuffer(location, GL_UNSIGNED_SHORT, 0, 3, QUANT_POINT_BYTES);
+        }
+        f->glDrawArrays(GL_POINTS, first, count);
+    }
+    compressCold();
+
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    program->disableAttributeArray(location);
+    program->release();
+}
+
+void PointSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    for (int i = 0; i < fChunks.count(); i++) {
+        if (fChunks[i].vbo)
+            f->glDeleteBuffers(1, &fChunks[i].vbo);
+        fChunks[i].vbo = 0;
+        fChunks[i].uploaded = 0;
+    }
+}
+
+RollingSeries::RollingSeries(const QString &name, int capacity) : DataSeries(name), fCapacity(qMax(1, capacity)), fWritten(0), fUploaded(0),
+    fWindow(10.0f), fTimeBase(0.0), fVbo(0), fProgram(nullptr)
+{
+    fRing = new float[size_t(fCapacity) * 4];
+    fClock.start();
+}
+
+RollingSeries::~RollingSeries()
+{
+    delete [] fRing;
+}
+
+double RollingSeries::now() const
+{
+    return fClock.elapsed() / 1000.0;
+}
+
+void RollingSeries::append(const float *xyz, size_t n)
+{
+    append(xyz, n, now());
+}
+
+void RollingSeries::append(const float *xyz, size_t n, double time)
+{
+    QMutexLocker locker(&fMutex);
+    if (time - fTimeBase > TIME_REBASE_INTERVAL)
+        rebase(time);
+
+    // из пачки больше кольца видны только последние точки
+    if (n > size_t(fCapacity)) {
+        const size_t skip = n - size_t(fCapacity);
+        xyz += skip * 3;
+        fWritten += skip;
+        n = size_t(fCapacity);
+    }
+
+    const float t = float(time - fTimeBase);
+    int index = int(fWritten % quint64(fCapacity));
+    for (size_t i = 0; i < n; i++) {
+        float *dst = fRing + index * 4;
+        dst[0] = xyz[0];
+        dst[1] = xyz[1];
+        dst[2] = xyz[2];
+        dst[3] = t;
+        xyz += 3;
+        if (++index == fCapacity)
+            index = 0;
+    }
+    fWritten += n;
+}
+
+void RollingSeries::rebase(double time)
+{
+    const float delta = float(time - fTimeBase);
+    const int stored = int(qMin(fWritten, quint64(fCapacity)));
+    for (int i = 0; i < stored; i++)
+        fRing[i * 4 + 3] -= delta;
+    fTimeBase = time;
+
+    // время изменилось у всех точек, кольцо загружается целиком
+    fUploaded = fWritten > quint64(fCapacity) ? fWritten - quint64(fCapacity) : 0;
+}
+
+void RollingSeries::clear()
+{
+    QMutexLocker locker(&fMutex);
+    fWritten = 0;
+    fUploaded = 0;
+}
+
+int RollingSeries::count() const
+{
+    QMutexLocker locker(&fMutex);
+    return int(qMin(fWritten, quint64(fCapacity)));
+}
+
+void RollingSeries::setWindow(float seconds)
+{
+    QMutexLocker locker(&fMutex);
+    fWindow = qMax(0.001f, seconds);
+}
+
+float RollingSeries::window() const
+{
+    QMutexLocker locker(&fMutex);
+    return fWindow;
+}
+
+static QOpenGLShaderProgram *createRingProgram()
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, RING_VERTEX_SHADER))
+        qDebug() << "VertexShader:" << program->log();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, RING_FRAGMENT_SHADER))
+        qDebug() << "FragmentShader:" << program->log();
+    program->link();
+    return program;
+}
+
+void RollingSeries::upload(int from, int count)
+{
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    f->glBufferSubData(GL_ARRAY_BUFFER, from * RING_POINT_BYTES, count * RING_POINT_BYTES, fRing + from * 4);
+    fUploadedBytes += count * RING_POINT_BYTES;
+}
+
+void RollingSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    Q_UNUSED(program);
+
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    SceneResources *resources = SceneResources::current();
+    if (!ctx || !resources)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fVisible || !fWritten)
+        return;
+
+    if (!fProgram)
+        fProgram = resources->acquire<QOpenGLShaderProgram>("program:" RING_VERTEX_SHADER ":" RING_FRAGMENT_SHADER, createRingProgram);
+
+    if (!fVbo) {
+        f->glGenBuffers(1, &fVbo);
+        f->glBindBuffer(GL_ARRAY_BUFFER, fVbo);
+        f->glBufferData(GL_ARRAY_BUFFER, fCapacity * RING_POINT_BYTES, nullptr, GL_DYNAMIC_DRAW);
+        fUploaded = fWritten > quint64(fCapacity) ? fWritten - quint64(fCapacity) : 0;
+    }
+    else
+        f->glBindBuffer(GL_ARRAY_BUFFER, fVbo);
+
+    // только записанный после прошлого кадра участок, при переходе через конец - два куска
+    const quint64 pending = fWritten - fUploaded;
+    if (pending >= quint64(fCapacity))
+        upload(0, fCapacity);
+    else if (pending > 0) {
+        const int from = int(fUploaded % quint64(fCapacity));
+        const int count = int(pending);
+        const int first = qMin(count, fCapacity - from);
+        upload(from, first);
+        if (count > first)
+            upload(0, count - first);
+    }
+    fUploaded = fWritten;
+
+    fProgram->bind();
+    fProgram->setUniformValue("color", QVector3D(fColor.redF(), fColor.greenF(), fColor.blueF()));
+    fProgram->setUniformValue("Matrix", pmvMatrix);
+    fProgram->setUniformValue("now", GLfloat(now() - fTimeBase));
+    fProgram->setUniformValue("window", fWindow);
+    const int location = fProgram->attributeLocation("qt_Vertex");
+    fProgram->enableAttributeArray(location);
+    fProgram->setAttributeBuffer(location, GL_FLOAT, 0, 4);
+
+    f->glEnable(GL_BLEND);
+    f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    f->glDepthMask(GL_FALSE);
+    glPointSize(fPointSize);
+
+    // от старых точек к новым: сначала хвост кольца после головы, затем начало
+    if (fWritten <= quint64(fCapacity))
+        f->glDrawArrays(GL_POINTS, 0, int(fWritten));
+    else {
+        const int head = int(fWritten % quint64(fCapacity));
+        f->glDrawArrays(GL_POINTS, head, fCapacity - head);
+        if (head > 0)
+            f->glDrawArrays(GL_POINTS, 0, head);
+    }
+
+    f->glDepthMask(GL_TRUE);
+    f->glDisable(GL_BLEND);
+    fProgram->disableAttributeArray(location);
+    fProgram->release();
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void RollingSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QMutexLocker locker(&fMutex);
+    if (fVbo)
+        ctx->functions()->glDeleteBuffers(1, &fVbo);
+    fVbo = 0;
+    fUploaded = 0;
+
+    if (fProgram) {
+        SceneResources *resources = SceneResources::current();
+        if (resources)
+            resources->release("program:" RING_VERTEX_SHADER ":" RING_FRAGMENT_SHADER);
+        fProgram = nullptr;
+    }
+}
+
+SpriteSeries::SpriteSeries(const QString &name) : DataSeries(name), fExtent(1.0f, 1.0f, 1.0f), fAttenuation(0.0f), fRound(true),
+    fDirty(false), fVbo(0), fProgram(nullptr), fDensity(false), fDownsample(2), fSaturation(0.0f), fColormapDirty(true),
+    fDensityFbo(nullptr), fDensityContext(nullptr), fColormapTexture(0), fDensityProgram(nullptr), fToneProgram(nullptr)
+{
+    fPointSize = 3.0f;
+    fColormap = defaultColormap();
+}
+
+SpriteSeries::~SpriteSeries()
+{
+}
+
+void SpriteSeries::setPoints(const float *xyz, const QRgb *colors, const float *sizes, int count)
+{
+    QVector3D lo, hi;
+    if (count > 0) {
+        float min[3] = { xyz[0], xyz[1], xyz[2] };
+        float max[3] = { xyz[0], xyz[1], xyz[2] };
+        extendBounds(xyz, size_t(count), min, max);
+        lo = QVector3D(min[0], min[1], min[2]);
+        hi = QVector3D(max[0], max[1], max[2]);
+    }
+
+    QRgb color;
+    float size;
+    {
+        QMutexLocker locker(&fMutex);
+        color = fColor.rgba();
+        size = fPointSize;
+    }
+
+    // упаковка миллионов точек - без блокировки, отрисовка не ждёт
+    QVector<SpriteVertex> vertices(qMax(count, 0));
+    PointSprites::pack(xyz, colors, sizes, vertices.count(), color, size, lo, hi - lo, vertices.data());
+
+    QMutexLocker locker(&fMutex);
+    fVertices.swap(vertices);
+    fOrigin = lo;
+    fExtent = hi - lo;
+    fDirty = true;
+}
+
+void SpriteSeries::clear()
+{
+    QMutexLocker locker(&fMutex);
+    fVertices.clear();
+    fDirty = true;
+}
+
+bool SpriteSeries::bounds(QVector3D *min, QVector3D *max) const
+{
+    QMutexLocker locker(&fMutex);
+    if (fVertices.isEmpty())
+        return false;
+    *min = fOrigin;
+    *max = fOrigin + fExtent;
+    return true;
+}
+
+int SpriteSeries::count() const
+{
+    QMutexLocker locker(&fMutex);
+    return fVertices.count();
+}
+
+QVector3D SpriteSeries::boundsMin() const
+{
+    QMutexLocker locker(&fMutex);
+    return fOrigin;
+}
+
+QVector3D SpriteSeries::boundsMax() const
+{
+    QMutexLocker locker(&fMutex);
+    return fOrigin + fExtent;
+}
+
+void SpriteSeries::setAttenuation(float distance)
+{
+    QMutexLocker locker(&fMutex);
+    fAttenuation = qMax(0.0f, distance);
+}
+
+float SpriteSeries::attenuation() const
+{
+    QMutexLocker locker(&fMutex);
+    return fAttenuation;
+}
+
+void SpriteSeries::setRoundPoints(bool round)
+{
+    QMutexLocker locker(&fMutex);
+    fRound = round;
+}
+
+bool SpriteSeries::roundPoints() const
+{
+    QMutexLocker locker(&fMutex);
+    return fRound;
+}
+
+void SpriteSeries::setDensityMode(bool enabled, int downsample)
+{
+    QMutexLocker locker(&fMutex);
+    fDensity = enabled;
+    fDownsample = qBound(1, downsample, 16);
+}
+
+bool SpriteSeries::densityMode() const
+{
+    QMutexLocker locker(&fMutex);
+    return fDensity;
+}
+
+void SpriteSeries::setDensitySaturation(float count)
+{
+    QMutexLocker locker(&fMutex);
+    fSaturation = qMax(0.0f, count);
+}
+
+void SpriteSeries::setDensityColormap(const QVector<QRgb> &colors)
+{
+    if (colors.isEmpty())
+        return;
+    QMutexLocker locker(&fMutex);
+    fColormap = colors;
+    fColormapDirty = true;
+}
+
+void SpriteSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    Q_UNUSED(program);
+
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fVisible || fVertices.isEmpty())
+        return;
+
+    if (!fVbo) {
+        f->glGenBuffers(1, &fVbo);
+        fDirty = true;
+    }
+    f->glBindBuffer(GL_ARRAY_BUFFER, fVbo);
+    if (fDirty) {
+        // облако заменяется целиком, старое хранилище отдаём драйверу
+        const GLsizeiptr bytes = GLsizeiptr(fVertices.count()) * GLsizeiptr(sizeof(SpriteVertex));
+        f->glBufferData(GL_ARRAY_BUFFER, bytes, fVertices.constData(), GL_STATIC_DRAW);
+        fUploadedBytes += quint64(bytes);
+        fDirty = false;
+    }
+
+    if (fDensity && drawDensity(pmvMatrix)) {
+        f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return;
+    }
+
+    if (!fProgram)
+        fProgram = PointSprites::acquireProgram();
+    if (!fProgram) {
+        f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return;
+    }
+
+    fProgram->bind();
+    fProgram->setUniformValue("Matrix", pmvMatrix);
+    fProgram->setUniformValue("origin", fOrigin);
+    fProgram->setUniformValue("extent", fExtent);
+    fProgram->setUniformValue("sizeScale", GLfloat(PointSprites::MaxSize));
+    fProgram->setUniformValue("attenuation", fAttenuation);
+    fProgram->setUniformValue("roundPoints", fRound);
+
+    const int vertexLocation = fProgram->attributeLocation("qt_Vertex");
+    const int colorLocation = fProgram->attributeLocation("qt_Color");
+    fProgram->enableAttributeArray(vertexLocation);
+    fProgram->setAttributeBuffer(vertexLocation, GL_UNSIGNED_SHORT, 0, 4, sizeof(SpriteVertex));
+    fProgram->enableAttributeArray(colorLocation);
+    fProgram->setAttributeBuffer(colorLocation, GL_UNSIGNED_BYTE, offsetof(SpriteVertex, r), 4, sizeof(SpriteVertex));
+
+    PointSprites::begin();
+    f->glDrawArrays(GL_POINTS, 0, fVertices.count());
+    PointSprites::end();
+
+    fProgram->disableAttributeArray(colorLocation);
+    fProgram->disableAttributeArray(vertexLocation);
+    fProgram->release();
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static QOpenGLShaderProgram *createDensityProgram()
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, DENSITY_VERTEX_SHADER))
+        qDebug() << "VertexShader:" << program->log();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, DENSITY_FRAGMENT_SHADER))
+        qDebug() << "FragmentShader:" << program->log();
+    program->link();
+    return program;
+}
+
+static QOpenGLShaderProgram *createToneProgram()
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, TONEMAP_VERTEX_SHADER))
+        qDebug() << "VertexShader:" << program->log();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, TONEMAP_FRAGMENT_SHADER))
+        qDebug() << "FragmentShader:" << program->log();
+    program->link();
+    return program;
+}
+
+bool SpriteSeries::drawDensity(const QMatrix4x4 &pmvMatrix)
+{
+    // fMutex захвачен, вершины загружены и fVbo привязан
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    SceneResources *resources = SceneResources::current();
+    if (!resources)
+        return false;
+
+    QOpenGLFunctions *f = ctx->functions();
+    GLint viewport[4];
+    f->glGetIntegerv(GL_VIEWPORT, viewport);
+    const QSize size(qMax(1, (viewport[2] + fDownsample - 1) / fDownsample), qMax(1, (viewport[3] + fDownsample - 1) / fDownsample));
+    if (fDensityFbo && (fDensityFbo->size() != size || fDensityContext != ctx)) {
+        delete fDensityFbo;
+        fDensityFbo = nullptr;
+    }
+    if (!fDensityFbo) {
+        fDensityFbo = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::NoAttachment, GL_TEXTURE_2D, GL_R32F);
+        if (!fDensityFbo->isValid()) {
+            qDebug() << "SpriteSeries: no float framebuffer, density is drawn as sprites";
+            delete fDensityFbo;
+            fDensityFbo = nullptr;
+            fDensity = false;
+            return false;
+        }
+        fDensityContext = ctx;
+        f->glBindTexture(GL_TEXTURE_2D, fDensityFbo->texture());
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        f->glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    if (!fDensityProgram)
+        fDensityProgram = resources->acquire<QOpenGLShaderProgram>("program:" DENSITY_VERTEX_SHADER ":" DENSITY_FRAGMENT_SHADER, createDensityProgram);
+    if (!fToneProgram)
+        fToneProgram = resources->acquire<QOpenGLShaderProgram>("program:" TONEMAP_VERTEX_SHADER ":" TONEMAP_FRAGMENT_SHADER, createToneProgram);
+
+    // цель кадра может быть FBO потока отрисовки, а не экран виджета
+    GLint target = 0;
+    GLfloat clearColor[4];
+    f->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
+    f->glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    const bool depthTest = f->glIsEnabled(GL_DEPTH_TEST);
+
+    // накопление: точка в один пиксель прибавляет 1, без глубины и затенения
+    fDensityFbo->bind();
+    f->glViewport(0, 0, size.width(), size.height());
+    f->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    f->glClear(GL_COLOR_BUFFER_BIT);
+    f->glDisable(GL_DEPTH_TEST);
+    f->glEnable(GL_BLEND);
+    f->glBlendFunc(GL_ONE, GL_ONE);
+    glPointSize(1.0f);
+
+    fDensityProgram->bind();
+    fDensityProgram->setUniformValue("Matrix", pmvMatrix);
+    fDensityProgram->setUniformValue("origin", fOrigin);
+    fDensityProgram->setUniformValue("extent", fExtent);
+    const int vertexLocation = fDensityProgram->attributeLocation("qt_Vertex");
+    fDensityProgram->enableAttributeArray(vertexLocation);
+    fDensityProgram->setAttributeBuffer(vertexLocation, GL_UNSIGNED_SHORT, 0, 3, sizeof(SpriteVertex));
+    f->glDrawArrays(GL_POINTS, 0, fVertices.count());
+    fDensityProgram->disableAttributeArray(vertexLocation);
+    fDensityProgram->release();
+
+    f->glBindFramebuffer(GL_FRAMEBUFFER, GLuint(target));
+    f->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    f->glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+    // цвет по логарифму числа точек, полноэкранный квадрат поверх сцены
+    f->glActiveTexture(GL_TEXTURE1);
+    if (!fColormapTexture) {
+        f->glGenTextures(1, &fColormapTexture);
+        glBindTexture(GL_TEXTURE_1D, fColormapTexture);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        fColormapDirty = true;
+    }
+    else
+        glBindTexture(GL_TEXTURE_1D, fColormapTexture);
+    if (fColormapDirty) {
+        uploadColormap(fColormap);
+        fColormapDirty = false;
+    }
+    f->glActiveTexture(GL_TEXTURE0);
+    f->glBindTexture(GL_TEXTURE_2D, fDensityFbo->texture());
+
+    const float saturation = fSaturation > 0.0f ? fSaturation
+            : qMax(1.0f, DENSITY_AUTO_SATURATION * fVertices.count() / (float(size.width()) * size.height()));
+    const GLfloat quad[8] = { -1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f };
+    f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    fToneProgram->bind();
+    fToneProgram->setUniformValue("density", 0);
+    fToneProgram->setUniformValue("colormap", 1);
+    fToneProgram->setUniformValue("logScale", 1.0f / std::log(1.0f + saturation));
+    const int quadLocation = fToneProgram->attributeLocation("qt_Vertex");
+    fToneProgram->enableAttributeArray(quadLocation);
+    fToneProgram->setAttributeArray(quadLocation, quad, 2);
+    f->glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    fToneProgram->disableAttributeArray(quadLocation);
+    fToneProgram->release();
+
+    f->glDisable(GL_BLEND);
+    if (depthTest)
+        f->glEnable(GL_DEPTH_TEST);
+    f->glBindTexture(GL_TEXTURE_2D, 0);
+    f->glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    f->glActiveTexture(GL_TEXTURE0);
+    return true;
+}
+
+void SpriteSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QMutexLocker locker(&fMutex);
+    if (fVbo)
+        ctx->functions()->glDeleteBuffers(1, &fVbo);
+    fVbo = 0;
+
+    if (fProgram) {
+        PointSprites::releaseProgram();
+        fProgram = nullptr;
+    }
+
+    if (fColormapTexture)
+        ctx->functions()->glDeleteTextures(1, &fColormapTexture);
+    fColormapTexture = 0;
+    fColormapDirty = true;
+    delete fDensityFbo;
+    fDensityFbo = nullptr;
+    fDensityContext = nullptr;
+
+    SceneResources *resources = SceneResources::current();
+    if (fDensityProgram && resources)
+        resources->release("program:" DENSITY_VERTEX_SHADER ":" DENSITY_FRAGMENT_SHADER);
+    if (fToneProgram && resources)
+        resources->release("program:" TONEMAP_VERTEX_SHADER ":" TONEMAP_FRAGMENT_SHADER);
+    fDensityProgram = fToneProgram = nullptr;
+}
+
+PolylineSeries::PolylineSeries(const QString &name) : DataSeries(name), fMaxError(1.0f), fDrawnLevel(0), fSubmitted(0)
+{
+}
+
+PolylineSeries::~PolylineSeries()
+{
+}
+
+void PolylineSeries::append(const float *xyz, int n)
+{
+    QMutexLocker locker(&fMutex);
+    fLod.append(xyz, n);
+}
+
+void PolylineSeries::clear()
+{
+    QMutexLocker locker(&fMutex);
+    fLod.clear();
+    for (int i = 0; i < fBuffers.count(); i++)
+        fBuffers[i].uploaded = 0;
+}
+
+int PolylineSeries::count() const
+{
+    QMutexLocker locker(&fMutex);
+    return fLod.count();
+}
+
+void PolylineSeries::setMaxError(float pixels)
+{
+    QMutexLocker locker(&fMutex);
+    fMaxError = qMax(0.01f, pixels);
+}
+
+float PolylineSeries::maxError() const
+{
+    QMutexLocker locker(&fMutex);
+    return fMaxError;
+}
+
+int PolylineSeries::drawnLevel() const
+{
+    QMutexLocker locker(&fMutex);
+    return fDrawnLevel;
+}
+
+int PolylineSeries::submittedVertices() const
+{
+    QMutexLocker locker(&fMutex);
+    return fSubmitted;
+}
+
+bool PolylineSeries::bounds(QVector3D *min, QVector3D *max) const
+{
+    QMutexLocker locker(&fMutex);
+    if (!fLod.count())
+        return false;
+    *min = fLod.boundsMin();
+    *max = fLod.boundsMax();
+    return true;
+}
+
+float PolylineSeries::worldError(const QMatrix4x4 &pmvMatrix, const QSize &viewport) const
+{
+    const QVector4D r0 = pmvMatrix.row(0);
+    const QVector4D r1 = pmvMatrix.row(1);
+    const QVector4D r2 = pmvMatrix.row(2);
+    const QVector4D r3 = pmvMatrix.row(3);
+    // пикселей на единицу длины при w = 1
+    const float pixelScale = 0.5f * qMax(r0.toVector3D().length() * viewport.width(), r1.toVector3D().length() * viewport.height());
+    if (pixelScale <= 0.0f)
+        return 0.0f;
+
+    float w = 1.0f;
+    const QVector3D dir = r3.toVector3D();
+    if (!qFuzzyIsNull(dir.lengthSquared())) {
+        // ближайший угол границ, но не ближе передней плоскости: ближе всё отсечено.
+        // z клипа линеен по w, передняя плоскость - там, где z = -w
+        const float w0 = r3.w();
+        const float z0 = r2.w();
+        const float w1 = w0 + dir.lengthSquared();
+        const float z1 = z0 + QVector3D::dotProduct(r2.toVector3D(), dir);
+        const float alpha = (z1 - z0) / (w1 - w0);
+        const float nearW = qFuzzyCompare(alpha, -1.0f) ? 0.001f : qMax(0.001f, -(z0 - alpha * w0) / (alpha + 1.0f));
+
+        const QVector3D lo = fLod.boundsMin();
+        const QVector3D hi = fLod.boundsMax();
+        w = 1e30f;
+        for (int c = 0; c < 8; c++) {
+            const QVector3D corner((c & 1) ? hi.x() : lo.x(), (c & 2) ? hi.y() : lo.y(), (c & 4) ? hi.z() : lo.z());
+            w = qMin(w, QVector3D::dotProduct(dir, corner) + r3.w());
+        }
+        w = qMax(w, nearW);
+    }
+    return fMaxError * w / pixelScale;
+}
+
+void PolylineSeries::upload(int level)
+{
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    if (fBuffers.count() <= level)
+        fBuffers.resize(level + 1);
+
+    LevelBuffer &buffer = fBuffers[level];
+    const int points = fLod.levelPoints(level);
+    const float *data = fLod.levelData(level);
+    if (!buffer.vbo)
+        f->glGenBuffers(1, &buffer.vbo);
+    f->glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+
+    if (points > buffer.capacity) {
+        // запас вдвое, чтобы перевыделение было редким
+        buffer.capacity = qMax(points * 2, 1024);
+        f->glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(buffer.capacity) * POINT_BYTES, nullptr, GL_DYNAMIC_DRAW);
+        buffer.uploaded = 0;
+    }
+    if (buffer.uploaded < points) {
+        const int fresh = points - buffer.uploaded;
+        f->glBufferSubData(GL_ARRAY_BUFFER, GLintptr(buffer.uploaded) * POINT_BYTES, GLsizeiptr(fresh) * POINT_BYTES, data + buffer.uploaded * 3);
+        fUploadedBytes += quint64(fresh) * POINT_BYTES;
+        buffer.uploaded = points;
+    }
+}
+
+void PolylineSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx || !program)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fVisible || fLod.count() < 2)
+        return;
+
+    GLint viewport[4];
+    f->glGetIntegerv(GL_VIEWPORT, viewport);
+    fDrawnLevel = fLod.pickLevel(worldError(pmvMatrix, QSize(viewport[2], viewport[3])));
+
+    QVector<PolylineLod::Range> ranges;
+    fLod.ranges(fDrawnLevel, ranges);
+
+    program->bind();
+    program->setUniformValue("color", QVector3D(fColor.redF(), fColor.greenF(), fColor.blueF()));
+    program->setUniformValue("Matrix", pmvMatrix);
+    const int location = program->attributeLocation("qt_Vertex");
+    program->enableAttributeArray(location);
+
+    fSubmitted = 0;
+    for (int i = 0; i < ranges.count(); i++) {
+        const PolylineLod::Range &range = ranges[i];
+        if (range.level == fDrawnLevel) {
+            upload(range.level);
+            program->setAttributeBuffer(location, GL_FLOAT, 0, 3);
+        }
+        else {
+            // хвосты короче корзины, их проще отдать из памяти
+            f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+            program->setAttributeArray(location, fLod.levelData(range.level), 3);
+        }
+        f->glDrawArrays(GL_LINE_STRIP, range.first, range.count);
+        fSubmitted += range.count;
+    }
+
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    program->disableAttributeArray(location);
+    program->release();
+}
+
+void PolylineSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QMutexLocker locker(&fMutex);
+    for (int i = 0; i < fBuffers.count(); i++) {
+        if (fBuffers[i].vbo)
+            ctx->functions()->glDeleteBuffers(1, &fBuffers[i].vbo);
+    }
+    fBuffers.clear();
+}
+
+WaterfallSeries::WaterfallSeries(const QString &name, int columns, int rows) : DataSeries(name), fColumns(qMax(2, columns)), fRows(qMax(2, rows)),
+    fWritten(0), fUploaded(0), fMin(0.0f), fMax(1.0f), fOrigin(0.0f, 0.0f, 0.0f), fSize(1.0f, 1.0f, 1.0f), fColormapDirty(true),
+    fVbo(0), fIbo(0), fHeights(0), fColormapTexture(0), fProgram(nullptr)
+{
+    fRing = new float[size_t(fColumns) * size_t(fRows)];
+    fColormap = defaultColormap();
+}
+
+WaterfallSeries::~WaterfallSeries()
+{
+    delete [] fRing;
+}
+
+void WaterfallSeries::append(const float *values, int rowCount)
+{
+    QMutexLocker locker(&fMutex);
+    // из пачки больше кольца видны только последние строки
+    if (rowCount > fRows) {
+        values += size_t(rowCount - fRows) * fColumns;
+        fWritten += quint64(rowCount - fRows);
+        rowCount = fRows;
+    }
+
+    for (int i = 0; i < rowCount; i++, values += fColumns) {
+        const int row = int(fWritten % quint64(fRows));
+        memcpy(fRing + size_t(row) * fColumns, values, fColumns * sizeof(float));
+        fWritten++;
+    }
+}
+
+void WaterfallSeries::clear()
+{
+    QMutexLocker locker(&fMutex);
+    fWritten = 0;
+    fUploaded = 0;
+}
+
+int WaterfallSeries::count() const
+{
+    QMutexLocker locker(&fMutex);
+    return int(qMin(fWritten, quint64(fRows)));
+}
+
+void WaterfallSeries::setValueRange(float min, float max)
+{
+    QMutexLocker locker(&fMutex);
+    fMin = qMin(min, max);
+    fMax = qMax(min, max);
+}
+
+void WaterfallSeries::setGeometry(const QVector3D &origin, const QVector3D &size)
+{
+    QMutexLocker locker(&fMutex);
+    fOrigin = origin;
+    fSize = size;
+}
+
+void WaterfallSeries::setColormap(const QVector<QRgb> &colors)
+{
+    if (colors.isEmpty())
+        return;
+    QMutexLocker locker(&fMutex);
+    fColormap = colors;
+    fColormapDirty = true;
+}
+
+bool WaterfallSeries::bounds(QVector3D *min, QVector3D *max) const
+{
+    QMutexLocker locker(&fMutex);
+    if (!fWritten)
+        return false;
+    const QVector3D end = fOrigin + fSize;
+    *min = QVector3D(qMin(fOrigin.x(), end.x()), qMin(fOrigin.y(), end.y()), qMin(fOrigin.z(), end.z()));
+    *max = QVector3D(qMax(fOrigin.x(), end.x()), qMax(fOrigin.y(), end.y()), qMax(fOrigin.z(), end.z()));
+    return true;
+}
+
+static QOpenGLShaderProgram *createWaterfallProgram()
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, WATERFALL_VERTEX_SHADER))
+        qDebug() << "VertexShader:" << program->log();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, WATERFALL_FRAGMENT_SHADER))
+        qDebug() << "FragmentShader:" << program->log();
+    program->link();
+    return program;
+}
+
+void WaterfallSeries::createMesh()
+{
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+
+    // вершина - номер столбца и возраст строки, высоту даёт текстура
+    QVector<GLfloat> vertices(fColumns * fRows * 2);
+    GLfloat *v = vertices.data();
+    for (int age = 0; age < fRows; age++) {
+        for (int column = 0; column < fColumns; column++, v += 2) {
+            v[0] = GLfloat(column);
+            v[1] = GLfloat(age);
+        }
+    }
+
+    // полосы между соседними строками по возрасту: первые n - 1 полос рисуют n строк
+    QVector<GLuint> indexes((fColumns - 1) * (fRows - 1) * 6);
+    GLuint *index = indexes.data();
+    for (int age = 0; age + 1 < fRows; age++) {
+        for (int column = 0; column + 1 < fColumns; column++, index += 6) {
+            const GLuint a = GLuint(age * fColumns + column);
+            const GLuint b = a + GLuint(fColumns);
+            index[0] = a;
+            index[1] = a + 1;
+            index[2] = b;
+            index[3] = b;
+            index[4] = a + 1;
+            index[5] = b + 1;
+        }
+    }
+
+    f->glGenBuffers(1, &fVbo);
+    f->glBindBuffer(GL_ARRAY_BUFFER, fVbo);
+    f->glBufferData(GL_ARRAY_BUFFER, vertices.count() * sizeof(GLfloat), vertices.constData(), GL_STATIC_DRAW);
+    f->glGenBuffers(1, &fIbo);
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fIbo);
+    f->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexes.count() * sizeof(GLuint), indexes.constData(), GL_STATIC_DRAW);
+    fUploadedBytes += vertices.count() * sizeof(GLfloat) + indexes.count() * sizeof(GLuint);
+}
+
+void WaterfallSeries::uploadRows(int from, int count)
+{
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    f->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, from, fColumns, count, GL_RED, GL_FLOAT, fRing + size_t(from) * fColumns);
+    fUploadedBytes += quint64(count) * fColumns * sizeof(float);
+}
+
+void WaterfallSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    Q_UNUSED(program);
+
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    SceneResources *resources = SceneResources::current();
+    if (!ctx || !resources)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fVisible || fWritten < 2)
+        return;
+
+    if (!fProgram)
+        fProgram = resources->acquire<QOpenGLShaderProgram>("program:" WATERFALL_VERTEX_SHADER ":" WATERFALL_FRAGMENT_SHADER, createWaterfallProgram);
+    if (!fVbo)
+        createMesh();
+
+    f->glActiveTexture(GL_TEXTURE1);
+    if (!fColormapTexture) {
+        f->glGenTextures(1, &fColormapTexture);
+        glBindTexture(GL_TEXTURE_1D, fColormapTexture);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        fColormapDirty = true;
+    }
+    else
+        glBindTexture(GL_TEXTURE_1D, fColormapTexture);
+    if (fColormapDirty) {
+        uploadColormap(fColormap);
+        fColormapDirty = false;
+    }
+
+    f->glActiveTexture(GL_TEXTURE0);
+    if (!fHeights) {
+        f->glGenTextures(1, &fHeights);
+        f->glBindTexture(GL_TEXTURE_2D, fHeights);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        f->glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, fColumns, fRows, 0, GL_RED, GL_FLOAT, nullptr);
+        fUploaded = fWritten > quint64(fRows) ? fWritten - quint64(fRows) : 0;
+    }
+    else
+        f->glBindTexture(GL_TEXTURE_2D, fHeights);
+
+    // одна строка текстуры на строку данных, при переходе через конец кольца - два куска
+    const quint64 pending = fWritten - fUploaded;
+    if (pending >= quint64(fRows))
+        uploadRows(0, fRows);
+    else if (pending > 0) {
+        const int from = int(fUploaded % quint64(fRows));
+        const int count = int(pending);
+        const int first = qMin(count, fRows - from);
+        uploadRows(from, first);
+        if (count > first)
+            uploadRows(0, count - first);
+    }
+    fUploaded = fWritten;
+
+    fProgram->bind();
+    fProgram->setUniformValue("Matrix", pmvMatrix);
+    fProgram->setUniformValue("heights", 0);
+    fProgram->setUniformValue("colormap", 1);
+    fProgram->setUniformValue("columns", GLfloat(fColumns));
+    fProgram->setUniformValue("rows", GLfloat(fRows));
+    fProgram->setUniformValue("head", GLfloat((fWritten - 1) % quint64(fRows)));
+    fProgram->setUniformValue("origin", fOrigin);
+    fProgram->setUniformValue("size", fSize);
+    fProgram->setUniformValue("valueMin", fMin);
+    fProgram->setUniformValue("valueScale", fMax > fMin ? 1.0f / (fMax - fMin) : 0.0f);
+
+    f->glBindBuffer(GL_ARRAY_BUFFER, fVbo);
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fIbo);
+    const int location = fProgram->attributeLocation("qt_Vertex");
+    fProgram->enableAttributeArray(location);
+    fProgram->setAttributeBuffer(location, GL_FLOAT, 0, 2);
+    f->glEnable(GL_DEPTH_TEST);
+
+    const int shown = int(qMin(fWritten, quint64(fRows)));
+    f->glDrawElements(GL_TRIANGLES, (shown - 1) * (fColumns - 1) * 6, GL_UNSIGNED_INT, nullptr);
+
+    fProgram->disableAttributeArray(location);
+    fProgram->release();
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    f->glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    f->glActiveTexture(GL_TEXTURE0);
+    f->glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void WaterfallSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (fVbo)
+        f->glDeleteBuffers(1, &fVbo);
+    if (fIbo)
+        f->glDeleteBuffers(1, &fIbo);
+    if (fHeights)
+        f->glDeleteTextures(1, &fHeights);
+    if (fColormapTexture)
+        f->glDeleteTextures(1, &fColormapTexture);
+    fVbo = fIbo = fHeights = fColormapTexture = 0;
+    fUploaded = 0;
+
+    if (fProgram) {
+        SceneResources *resources = SceneResources::current();
+        if (resources)
+            resources->release("program:" WATERFALL_VERTEX_SHADER ":" WATERFALL_FRAGMENT_SHADER);
+        fProgram = nullptr;
+    }
+}
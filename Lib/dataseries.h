@@ -0,0 +1,374 @@
+#ifndef DATASERIES_H
+#define DATASERIES_H
+
+#include <QString>
+#include <QColor>
+#include <QVector>
+#include <QList>
+#include <QByteArray>
+#include <QVector3D>
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QSize>
+#include <qopengl.h>
+
+#include "gl_pointsprites.h"
+#include "polylinelod.h"
+
+class QOpenGLShaderProgram;
+class QOpenGLFramebufferObject;
+class QOpenGLContext;
+
+// Common part of the data series owned by the scene.
+class DataSeries
+{
+public:
+    explicit DataSeries(const QString &name);
+    virtual ~DataSeries() {}
+
+    QString name() const { return fName; }
+
+    void setColor(const QColor &color);
+    QColor color() const;
+    void setPointSize(float size);
+    float pointSize() const;
+    void setVisible(bool visible);
+    bool isVisible() const;
+    quint64 uploadedBytes() const;
+
+    // границы без обхода точек; false, если серия их не знает или пуста
+    virtual bool bounds(QVector3D *min, QVector3D *max) const { Q_UNUSED(min); Q_UNUSED(max); return false; }
+
+    // context of the scene share group must be current
+    virtual void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) = 0;
+    virtual void releaseGL() = 0;
+
+protected:
+    static QVector<QRgb> defaultColormap();                 // blue - cyan - yellow - red
+    static void uploadColormap(const QVector<QRgb> &colors);   // to the bound GL_TEXTURE_1D
+
+    mutable QMutex fMutex;
+    QColor fColor;
+    float fPointSize;
+    bool fVisible;
+    quint64 fUploadedBytes;
+
+private:
+    QString fName;
+
+    Q_DISABLE_COPY(DataSeries)
+};
+
+// Point cloud stored in fixed-size chunks. Appending never moves stored points:
+// a new chunk is allocated when the last one is full. Each chunk has its own
+// vertex buffer of the full chunk size, draw() uploads only the points appended
+// since the previous frame and issues one draw call per chunk.
+// Every chunk keeps a summary: time range, AABB (the min/max of each coordinate)
+// and the times of its appends. With a time window set, draw() finds the first
+// overlapping chunk by binary search and draws only the points inside the window,
+// chunks outside it are not even uploaded. Times must not decrease, an earlier
+// time is raised to the last one.
+// With compression on, full chunks beyond the warm ones are kept only packed by
+// PointCodec (16-bit quantization to the chunk AABB, 2-6 times smaller depending
+// on how close successive points are) and unpacked when their buffer has to be
+// filled again, e.g. after releaseGL().
+// The unpacked chunks form an LRU of warmChunks entries, the packed copy stays
+// so that evicting a chunk just frees its points. Packed chunks also keep at most
+// one time mark per 256 points, the time window then cuts them to within that.
+// With the Normalized16 vertex format the vertex buffers hold 16-bit coordinates
+// in a frame of the chunk (offset and scale, 8 bytes per point instead of 12);
+// the frame is applied to the matrix, so the shader decodes them for free. The
+// frame of a growing chunk has a margin and is widened (with a full upload of the
+// chunk) when the new points leave it.
+// append() and clear() may be called from any thread, draw() and releaseGL()
+// with a context of the scene share group current.
+class PointSeries : public DataSeries
+{
+public:
+    enum {
+        ChunkPoints = 65536
+    };
+
+    enum VertexFormat {
+        Float32,            // 12 bytes per point
+        Normalized16        // 8 bytes per point, 1/65535 of the chunk frame
+    };
+
+    struct ChunkSummary {
+        double firstTime;
+        double lastTime;
+        QVector3D min;
+        QVector3D max;
+        int count;
+    };
+
+    explicit PointSeries(const QString &name);
+    ~PointSeries();     // releaseGL() must be called before if the series was drawn
+
+    void append(const float *xyz, size_t n);                 // time - now()
+    void append(const float *xyz, size_t n, double time);
+    void append(const QVector<QVector3D> &points) { append(reinterpret_cast<const float*>(points.constData()), size_t(points.count())); }
+    void clear();       // keeps chunks and buffers for the next points
+
+    quint64 count() const;
+    int chunkCount() const;
+    double now() const;                 // seconds from the series creation
+
+    void setTimeWindow(double from, double to);     // draw only points with from <= time <= to
+    void clearTimeWindow();
+    bool hasTimeWindow() const;
+    QVector<ChunkSummary> summaries(double from, double to) const;
+    bool bounds(QVector3D *min, QVector3D *max) const override;    // of the time window, if set
+
+    void setCompression(bool enabled, int warmChunks = 4);
+    bool compression() const;
+    quint64 memoryBytes() const;        // points and time marks in RAM, unpacked and packed
+
+    void setVertexFormat(VertexFormat format);  // buffers are filled again on the next draw()
+    VertexFormat vertexFormat() const;
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    struct Mark {
+        double time;
+        int first;          // first point of the append
+    };
+
+    struct Chunk {
+        float *data;        // ChunkPoints * 3, nullptr while only packed
+        QByteArray packed;  // PointCodec block of a full chunk
+        int count;
+        int uploaded;       // points already in vbo
+        GLuint vbo;
+        VertexFormat format;    // of vbo
+        bool framed;
+        float origin[3];        // Normalized16 frame
+        float extent[3];
+        QVector<Mark> marks;
+        bool thinned;       // marks thinned when the chunk was packed
+        float min[3];
+        float max[3];
+        Chunk() : data(nullptr), count(0), uploaded(0), vbo(0), format(Float32), framed(false), thinned(false) {}
+    };
+
+    QVector<Chunk> fChunks;
+    int fUsedChunks;        // chunks after clear() are reused from the start
+    quint64 fCount;
+    double fLastTime;
+    QElapsedTimer fClock;
+    bool fWindowed;
+    double fWindowFrom;
+    double fWindowTo;
+    bool fCompression;
+    int fWarmChunks;
+    QList<int> fWarm;       // full unpacked chunks, the least recently used first
+    VertexFormat fFormat;
+    QVector<quint16> fQuantized;    // upload scratch of Normalized16
+
+    int firstChunk(double time) const;      // first chunk ending at or after time
+    void range(const Chunk &chunk, int *first, int *count) const;
+    void compressCold();
+    void thinMarks(Chunk &chunk);
+    bool fitFrame(Chunk &chunk);            // true if the frame changed
+    void upload(Chunk &chunk);              // the tail after uploaded, vbo bound
+};
+
+// Last points of a live signal in a ring of fixed capacity. The vertex buffer
+// is allocated once, new points overwrite the oldest ones and only the written
+// span is uploaded (two glBufferSubData calls when it wraps). The ring is drawn
+// as at most two ranges; the shader fades points by age from the per-vertex
+// time and the "now" uniform and hides points older than the window.
+class RollingSeries : public DataSeries
+{
+public:
+    RollingSeries(const QString &name, int capacity);
+    ~RollingSeries();   // releaseGL() must be called before if the series was drawn
+
+    void append(const float *xyz, size_t n);                 // time - now()
+    void append(const float *xyz, size_t n, double time);   // time of all points, s on the now() clock
+    void clear();
+
+    int capacity() const { return fCapacity; }
+    int count() const;
+    void setWindow(float seconds);      // points older than the window are invisible
+    float window() const;
+    double now() const;                 // seconds from the series creation
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    const int fCapacity;
+    float *fRing;           // capacity * 4: x, y, z, time - fTimeBase
+    quint64 fWritten;       // points ever written
+    quint64 fUploaded;      // points ever uploaded
+    float fWindow;
+    double fTimeBase;       // время хранится во float относительно этой точки
+    QElapsedTimer fClock;
+    GLuint fVbo;
+    QOpenGLShaderProgram *fProgram;
+
+    void rebase(double time);
+    void upload(int from, int count);
+};
+
+// Point cloud replaced as a whole and drawn as shader sprites with per-point
+// color and size. Vertices are packed to 12 bytes (SpriteVertex) relative to the
+// cloud bounds, so 5M points take 60 MB and one draw call. Colors and sizes are
+// packed by setPoints(), later setColor()/setPointSize() apply to the next points.
+// setPoints() may be called from any thread, packing is done outside the lock.
+// In the density mode the points are not shaded as sprites: each adds 1 to a
+// float framebuffer of the viewport size divided by downsample (one pixel, no
+// depth test, additive blending), then a full-screen pass maps the count of
+// every pixel through a colormap on a log scale. Pixels without points stay
+// transparent. Needs float render targets (GL 3.0 or ARB_texture_float), without
+// them the cloud is drawn as sprites.
+class SpriteSeries : public DataSeries
+{
+public:
+    explicit SpriteSeries(const QString &name);
+    ~SpriteSeries();    // releaseGL() must be called before if the series was drawn
+
+    // colors and sizes (px) may be null - color() and pointSize() are used
+    void setPoints(const float *xyz, const QRgb *colors, const float *sizes, int count);
+    void setPoints(const QVector<QVector3D> &points) { setPoints(reinterpret_cast<const float*>(points.constData()), nullptr, nullptr, points.count()); }
+    void clear();
+
+    int count() const;
+    QVector3D boundsMin() const;
+    QVector3D boundsMax() const;
+    bool bounds(QVector3D *min, QVector3D *max) const override;
+
+    void setAttenuation(float distance);    // size is nominal at this eye distance, 0 - size in pixels
+    float attenuation() const;
+    void setRoundPoints(bool round);        // false - square sprites, cheaper on llvmpipe
+    bool roundPoints() const;
+
+    void setDensityMode(bool enabled, int downsample = 2);
+    bool densityMode() const;
+    void setDensitySaturation(float count);     // count at the top of the colormap, 0 - 8 times the mean
+    void setDensityColormap(const QVector<QRgb> &colors);  // from 1 point to saturation, interpolated
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    QVector<SpriteVertex> fVertices;
+    QVector3D fOrigin;
+    QVector3D fExtent;
+    float fAttenuation;
+    bool fRound;
+    bool fDirty;            // vertices changed after the last upload
+    GLuint fVbo;
+    QOpenGLShaderProgram *fProgram;
+    bool fDensity;
+    int fDownsample;
+    float fSaturation;
+    QVector<QRgb> fColormap;
+    bool fColormapDirty;
+    QOpenGLFramebufferObject *fDensityFbo;
+    QOpenGLContext *fDensityContext;    // framebuffers are not shared between contexts
+    GLuint fColormapTexture;
+    QOpenGLShaderProgram *fDensityProgram;
+    QOpenGLShaderProgram *fToneProgram;
+
+    bool drawDensity(const QMatrix4x4 &pmvMatrix);  // false if no float framebuffer
+};
+
+// Long trajectory drawn as a line strip through a PolylineLod. Each frame the
+// coarsest level whose error projects below one pixel at the nearest visible
+// point of the bounds is drawn: the level from its own vertex buffer (only
+// appended points are uploaded), the short unreduced tails of finer levels from
+// client memory. append() and clear() may be called from any thread.
+class PolylineSeries : public DataSeries
+{
+public:
+    explicit PolylineSeries(const QString &name);
+    ~PolylineSeries();  // releaseGL() must be called before if the series was drawn
+
+    void append(const float *xyz, int n);
+    void append(const QVector<QVector3D> &points) { append(reinterpret_cast<const float*>(points.constData()), points.count()); }
+    void clear();
+
+    int count() const;
+    void setMaxError(float pixels);     // 1 by default
+    float maxError() const;
+    int drawnLevel() const;             // level of the last frame
+    int submittedVertices() const;      // vertices of the last frame
+    bool bounds(QVector3D *min, QVector3D *max) const override;
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    struct LevelBuffer {
+        GLuint vbo;
+        int capacity;       // points
+        int uploaded;
+        LevelBuffer() : vbo(0), capacity(0), uploaded(0) {}
+    };
+
+    PolylineLod fLod;
+    QVector<LevelBuffer> fBuffers;
+    float fMaxError;
+    int fDrawnLevel;
+    int fSubmitted;
+
+    float worldError(const QMatrix4x4 &pmvMatrix, const QSize &viewport) const;
+    void upload(int level);
+};
+
+// Scrolling heightfield (waterfall, spectrogram): rows of columns values, the
+// newest row at origin.y, older ones further along Y. The grid mesh is static
+// and built once; the values live in a float texture used as a ring of rows, so
+// appending a row uploads one texture row whatever the depth of the history. The
+// vertex shader reads the height from the texture shifted by the ring head, the
+// fragment shader colors it through a 1D colormap texture.
+// Needs float textures (GL 3.0 or ARB_texture_float) and vertex texture fetch.
+// append() and clear() may be called from any thread.
+class WaterfallSeries : public DataSeries
+{
+public:
+    WaterfallSeries(const QString &name, int columns, int rows);
+    ~WaterfallSeries(); // releaseGL() must be called before if the series was drawn
+
+    void append(const float *values, int rowCount = 1);    // rowCount * columns values
+    void clear();
+
+    int columns() const { return fColumns; }
+    int rows() const { return fRows; }
+    int count() const;                  // rows in the history
+    void setValueRange(float min, float max);               // mapped to the height and the colormap
+    void setGeometry(const QVector3D &origin, const QVector3D &size);  // x - columns, y - history, z - height
+    void setColormap(const QVector<QRgb> &colors);          // from min to max, interpolated
+    bool bounds(QVector3D *min, QVector3D *max) const override;
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    const int fColumns;
+    const int fRows;
+    float *fRing;           // rows * columns
+    quint64 fWritten;       // rows ever written
+    quint64 fUploaded;      // rows ever uploaded
+    float fMin;
+    float fMax;
+    QVector3D fOrigin;
+    QVector3D fSize;
+    QVector<QRgb> fColormap;
+    bool fColormapDirty;
+    GLuint fVbo;
+    GLuint fIbo;
+    GLuint fHeights;
+    GLuint fColormapTexture;
+    QOpenGLShaderProgram *fProgram;
+
+    void createMesh();
+    void uploadRows(int from, int count);
+};
+
+#endif // DATASERIES_H
@@ -0,0 +1,7 @@
+#version 120
+
+void main(void)
+{
+	// одна точка - единица в красном канале float-буфера
+	gl_FragColor = vec4(1.0, 0.0, 0.0, 0.0);
+}
@@ -0,0 +1,10 @@
+#version 120
+attribute vec3 qt_Vertex;   // position in the cloud bounds 0..1
+uniform mat4 Matrix;
+uniform vec3 origin;
+uniform vec3 extent;
+
+void main(void)
+{
+	gl_Position = Matrix * vec4( origin + qt_Vertex * extent, 1.0 );
+}
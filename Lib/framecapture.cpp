@@ -0,0 +1,259 @@
+#include "framecapture.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QRunnable>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+#define FENCE_TIMEOUT 1000000000 // ns
+
+QImage CapturedFrame::toImage() const
+{
+    if (pixels.isEmpty())
+        return QImage();
+
+    QImage image(reinterpret_cast<const uchar*>(pixels.constData()), size.width(), size.height(), QImage::Format_RGBA8888);
+    return image.mirrored();
+}
+
+FrameCapture::FrameCapture(int ringSize, quint32 queueCapacity) : fQueue(queueCapacity), fResolveFbo(nullptr), fInitialized(false), fAsync(false),
+    fFrameNumber(0), fCapturedFrames(0), fDroppedFrames(0), fStalls(0)
+{
+    fSlots.resize(qMax(2, ringSize));
+}
+
+FrameCapture::~FrameCapture()
+{
+    if (fInitialized && QOpenGLContext::currentContext())
+        release();
+}
+
+bool FrameCapture::initialize()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return false;
+
+    initializeOpenGLFunctions();
+
+    QSurfaceFormat f = ctx->format();
+    bool sync = ctx->isOpenGLES() ? f.version() >= qMakePair(3, 0)
+                                  : (f.version() >= qMakePair(3, 2) || ctx->hasExtension("GL_ARB_sync"));
+    bool pbo = ctx->isOpenGLES() ? f.version() >= qMakePair(3, 0)
+                                 : (f.version() >= qMakePair(2, 1) || ctx->hasExtension("GL_ARB_pixel_buffer_object"));
+    // кадры забираются через glMapBufferRange
+    bool mapRange = ctx->isOpenGLES() ? f.version() >= qMakePair(3, 0)
+                                      : (f.version() >= qMakePair(3, 0) || ctx->hasExtension("GL_ARB_map_buffer_range"));
+    fAsync = sync && pbo && mapRange;
+
+    if (fAsync) {
+        for (int i = 0; i < fSlots.count(); i++)
+            glGenBuffers(1, &fSlots[i].pbo);
+    }
+    else
+        qDebug() << "FrameCapture: PBO, fences or buffer mapping are not available, frames are read synchronously";
+
+    fFrameNumber = 0;
+    fClock.start();
+    fInitialized = true;
+    return true;
+}
+
+void FrameCapture::release()
+{
+    if (!fInitialized)
+        return;
+
+    flush();
+
+    for (int i = 0; i < fSlots.count(); i++) {
+        if (fSlots[i].pbo)
+            glDeleteBuffers(1, &fSlots[i].pbo);
+        fSlots[i] = Slot();
+    }
+
+    delete fResolveFbo;
+    fResolveFbo = nullptr;
+    fInitialized = false;
+}
+
+void FrameCapture::capture(GLuint fbo, const QSize &size, int samples)
+{
+    if (!fInitialized || size.isEmpty())
+        return;
+
+    GLuint readFbo = samples > 0 ? resolve(fbo, size) : fbo;
+    const int bytes = size.width() * size.height() * 4;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    if (!fAsync) {
+        CapturedFrame frame;
+        frame.number = fFrameNumber++;
+        frame.timestamp = fClock.elapsed();
+        frame.size = size;
+        frame.pixels.resize(bytes);
+        glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, frame.pixels.data());
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        deliver(frame);
+        return;
+    }
+
+    const int ring = fSlots.count();
+    Slot &slot = fSlots[int(fFrameNumber % ring)];
+
+    // слот ещё хранит кадр N - ring, его нужно забрать перед повторным использованием
+    collect(slot, true);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (slot.bytes != bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        slot.bytes = bytes;
+    }
+    glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.size = size;
+    slot.number = fFrameNumber;
+    slot.timestamp = fClock.elapsed();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    // кадр N - 2 забираем, только если GPU его уже записал
+    if (fFrameNumber >= 2)
+        collect(fSlots[int((fFrameNumber - 2) % ring)], false);
+
+    fFrameNumber++;
+}
+
+void FrameCapture::flush()
+{
+    if (!fAsync)
+        return;
+
+    // collect in frame order
+    const int ring = fSlots.count();
+    for (int i = 0; i < ring; i++)
+        collect(fSlots[int((fFrameNumber + i) % ring)], true);
+}
+
+GLuint FrameCapture::resolve(GLuint fbo, const QSize &size)
+{
+    if (!fResolveFbo || fResolveFbo->size() != size) {
+        delete fResolveFbo;
+        fResolveFbo = new QOpenGLFramebufferObject(size);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fResolveFbo->handle());
+    glBlitFramebuffer(0, 0, size.width(), size.height(), 0, 0, size.width(), size.height(), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    return fResolveFbo->handle();
+}
+
+void FrameCapture::collect(Slot &slot, bool wait)
+{
+    if (!slot.fence)
+        return;
+
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        if (!wait)
+            return;
+        fStalls++;
+        status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED) {
+        fDroppedFrames++;
+        return;
+    }
+
+    CapturedFrame frame;
+    frame.number = slot.number;
+    frame.timestamp = slot.timestamp;
+    frame.size = slot.size;
+
+    const int bytes = slot.size.width() * slot.size.height() * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (data) {
+        frame.pixels = QByteArray(reinterpret_cast<const char*>(data), bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (frame.pixels.isEmpty()) {
+        fDroppedFrames++;
+        return;
+    }
+    deliver(frame);
+}
+
+void FrameCapture::deliver(CapturedFrame &frame)
+{
+    fCapturedFrames++;
+    if (fCallback)
+        fCallback(frame);
+    else if (!fQueue.push(std::move(frame)))
+        fDroppedFrames++;
+}
+
+class FrameEncodeTask : public QRunnable
+{
+public:
+    FrameEncodeTask(FrameEncoder *encoder, const CapturedFrame &frame) : fEncoder(encoder), fFrame(frame) {}
+
+    void run() override
+    {
+        QString name = QString("frame_%1").arg(fFrame.number, 8, 10, QChar('0'));
+        QDir dir(fEncoder->fDirectory);
+        bool ok = false;
+
+        if (fEncoder->fFormat == FrameEncoder::efPng)
+            ok = fFrame.toImage().save(dir.filePath(name + ".png"), "PNG");
+        else {
+            QFile file(dir.filePath(name + ".rgba"));
+            if (file.open(QIODevice::WriteOnly))
+                ok = file.write(fFrame.pixels) == fFrame.pixels.size();
+        }
+
+        if (ok)
+            fEncoder->fEncoded.fetchAndAddRelaxed(1);
+        else
+            fEncoder->fDropped.fetchAndAddRelaxed(1);
+        fEncoder->fPending.fetchAndAddRelease(-1);
+    }
+
+private:
+    FrameEncoder *fEncoder;
+    CapturedFrame fFrame;
+};
+
+FrameEncoder::FrameEncoder(const QString &directory, Format format, int threads, int maxPending) : fDirectory(directory), fFormat(format),
+    fMaxPending(maxPending), fPending(0), fEncoded(0), fDropped(0)
+{
+    fPool.setMaxThreadCount(qMax(1, threads));
+    QDir().mkpath(fDirectory);
+}
+
+FrameEncoder::~FrameEncoder()
+{
+    fPool.waitForDone();
+}
+
+void FrameEncoder::encode(const CapturedFrame &frame)
+{
+    if (fPending.fetchAndAddAcquire(1) >= fMaxPending) {
+        fPending.fetchAndAddRelease(-1);
+        fDropped.fetchAndAddRelaxed(1);
+        return;
+    }
+    fPool.start(new FrameEncodeTask(this, frame));
+}
@@ -0,0 +1,108 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QOpenGLExtraFunctions>
+#include <QByteArray>
+#include <QImage>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <functional>
+
+#include "spscqueue.h"
+
+class QOpenGLFramebufferObject;
+
+struct CapturedFrame {
+    quint64 number;
+    qint64 timestamp;   // ms from the capture start
+    QSize size;
+    QByteArray pixels;  // RGBA8888, rows from bottom to top as returned by glReadPixels
+    CapturedFrame() : number(0), timestamp(0) {}
+    QImage toImage() const;
+};
+
+// Reads rendered frames back through a ring of pixel buffer objects.
+// The read of frame N is only issued; its pixels are collected two frames later
+// when the fence has signalled, so the render thread does not wait for the GPU.
+// All methods except frames() must be called with the rendering context current.
+class FrameCapture : protected QOpenGLExtraFunctions
+{
+public:
+    typedef std::function<void(const CapturedFrame &)> FrameCallback;
+
+    FrameCapture(int ringSize = 3, quint32 queueCapacity = 16);
+    ~FrameCapture();
+
+    // frames go to the callback if it is set, otherwise to the frames() queue
+    void setFrameCallback(FrameCallback callback) { fCallback = callback; }
+    SpscQueue<CapturedFrame> &frames() { return fQueue; }
+
+    bool initialize();
+    void release();
+    void capture(GLuint fbo, const QSize &size, int samples = 0);
+    void flush();
+
+    bool isAsync() const { return fAsync; }
+    quint64 capturedFrames() const { return fCapturedFrames; }
+    quint64 droppedFrames() const { return fDroppedFrames; }
+    quint64 stalls() const { return fStalls; }
+
+private:
+    struct Slot {
+        GLuint pbo;
+        GLsync fence;
+        QSize size;
+        int bytes;
+        quint64 number;
+        qint64 timestamp;
+        Slot() : pbo(0), fence(nullptr), bytes(0), number(0), timestamp(0) {}
+    };
+
+    QVector<Slot> fSlots;
+    SpscQueue<CapturedFrame> fQueue;
+    FrameCallback fCallback;
+    QOpenGLFramebufferObject *fResolveFbo;
+    QElapsedTimer fClock;
+    bool fInitialized;
+    bool fAsync;    // PBO and fences are available
+    quint64 fFrameNumber;
+    quint64 fCapturedFrames;
+    quint64 fDroppedFrames;
+    quint64 fStalls;
+
+    GLuint resolve(GLuint fbo, const QSize &size);
+    void collect(Slot &slot, bool wait);
+    void deliver(CapturedFrame &frame);
+};
+
+// Encodes captured frames on worker threads: PNG images or raw RGBA dumps.
+// encode() may be called from any thread; frames beyond maxPending are dropped.
+class FrameEncoder
+{
+public:
+    enum Format {
+        efPng,
+        efRaw
+    };
+
+    FrameEncoder(const QString &directory, Format format = efPng, int threads = 2, int maxPending = 8);
+    ~FrameEncoder();
+
+    void encode(const CapturedFrame &frame);
+    void waitForDone() { fPool.waitForDone(); }
+    quint64 encodedFrames() const { return quint64(fEncoded.loadAcquire()); }
+    quint64 droppedFrames() const { return quint64(fDropped.loadAcquire()); }
+
+private:
+    QString fDirectory;
+    Format fFormat;
+    int fMaxPending;
+    QThreadPool fPool;
+    QAtomicInt fPending;
+    QAtomicInteger<quint32> fEncoded;
+    QAtomicInteger<quint32> fDropped;
+
+    friend class FrameEncodeTask;
+};
+
+#endif // FRAMECAPTURE_H
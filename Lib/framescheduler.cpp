@@ -0,0 +1,65 @@
+#include "framescheduler.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+
+#define DEFAULT_REFRESH_RATE 60
+
+FrameScheduler::FrameScheduler(QObject *parent) : QObject(parent), fRenderMode(rmOnDemand), fMaxFps(0), fFrameInterval(0), fPending(urNone),
+    fRenderedFrames(0), fCoalescedRequests(0)
+{
+    fTimer.setSingleShot(true);
+    fTimer.setTimerType(Qt::PreciseTimer);
+    connect(&fTimer, SIGNAL(timeout()), this, SLOT(timeout()));
+
+    setMaxFps(0);
+}
+
+void FrameScheduler::setMaxFps(int fps)
+{
+    fMaxFps = qMax(0, fps);
+
+    int rate = fMaxFps;
+    if (!rate) {
+        QScreen *screen = QGuiApplication::primaryScreen();
+        rate = screen ? qRound(screen->refreshRate()) : DEFAULT_REFRESH_RATE;
+        if (rate <= 0)
+            rate = DEFAULT_REFRESH_RATE;
+    }
+    fFrameInterval = 1000 / rate;
+}
+
+void FrameScheduler::requestFrame(FrameScheduler::UpdateReason reason)
+{
+    fPending |= reason;
+
+    // in data only mode input is accumulated until data arrives
+    if (fRenderMode == rmDataOnly && !(fPending & (urData | urView)))
+        return;
+
+    if (fTimer.isActive()) {
+        fCoalescedRequests++;
+        return;
+    }
+
+    int wait = 0;
+    if (fLastFrame.isValid())
+        wait = qMax(0, fFrameInterval - int(fLastFrame.elapsed()));
+    fTimer.start(wait);
+}
+
+void FrameScheduler::frameRendered()
+{
+    fRenderedFrames++;
+    fLastFrame.restart();
+}
+
+void FrameScheduler::timeout()
+{
+    UpdateReasons reasons = fPending;
+    if (reasons == urNone)
+        return;
+
+    fPending = urNone;
+    emit frameDue(reasons);
+}
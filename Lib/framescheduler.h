@@ -0,0 +1,61 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// Collects frame requests and emits frameDue() at most once per frame interval.
+// Requests arriving while a frame is pending are merged into it.
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    enum UpdateReason {
+        urNone = 0x0,
+        urInput = 0x1,  // camera was moved by mouse or keyboard
+        urData = 0x2,   // scene data was changed
+        urView = 0x4    // view settings (scales, space box, colors) were changed
+    };
+    Q_DECLARE_FLAGS(UpdateReasons, UpdateReason)
+
+    enum RenderMode {
+        rmOnDemand,     // any request produces a frame
+        rmDataOnly      // input alone does not produce a frame, it is shown with the next data frame
+    };
+
+    explicit FrameScheduler(QObject *parent = nullptr);
+
+    void setMaxFps(int fps);    // 0 - use the screen refresh rate
+    int maxFps() const { return fMaxFps; }
+    int frameInterval() const { return fFrameInterval; }
+    void setRenderMode(RenderMode mode) { fRenderMode = mode; }
+    RenderMode renderMode() const { return fRenderMode; }
+    UpdateReasons pendingReasons() const { return fPending; }
+    quint64 renderedFrames() const { return fRenderedFrames; }
+    quint64 coalescedRequests() const { return fCoalescedRequests; }
+
+public slots:
+    void requestFrame(FrameScheduler::UpdateReason reason);
+    void frameRendered();
+
+signals:
+    void frameDue(FrameScheduler::UpdateReasons reasons);
+
+private slots:
+    void timeout();
+
+private:
+    QTimer fTimer;
+    QElapsedTimer fLastFrame;
+    RenderMode fRenderMode;
+    int fMaxFps;
+    int fFrameInterval;  // ms
+    UpdateReasons fPending;
+    quint64 fRenderedFrames;
+    quint64 fCoalescedRequests;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(FrameScheduler::UpdateReasons)
+
+#endif // FRAMESCHEDULER_H
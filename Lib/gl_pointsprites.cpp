@@ -0,0 +1,69 @@
+#include "gl_pointsprites.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QDebug>
+
+#include "sceneresources.h"
+
+#ifndef GL_VERTEX_PROGRAM_POINT_SIZE
+#define GL_VERTEX_PROGRAM_POINT_SIZE 0x8642
+#endif
+#ifndef GL_POINT_SPRITE
+#define GL_POINT_SPRITE 0x8861
+#endif
+
+#define SPRITE_VERTEX_SHADER ":/BaseShaders/Lib/sprite_vsh.vert"
+#define SPRITE_FRAGMENT_SHADER ":/BaseShaders/Lib/sprite_fsh.frag"
+#define SPRITE_PROGRAM_KEY "program:" SPRITE_VERTEX_SHADER ":" SPRITE_FRAGMENT_SHADER
+
+static QOpenGLShaderProgram *createSpriteProgram()
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, SPRITE_VERTEX_SHADER))
+        qDebug() << "VertexShader:" << program->log();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, SPRITE_FRAGMENT_SHADER))
+        qDebug() << "FragmentShader:" << program->log();
+    // нулевой атрибут совпадает с glVertexPointer в профиле совместимости
+    program->bindAttributeLocation("qt_Vertex", 0);
+    program->link();
+    return program;
+}
+
+QOpenGLShaderProgram *PointSprites::acquireProgram()
+{
+    SceneResources *resources = SceneResources::current();
+    if (!resources)
+        return nullptr;
+    return resources->acquire<QOpenGLShaderProgram>(SPRITE_PROGRAM_KEY, createSpriteProgram);
+}
+
+void PointSprites::releaseProgram()
+{
+    SceneResources *resources = SceneResources::current();
+    if (resources)
+        resources->release(SPRITE_PROGRAM_KEY);
+}
+
+void PointSprites::begin()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx || ctx->isOpenGLES())
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    f->glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    f->glEnable(GL_POINT_SPRITE);
+}
+
+void PointSprites::end()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx || ctx->isOpenGLES())
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    f->glDisable(GL_POINT_SPRITE);
+    f->glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+}
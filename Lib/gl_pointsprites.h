@@ -0,0 +1,43 @@
+#ifndef GL_POINTSPRITES_H
+#define GL_POINTSPRITES_H
+
+#include <QVector3D>
+#include <QRgb>
+#include <qopengl.h>
+
+class QOpenGLShaderProgram;
+
+// Vertex of a sprite cloud, 12 bytes: position quantized to 16 bits inside the
+// cloud bounds, size in 1/65535 of PointSprites::MaxSize and RGBA8 color.
+struct SpriteVertex {
+    quint16 x, y, z;
+    quint16 size;
+    quint8 r, g, b, a;
+};
+
+// Points drawn as shader sprites: the vertex shader sets gl_PointSize from the
+// per-vertex size (optionally attenuated by the eye distance), the fragment
+// shader cuts the square to a circle. Replaces glPointSize + GL_POINT_SMOOTH,
+// which is slow on software rasterizers. The program binds qt_Vertex to
+// location 0, so client arrays set by glVertexPointer are read as well.
+class PointSprites
+{
+public:
+    enum {
+        MaxSize = 64    // px
+    };
+
+    // shared program of the current share group, context must be current
+    static QOpenGLShaderProgram *acquireProgram();
+    static void releaseProgram();
+
+    static void begin();    // enables program point size and sprite coordinates
+    static void end();
+
+    // colors and sizes may be null, then color and size are used for all points;
+    // no GL calls, defined in spritepack.cpp for the offline tools
+    static void pack(const float *xyz, const QRgb *colors, const float *sizes, int count,
+                     QRgb color, float size, const QVector3D &origin, const QVector3D &extent, SpriteVertex *out);
+};
+
+#endif // GL_POINTSPRITES_H
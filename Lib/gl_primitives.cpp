@@ -3,6 +3,10 @@
 #include <QOpenGLContext>
 #include <QOpenGLExtraFunctions>
 
+#include "gl_pointsprites.h"
+
+#define PRIMITIVE_POINT_SIZE 3.0f
+
 Primitive::~Primitive()
 {
     if (points)
@@ -40,10 +44,9 @@ void Primitive::draw()
     }
         break;
     default: {
+        // размер и круглая форма задаются программой спрайтов в PrimitiveManager
         glPointSize(3);
-        glEnable(GL_POINT_SMOOTH);
         glDrawArrays(GL_POINTS, 0, pointCount);
-        glDisable(GL_POINT_SMOOTH);
     }
         break;
     }
@@ -388,15 +391,26 @@ void PrimitiveSimpleArrow::setLength(float length)
     buf->z = 0;
 }
 
-PrimitiveManager::PrimitiveManager()
+PrimitiveManager::PrimitiveManager() : fOwnProgram(true), fPointProgram(nullptr)
 {
     vertexShader = new QOpenGLShader(QOpenGLShader::Vertex);
     fragmentShader = new QOpenGLShader(QOpenGLShader::Fragment);
     program = new QOpenGLShaderProgram(nullptr);
 }
 
-PrimitiveManager::PrimitiveManager(const PrimitiveManager &pm)
+PrimitiveManager::PrimitiveManager(QOpenGLShaderProgram *sharedProgram) : vertexShader(nullptr), fragmentShader(nullptr), program(sharedProgram), fOwnProgram(false), fPointProgram(nullptr)
 {
+}
+
+PrimitiveManager::PrimitiveManager(const PrimitiveManager &pm) : fOwnProgram(pm.fOwnProgram), fPointProgram(nullptr)
+{
+    if (!fOwnProgram) {
+        vertexShader = nullptr;
+        fragmentShader = nullptr;
+        program = pm.program;
+        return;
+    }
+
     vertexShader = new QOpenGLShader(QOpenGLShader::Vertex);
     fragmentShader = new QOpenGLShader(QOpenGLShader::Fragment);
     program = new QOpenGLShaderProgram(nullptr);
@@ -407,12 +421,16 @@ PrimitiveManager::PrimitiveManager(const PrimitiveManager &pm)
 
 PrimitiveManager::~PrimitiveManager()
 {
-    for (int i = 0; i < primitives.count(); i++)
-        delete primitives[i];
+    clear();
 
-    delete vertexShader;
-    delete fragmentShader;
-    delete program;
+    if (fPointProgram && QOpenGLContext::currentContext())
+        PointSprites::releaseProgram();
+
+    if (fOwnProgram) {
+        delete vertexShader;
+        delete fragmentShader;
+        delete program;
+    }
 }
 
 void PrimitiveManager::compileShaders(QString vertexShaderPath, QString fragmentShaderPath)
@@ -434,6 +452,12 @@ void PrimitiveManager::drawPrimitives(const QMatrix4x4 &pmvMatrix)
     program->bind();
 
     for (int i = 0; i < primitives.count(); i++) {
+        if (primitives[i]->drawType() == dtPoints) {
+            drawPoints(primitives[i], pmvMatrix);
+            program->bind();
+            continue;
+        }
+
         QColor c = primitives[i]->color();
         QVector3D vColor(c.redF(), c.greenF(), c.blueF());
         program->setUniformValue("color", vColor);
@@ -444,6 +468,39 @@ void PrimitiveManager::drawPrimitives(const QMatrix4x4 &pmvMatrix)
     program->release();
 }
 
+void PrimitiveManager::drawPoints(Primitive *primitive, const QMatrix4x4 &pmvMatrix)
+{
+    if (!fPointProgram)
+        fPointProgram = PointSprites::acquireProgram();
+    if (!fPointProgram) {
+        primitive->draw();
+        return;
+    }
+
+    // вершины примитива - float без размера, w = 1 из glVertexPointer
+    QColor c = primitive->color();
+    fPointProgram->bind();
+    fPointProgram->setUniformValue("Matrix", pmvMatrix * primitive->matrix());
+    fPointProgram->setUniformValue("origin", QVector3D(0.0f, 0.0f, 0.0f));
+    fPointProgram->setUniformValue("extent", QVector3D(1.0f, 1.0f, 1.0f));
+    fPointProgram->setUniformValue("sizeScale", PRIMITIVE_POINT_SIZE);
+    fPointProgram->setUniformValue("attenuation", 0.0f);
+    fPointProgram->setUniformValue("roundPoints", true);
+    fPointProgram->setAttributeValue("qt_Color", c.redF(), c.greenF(), c.blueF(), c.alphaF());
+
+    PointSprites::begin();
+    primitive->draw();
+    PointSprites::end();
+    fPointProgram->release();
+}
+
+void PrimitiveManager::clear()
+{
+    for (int i = 0; i < primitives.count(); i++)
+        delete primitives[i];
+    primitives.clear();
+}
+
 Primitive *PrimitiveManager::addSphere(const int segments, const float radiusX, const float radiusY, const float radiusZ, QVector3D direction)
 {
     Primitive *newSphere = new PrimitiveSphere(segments, radiusX, radiusY, radiusZ, direction);
@@ -93,11 +93,14 @@ class PrimitiveManager
 {
 public:
     PrimitiveManager();
+    PrimitiveManager(QOpenGLShaderProgram *sharedProgram); // linked program owned by the caller
     PrimitiveManager( const PrimitiveManager& pm);
     ~PrimitiveManager();
     void compileShaders(QString vertexShaderPath, QString fragmentShaderPath);
     void compileShaders(QByteArray &vertexShaderCode, QByteArray &fragmentShaderCode);
     void drawPrimitives(const QMatrix4x4 &pmvMatrix);
+    void clear();
+    int count() const { return primitives.count(); }
 
     Primitive * addSphere(const int segments, const float radiusX, const float radiusY, const float radiusZ, QVector3D direction = QVector3D(0.0f, 0.0f, 1.0f));
     Primitive * addCone(const int segments, const float height, const float radius, QVector3D direction = QVector3D(0.0f, 0.0f, 1.0f));
@@ -106,9 +109,12 @@ public:
 
 private:
     void linkShaders();
+    void drawPoints(Primitive *primitive, const QMatrix4x4 &pmvMatrix);   // dtPoints as shader sprites
     QOpenGLShader *vertexShader;
     QOpenGLShader *fragmentShader;
     QOpenGLShaderProgram *program;
+    bool fOwnProgram;
+    QOpenGLShaderProgram *fPointProgram;    // shared sprite program, acquired on the first dtPoints primitive
 
     QList<Primitive*> primitives;    
 };
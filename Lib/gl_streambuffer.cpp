@@ -0,0 +1,170 @@
+#include "gl_streambuffer.h"
+
+#include <QOpenGLContext>
+#include <QDebug>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#define FENCE_TIMEOUT 1000000000 // ns
+
+typedef void (QOPENGLF_APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+StreamBuffer::StreamBuffer(GLsizeiptr regionSize, GLenum target) : fRegionSize(regionSize), fTarget(target), fBuffer(0), fMapped(nullptr),
+    fRegion(0), fUsed(0), fInitialized(false), fFrames(0), fStalls(0), fOverflows(0), fAllocatedBytes(0)
+{
+    for (int i = 0; i < RegionCount; i++)
+        fFences[i] = nullptr;
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    if (fInitialized && QOpenGLContext::currentContext())
+        release();
+}
+
+bool StreamBuffer::initialize()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return false;
+
+    initializeOpenGLFunctions();
+    glGenBuffers(1, &fBuffer);
+    glBindBuffer(fTarget, fBuffer);
+
+    BufferStorageProc bufferStorage = nullptr;
+    if (!ctx->isOpenGLES() && (ctx->format().version() >= qMakePair(4, 4) || ctx->hasExtension("GL_ARB_buffer_storage")))
+        bufferStorage = reinterpret_cast<BufferStorageProc>(ctx->getProcAddress("glBufferStorage"));
+
+    if (bufferStorage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bufferStorage(fTarget, fRegionSize * RegionCount, nullptr, flags);
+        fMapped = static_cast<char*>(glMapBufferRange(fTarget, 0, fRegionSize * RegionCount, flags));
+        if (!fMapped)
+            qDebug() << "StreamBuffer: cannot map buffer persistently, falling back to orphaning";
+    }
+
+    if (!fMapped) {
+        // буфер с неизменяемым хранилищем нельзя переразместить - создаём новый
+        if (bufferStorage) {
+            glBindBuffer(fTarget, 0);
+            glDeleteBuffers(1, &fBuffer);
+            glGenBuffers(1, &fBuffer);
+            glBindBuffer(fTarget, fBuffer);
+        }
+        glBufferData(fTarget, fRegionSize, nullptr, GL_STREAM_DRAW);
+        fStaging.resize(int(fRegionSize));
+    }
+    glBindBuffer(fTarget, 0);
+
+    fRegion = 0;
+    fUsed = 0;
+    fInitialized = true;
+    return true;
+}
+
+void StreamBuffer::release()
+{
+    if (!fInitialized)
+        return;
+
+    for (int i = 0; i < RegionCount; i++) {
+        if (fFences[i])
+            glDeleteSync(fFences[i]);
+        fFences[i] = nullptr;
+    }
+
+    if (fMapped) {
+        glBindBuffer(fTarget, fBuffer);
+        glUnmapBuffer(fTarget);
+        glBindBuffer(fTarget, 0);
+        fMapped = nullptr;
+    }
+    glDeleteBuffers(1, &fBuffer);
+    fBuffer = 0;
+    fStaging.clear();
+    fInitialized = false;
+}
+
+void StreamBuffer::beginFrame()
+{
+    if (!fInitialized)
+        return;
+
+    fUsed = 0;
+    if (!fMapped) {
+        // отдаём драйверу старое хранилище, он не будет ждать GPU
+        glBindBuffer(fTarget, fBuffer);
+        glBufferData(fTarget, fRegionSize, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(fTarget, 0);
+        return;
+    }
+
+    GLsync &fence = fFences[fRegion];
+    if (!fence)
+        return;
+
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        fStalls++;
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    }
+    if (result == GL_WAIT_FAILED)
+        qDebug() << "StreamBuffer: glClientWaitSync failed";
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    Allocation a;
+    if (!fInitialized || size <= 0)
+        return a;
+
+    const GLsizeiptr start = alignment > 1 ? (fUsed + alignment - 1) / alignment * alignment : fUsed;
+    if (start + size > fRegionSize) {
+        fOverflows++;
+        return a;
+    }
+
+    if (fMapped) {
+        a.offset = fRegion * fRegionSize + start;
+        a.data = fMapped + a.offset;
+    }
+    else {
+        a.offset = start;
+        a.data = fStaging.data() + start;
+    }
+    a.size = size;
+    fUsed = start + size;
+    fAllocatedBytes += quint64(size);
+    return a;
+}
+
+void StreamBuffer::commit(const Allocation &allocation)
+{
+    // отображение когерентное, запись уже видна GPU
+    if (!allocation.isValid() || fMapped)
+        return;
+
+    glBindBuffer(fTarget, fBuffer);
+    glBufferSubData(fTarget, allocation.offset, allocation.size, allocation.data);
+    glBindBuffer(fTarget, 0);
+}
+
+void StreamBuffer::endFrame()
+{
+    if (!fInitialized)
+        return;
+
+    if (fMapped) {
+        fFences[fRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        fRegion = (fRegion + 1) % RegionCount;
+    }
+    fFrames++;
+}
@@ -0,0 +1,62 @@
+#ifndef GL_STREAMBUFFER_H
+#define GL_STREAMBUFFER_H
+
+#include <QOpenGLExtraFunctions>
+
+// Per-frame allocator for streamed geometry. With ARB_buffer_storage one buffer
+// is mapped persistently and split into three regions, each frame writes its own
+// region and a fence keeps the CPU from overwriting a region the GPU still reads.
+// Without it the buffer is orphaned every frame and allocations are uploaded by
+// commit(). Usage per frame: beginFrame(), allocate() + write + commit() + draw
+// from buffer() at offset, endFrame(). Context must be current.
+class StreamBuffer : protected QOpenGLExtraFunctions
+{
+public:
+    struct Allocation {
+        void *data;         // write pointer, valid until commit()
+        GLintptr offset;    // offset in buffer()
+        GLsizeiptr size;
+        Allocation() : data(nullptr), offset(0), size(0) {}
+        bool isValid() const { return data != nullptr; }
+    };
+
+    explicit StreamBuffer(GLsizeiptr regionSize = 1024 * 1024, GLenum target = GL_ARRAY_BUFFER);
+    ~StreamBuffer();
+
+    bool initialize();
+    void release();
+
+    void beginFrame();
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);    // invalid when the region is full
+    void commit(const Allocation &allocation);
+    void endFrame();
+
+    GLuint buffer() const { return fBuffer; }
+    GLenum target() const { return fTarget; }
+    bool isPersistent() const { return fMapped != nullptr; }
+    quint64 frames() const { return fFrames; }
+    quint64 stalls() const { return fStalls; }          // frames that waited for the GPU
+    quint64 overflows() const { return fOverflows; }    // allocations that did not fit
+    quint64 allocatedBytes() const { return fAllocatedBytes; }
+
+private:
+    enum {
+        RegionCount = 3
+    };
+
+    GLsizeiptr fRegionSize;
+    GLenum fTarget;
+    GLuint fBuffer;
+    char *fMapped;          // persistent mapping of all regions
+    QByteArray fStaging;    // запасной путь: данные кадра до commit()
+    GLsync fFences[RegionCount];
+    int fRegion;
+    GLsizeiptr fUsed;
+    bool fInitialized;
+    quint64 fFrames;
+    quint64 fStalls;
+    quint64 fOverflows;
+    quint64 fAllocatedBytes;
+};
+
+#endif // GL_STREAMBUFFER_H
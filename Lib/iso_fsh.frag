@@ -0,0 +1,11 @@
+#version 120
+uniform vec3 color;
+varying vec3 normal;
+
+void main(void)
+{
+	// свет сверху-сбоку, обе стороны поверхности освещены одинаково
+	vec3 light = normalize(vec3(0.3, 0.5, 1.0));
+	float diffuse = abs(dot(normalize(normal), light));
+	gl_FragColor = vec4(color * (0.3 + 0.7 * diffuse), 1.0);
+}
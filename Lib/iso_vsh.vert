@@ -0,0 +1,12 @@
+#version 120
+attribute vec3 qt_Vertex;   // grid coordinates
+attribute vec3 qt_Normal;
+uniform mat4 Matrix;        // with the grid box
+uniform vec3 normalScale;   // cells / box size
+varying vec3 normal;
+
+void main(void)
+{
+	normal = qt_Normal * normalScale;
+	gl_Position = Matrix * vec4( qt_Vertex, 1.0 );
+}
@@ -0,0 +1,581 @@
+#include "isosurface.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QtConcurrent>
+#include <QDebug>
+#include <cstring>
+#include <cstddef>
+
+#include "sceneresources.h"
+
+#define ISO_VERTEX_SHADER ":/BaseShaders/Lib/iso_vsh.vert"
+#define ISO_FRAGMENT_SHADER ":/BaseShaders/Lib/iso_fsh.frag"
+
+// Угол куба i: x = бит 0, y = бит 1, z = бит 2. Ребро оси a с нижним углом c
+// имеет номер a * 4 + бит u + 2 * бит v угла c, где u = (a + 1) % 3, v = (a + 2) % 3.
+static int edgeIndex(int a, int b)
+{
+    const int lower = a & b;
+    const int axis = (a ^ b) == 1 ? 0 : (a ^ b) == 2 ? 1 : 2;
+    const int u = (axis + 1) % 3;
+    const int v = (axis + 2) % 3;
+    return axis * 4 + ((lower >> u) & 1) + 2 * ((lower >> v) & 1);
+}
+
+struct CubeTable {
+    signed char triangles[256][MarchingCubes::MaxTriangles * 3 + 1];
+
+    CubeTable()
+    {
+        // грани: углы по кругу против часовой стрелки, если смотреть снаружи
+        int faces[6][4];
+        for (int axis = 0; axis < 3; axis++) {
+            const int u = 1 << ((axis + 1) % 3);
+            const int v = 1 << ((axis + 2) % 3);
+            for (int side = 0; side < 2; side++) {
+                const int base = side << axis;
+                int *face = faces[axis * 2 + side];
+                face[0] = base;
+                face[1] = base | u;
+                face[2] = base | u | v;
+                face[3] = base | v;
+                if (!side)
+                    std::swap(face[1], face[3]);
+            }
+        }
+
+        for (int cube = 0; cube < 256; cube++) {
+            // отрезок на грани идёт от входа обхода внутрь к следующему выходу наружу;
+            // на неоднозначной грани внутренние углы оказываются отделены друг от друга
+            int next[12];
+            for (int e = 0; e < 12; e++)
+                next[e] = -1;
+            for (int f = 0; f < 6; f++) {
+                const int *face = faces[f];
+                for (int j = 0; j < 4; j++) {
+                    const bool from = (cube >> face[j]) & 1;
+                    const bool to = (cube >> face[(j + 1) % 4]) & 1;
+                    if (from || !to)
+                        continue;
+                    for (int k = 1; k < 4; k++) {
+                        const int a = face[(j + k) % 4];
+                        const int b = face[(j + k + 1) % 4];
+                        if (((cube >> a) & 1) && !((cube >> b) & 1)) {
+                            next[edgeIndex(face[j], face[(j + 1) % 4])] = edgeIndex(a, b);
+                            break;
+                        }
+                    }
+                }
+            }
+
+            // петли отрезков режутся веером на треугольники
+            signed char *out = triangles[cube];
+            int count = 0;
+            bool used[12] = {};
+            for (int e = 0; e < 12; e++) {
+                if (next[e] < 0 || used[e])
+                    continue;
+                int loop[12];
+                int n = 0;
+                for (int k = e; !used[k]; k = next[k]) {
+                    used[k] = true;
+                    loop[n++] = k;
+                }
+                for (int k = 1; k + 1 < n && count < MarchingCubes::MaxTriangles; k++, count++) {
+                    *out++ = static_cast<signed char>(loop[0]);
+                    *out++ = static_cast<signed char>(loop[k]);
+                    *out++ = static_cast<signed char>(loop[k + 1]);
+                }
+            }
+            *out = -1;
+        }
+    }
+};
+
+const signed char *MarchingCubes::triangles(int cube)
+{
+    static const CubeTable table;
+    return table.triangles[cube & 0xFF];
+}
+
+static inline float sample(const float *values, int nx, int ny, int nz, int x, int y, int z)
+{
+    x = qBound(0, x, nx - 1);
+    y = qBound(0, y, ny - 1);
+    z = qBound(0, z, nz - 1);
+    return values[(size_t(z) * ny + y) * nx + x];
+}
+
+static void gradient(const float *values, int nx, int ny, int nz, int x, int y, int z, float *g)
+{
+    g[0] = (sample(values, nx, ny, nz, x + 1, y, z) - sample(values, nx, ny, nz, x - 1, y, z)) * 0.5f;
+    g[1] = (sample(values, nx, ny, nz, x, y + 1, z) - sample(values, nx, ny, nz, x, y - 1, z)) * 0.5f;
+    g[2] = (sample(values, nx, ny, nz, x, y, z + 1) - sample(values, nx, ny, nz, x, y, z - 1)) * 0.5f;
+}
+
+void MarchingCubes::extract(const float *values, int nx, int ny, int nz, const int *cellMin, const int *cellMax, float iso,
+                            QVector<IsoVertex> &vertices, QVector<quint32> &indexes)
+{
+    const int bx = cellMax[0] - cellMin[0];
+    const int by = cellMax[1] - cellMin[1];
+    const int bz = cellMax[2] - cellMin[2];
+    if (bx <= 0 || by <= 0 || bz <= 0)
+        return;
+
+    // кэш вершин на рёбрах: x и y рёбра нижнего и верхнего слоя, z рёбра между ними
+    const int layer = (bx + 1) * (by + 1);
+    QVector<qint32> cache(layer * 5, -1);
+    qint32 *xEdges[2] = { cache.data(), cache.data() + layer };
+    qint32 *yEdges[2] = { cache.data() + layer * 2, cache.data() + layer * 3 };
+    qint32 *zEdges = cache.data() + layer * 4;
+
+    const size_t sliceSize = size_t(nx) * size_t(ny);
+    for (int cz = 0; cz < bz; cz++) {
+        if (cz) {
+            std::swap(xEdges[0], xEdges[1]);
+            std::swap(yEdges[0], yEdges[1]);
+            std::fill(xEdges[1], xEdges[1] + layer, -1);
+            std::fill(yEdges[1], yEdges[1] + layer, -1);
+            std::fill(zEdges, zEdges + layer, -1);
+        }
+
+        const int z = cellMin[2] + cz;
+        for (int cy = 0; cy < by; cy++) {
+            const int y = cellMin[1] + cy;
+            for (int cx = 0; cx < bx; cx++) {
+                const int x = cellMin[0] + cx;
+                const float *base = values + size_t(z) * sliceSize + size_t(y) * nx + x;
+                float corner[8];
+                corner[0] = base[0];
+                corner[1] = base[1];
+                corner[2] = base[nx];
+                corner[3] = base[nx + 1];
+                corner[4] = base[sliceSize];
+                corner[5] = base[sliceSize + 1];
+                corner[6] = base[sliceSize + nx];
+                corner[7] = base[sliceSize + nx + 1];
+
+                int cube = 0;
+                for (int i = 0; i < 8; i++)
+                    cube |= (corner[i] >= iso) << i;
+                if (cube == 0 || cube == 0xFF)
+                    continue;
+
+                const signed char *tri = triangles(cube);
+                for (; *tri >= 0; tri++) {
+                    const int edge = *tri;
+                    const int axis = edge / 4;
+                    const int ub = edge & 1;
+                    const int vb = (edge >> 1) & 1;
+                    int dx = 0, dy = 0, dz = 0;
+                    qint32 *slot;
+                    if (axis == 0) {
+                        dy = ub;
+                        dz = vb;
+                        slot = &xEdges[dz][(cy + dy) * (bx + 1) + cx];
+                    }
+                    else if (axis == 1) {
+                        dz = ub;
+                        dx = vb;
+                        slot = &yEdges[dz][cy * (bx + 1) + cx + dx];
+                    }
+                    else {
+                        dx = ub;
+                        dy = vb;
+                        slot = &zEdges[(cy + dy) * (bx + 1) + cx + dx];
+                    }
+
+                    if (*slot < 0) {
+                        const int c0 = dx | (dy << 1) | (dz << 2);
+                        const int c1 = c0 | (1 << axis);
+                        const float t = (iso - corner[c0]) / (corner[c1] - corner[c0]);
+                        float g0[3], g1[3];
+                        gradient(values, nx, ny, nz, x + dx, y + dy, z + dz, g0);
+                        gradient(values, nx, ny, nz, x + dx + (axis == 0), y + dy + (axis == 1), z + dz + (axis == 2), g1);
+
+                        IsoVertex v;
+                        v.x = float(x + dx) + (axis == 0 ? t : 0.0f);
+                        v.y = float(y + dy) + (axis == 1 ? t : 0.0f);
+                        v.z = float(z + dz) + (axis == 2 ? t : 0.0f);
+                        v.nx = -(g0[0] + (g1[0] - g0[0]) * t);
+                        v.ny = -(g0[1] + (g1[1] - g0[1]) * t);
+                        v.nz = -(g0[2] + (g1[2] - g0[2]) * t);
+                        *slot = vertices.count();
+                        vertices.append(v);
+                    }
+                    indexes.append(quint32(*slot));
+                }
+            }
+        }
+    }
+}
+
+struct IsoJob {
+    int block;
+    int cellMin[3];
+    int cellMax[3];
+    QVector<IsoVertex> vertices;
+    QVector<quint32> indexes;
+};
+
+IsoSurfaceSeries::IsoSurfaceSeries(const QString &name) : DataSeries(name), fIsoLevel(0.0f), fOrigin(0.0f, 0.0f, 0.0f), fBoxSize(1.0f, 1.0f, 1.0f),
+    fExtracting(false), fLost(false), fGeneration(0), fProgram(nullptr)
+{
+    fSize[0] = fSize[1] = fSize[2] = 0;
+    fExtractor.setMaxThreadCount(1);
+}
+
+IsoSurfaceSeries::~IsoSurfaceSeries()
+{
+    fExtractor.waitForDone();
+}
+
+void IsoSurfaceSeries::setVolume(const float *values, int nx, int ny, int nz)
+{
+    if (nx < 2 || ny < 2 || nz < 2) {
+        qDebug() << "IsoSurfaceSeries: volume must have at least 2 samples on each axis";
+        return;
+    }
+
+    QWriteLocker valuesLocker(&fValuesLock);
+    fValues.resize(nx * ny * nz);
+    memcpy(fValues.data(), values, size_t(fValues.count()) * sizeof(float));
+
+    QMutexLocker locker(&fMutex);
+    fSize[0] = nx;
+    fSize[1] = ny;
+    fSize[2] = nz;
+    fGeneration++;      // результаты идущего извлечения относятся к старой сетке
+
+    for (int i = 0; i < fBlocks.count(); i++) {
+        if (fBlocks[i].vbo)
+            fGarbage << fBlocks[i].vbo << fBlocks[i].ibo;
+    }
+    fBlocks.clear();
+    for (int z = 0; z < nz - 1; z += BlockCells) {
+        for (int y = 0; y < ny - 1; y += BlockCells) {
+            for (int x = 0; x < nx - 1; x += BlockCells) {
+                Block block;
+                block.cellMin[0] = x;
+                block.cellMin[1] = y;
+                block.cellMin[2] = z;
+                block.cellMax[0] = qMin(x + BlockCells, nx - 1);
+                block.cellMax[1] = qMin(y + BlockCells, ny - 1);
+                block.cellMax[2] = qMin(z + BlockCells, nz - 1);
+                updateRange(block);
+                block.dirty = block.min < fIsoLevel && fIsoLevel <= block.max;
+                fBlocks.append(block);
+            }
+        }
+    }
+    schedule();
+}
+
+void IsoSurfaceSeries::updateValues(int x0, int y0, int z0, int sx, int sy, int sz, const float *values)
+{
+    QWriteLocker valuesLocker(&fValuesLock);
+    // часть коробки вне сетки отбрасывается
+    const int x1 = qMin(x0 + sx, fSize[0]);
+    const int y1 = qMin(y0 + sy, fSize[1]);
+    const int z1 = qMin(z0 + sz, fSize[2]);
+    const int from[3] = { qMax(x0, 0), qMax(y0, 0), qMax(z0, 0) };
+    if (from[0] >= x1 || from[1] >= y1 || from[2] >= z1)
+        return;
+
+    for (int z = from[2]; z < z1; z++) {
+        for (int y = from[1]; y < y1; y++) {
+            const float *in = values + (size_t(z - z0) * sy + (y - y0)) * sx + (from[0] - x0);
+            memcpy(fValues.data() + (size_t(z) * fSize[1] + y) * fSize[0] + from[0], in, size_t(x1 - from[0]) * sizeof(float));
+        }
+    }
+    x0 = from[0];
+    y0 = from[1];
+    z0 = from[2];
+
+    // блок зависит от образцов [cellMin, cellMax], соседи по границе тоже
+    QMutexLocker locker(&fMutex);
+    const float iso = fIsoLevel;
+    for (int i = 0; i < fBlocks.count(); i++) {
+        Block &block = fBlocks[i];
+        if (block.cellMax[0] < x0 || block.cellMin[0] >= x1 || block.cellMax[1] < y0 || block.cellMin[1] >= y1
+                || block.cellMax[2] < z0 || block.cellMin[2] >= z1)
+            continue;
+        const bool had = block.min < iso && iso <= block.max;
+        updateRange(block);
+        block.dirty = block.dirty || had || (block.min < iso && iso <= block.max);
+    }
+    schedule();
+}
+
+void IsoSurfaceSeries::updateRange(Block &block)
+{
+    const int nx = fSize[0];
+    const int ny = fSize[1];
+    block.min = block.max = fValues[(size_t(block.cellMin[2]) * ny + block.cellMin[1]) * nx + block.cellMin[0]];
+    for (int z = block.cellMin[2]; z <= block.cellMax[2]; z++) {
+        for (int y = block.cellMin[1]; y <= block.cellMax[1]; y++) {
+            const float *row = fValues.constData() + (size_t(z) * ny + y) * nx;
+            for (int x = block.cellMin[0]; x <= block.cellMax[0]; x++) {
+                block.min = qMin(block.min, row[x]);
+                block.max = qMax(block.max, row[x]);
+            }
+        }
+    }
+}
+
+void IsoSurfaceSeries::setIsoLevel(float level)
+{
+    QMutexLocker locker(&fMutex);
+    // поверхность есть только в блоках, диапазон которых содержит уровень
+    for (int i = 0; i < fBlocks.count(); i++) {
+        Block &block = fBlocks[i];
+        const bool had = block.min < fIsoLevel && fIsoLevel <= block.max;
+        const bool has = block.min < level && level <= block.max;
+        block.dirty = block.dirty || had || has;
+    }
+    fIsoLevel = level;
+    schedule();
+}
+
+float IsoSurfaceSeries::isoLevel() const
+{
+    QMutexLocker locker(&fMutex);
+    return fIsoLevel;
+}
+
+void IsoSurfaceSeries::setGeometry(const QVector3D &origin, const QVector3D &size)
+{
+    QMutexLocker locker(&fMutex);
+    fOrigin = origin;
+    fBoxSize = size;
+}
+
+void IsoSurfaceSeries::setExtractedCallback(std::function<void()> callback)
+{
+    QMutexLocker locker(&fMutex);
+    fExtractedCallback = callback;
+}
+
+bool IsoSurfaceSeries::isExtracting() const
+{
+    QMutexLocker locker(&fMutex);
+    return fExtracting;
+}
+
+int IsoSurfaceSeries::triangleCount() const
+{
+    QMutexLocker locker(&fMutex);
+    int count = 0;
+    for (int i = 0; i < fBlocks.count(); i++)
+        count += (fBlocks[i].uploaded ? fBlocks[i].indexCount : fBlocks[i].indexes.count()) / 3;
+    return count;
+}
+
+bool IsoSurfaceSeries::bounds(QVector3D *min, QVector3D *max) const
+{
+    QMutexLocker locker(&fMutex);
+    if (fBlocks.isEmpty())
+        return false;
+    const QVector3D end = fOrigin + fBoxSize;
+    *min = QVector3D(qMin(fOrigin.x(), end.x()), qMin(fOrigin.y(), end.y()), qMin(fOrigin.z(), end.z()));
+    *max = QVector3D(qMax(fOrigin.x(), end.x()), qMax(fOrigin.y(), end.y()), qMax(fOrigin.z(), end.z()));
+    return true;
+}
+
+void IsoSurfaceSeries::schedule()
+{
+    // fMutex захвачен вызывающим
+    if (fExtracting)
+        return;
+    fExtracting = true;
+    QtConcurrent::run(&fExtractor, this, &IsoSurfaceSeries::extract);
+}
+
+void IsoSurfaceSeries::extract()
+{
+    forever {
+        QVector<IsoJob> jobs;
+        float iso;
+        quint64 generation;
+        {
+            QMutexLocker locker(&fMutex);
+            for (int i = 0; i < fBlocks.count(); i++) {
+                Block &block = fBlocks[i];
+                if (!block.dirty)
+                    continue;
+                block.dirty = false;
+                IsoJob job;
+                job.block = i;
+                memcpy(job.cellMin, block.cellMin, sizeof(job.cellMin));
+                memcpy(job.cellMax, block.cellMax, sizeof(job.cellMax));
+                jobs.append(job);
+            }
+            if (jobs.isEmpty()) {
+                fExtracting = false;
+                return;
+            }
+            iso = fIsoLevel;
+            generation = fGeneration;
+        }
+
+        // блок - задача общего пула; сетка не меняется, пока идёт извлечение
+        {
+            QReadLocker valuesLocker(&fValuesLock);
+            const float *values = fValues.constData();
+            const int nx = fSize[0];
+            const int ny = fSize[1];
+            const int nz = fSize[2];
+            QtConcurrent::blockingMap(jobs, [=](IsoJob &job) {
+                MarchingCubes::extract(values, nx, ny, nz, job.cellMin, job.cellMax, iso, job.vertices, job.indexes);
+            });
+        }
+
+        std::function<void()> callback;
+        {
+            QMutexLocker locker(&fMutex);
+            if (generation != fGeneration)
+                continue;
+            for (int i = 0; i < jobs.count(); i++) {
+                Block &block = fBlocks[jobs[i].block];
+                block.vertices.swap(jobs[i].vertices);
+                block.indexes.swap(jobs[i].indexes);
+                block.uploaded = false;
+            }
+            callback = fExtractedCallback;
+        }
+        if (callback)
+            callback();
+    }
+}
+
+static QOpenGLShaderProgram *createIsoProgram()
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, ISO_VERTEX_SHADER))
+        qDebug() << "VertexShader:" << program->log();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, ISO_FRAGMENT_SHADER))
+        qDebug() << "FragmentShader:" << program->log();
+    program->link();
+    return program;
+}
+
+void IsoSurfaceSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    Q_UNUSED(program);
+
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    SceneResources *resources = SceneResources::current();
+    if (!ctx || !resources)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fGarbage.isEmpty()) {
+        f->glDeleteBuffers(fGarbage.count(), fGarbage.constData());
+        fGarbage.clear();
+    }
+    if (fLost) {
+        fLost = false;
+        schedule();
+    }
+    if (!fVisible || fBlocks.isEmpty())
+        return;
+
+    if (!fProgram)
+        fProgram = resources->acquire<QOpenGLShaderProgram>("program:" ISO_VERTEX_SHADER ":" ISO_FRAGMENT_SHADER, createIsoProgram);
+
+    // вершины в единицах сетки, коробка переносится в матрицу
+    const QVector3D cells(fSize[0] - 1, fSize[1] - 1, fSize[2] - 1);
+    QMatrix4x4 box;
+    box.translate(fOrigin);
+    box.scale(fBoxSize / cells);
+
+    fProgram->bind();
+    fProgram->setUniformValue("Matrix", pmvMatrix * box);
+    fProgram->setUniformValue("normalScale", cells / fBoxSize);
+    fProgram->setUniformValue("color", QVector3D(fColor.redF(), fColor.greenF(), fColor.blueF()));
+    const int vertexLocation = fProgram->attributeLocation("qt_Vertex");
+    const int normalLocation = fProgram->attributeLocation("qt_Normal");
+    fProgram->enableAttributeArray(vertexLocation);
+    fProgram->enableAttributeArray(normalLocation);
+    f->glEnable(GL_DEPTH_TEST);
+
+    for (int i = 0; i < fBlocks.count(); i++) {
+        Block &block = fBlocks[i];
+        if (!block.uploaded) {
+            // копия в памяти нужна только до загрузки в буфер
+            if (block.indexes.isEmpty() && block.vbo) {
+                fGarbage << block.vbo << block.ibo;
+                block.vbo = block.ibo = 0;
+            }
+            else if (!block.indexes.isEmpty()) {
+                if (!block.vbo) {
+                    f->glGenBuffers(1, &block.vbo);
+                    f->glGenBuffers(1, &block.ibo);
+                }
+                const int vertexBytes = block.vertices.count() * int(sizeof(IsoVertex));
+                const int indexBytes = block.indexes.count() * int(sizeof(quint32));
+                f->glBindBuffer(GL_ARRAY_BUFFER, block.vbo);
+                f->glBufferData(GL_ARRAY_BUFFER, vertexBytes, block.vertices.constData(), GL_STATIC_DRAW);
+                f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, block.ibo);
+                f->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, block.indexes.constData(), GL_STATIC_DRAW);
+                fUploadedBytes += vertexBytes + indexBytes;
+            }
+            block.indexCount = block.indexes.count();
+            block.vertices = QVector<IsoVertex>();
+            block.indexes = QVector<quint32>();
+            block.uploaded = true;
+        }
+        if (!block.indexCount)
+            continue;
+
+        f->glBindBuffer(GL_ARRAY_BUFFER, block.vbo);
+        f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, block.ibo);
+        fProgram->setAttributeBuffer(vertexLocation, GL_FLOAT, offsetof(IsoVertex, x), 3, sizeof(IsoVertex));
+        fProgram->setAttributeBuffer(normalLocation, GL_FLOAT, offsetof(IsoVertex, nx), 3, sizeof(IsoVertex));
+        f->glDrawElements(GL_TRIANGLES, block.indexCount, GL_UNSIGNED_INT, nullptr);
+    }
+
+    fProgram->disableAttributeArray(vertexLocation);
+    fProgram->disableAttributeArray(normalLocation);
+    fProgram->release();
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void IsoSurfaceSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fGarbage.isEmpty())
+        f->glDeleteBuffers(fGarbage.count(), fGarbage.constData());
+    fGarbage.clear();
+
+    // сетки в памяти уже нет, блоки с поверхностью извлекаются заново при следующей отрисовке
+    for (int i = 0; i < fBlocks.count(); i++) {
+        Block &block = fBlocks[i];
+        if (block.vbo) {
+            f->glDeleteBuffers(1, &block.vbo);
+            f->glDeleteBuffers(1, &block.ibo);
+        }
+        block.vbo = block.ibo = 0;
+        if (block.uploaded && block.indexCount) {
+            block.dirty = true;
+            fLost = true;
+        }
+        block.indexCount = 0;
+    }
+
+    if (fProgram) {
+        SceneResources *resources = SceneResources::current();
+        if (resources)
+            resources->release("program:" ISO_VERTEX_SHADER ":" ISO_FRAGMENT_SHADER);
+        fProgram = nullptr;
+    }
+}
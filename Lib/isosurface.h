@@ -0,0 +1,108 @@
+#ifndef ISOSURFACE_H
+#define ISOSURFACE_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QThreadPool>
+#include <functional>
+
+#include "dataseries.h"
+
+// Vertex of an isosurface in grid coordinates (sample units), the normal is the
+// negative gradient of the field - it points to the lower values.
+struct IsoVertex {
+    float x, y, z;
+    float nx, ny, nz;
+};
+
+// Marching cubes over a part of a scalar grid. Values are x-fastest, a corner is
+// inside when value >= iso. The case table is built at first use from the face
+// crossings: ambiguous faces always separate the inside corners, the same rule on
+// both sides of a face keeps the surface closed. Vertices are welded inside the
+// extracted range through a cache of the edges of two z layers.
+class MarchingCubes
+{
+public:
+    enum {
+        MaxTriangles = 5    // per cell
+    };
+
+    // cells [cellMin, cellMax) of a nx * ny * nz grid, output is appended
+    static void extract(const float *values, int nx, int ny, int nz, const int *cellMin, const int *cellMax, float iso,
+                        QVector<IsoVertex> &vertices, QVector<quint32> &indexes);
+    static const signed char *triangles(int cube);      // edge triples, -1 ends
+};
+
+// Isosurface of a scalar volume placed into a box of the scene (usually the
+// SpaceData box). The grid is split into blocks of BlockCells^3 cells, each with
+// its own mesh and buffers and the value range of its samples. Changing the iso
+// level re-extracts only the blocks whose range holds the old or the new level,
+// updateValues() only the blocks touching the changed samples. Dirty blocks are
+// extracted by QtConcurrent on the global pool, one block per task, the meshes
+// are uploaded by the next draw(); a surface of a 256^3 grid is typically a few
+// hundred blocks. setVolume(), setIsoLevel() and updateValues() may be called from
+// any thread and return at once.
+class IsoSurfaceSeries : public DataSeries
+{
+public:
+    enum {
+        BlockCells = 32
+    };
+
+    explicit IsoSurfaceSeries(const QString &name);
+    ~IsoSurfaceSeries();    // releaseGL() must be called before if the series was drawn
+
+    void setVolume(const float *values, int nx, int ny, int nz);
+    // box x0 y0 z0 of sx * sy * sz samples changed, values are the new samples of the box
+    void updateValues(int x0, int y0, int z0, int sx, int sy, int sz, const float *values);
+    void setIsoLevel(float level);
+    float isoLevel() const;
+    void setGeometry(const QVector3D &origin, const QVector3D &size);    // box of the whole grid
+    void setExtractedCallback(std::function<void()> callback);  // called on a worker thread, e.g. postDataChanged()
+
+    bool isExtracting() const;
+    int triangleCount() const;
+    bool bounds(QVector3D *min, QVector3D *max) const override;
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    struct Block {
+        int cellMin[3];
+        int cellMax[3];
+        float min;          // range of the samples of the block cells
+        float max;
+        bool dirty;
+        bool uploaded;
+        QVector<IsoVertex> vertices;
+        QVector<quint32> indexes;
+        GLuint vbo;
+        GLuint ibo;
+        int indexCount;     // in ibo
+        Block() : min(0), max(0), dirty(false), uploaded(true), vbo(0), ibo(0), indexCount(0) {}
+    };
+
+    QVector<float> fValues;
+    int fSize[3];
+    mutable QReadWriteLock fValuesLock;    // worker threads read the grid
+    QVector<Block> fBlocks;
+    float fIsoLevel;
+    QVector3D fOrigin;
+    QVector3D fBoxSize;
+    bool fExtracting;
+    bool fLost;             // buffers released, dirty blocks wait for draw()
+    quint64 fGeneration;    // of the grid, changed by setVolume()
+    QVector<GLuint> fGarbage;   // buffers to delete in draw()
+    std::function<void()> fExtractedCallback;
+    QThreadPool fExtractor;
+    QOpenGLShaderProgram *fProgram;
+
+    void updateRange(Block &block);
+    void schedule();        // fMutex locked
+    void extract();
+};
+
+#endif // ISOSURFACE_H
@@ -0,0 +1,126 @@
+#include "offscreenscene3d.h"
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLPaintDevice>
+#include <QDebug>
+
+OffscreenScene3D::OffscreenScene3D(const QSurfaceFormat &format) : fFormat(format), fContext(nullptr), fFbo(nullptr)
+{
+    fSurface = new QOffscreenSurface();
+    fSurface->setFormat(fFormat);
+    fSurface->create();
+    if (!fSurface->isValid())
+        qDebug() << "Cannot create QOffscreenSurface!";
+}
+
+OffscreenScene3D::~OffscreenScene3D()
+{
+    release();
+    delete fSurface;
+}
+
+bool OffscreenScene3D::initialize(QOpenGLContext *shareContext)
+{
+    if (fContext)
+        return true;
+
+    fContext = new QOpenGLContext();
+    fContext->setFormat(fFormat);
+    if (shareContext)
+        fContext->setShareContext(shareContext);
+
+    if (!fContext->create()) {
+        qDebug() << "Cannot create offscreen QOpenGLContext!";
+        delete fContext;
+        fContext = nullptr;
+        return false;
+    }
+
+    if (!fContext->makeCurrent(fSurface)) {
+        qDebug() << "Cannot make offscreen context current!";
+        delete fContext;
+        fContext = nullptr;
+        return false;
+    }
+
+    initializeScene();
+    return true;
+}
+
+void OffscreenScene3D::release()
+{
+    if (!fContext)
+        return;
+
+    if (fContext->makeCurrent(fSurface)) {
+        releaseScene();
+        delete fFbo;
+        fFbo = nullptr;
+        fContext->doneCurrent();
+    }
+
+    delete fContext;
+    fContext = nullptr;
+}
+
+bool OffscreenScene3D::makeCurrent()
+{
+    return fContext && fContext->makeCurrent(fSurface);
+}
+
+void OffscreenScene3D::doneCurrent()
+{
+    if (fContext)
+        fContext->doneCurrent();
+}
+
+QImage OffscreenScene3D::renderToImage(const QSize &size, const CameraState &camera)
+{
+    if (size.isEmpty() || !makeCurrent())
+        return QImage();
+
+    if (!prepareFramebuffer(size))
+        return QImage();
+
+    fCamera = camera;
+    renderToFramebuffer(fFbo);
+
+    return fFbo->toImage();
+}
+
+bool OffscreenScene3D::renderToFramebuffer(QOpenGLFramebufferObject *target)
+{
+    if (!target || !makeCurrent())
+        return false;
+
+    target->bind();
+    {
+        QOpenGLPaintDevice device(target->size());
+        renderScene(&device, target->size());
+    }
+    target->release();
+    return true;
+}
+
+bool OffscreenScene3D::prepareFramebuffer(const QSize &size)
+{
+    if (fFbo && fFbo->size() == size)
+        return true;
+
+    delete fFbo;
+
+    // те же вложения, что и у FBO QOpenGLWidget
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    fboFormat.setSamples(qMax(0, fFormat.samples()));
+    fFbo = new QOpenGLFramebufferObject(size, fboFormat);
+    if (!fFbo->isValid()) {
+        qDebug() << "Cannot create offscreen framebuffer" << size;
+        delete fFbo;
+        fFbo = nullptr;
+        return false;
+    }
+    return true;
+}
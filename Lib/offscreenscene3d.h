@@ -0,0 +1,45 @@
+#ifndef OFFSCREENSCENE3D_H
+#define OFFSCREENSCENE3D_H
+
+#include <QImage>
+#include <QSurfaceFormat>
+
+#include "basescenecore.h"
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+// Headless variant of BaseScene3D: renders the same scene into an FBO
+// of arbitrary size. The object must be constructed and destroyed on the GUI
+// thread (QOffscreenSurface requirement); initialize(), renderToImage() and
+// release() must be called from the thread that renders. Every instance owns
+// its own context.
+class OffscreenScene3D : public BaseSceneCore
+{
+public:
+    OffscreenScene3D(const QSurfaceFormat &format = QSurfaceFormat::defaultFormat());
+    virtual ~OffscreenScene3D();
+
+    bool initialize(QOpenGLContext *shareContext = nullptr);
+    void release();
+    bool isInitialized() const { return fContext != nullptr; }
+    QOpenGLContext *context() const { return fContext; }
+
+    bool makeCurrent();
+    void doneCurrent();
+
+    QImage renderToImage(const QSize &size, const CameraState &camera);
+    QImage renderToImage(const QSize &size) { return renderToImage(size, cameraState()); }
+    bool renderToFramebuffer(QOpenGLFramebufferObject *target);  // current camera, target size
+
+private:
+    QSurfaceFormat fFormat;
+    QOffscreenSurface *fSurface;
+    QOpenGLContext *fContext;
+    QOpenGLFramebufferObject *fFbo;
+
+    bool prepareFramebuffer(const QSize &size);
+};
+
+#endif // OFFSCREENSCENE3D_H
@@ -0,0 +1,183 @@
+#include "pointcodec.h"
+
+#include <QtEndian>
+#include <QVector>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CODEC_SSE2
+#endif
+
+#define QUANT_MAX 65535.0f
+#define TAIL_PADDING 8      // распаковка читает по 8 байтов
+
+struct PackedHeader {
+    quint32 count;
+    float min[3];
+    float step[3];      // (max - min) / QUANT_MAX
+};
+
+static inline quint32 zigzag(qint32 v)
+{
+    return (quint32(v) << 1) ^ quint32(v >> 31);
+}
+
+static inline qint32 unzigzag(quint32 v)
+{
+    return qint32(v >> 1) ^ -qint32(v & 1);
+}
+
+static inline int bitWidth(quint32 v)
+{
+    int width = 0;
+    while (v) {
+        width++;
+        v >>= 1;
+    }
+    return width;
+}
+
+QByteArray PointCodec::encode(const float *xyz, int count, const float *min, const float *max)
+{
+    PackedHeader header;
+    header.count = quint32(qMax(0, count));
+    for (int k = 0; k < 3; k++) {
+        header.min[k] = min[k];
+        header.step[k] = (max[k] - min[k]) / QUANT_MAX;
+    }
+
+    QByteArray packed;
+    packed.reserve(int(sizeof(header)) + count * 6 + TAIL_PADDING);
+    packed.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    QVector<quint32> deltas(count);
+    for (int k = 0; k < 3; k++) {
+        const float scale = header.step[k] > 0.0f ? 1.0f / header.step[k] : 0.0f;
+        qint32 previous = 0;
+        for (int i = 0; i < count; i++) {
+            const float q = (xyz[i * 3 + k] - min[k]) * scale + 0.5f;
+            const qint32 value = q <= 0.0f ? 0 : q >= QUANT_MAX ? qint32(QUANT_MAX) : qint32(q);
+            deltas[i] = zigzag(value - previous);
+            previous = value;
+        }
+
+        // группа: байт ширины и значения по width бит подряд
+        for (int group = 0; group < count; group += GroupSize) {
+            const int n = qMin(int(GroupSize), count - group);
+            quint32 widest = 0;
+            for (int i = 0; i < n; i++)
+                widest |= deltas[group + i];
+            const int width = bitWidth(widest);
+            packed.append(char(width));
+            if (!width)
+                continue;
+
+            const int bytes = (n * width + 7) / 8;
+            const int start = packed.size();
+            packed.append(QByteArray(bytes, 0));
+            uchar *out = reinterpret_cast<uchar*>(packed.data()) + start;
+            quint64 bit = 0;
+            for (int i = 0; i < n; i++, bit += quint64(width)) {
+                quint64 v = quint64(deltas[group + i]) << (bit & 7);
+                for (uchar *p = out + (bit >> 3); v; p++, v >>= 8)
+                    *p |= uchar(v);
+            }
+        }
+    }
+
+    packed.append(QByteArray(TAIL_PADDING, 0));
+    return packed;
+}
+
+int PointCodec::count(const QByteArray &packed)
+{
+    if (packed.size() < int(sizeof(PackedHeader)) + TAIL_PADDING)
+        return 0;
+    PackedHeader header;
+    memcpy(&header, packed.constData(), sizeof(header));
+    return int(header.count);
+}
+
+// values[i] += values[i - 1] для всего массива
+static void prefixSum(qint32 *values, int count)
+{
+    int i = 0;
+#if defined(CODEC_SSE2)
+    __m128i carry = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi32(v, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), v);
+        carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+#endif
+    for (; i < count; i++)
+        values[i] += i ? values[i - 1] : 0;
+}
+
+static void dequantize(const qint32 *values, int count, float min, float step, float *out)
+{
+    int i = 0;
+#if defined(CODEC_SSE2)
+    const __m128 vmin = _mm_set1_ps(min);
+    const __m128 vstep = _mm_set1_ps(step);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 q = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)));
+        _mm_storeu_ps(out + i, _mm_add_ps(vmin, _mm_mul_ps(q, vstep)));
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = min + float(values[i]) * step;
+}
+
+bool PointCodec::decode(const QByteArray &packed, float *xyz)
+{
+    const int n = count(packed);
+    if (!n)
+        return packed.size() >= int(sizeof(PackedHeader));
+
+    PackedHeader header;
+    memcpy(&header, packed.constData(), sizeof(header));
+    const uchar *in = reinterpret_cast<const uchar*>(packed.constData()) + sizeof(header);
+    const uchar *end = reinterpret_cast<const uchar*>(packed.constData()) + packed.size() - TAIL_PADDING;
+
+    QVector<qint32> values(n);
+    QVector<float> axis(n);
+    for (int k = 0; k < 3; k++) {
+        for (int group = 0; group < n; group += GroupSize) {
+            const int count = qMin(int(GroupSize), n - group);
+            if (in >= end)
+                return false;
+            const int width = *in++;
+            if (width > 32)
+                return false;
+
+            qint32 *out = values.data() + group;
+            if (!width) {
+                memset(out, 0, size_t(count) * sizeof(qint32));
+                continue;
+            }
+
+            const int bytes = (count * width + 7) / 8;
+            if (in + bytes > end)
+                return false;
+            // отступ в конце блока позволяет читать 8 байтов с любого места
+            const quint64 mask = (quint64(1) << width) - 1;
+            quint64 bit = 0;
+            for (int i = 0; i < count; i++, bit += quint64(width)) {
+                const quint64 word = qFromLittleEndian<quint64>(in + (bit >> 3));
+                out[i] = unzigzag(quint32((word >> (bit & 7)) & mask));
+            }
+            in += bytes;
+        }
+
+        prefixSum(values.data(), n);
+        dequantize(values.constData(), n, header.min[k], header.step[k], axis.data());
+        for (int i = 0; i < n; i++)
+            xyz[i * 3 + k] = axis[i];
+    }
+    return true;
+}
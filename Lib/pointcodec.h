@@ -0,0 +1,23 @@
+#ifndef POINTCODEC_H
+#define POINTCODEC_H
+
+#include <QByteArray>
+
+// Lossy compression of a point block for the history tier. Each coordinate is
+// quantized to 16 bits inside the block bounds, stored as zigzag deltas of the
+// previous point and bit-packed in groups of GroupSize values with the width of
+// the largest delta of the group. The error is at most 1/131070 of the bounds
+// extent per axis. Decoding reconstructs the deltas with an SSE2 prefix sum.
+class PointCodec
+{
+public:
+    enum {
+        GroupSize = 128
+    };
+
+    static QByteArray encode(const float *xyz, int count, const float *min, const float *max);
+    static int count(const QByteArray &packed);             // points in the block, 0 if it is broken
+    static bool decode(const QByteArray &packed, float *xyz);   // xyz - count() * 3 floats
+};
+
+#endif // POINTCODEC_H
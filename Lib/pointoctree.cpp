@@ -0,0 +1,373 @@
+#include "pointoctree.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QRunnable>
+#include <QDebug>
+#include <cstddef>
+#include <queue>
+
+#define MAX_PENDING_LOADS 8
+#define PAGE_SIZE 4096
+
+// Reads the pages of a node payload so that the upload does not wait for the disk.
+class OctreeLoadTask : public QRunnable
+{
+public:
+    OctreeLoadTask(OctreeSeries *series, int index) : fSeries(series), fIndex(index) {}
+
+    void run() override
+    {
+        const uchar *data = reinterpret_cast<const uchar*>(fSeries->fOctree.payload(fIndex));
+        const size_t bytes = size_t(fSeries->fOctree.node(fIndex).count) * sizeof(SpriteVertex);
+        uchar sum = 0;
+        for (size_t i = 0; i < bytes; i += PAGE_SIZE)
+            sum += data[i];
+        if (bytes)
+            sum += data[bytes - 1];
+        fTouched = sum;
+
+        std::function<void()> callback;
+        {
+            QMutexLocker locker(&fSeries->fLoadMutex);
+            fSeries->fLoaded.append(fIndex);
+            fSeries->fPending--;
+            callback = fSeries->fLoadedCallback;
+        }
+        if (callback)
+            callback();
+    }
+
+private:
+    OctreeSeries *fSeries;
+    int fIndex;
+    static volatile uchar fTouched;     // чтение не выбрасывается оптимизатором
+};
+
+volatile uchar OctreeLoadTask::fTouched = 0;
+
+OctreeSeries::OctreeSeries(const QString &name) : DataSeries(name), fCacheBytes(0), fFrame(0), fPointBudget(3000000), fErrorThreshold(1.5f),
+    fCacheSize(512 * 1024 * 1024), fUploadBudget(32 * 1024 * 1024), fDrawnPoints(0), fProgram(nullptr), fPending(0)
+{
+    fLoader.setMaxThreadCount(2);
+}
+
+OctreeSeries::~OctreeSeries()
+{
+    fLoader.waitForDone();
+}
+
+bool OctreeSeries::open(const QString &path)
+{
+    close();
+
+    QMutexLocker locker(&fMutex);
+    if (!fOctree.open(path))
+        return false;
+    fState.fill(nsUnloaded, fOctree.nodeCount());
+    return true;
+}
+
+void OctreeSeries::close()
+{
+    // draw() не запустит новых загрузок, пока держим fMutex
+    QMutexLocker locker(&fMutex);
+    fLoader.waitForDone();
+    if (!fResident.isEmpty())
+        qDebug() << "OctreeSeries: close() before releaseGL()";
+    fOctree.close();
+    fState.clear();
+
+    QMutexLocker loadLocker(&fLoadMutex);
+    fLoaded.clear();
+    fPending = 0;
+}
+
+void OctreeSeries::setPointBudget(quint64 points)
+{
+    QMutexLocker locker(&fMutex);
+    fPointBudget = qMax<quint64>(1, points);
+}
+
+quint64 OctreeSeries::pointBudget() const
+{
+    QMutexLocker locker(&fMutex);
+    return fPointBudget;
+}
+
+void OctreeSeries::setErrorThreshold(float pixels)
+{
+    QMutexLocker locker(&fMutex);
+    fErrorThreshold = qMax(0.1f, pixels);
+}
+
+float OctreeSeries::errorThreshold() const
+{
+    QMutexLocker locker(&fMutex);
+    return fErrorThreshold;
+}
+
+void OctreeSeries::setCacheSize(quint64 bytes)
+{
+    QMutexLocker locker(&fMutex);
+    fCacheSize = bytes;
+}
+
+void OctreeSeries::setUploadBudget(quint64 bytes)
+{
+    QMutexLocker locker(&fMutex);
+    fUploadBudget = qMax<quint64>(1, bytes);
+}
+
+void OctreeSeries::setLoadedCallback(std::function<void()> callback)
+{
+    QMutexLocker locker(&fLoadMutex);
+    fLoadedCallback = callback;
+}
+
+quint64 OctreeSeries::drawnPoints() const
+{
+    QMutexLocker locker(&fMutex);
+    return fDrawnPoints;
+}
+
+int OctreeSeries::residentNodes() const
+{
+    QMutexLocker locker(&fMutex);
+    return fResident.count();
+}
+
+quint64 OctreeSeries::cacheBytes() const
+{
+    QMutexLocker locker(&fMutex);
+    return fCacheBytes;
+}
+
+bool OctreeSeries::bounds(QVector3D *min, QVector3D *max) const
+{
+    QMutexLocker locker(&fMutex);
+    if (!fOctree.isOpen())
+        return false;
+    const float size = fOctree.boundsSize();
+    *min = fOctree.boundsMin();
+    *max = *min + QVector3D(size, size, size);
+    return true;
+}
+
+void OctreeSeries::select(const QMatrix4x4 &pmvMatrix, const QSize &viewport, QVector<int> &nodes)
+{
+    const QVector4D r0 = pmvMatrix.row(0);
+    const QVector4D r1 = pmvMatrix.row(1);
+    const QVector4D r3 = pmvMatrix.row(3);
+    const QVector4D planes[6] = {
+        r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + pmvMatrix.row(2), r3 - pmvMatrix.row(2)
+    };
+    // пикселей на единицу длины при w = 1
+    const float pixelScale = 0.5f * qMax(r0.toVector3D().length() * viewport.width(), r1.toVector3D().length() * viewport.height());
+    const bool perspective = !qFuzzyIsNull(r3.toVector3D().lengthSquared());
+
+    auto visible = [&](const OctreeFileNode &node) {
+        for (int p = 0; p < 6; p++) {
+            const QVector4D &plane = planes[p];
+            const QVector3D corner(node.min[0] + (plane.x() >= 0.0f ? node.size : 0.0f),
+                                   node.min[1] + (plane.y() >= 0.0f ? node.size : 0.0f),
+                                   node.min[2] + (plane.z() >= 0.0f ? node.size : 0.0f));
+            if (QVector3D::dotProduct(plane.toVector3D(), corner) + plane.w() < 0.0f)
+                return false;
+        }
+        return true;
+    };
+
+    // ошибка узла - шаг его сетки в пикселях на ближайшей к камере точке куба
+    auto error = [&](const OctreeFileNode &node) {
+        const float half = node.size * 0.5f;
+        const QVector3D center(node.min[0] + half, node.min[1] + half, node.min[2] + half);
+        const float w = QVector3D::dotProduct(r3.toVector3D(), center) + r3.w();
+        const float distance = perspective ? qMax(w - half * 1.7320508f, 0.001f) : w;
+        return node.spacing * pixelScale / distance;
+    };
+
+    typedef QPair<float, int> Candidate;
+    std::priority_queue<Candidate> queue;
+    if (visible(fOctree.node(0)))
+        queue.push(Candidate(error(fOctree.node(0)), 0));
+
+    quint64 points = 0;
+    while (!queue.empty()) {
+        const Candidate candidate = queue.top();
+        queue.pop();
+
+        const OctreeFileNode &node = fOctree.node(candidate.second);
+        if (points + node.count > fPointBudget && !nodes.isEmpty())
+            break;
+        nodes.append(candidate.second);
+        points += node.count;
+
+        if (candidate.first <= fErrorThreshold)
+            continue;
+        for (int c = 0; c < 8; c++) {
+            const int child = node.children[c];
+            if (child >= 0 && visible(fOctree.node(child)))
+                queue.push(Candidate(error(fOctree.node(child)), child));
+        }
+    }
+}
+
+void OctreeSeries::request(int index)
+{
+    {
+        QMutexLocker locker(&fLoadMutex);
+        if (fPending >= MAX_PENDING_LOADS)
+            return;
+        fPending++;
+    }
+    fState[index] = nsLoading;
+    fLoader.start(new OctreeLoadTask(this, index));
+}
+
+void OctreeSeries::upload(int index)
+{
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    Resident resident;
+    resident.bytes = quint64(fOctree.node(index).count) * sizeof(SpriteVertex);
+    resident.lastFrame = fFrame;
+    f->glGenBuffers(1, &resident.vbo);
+    f->glBindBuffer(GL_ARRAY_BUFFER, resident.vbo);
+    // данные лежат в файле в формате вершин, копируется прямо из отображения
+    f->glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(resident.bytes), fOctree.payload(index), GL_STATIC_DRAW);
+
+    fResident.insert(index, resident);
+    fState[index] = nsResident;
+    fCacheBytes += resident.bytes;
+    fUploadedBytes += resident.bytes;
+}
+
+void OctreeSeries::evict()
+{
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    while (fCacheBytes > fCacheSize) {
+        // узлы текущего кадра не вытесняются
+        QHash<int, Resident>::iterator oldest = fResident.end();
+        for (QHash<int, Resident>::iterator it = fResident.begin(); it != fResident.end(); ++it) {
+            if (it->lastFrame < fFrame && (oldest == fResident.end() || it->lastFrame < oldest->lastFrame))
+                oldest = it;
+        }
+        if (oldest == fResident.end())
+            break;
+
+        f->glDeleteBuffers(1, &oldest->vbo);
+        fCacheBytes -= oldest->bytes;
+        fState[oldest.key()] = nsUnloaded;
+        fResident.erase(oldest);
+    }
+}
+
+void OctreeSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    Q_UNUSED(program);
+
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fVisible || !fOctree.isOpen())
+        return;
+
+    if (!fProgram)
+        fProgram = PointSprites::acquireProgram();
+    if (!fProgram)
+        return;
+    fFrame++;
+
+    QVector<int> loaded;
+    {
+        QMutexLocker loadLocker(&fLoadMutex);
+        loaded.swap(fLoaded);
+    }
+    for (int i = 0; i < loaded.count(); i++) {
+        if (fState[loaded[i]] == nsLoading)
+            fState[loaded[i]] = nsReady;
+    }
+
+    GLint viewport[4];
+    f->glGetIntegerv(GL_VIEWPORT, viewport);
+    QVector<int> nodes;
+    select(pmvMatrix, QSize(viewport[2], viewport[3]), nodes);
+
+    fProgram->bind();
+    fProgram->setUniformValue("Matrix", pmvMatrix);
+    fProgram->setUniformValue("sizeScale", GLfloat(PointSprites::MaxSize));
+    fProgram->setUniformValue("attenuation", 0.0f);
+    fProgram->setUniformValue("roundPoints", true);
+    const int vertexLocation = fProgram->attributeLocation("qt_Vertex");
+    const int colorLocation = fProgram->attributeLocation("qt_Color");
+    fProgram->enableAttributeArray(vertexLocation);
+    fProgram->enableAttributeArray(colorLocation);
+    PointSprites::begin();
+
+    quint64 uploaded = 0;
+    bool waiting = false;   // выбранные узлы, которые ещё не в кэше
+    fDrawnPoints = 0;
+    for (int i = 0; i < nodes.count(); i++) {
+        const int index = nodes[i];
+        if (fState[index] == nsUnloaded)
+            request(index);
+        else if (fState[index] == nsReady && uploaded < fUploadBudget) {
+            upload(index);
+            uploaded += fResident.value(index).bytes;
+        }
+        if (fState[index] != nsResident) {
+            waiting = true;
+            continue;
+        }
+
+        Resident &resident = fResident[index];
+        resident.lastFrame = fFrame;
+        const OctreeFileNode &node = fOctree.node(index);
+        f->glBindBuffer(GL_ARRAY_BUFFER, resident.vbo);
+        fProgram->setAttributeBuffer(vertexLocation, GL_UNSIGNED_SHORT, 0, 4, sizeof(SpriteVertex));
+        fProgram->setAttributeBuffer(colorLocation, GL_UNSIGNED_BYTE, offsetof(SpriteVertex, r), 4, sizeof(SpriteVertex));
+        fProgram->setUniformValue("origin", QVector3D(node.min[0], node.min[1], node.min[2]));
+        fProgram->setUniformValue("extent", QVector3D(node.size, node.size, node.size));
+        f->glDrawArrays(GL_POINTS, 0, GLsizei(node.count));
+        fDrawnPoints += node.count;
+    }
+
+    PointSprites::end();
+    fProgram->disableAttributeArray(colorLocation);
+    fProgram->disableAttributeArray(vertexLocation);
+    fProgram->release();
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    evict();
+
+    // остаток загрузится в следующих кадрах
+    if (waiting && uploaded >= fUploadBudget) {
+        QMutexLocker loadLocker(&fLoadMutex);
+        if (fLoadedCallback)
+            fLoadedCallback();
+    }
+}
+
+void OctreeSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QMutexLocker locker(&fMutex);
+    for (QHash<int, Resident>::iterator it = fResident.begin(); it != fResident.end(); ++it) {
+        ctx->functions()->glDeleteBuffers(1, &it->vbo);
+        fState[it.key()] = nsReady;
+    }
+    fResident.clear();
+    fCacheBytes = 0;
+
+    if (fProgram) {
+        PointSprites::releaseProgram();
+        fProgram = nullptr;
+    }
+}
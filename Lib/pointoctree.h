@@ -0,0 +1,84 @@
+#ifndef POINTOCTREE_H
+#define POINTOCTREE_H
+
+#include <QVector>
+#include <QHash>
+#include <QSize>
+#include <QMutex>
+#include <QThreadPool>
+#include <functional>
+
+#include "dataseries.h"
+#include "pointoctreefile.h"
+
+// Octree drawn with a bounded frame cost. Nodes are selected by screen-space
+// error under the camera, largest error first, until the point budget is spent.
+// Pages of selected nodes are read on background threads, then uploaded (at most
+// uploadBudget bytes per frame) into an LRU cache of vertex buffers.
+class OctreeSeries : public DataSeries
+{
+public:
+    explicit OctreeSeries(const QString &name);
+    ~OctreeSeries();    // releaseGL() must be called before if the series was drawn
+
+    bool open(const QString &path);
+    void close();       // after releaseGL()
+    const PointOctree &octree() const { return fOctree; }
+
+    void setPointBudget(quint64 points);
+    quint64 pointBudget() const;
+    void setErrorThreshold(float pixels);       // nodes whose spacing projects larger are refined
+    float errorThreshold() const;
+    void setCacheSize(quint64 bytes);
+    void setUploadBudget(quint64 bytes);        // per frame
+    void setLoadedCallback(std::function<void()> callback);   // called on the loader thread, e.g. postDataChanged()
+
+    quint64 drawnPoints() const;
+    int residentNodes() const;
+    quint64 cacheBytes() const;
+    bool bounds(QVector3D *min, QVector3D *max) const override;     // cube of the root
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    enum NodeState {
+        nsUnloaded,
+        nsLoading,
+        nsReady,        // страницы прочитаны, можно загружать в буфер
+        nsResident
+    };
+
+    struct Resident {
+        GLuint vbo;
+        quint64 bytes;
+        quint64 lastFrame;
+    };
+
+    PointOctree fOctree;
+    QVector<quint8> fState;
+    QHash<int, Resident> fResident;
+    quint64 fCacheBytes;
+    quint64 fFrame;
+    quint64 fPointBudget;
+    float fErrorThreshold;
+    quint64 fCacheSize;
+    quint64 fUploadBudget;
+    quint64 fDrawnPoints;
+    QOpenGLShaderProgram *fProgram;
+
+    QThreadPool fLoader;
+    QMutex fLoadMutex;
+    QVector<int> fLoaded;   // prefetched by the loader, not yet seen by draw()
+    int fPending;           // requests in the loader
+    std::function<void()> fLoadedCallback;
+
+    void select(const QMatrix4x4 &pmvMatrix, const QSize &viewport, QVector<int> &nodes);
+    void request(int index);
+    void upload(int index);
+    void evict();
+
+    friend class OctreeLoadTask;
+};
+
+#endif // POINTOCTREE_H
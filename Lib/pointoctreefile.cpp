@@ -0,0 +1,325 @@
+#include "pointoctreefile.h"
+
+#include <QBitArray>
+#include <QDir>
+#include <QDebug>
+#include <cstring>
+
+#define OCTREE_MAGIC "POCT"
+#define SPILL_BLOCK 65536           // records per read
+#define CHILD_FLUSH 4096            // records buffered per child
+
+Q_STATIC_ASSERT(sizeof(OctreeFileHeader) == 48);
+Q_STATIC_ASSERT(sizeof(OctreeFileNode) == 64);
+
+static QTemporaryFile *createTemporary()
+{
+    QTemporaryFile *file = new QTemporaryFile(QDir::tempPath() + "/octree_XXXXXX");
+    if (!file->open()) {
+        qDebug() << "PointOctreeBuilder: cannot create temporary file" << file->errorString();
+        delete file;
+        return nullptr;
+    }
+    return file;
+}
+
+PointOctreeBuilder::PointOctreeBuilder(float pointSize) : fSpill(QDir::tempPath() + "/octree_XXXXXX"), fCount(0), fPointSize(pointSize)
+{
+    for (int i = 0; i < 3; i++) {
+        fMin[i] = 0.0f;
+        fMax[i] = 0.0f;
+    }
+}
+
+PointOctreeBuilder::~PointOctreeBuilder()
+{
+}
+
+bool PointOctreeBuilder::add(const float *xyz, const QRgb *colors, int count)
+{
+    if (!fSpill.isOpen() && !fSpill.open()) {
+        fError = fSpill.errorString();
+        return false;
+    }
+
+    QVector<Record> records(count);
+    for (int i = 0; i < count; i++, xyz += 3) {
+        Record &r = records[i];
+        r.x = xyz[0];
+        r.y = xyz[1];
+        r.z = xyz[2];
+        r.color = colors ? colors[i] : qRgba(255, 255, 255, 255);
+
+        for (int k = 0; k < 3; k++) {
+            if (fCount == 0 && i == 0) {
+                fMin[k] = xyz[k];
+                fMax[k] = xyz[k];
+            }
+            fMin[k] = qMin(fMin[k], xyz[k]);
+            fMax[k] = qMax(fMax[k], xyz[k]);
+        }
+    }
+
+    const qint64 bytes = qint64(count) * qint64(sizeof(Record));
+    if (fSpill.write(reinterpret_cast<const char*>(records.constData()), bytes) != bytes) {
+        fError = fSpill.errorString();
+        return false;
+    }
+    fCount += quint64(count);
+    return true;
+}
+
+bool PointOctreeBuilder::build(const QString &path)
+{
+    if (!fCount) {
+        fError = "no points";
+        return false;
+    }
+
+    float size = 0.0f;
+    for (int k = 0; k < 3; k++)
+        size = qMax(size, fMax[k] - fMin[k]);
+    size = size > 0.0f ? size * 1.0001f : 1.0f;     // точки на верхней границе остаются внутри куба
+
+    QFile output(path);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fError = output.errorString();
+        return false;
+    }
+
+    OctreeFileHeader header;
+    memset(&header, 0, sizeof(header));
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    fNodes.clear();
+    fSpill.flush();
+    if (buildNode(&fSpill, fCount, fMin, size, 0, output) < 0)
+        return false;
+
+    memcpy(header.magic, OCTREE_MAGIC, 4);
+    header.version = PointOctree::Version;
+    header.nodeCount = quint32(fNodes.count());
+    for (int k = 0; k < 3; k++)
+        header.min[k] = fMin[k];
+    header.size = size;
+    header.pointCount = fCount;
+    header.nodeTableOffset = quint64(output.pos());
+
+    const qint64 tableBytes = qint64(fNodes.count()) * qint64(sizeof(OctreeFileNode));
+    if (output.write(reinterpret_cast<const char*>(fNodes.constData()), tableBytes) != tableBytes
+            || !output.seek(0)
+            || output.write(reinterpret_cast<const char*>(&header), sizeof(header)) != qint64(sizeof(header))) {
+        fError = output.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool PointOctreeBuilder::writePayload(QFile &output, const QVector<Record> &records, const float *min, float size, OctreeFileNode &node)
+{
+    if (records.isEmpty())
+        return true;
+
+    QVector<float> xyz(records.count() * 3);
+    QVector<QRgb> colors(records.count());
+    for (int i = 0; i < records.count(); i++) {
+        xyz[i * 3] = records[i].x;
+        xyz[i * 3 + 1] = records[i].y;
+        xyz[i * 3 + 2] = records[i].z;
+        colors[i] = records[i].color;
+    }
+
+    QVector<SpriteVertex> vertices(records.count());
+    PointSprites::pack(xyz.constData(), colors.constData(), nullptr, records.count(), 0, fPointSize,
+                       QVector3D(min[0], min[1], min[2]), QVector3D(size, size, size), vertices.data());
+
+    if (!node.count)
+        node.offset = quint64(output.pos());
+    const qint64 bytes = qint64(vertices.count()) * qint64(sizeof(SpriteVertex));
+    if (output.write(reinterpret_cast<const char*>(vertices.constData()), bytes) != bytes) {
+        fError = output.errorString();
+        return false;
+    }
+    node.count += quint32(vertices.count());
+    return true;
+}
+
+int PointOctreeBuilder::buildNode(QFile *input, quint64 count, const float *min, float size, int depth, QFile &output)
+{
+    const int index = fNodes.count();
+    OctreeFileNode node;
+    memset(&node, 0, sizeof(node));
+    for (int k = 0; k < 3; k++)
+        node.min[k] = min[k];
+    node.size = size;
+    for (int c = 0; c < 8; c++)
+        node.children[c] = -1;
+
+    input->seek(0);
+    QVector<Record> block(SPILL_BLOCK);
+    const qint64 blockBytes = qint64(SPILL_BLOCK) * qint64(sizeof(Record));
+
+    if (count <= LeafPoints || depth >= MaxDepth) {
+        // лист: все точки, дальше уточнять нечего
+        node.spacing = 0.0f;
+        qint64 read;
+        while ((read = input->read(reinterpret_cast<char*>(block.data()), blockBytes)) > 0) {
+            if (!writePayload(output, block.mid(0, int(read / qint64(sizeof(Record)))), min, size, node))
+                return -1;
+        }
+        fNodes.append(node);
+        return index;
+    }
+
+    node.spacing = size / GridSize;
+    fNodes.append(node);
+
+    const float scale = GridSize / size;
+    const int half = GridSize / 2;
+    QBitArray occupied(GridSize * GridSize * GridSize);
+    QVector<Record> kept;
+    QTemporaryFile *children[8];
+    QVector<Record> childBuffers[8];
+    quint64 childCounts[8];
+    for (int c = 0; c < 8; c++) {
+        children[c] = nullptr;
+        childCounts[c] = 0;
+    }
+
+    bool ok = true;
+    qint64 read;
+    while (ok && (read = input->read(reinterpret_cast<char*>(block.data()), blockBytes)) > 0) {
+        const int n = int(read / qint64(sizeof(Record)));
+        for (int i = 0; i < n && ok; i++) {
+            const Record &r = block[i];
+            const int ix = qBound(0, int((r.x - min[0]) * scale), GridSize - 1);
+            const int iy = qBound(0, int((r.y - min[1]) * scale), GridSize - 1);
+            const int iz = qBound(0, int((r.z - min[2]) * scale), GridSize - 1);
+            const int cell = ix + GridSize * (iy + GridSize * iz);
+
+            // первая точка ячейки остаётся в узле, остальные уходят в потомков
+            if (!occupied.testBit(cell)) {
+                occupied.setBit(cell);
+                kept.append(r);
+                continue;
+            }
+
+            const int c = (ix >= half ? 1 : 0) | (iy >= half ? 2 : 0) | (iz >= half ? 4 : 0);
+            childBuffers[c].append(r);
+            childCounts[c]++;
+            if (childBuffers[c].count() >= CHILD_FLUSH) {
+                if (!children[c] && !(children[c] = createTemporary()))
+                    ok = false;
+                else {
+                    children[c]->write(reinterpret_cast<const char*>(childBuffers[c].constData()), qint64(childBuffers[c].count()) * qint64(sizeof(Record)));
+                    childBuffers[c].clear();
+                }
+            }
+        }
+    }
+
+    for (int c = 0; c < 8 && ok; c++) {
+        if (childBuffers[c].isEmpty())
+            continue;
+        if (!children[c] && !(children[c] = createTemporary()))
+            ok = false;
+        else {
+            children[c]->write(reinterpret_cast<const char*>(childBuffers[c].constData()), qint64(childBuffers[c].count()) * qint64(sizeof(Record)));
+            childBuffers[c].clear();
+        }
+    }
+
+    if (ok)
+        ok = writePayload(output, kept, min, size, fNodes[index]);
+    kept.clear();
+
+    for (int c = 0; c < 8; c++) {
+        if (ok && children[c]) {
+            children[c]->flush();
+            const float childMin[3] = {
+                min[0] + ((c & 1) ? size / 2 : 0.0f),
+                min[1] + ((c & 2) ? size / 2 : 0.0f),
+                min[2] + ((c & 4) ? size / 2 : 0.0f)
+            };
+            const int child = buildNode(children[c], childCounts[c], childMin, size / 2, depth + 1, output);
+            if (child < 0)
+                ok = false;
+            else
+                fNodes[index].children[c] = child;
+        }
+        delete children[c];     // временный файл удаляется
+    }
+
+    if (!ok && fError.isEmpty())
+        fError = "cannot write temporary file";
+    return ok ? index : -1;
+}
+
+PointOctree::PointOctree() : fMap(nullptr), fHeader(nullptr), fNodes(nullptr)
+{
+}
+
+bool PointOctree::open(const QString &path)
+{
+    close();
+
+    fFile.setFileName(path);
+    if (!fFile.open(QIODevice::ReadOnly)) {
+        qDebug() << "PointOctree: cannot open" << path << fFile.errorString();
+        return false;
+    }
+
+    const qint64 size = fFile.size();
+    if (size < qint64(sizeof(OctreeFileHeader)) || !(fMap = fFile.map(0, size))) {
+        qDebug() << "PointOctree: cannot map" << path;
+        close();
+        return false;
+    }
+
+    const OctreeFileHeader *header = reinterpret_cast<const OctreeFileHeader*>(fMap);
+    // размеры из файла сравниваются с остатком файла, сумма не переполняется
+    const quint64 fileSize = quint64(size);
+    const bool tableFits = header->nodeTableOffset <= fileSize
+            && quint64(header->nodeCount) <= (fileSize - header->nodeTableOffset) / sizeof(OctreeFileNode);
+    if (memcmp(header->magic, OCTREE_MAGIC, 4) != 0 || header->version != Version || !header->nodeCount || !tableFits) {
+        qDebug() << "PointOctree: bad header" << path;
+        close();
+        return false;
+    }
+
+    const OctreeFileNode *nodes = reinterpret_cast<const OctreeFileNode*>(fMap + header->nodeTableOffset);
+    for (quint32 i = 0; i < header->nodeCount; i++) {
+        bool valid = nodes[i].offset <= fileSize && quint64(nodes[i].count) <= (fileSize - nodes[i].offset) / sizeof(SpriteVertex);
+        // потомки строителя идут после родителя: ссылка назад дала бы цикл в select()
+        for (int c = 0; c < 8; c++) {
+            const qint32 child = nodes[i].children[c];
+            valid = valid && (child == -1 || (child > qint32(i) && quint32(child) < header->nodeCount));
+        }
+        if (!valid) {
+            qDebug() << "PointOctree: bad node" << i << path;
+            close();
+            return false;
+        }
+    }
+
+    fHeader = header;
+    fNodes = nodes;
+    return true;
+}
+
+void PointOctree::close()
+{
+    if (fMap)
+        fFile.unmap(fMap);
+    fMap = nullptr;
+    fHeader = nullptr;
+    fNodes = nullptr;
+    fFile.close();
+}
+
+QVector3D PointOctree::boundsMin() const
+{
+    if (!fHeader)
+        return QVector3D();
+    return QVector3D(fHeader->min[0], fHeader->min[1], fHeader->min[2]);
+}
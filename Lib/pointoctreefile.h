@@ -0,0 +1,110 @@
+#ifndef POINTOCTREEFILE_H
+#define POINTOCTREEFILE_H
+
+#include <QFile>
+#include <QTemporaryFile>
+#include <QVector>
+#include <QVector3D>
+#include <QRgb>
+
+#include "gl_pointsprites.h"
+
+// Tiled octree file, little-endian:
+//   OctreeFileHeader | node payloads | OctreeFileNode[nodeCount]
+// A node payload is SpriteVertex[count] quantized inside the node cube, so it
+// is uploaded to the GPU straight from the mapping. Every node keeps a grid
+// subsample of its points, the rest go to the children (additive LOD): drawing
+// a node together with its ancestors gives all points of its cube.
+struct OctreeFileHeader {
+    char magic[4];              // "POCT"
+    quint32 version;
+    quint32 nodeCount;
+    quint32 reserved;
+    float min[3];               // cube of the root
+    float size;
+    quint64 pointCount;
+    quint64 nodeTableOffset;
+};
+
+struct OctreeFileNode {
+    float min[3];
+    float size;
+    float spacing;              // grid cell of the subsample, the error of drawing the node without children
+    quint32 count;
+    quint64 offset;             // SpriteVertex[count]
+    qint32 children[8];         // -1 - no child; bit 0 - x, bit 1 - y, bit 2 - z
+};
+
+// Offline builder. Points are spilled to a temporary file by add(), build()
+// partitions them node by node through temporary files, so memory does not
+// depend on the dataset size.
+class PointOctreeBuilder
+{
+public:
+    enum {
+        LeafPoints = 65536,     // a node with fewer points is not split
+        GridSize = 64,          // subsample grid of a node, GridSize^3 cells
+        MaxDepth = 20
+    };
+
+    explicit PointOctreeBuilder(float pointSize = 2.0f);
+    ~PointOctreeBuilder();
+
+    bool add(const float *xyz, const QRgb *colors, int count);     // colors may be null - white
+    bool build(const QString &path);
+
+    quint64 count() const { return fCount; }
+    int nodeCount() const { return fNodes.count(); }
+    QString errorString() const { return fError; }
+
+private:
+    struct Record {
+        float x, y, z;
+        QRgb color;
+    };
+
+    QTemporaryFile fSpill;
+    quint64 fCount;
+    float fMin[3];
+    float fMax[3];
+    float fPointSize;
+    QVector<OctreeFileNode> fNodes;
+    QString fError;
+
+    int buildNode(QFile *input, quint64 count, const float *min, float size, int depth, QFile &output);
+    bool writePayload(QFile &output, const QVector<Record> &records, const float *min, float size, OctreeFileNode &node);
+};
+
+// Read-only view of an octree file mapped into memory.
+class PointOctree
+{
+public:
+    enum {
+        Version = 1
+    };
+
+    PointOctree();
+    ~PointOctree() { close(); }
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return fHeader != nullptr; }
+
+    int nodeCount() const { return fHeader ? int(fHeader->nodeCount) : 0; }
+    quint64 pointCount() const { return fHeader ? fHeader->pointCount : 0; }
+    QVector3D boundsMin() const;
+    float boundsSize() const { return fHeader ? fHeader->size : 0.0f; }
+
+    const OctreeFileNode &node(int index) const { return fNodes[index]; }
+    const SpriteVertex *payload(int index) const { return reinterpret_cast<const SpriteVertex*>(fMap + fNodes[index].offset); }
+
+private:
+    QFile fFile;
+    uchar *fMap;
+    const OctreeFileHeader *fHeader;
+    const OctreeFileNode *fNodes;
+
+    Q_DISABLE_COPY(PointOctree)
+};
+
+#endif // POINTOCTREEFILE_H
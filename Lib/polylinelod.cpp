@@ -0,0 +1,132 @@
+#include "polylinelod.h"
+
+#include <algorithm>
+
+static float segmentDistance(const float *p, const float *a, const float *b)
+{
+    const QVector3D ab(b[0] - a[0], b[1] - a[1], b[2] - a[2]);
+    const QVector3D ap(p[0] - a[0], p[1] - a[1], p[2] - a[2]);
+    const float length = QVector3D::dotProduct(ab, ab);
+    const float t = length > 0.0f ? qBound(0.0f, QVector3D::dotProduct(ap, ab) / length, 1.0f) : 0.0f;
+    return (ap - ab * t).length();
+}
+
+PolylineLod::PolylineLod()
+{
+    fLevels.append(Level());
+}
+
+void PolylineLod::append(const float *xyz, int n)
+{
+    if (n <= 0)
+        return;
+
+    Level &base = fLevels[0];
+    if (!base.points())
+        fMin = fMax = QVector3D(xyz[0], xyz[1], xyz[2]);
+    for (int i = 0; i < n; i++) {
+        const float *p = xyz + i * 3;
+        fMin = QVector3D(qMin(fMin.x(), p[0]), qMin(fMin.y(), p[1]), qMin(fMin.z(), p[2]));
+        fMax = QVector3D(qMax(fMax.x(), p[0]), qMax(fMax.y(), p[1]), qMax(fMax.z(), p[2]));
+    }
+
+    const int size = base.xyz.count();
+    base.xyz.resize(size + n * 3);
+    std::copy(xyz, xyz + n * 3, base.xyz.data() + size);
+
+    // готовые корзины поднимаются по уровням каскадом
+    for (int level = 0; level < fLevels.count() && level + 1 < MaxLevels; level++)
+        reduce(level);
+}
+
+void PolylineLod::clear()
+{
+    fLevels.clear();
+    fLevels.append(Level());
+    fMin = fMax = QVector3D();
+}
+
+void PolylineLod::reduce(int level)
+{
+    if (fLevels[level].points() - fLevels[level].consumed < BucketSize)
+        return;
+    if (level + 1 == fLevels.count()) {
+        fLevels.append(Level());
+        fLevels.last().error = fLevels[level].error;
+    }
+
+    Level &source = fLevels[level];
+    Level &target = fLevels[level + 1];
+    float localError = 0.0f;
+
+    while (source.points() - source.consumed >= BucketSize) {
+        const int first = source.consumed;
+        const float *bucket = source.xyz.constData() + first * 3;
+
+        int keep[8] = { 0, BucketSize - 1, 0, 0, 0, 0, 0, 0 };
+        for (int axis = 0; axis < 3; axis++) {
+            int lo = 0;
+            int hi = 0;
+            for (int i = 1; i < BucketSize; i++) {
+                if (bucket[i * 3 + axis] < bucket[lo * 3 + axis])
+                    lo = i;
+                if (bucket[i * 3 + axis] > bucket[hi * 3 + axis])
+                    hi = i;
+            }
+            keep[2 + axis * 2] = lo;
+            keep[3 + axis * 2] = hi;
+        }
+        std::sort(keep, keep + 8);
+        const int kept = int(std::unique(keep, keep + 8) - keep);
+
+        // отброшенные точки лежат между соседними оставленными
+        for (int k = 0; k + 1 < kept; k++) {
+            for (int i = keep[k] + 1; i < keep[k + 1]; i++)
+                localError = qMax(localError, segmentDistance(bucket + i * 3, bucket + keep[k] * 3, bucket + keep[k + 1] * 3));
+        }
+
+        const int size = target.xyz.count();
+        target.xyz.resize(size + kept * 3);
+        float *out = target.xyz.data() + size;
+        for (int k = 0; k < kept; k++, out += 3)
+            std::copy(bucket + keep[k] * 3, bucket + keep[k] * 3 + 3, out);
+
+        source.consumed += BucketSize;
+    }
+
+    // ошибки уровней складываются: уровень строится из предыдущего, а не из исходных точек
+    target.error = qMax(target.error, source.error + localError);
+}
+
+int PolylineLod::pickLevel(float maxError) const
+{
+    int level = 0;
+    for (int k = 1; k < fLevels.count(); k++) {
+        if (fLevels[k].error > maxError || !fLevels[k].points())
+            break;
+        level = k;
+    }
+    return level;
+}
+
+void PolylineLod::ranges(int level, QVector<Range> &out) const
+{
+    out.clear();
+    level = qBound(0, level, fLevels.count() - 1);
+
+    Range range;
+    range.level = level;
+    range.first = 0;
+    range.count = fLevels[level].points();
+    if (range.count > 0)
+        out.append(range);
+
+    for (int k = level - 1; k >= 0; k--) {
+        const Level &finer = fLevels[k];
+        range.level = k;
+        range.first = qMax(0, finer.consumed - 1);
+        range.count = finer.points() - range.first;
+        if (range.count > 1 || (range.count == 1 && out.isEmpty()))
+            out.append(range);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef POLYLINELOD_H
+#define POLYLINELOD_H
+
+#include <QVector>
+#include <QVector3D>
+
+// Multi-resolution polyline built while points are appended. Level 0 holds
+// all points. Every complete bucket of BucketSize points of level k gives up
+// to eight points of level k + 1: the bucket's first and last points and the
+// points with the minimum and maximum x, y and z, in their original order.
+// Axis extremes of each bucket therefore survive on every level. The error of
+// a level is an upper bound of the distance from any level 0 point to the
+// level's polyline.
+class PolylineLod
+{
+public:
+    enum {
+        BucketSize = 32,
+        MaxLevels = 8
+    };
+
+    // часть уровня, которую надо нарисовать ломаной
+    struct Range {
+        int level;
+        int first;
+        int count;
+    };
+
+    PolylineLod();
+
+    void append(const float *xyz, int n);
+    void clear();
+
+    int count() const { return fLevels[0].points(); }
+    int levelCount() const { return fLevels.count(); }
+    int levelPoints(int level) const { return fLevels[level].points(); }
+    const float *levelData(int level) const { return fLevels[level].xyz.constData(); }
+    float error(int level) const { return fLevels[level].error; }
+    QVector3D boundsMin() const { return fMin; }
+    QVector3D boundsMax() const { return fMax; }
+
+    int pickLevel(float maxError) const;    // coarsest level with error <= maxError
+    // level as a whole and the tails of finer levels not yet reduced into it;
+    // consecutive ranges share their joint point, each tail is shorter than BucketSize + 1
+    void ranges(int level, QVector<Range> &out) const;
+
+private:
+    struct Level {
+        QVector<float> xyz;
+        int consumed;       // points grouped into buckets of the next level
+        float error;
+        Level() : consumed(0), error(0.0f) {}
+        int points() const { return xyz.count() / 3; }
+    };
+
+    QVector<Level> fLevels;
+    QVector3D fMin;
+    QVector3D fMax;
+
+    void reduce(int level);
+};
+
+#endif // POLYLINELOD_H
@@ -0,0 +1,10 @@
+#version 120
+uniform vec3 color;
+varying float fade;
+
+void main(void)
+{
+	if (fade <= 0.0)
+		discard;
+	gl_FragColor = vec4(color, fade);
+}
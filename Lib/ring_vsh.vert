@@ -0,0 +1,13 @@
+#version 120
+attribute vec4 qt_Vertex;   // xyz, w - time of the point
+uniform mat4 Matrix;
+uniform float now;
+uniform float window;
+varying float fade;
+
+void main(void)
+{
+	float age = now - qt_Vertex.w;
+	fade = 1.0 - clamp(age / window, 0.0, 1.0);
+	gl_Position = Matrix * vec4( qt_Vertex.xyz, 1.0 );
+}
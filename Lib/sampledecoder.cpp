@@ -0,0 +1,210 @@
+#include "sampledecoder.h"
+
+#include <QtEndian>
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DECODER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DECODER_SSE2
+#endif
+
+#define SYNC_LOW 0x5A
+#define SYNC_HIGH 0xA5
+
+// crcTable[k][v] - crc байта v, за которым следуют k нулевых байтов
+static quint16 crcTable[8][256];
+
+static bool initCrcTable()
+{
+    for (int i = 0; i < 256; i++) {
+        quint16 crc = quint16(i << 8);
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 0x8000) ? quint16((crc << 1) ^ 0x1021) : quint16(crc << 1);
+        crcTable[0][i] = crc;
+    }
+    for (int k = 1; k < 8; k++)
+        for (int i = 0; i < 256; i++)
+            crcTable[k][i] = quint16((crcTable[k - 1][i] << 8) ^ crcTable[0][crcTable[k - 1][i] >> 8]);
+    return true;
+}
+
+static const bool crcTableReady = initCrcTable();
+
+Q_STATIC_ASSERT(sizeof(QVector3D) == SampleDecoder::PointSize);
+
+SampleDecoder::SampleDecoder() : fFrames(0), fCrcErrors(0), fSkippedBytes(0)
+{
+    Q_UNUSED(crcTableReady);
+}
+
+void SampleDecoder::reset()
+{
+    fPending.clear();
+    fFrames = 0;
+    fCrcErrors = 0;
+    fSkippedBytes = 0;
+}
+
+quint16 SampleDecoder::crc16(const uchar *data, int size)
+{
+    quint16 crc = 0xFFFF;
+    while (size >= 8) {
+        crc = crcTable[7][data[0] ^ (crc >> 8)] ^ crcTable[6][data[1] ^ (crc & 0xFF)]
+            ^ crcTable[5][data[2]] ^ crcTable[4][data[3]] ^ crcTable[3][data[4]]
+            ^ crcTable[2][data[5]] ^ crcTable[1][data[6]] ^ crcTable[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0)
+        crc = quint16((crc << 8) ^ crcTable[0][((crc >> 8) ^ *data++) & 0xFF]);
+    return crc;
+}
+
+int SampleDecoder::findSync(const uchar *data, int size)
+{
+    int i = 0;
+#if defined(DECODER_AVX2)
+    const __m256i low = _mm256_set1_epi8(char(SYNC_LOW));
+    const __m256i high = _mm256_set1_epi8(char(SYNC_HIGH));
+    for (; i + 33 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+        quint32 mask = quint32(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, low), _mm256_cmpeq_epi8(b, high))));
+        if (mask)
+            return i + int(qCountTrailingZeroBits(mask));
+    }
+#elif defined(DECODER_SSE2)
+    const __m128i low = _mm_set1_epi8(char(SYNC_LOW));
+    const __m128i high = _mm_set1_epi8(char(SYNC_HIGH));
+    for (; i + 17 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        quint32 mask = quint32(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, low), _mm_cmpeq_epi8(b, high))));
+        if (mask)
+            return i + int(qCountTrailingZeroBits(mask));
+    }
+#endif
+    for (; i + 1 < size; i++) {
+        if (data[i] == SYNC_LOW && data[i + 1] == SYNC_HIGH)
+            return i;
+    }
+    return qMax(0, size - 1);
+}
+
+QByteArray SampleDecoder::encodeFrame(const QVector3D *points, int count)
+{
+    count = qBound(0, count, int(MaxFramePoints));
+
+    QByteArray frame(HeaderSize + count * PointSize + CrcSize, Qt::Uninitialized);
+    uchar *p = reinterpret_cast<uchar*>(frame.data());
+    qToLittleEndian<quint16>(SyncWord, p);
+    qToLittleEndian<quint16>(quint16(count), p + 2);
+
+    uchar *v = p + HeaderSize;
+    for (int i = 0; i < count; i++) {
+        const float xyz[3] = { points[i].x(), points[i].y(), points[i].z() };
+        for (int k = 0; k < 3; k++) {
+            quint32 bits;
+            memcpy(&bits, &xyz[k], sizeof(bits));
+            qToLittleEndian<quint32>(bits, v);
+            v += 4;
+        }
+    }
+
+    qToLittleEndian<quint16>(crc16(p + 2, 2 + count * PointSize), v);
+    return frame;
+}
+
+int SampleDecoder::pendingNeed() const
+{
+    if (fPending.size() < HeaderSize)
+        return HeaderSize - fPending.size();
+
+    // хвост начинается с правильного заголовка, иначе parse() его бы пропустил
+    const int count = qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(fPending.constData()) + 2);
+    return HeaderSize + count * PointSize + CrcSize - fPending.size();
+}
+
+int SampleDecoder::feed(const char *data, int size, QVector<QVector3D> &points)
+{
+    int decoded = 0;
+    int pos = 0;
+
+    // хвост прошлого вызова дополняется только до конца своего кадра
+    while (!fPending.isEmpty() && pos < size) {
+        const int take = qMin(pendingNeed(), size - pos);
+        fPending.append(data + pos, take);
+        pos += take;
+        int used = parse(reinterpret_cast<const uchar*>(fPending.constData()), fPending.size(), points, &decoded);
+        fPending.remove(0, used);
+    }
+
+    // остальное разбирается прямо из входного буфера
+    if (pos < size) {
+        int used = parse(reinterpret_cast<const uchar*>(data + pos), size - pos, points, &decoded);
+        pos += used;
+        if (pos < size)
+            fPending.append(data + pos, size - pos);
+    }
+    return decoded;
+}
+
+int SampleDecoder::parse(const uchar *data, int size, QVector<QVector3D> &points, int *decoded)
+{
+    int pos = 0;
+    while (size - pos >= HeaderSize) {
+        const uchar *p = data + pos;
+        if (p[0] != SYNC_LOW || p[1] != SYNC_HIGH) {
+            const int skip = qMax(1, findSync(p, size - pos));
+            pos += skip;
+            fSkippedBytes += skip;
+            continue;
+        }
+
+        const int count = qFromLittleEndian<quint16>(p + 2);
+        if (count == 0 || count > MaxFramePoints) {
+            pos++;
+            fSkippedBytes++;
+            continue;
+        }
+
+        const int frameSize = HeaderSize + count * PointSize + CrcSize;
+        if (size - pos < frameSize)
+            break;      // ждём остаток кадра
+
+        if (crc16(p + 2, 2 + count * PointSize) != qFromLittleEndian<quint16>(p + frameSize - CrcSize)) {
+            fCrcErrors++;
+            pos++;
+            fSkippedBytes++;
+            continue;
+        }
+
+        const uchar *v = p + HeaderSize;
+        const int first = points.size();
+        points.resize(first + count);
+        QVector3D *dst = points.data() + first;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        // QVector3D - три float подряд, кадр копируется целиком
+        memcpy(dst, v, size_t(count) * PointSize);
+#else
+        for (int i = 0; i < count; i++) {
+            float xyz[3];
+            for (int k = 0; k < 3; k++) {
+                quint32 bits = qFromLittleEndian<quint32>(v);
+                memcpy(&xyz[k], &bits, sizeof(bits));
+                v += 4;
+            }
+            dst[i] = QVector3D(xyz[0], xyz[1], xyz[2]);
+        }
+#endif
+
+        *decoded += count;
+        fFrames++;
+        pos += frameSize;
+    }
+    return pos;
+}
@@ -0,0 +1,49 @@
+#ifndef SAMPLEDECODER_H
+#define SAMPLEDECODER_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QVector3D>
+
+// Decoder of the instrument sample stream. Frame layout, little-endian:
+//   quint16 sync (0xA55A) | quint16 count | count * float[3] (x, y, z) | quint16 crc
+// crc is CRC-16/CCITT-FALSE of the count and point fields. Garbage between
+// frames and frames with a bad crc are skipped, the search restarts at the next byte.
+// The sync search uses SSE2 (AVX2 when the build enables it), the crc is computed
+// by slicing-by-8 and points are copied straight into the output vector.
+class SampleDecoder
+{
+public:
+    enum {
+        SyncWord = 0xA55A,
+        HeaderSize = 4,
+        CrcSize = 2,
+        PointSize = 12,
+        MaxFramePoints = 1024
+    };
+
+    SampleDecoder();
+
+    // decodes all complete frames, incomplete tail is kept until the next call
+    int feed(const char *data, int size, QVector<QVector3D> &points);   // number of decoded points
+    void reset();
+
+    quint64 frames() const { return fFrames; }
+    quint64 crcErrors() const { return fCrcErrors; }
+    quint64 skippedBytes() const { return fSkippedBytes; }
+
+    static quint16 crc16(const uchar *data, int size);
+    static int findSync(const uchar *data, int size);   // offset of the first sync word, size - 1 if none
+    static QByteArray encodeFrame(const QVector3D *points, int count);   // for simulators and loopback checks
+
+private:
+    QByteArray fPending;
+    quint64 fFrames;
+    quint64 fCrcErrors;
+    quint64 fSkippedBytes;
+
+    int parse(const uchar *data, int size, QVector<QVector3D> &points, int *decoded);   // returns consumed bytes
+    int pendingNeed() const;
+};
+
+#endif // SAMPLEDECODER_H
@@ -0,0 +1,219 @@
+#include "scenerenderer.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QDebug>
+
+SceneRenderWorker::SceneRenderWorker(SceneRenderer *renderer, QOpenGLContext *shareContext, ThreadedScene::DataPainter painter) :
+    fRenderer(renderer), fShareContext(shareContext), fMsaaFbo(nullptr)
+{
+    QSurfaceFormat format = shareContext->format();
+    fSamples = qMax(0, format.samples());
+    fScene = new ThreadedScene(format, painter);
+}
+
+SceneRenderWorker::~SceneRenderWorker()
+{
+    delete fScene;
+}
+
+void SceneRenderWorker::initialize()
+{
+    if (!fScene->initialize(fShareContext)) {
+        qDebug() << "SceneRenderWorker: cannot initialize render context";
+        return;
+    }
+    initializeOpenGLFunctions();
+}
+
+void SceneRenderWorker::renderPending()
+{
+    BaseSceneCore::ViewState state;
+    QSize size;
+    int target;
+    GLsync consumed;
+    {
+        QMutexLocker locker(&fRenderer->fMutex);
+        fRenderer->fScheduled = false;
+        if (!fRenderer->fHasPending || fRenderer->fStopping)
+            return;
+
+        state = fRenderer->fPending;
+        size = fRenderer->fPendingSize;
+        fRenderer->fHasPending = false;
+
+        // рисуем в буфер, который не показан; виджет может ещё композитить его
+        target = fRenderer->fFront == 0 ? 1 : 0;
+        while (fRenderer->fInUse == target && !fRenderer->fStopping)
+            fRenderer->fReleased.wait(&fRenderer->fMutex);
+        if (fRenderer->fStopping)
+            return;
+
+        consumed = fRenderer->fBuffers[target].consumed;
+        fRenderer->fBuffers[target].consumed = nullptr;
+    }
+
+    if (!fScene->isInitialized() || !fScene->makeCurrent())
+        return;
+
+    SceneRenderer::Buffer &buffer = fRenderer->fBuffers[target];
+    if (consumed) {
+        glWaitSync(consumed, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(consumed);
+    }
+    if (buffer.rendered) {
+        glDeleteSync(buffer.rendered);
+        buffer.rendered = nullptr;
+    }
+
+    if (buffer.size != size) {
+        delete buffer.fbo;
+        QOpenGLFramebufferObjectFormat format;
+        format.setAttachment(fSamples > 0 ? QOpenGLFramebufferObject::NoAttachment : QOpenGLFramebufferObject::CombinedDepthStencil);
+        buffer.fbo = new QOpenGLFramebufferObject(size, format);
+        buffer.texture = buffer.fbo->texture();
+        buffer.size = size;
+    }
+
+    fScene->setViewState(state);
+    if (fSamples > 0) {
+        if (!fMsaaFbo || fMsaaFbo->size() != size) {
+            delete fMsaaFbo;
+            QOpenGLFramebufferObjectFormat format;
+            format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+            format.setSamples(fSamples);
+            fMsaaFbo = new QOpenGLFramebufferObject(size, format);
+        }
+        fScene->renderToFramebuffer(fMsaaFbo);
+        QOpenGLFramebufferObject::blitFramebuffer(buffer.fbo, fMsaaFbo);
+    }
+    else
+        fScene->renderToFramebuffer(buffer.fbo);
+
+    if (fRenderer->fSync) {
+        buffer.rendered = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+    }
+    else
+        glFinish();
+
+    {
+        QMutexLocker locker(&fRenderer->fMutex);
+        fRenderer->fFront = target;
+        fRenderer->fRenderedFrames++;
+    }
+    emit fRenderer->frameReady();
+}
+
+void SceneRenderWorker::release()
+{
+    if (!fScene->makeCurrent())
+        return;
+
+    for (int i = 0; i < 2; i++) {
+        SceneRenderer::Buffer &buffer = fRenderer->fBuffers[i];
+        if (buffer.rendered)
+            glDeleteSync(buffer.rendered);
+        if (buffer.consumed)
+            glDeleteSync(buffer.consumed);
+        delete buffer.fbo;
+        buffer = SceneRenderer::Buffer();
+    }
+    delete fMsaaFbo;
+    fMsaaFbo = nullptr;
+
+    fScene->release();
+}
+
+SceneRenderer::SceneRenderer(QOpenGLContext *shareContext, ThreadedScene::DataPainter painter, QObject *parent) : QObject(parent),
+    fFront(-1), fInUse(-1), fStopping(false), fScheduled(false), fHasPending(false), fRenderedFrames(0), fMergedSnapshots(0)
+{
+    fGL = shareContext->extraFunctions();
+
+    QSurfaceFormat f = shareContext->format();
+    fSync = shareContext->isOpenGLES() ? f.version() >= qMakePair(3, 0)
+                                       : (f.version() >= qMakePair(3, 2) || shareContext->hasExtension("GL_ARB_sync"));
+
+    fWorker = new SceneRenderWorker(this, shareContext, painter);
+    fWorker->moveToThread(&fThread);
+    connect(&fThread, SIGNAL(started()), fWorker, SLOT(initialize()));
+    fThread.start();
+}
+
+SceneRenderer::~SceneRenderer()
+{
+    {
+        QMutexLocker locker(&fMutex);
+        fStopping = true;
+        fReleased.wakeAll();
+    }
+    QMetaObject::invokeMethod(fWorker, "release", Qt::BlockingQueuedConnection);
+    fThread.quit();
+    fThread.wait();
+    delete fWorker;
+}
+
+void SceneRenderer::render(const BaseSceneCore::ViewState &state, const QSize &size)
+{
+    if (size.isEmpty())
+        return;
+
+    QMutexLocker locker(&fMutex);
+    if (fHasPending)
+        fMergedSnapshots++;
+    fPending = state;
+    fPendingSize = size;
+    fHasPending = true;
+
+    if (!fScheduled) {
+        fScheduled = true;
+        QMetaObject::invokeMethod(fWorker, "renderPending", Qt::QueuedConnection);
+    }
+}
+
+GLuint SceneRenderer::acquireFrame(QSize *size)
+{
+    QMutexLocker locker(&fMutex);
+    if (fFront < 0)
+        return 0;
+
+    Buffer &buffer = fBuffers[fFront];
+    fInUse = fFront;
+    if (buffer.rendered)
+        fGL->glWaitSync(buffer.rendered, 0, GL_TIMEOUT_IGNORED);
+    if (size)
+        *size = buffer.size;
+    return buffer.texture;
+}
+
+void SceneRenderer::releaseFrame()
+{
+    QMutexLocker locker(&fMutex);
+    if (fInUse < 0)
+        return;
+
+    Buffer &buffer = fBuffers[fInUse];
+    if (fSync) {
+        if (buffer.consumed)
+            fGL->glDeleteSync(buffer.consumed);
+        buffer.consumed = fGL->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        fGL->glFlush();
+    }
+    else
+        fGL->glFinish();
+
+    fInUse = -1;
+    fReleased.wakeAll();
+}
+
+quint64 SceneRenderer::renderedFrames() const
+{
+    QMutexLocker locker(&fMutex);
+    return fRenderedFrames;
+}
+
+quint64 SceneRenderer::mergedSnapshots() const
+{
+    QMutexLocker locker(&fMutex);
+    return fMergedSnapshots;
+}
@@ -0,0 +1,108 @@
+#ifndef SCENERENDERER_H
+#define SCENERENDERER_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QOpenGLExtraFunctions>
+#include <functional>
+
+#include "offscreenscene3d.h"
+
+class QOpenGLFramebufferObject;
+class SceneRenderer;
+
+// Offscreen scene of the render thread, data painting is forwarded to the owner.
+class ThreadedScene : public OffscreenScene3D
+{
+public:
+    typedef std::function<void(const QMatrix4x4 &)> DataPainter;
+
+    ThreadedScene(const QSurfaceFormat &format, DataPainter painter) : OffscreenScene3D(format), fDataPainter(painter) {}
+
+protected:
+    void paintData(const QMatrix4x4 &pmvMatrix) override { if (fDataPainter) fDataPainter(pmvMatrix); }
+
+private:
+    DataPainter fDataPainter;
+};
+
+// Lives on the render thread, its context shares textures with the widget.
+class SceneRenderWorker : public QObject, protected QOpenGLExtraFunctions
+{
+    Q_OBJECT
+public:
+    SceneRenderWorker(SceneRenderer *renderer, QOpenGLContext *shareContext, ThreadedScene::DataPainter painter);  // GUI thread
+    ~SceneRenderWorker();                                                                                          // GUI thread, after release()
+
+public slots:
+    void initialize();
+    void renderPending();
+    void release();
+
+private:
+    SceneRenderer *fRenderer;
+    QOpenGLContext *fShareContext;
+    ThreadedScene *fScene;
+    QOpenGLFramebufferObject *fMsaaFbo;
+    int fSamples;
+};
+
+// Renders the scene on a dedicated thread into a pair of textures shared with
+// the widget context. The widget posts view snapshots with render() and
+// composites the latest finished texture, so a slow frame delays the picture
+// but not the UI. Snapshots posted while a frame is rendered are merged,
+// only the latest one is drawn.
+class SceneRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    // GUI thread, shareContext must be current
+    SceneRenderer(QOpenGLContext *shareContext, ThreadedScene::DataPainter painter, QObject *parent = nullptr);
+    ~SceneRenderer();
+
+    void render(const BaseSceneCore::ViewState &state, const QSize &size);
+
+    // GUI thread, widget context current
+    GLuint acquireFrame(QSize *size = nullptr);   // 0 - no frame yet
+    void releaseFrame();
+
+    quint64 renderedFrames() const;
+    quint64 mergedSnapshots() const;
+
+signals:
+    void frameReady();
+
+private:
+    friend class SceneRenderWorker;
+
+    struct Buffer {
+        QOpenGLFramebufferObject *fbo;  // created and deleted on the render thread
+        GLuint texture;
+        QSize size;
+        GLsync rendered;    // the render thread has finished the frame
+        GLsync consumed;    // the widget has finished compositing it
+        Buffer() : fbo(nullptr), texture(0), rendered(nullptr), consumed(nullptr) {}
+    };
+
+    QOpenGLExtraFunctions *fGL;   // widget context
+    bool fSync;
+    QThread fThread;
+    SceneRenderWorker *fWorker;
+
+    mutable QMutex fMutex;
+    QWaitCondition fReleased;
+    Buffer fBuffers[2];
+    int fFront;         // last finished buffer, -1 - none
+    int fInUse;         // buffer composited by the widget, -1 - none
+    bool fStopping;
+    bool fScheduled;    // renderPending() is posted to the render thread
+    bool fHasPending;
+    BaseSceneCore::ViewState fPending;
+    QSize fPendingSize;
+    quint64 fRenderedFrames;
+    quint64 fMergedSnapshots;
+};
+
+#endif // SCENERENDERER_H
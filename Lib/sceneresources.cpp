@@ -0,0 +1,113 @@
+#include "sceneresources.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLTexture>
+#include <QSurface>
+
+QMutex SceneResources::sGroupsMutex;
+QHash<QOpenGLContextGroup*, SceneResources*> SceneResources::sGroups;
+QSet<QOpenGLContext*> SceneResources::sContexts;
+
+ScaleLabelSet::~ScaleLabelSet()
+{
+    for (int i = 0; i < ltCount; i++) {
+        if (textures[i]) {
+            textures[i]->destroy();
+            delete textures[i];
+        }
+    }
+}
+
+SceneResources *SceneResources::current()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return nullptr;
+
+    QOpenGLContextGroup *group = ctx->shareGroup();
+    QMutexLocker locker(&sGroupsMutex);
+    SceneResources *resources = sGroups.value(group);
+    if (!resources) {
+        resources = new SceneResources();
+        sGroups.insert(group, resources);
+        QObject::connect(group, &QObject::destroyed, [group]() { groupDestroyed(group); });
+    }
+    if (!sContexts.contains(ctx)) {
+        sContexts.insert(ctx);
+        QObject::connect(ctx, &QOpenGLContext::aboutToBeDestroyed, [ctx]() { contextDestroying(ctx); });
+    }
+    return resources;
+}
+
+void SceneResources::destroyAll()
+{
+    QMutexLocker locker(&fMutex);
+    while (!fEntries.isEmpty()) {
+        // деструктор записи может освобождать другие записи
+        QHash<QByteArray, Entry>::iterator it = fEntries.begin();
+        Entry entry = it.value();
+        fEntries.erase(it);
+        entry.destroy(entry.resource);
+    }
+}
+
+void SceneResources::contextDestroying(QOpenGLContext *ctx)
+{
+    QOpenGLContextGroup *group = ctx->shareGroup();
+    SceneResources *resources;
+    {
+        // контекст ещё в группе: последний - когда он один
+        QMutexLocker locker(&sGroupsMutex);
+        resources = group->shares().count() <= 1 ? sGroups.value(group) : nullptr;
+    }
+
+    if (resources) {
+        // оставшиеся записи удаляются, пока объекты GL группы ещё живы
+        QSurface *surface = ctx->surface();
+        if (QOpenGLContext::currentContext() != ctx && surface)
+            ctx->makeCurrent(surface);
+        resources->destroyAll();
+    }
+
+    QMutexLocker locker(&sGroupsMutex);
+    sContexts.remove(ctx);
+    if (resources)
+        delete sGroups.take(group);
+}
+
+void SceneResources::groupDestroyed(QOpenGLContextGroup *group)
+{
+    // группа без отслеженного контекста: объекты GL ушли вместе с ней, удаляются только обёртки
+    QMutexLocker locker(&sGroupsMutex);
+    delete sGroups.take(group);
+}
+
+void SceneResources::release(const QByteArray &key)
+{
+    if (key.isEmpty())
+        return;
+
+    QMutexLocker locker(&fMutex);
+    QHash<QByteArray, Entry>::iterator it = fEntries.find(key);
+    if (it == fEntries.end())
+        return;
+
+    if (--it->refs > 0)
+        return;
+
+    Entry entry = it.value();
+    fEntries.erase(it);
+    entry.destroy(entry.resource);
+}
+
+int SceneResources::refCount(const QByteArray &key) const
+{
+    QMutexLocker locker(&fMutex);
+    return fEntries.value(key).refs;
+}
+
+int SceneResources::count() const
+{
+    QMutexLocker locker(&fMutex);
+    return fEntries.count();
+}
@@ -0,0 +1,91 @@
+#ifndef SCENERESOURCES_H
+#define SCENERESOURCES_H
+
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QByteArray>
+#include <functional>
+
+class QOpenGLContext;
+class QOpenGLContextGroup;
+class QOpenGLTexture;
+
+// Label textures of one scale: right, left, inverse right, inverse left.
+// The Z scale uses only the first two.
+struct ScaleLabelSet {
+    enum {
+        ltRight,
+        ltLeft,
+        ltInverseRight,
+        ltInverseLeft,
+        ltCount
+    };
+
+    QOpenGLTexture *textures[ltCount];
+    ScaleLabelSet() { for (int i = 0; i < ltCount; i++) textures[i] = nullptr; }
+    ~ScaleLabelSet();
+};
+
+// Reference counted GL resources of one context share group.
+// With Qt::AA_ShareOpenGLContexts all scene widgets are in one group, so
+// programs, axis meshes and scale labels with equal keys are created once.
+// acquire() and release() must be called with a context of the group current.
+// Entries still referenced when the last context of the group is destroyed are
+// destroyed with that context made current.
+class SceneResources
+{
+public:
+    static SceneResources *current();   // registry of the current context's share group
+
+    template <typename T>
+    T *acquire(const QByteArray &key, std::function<T*()> create)
+    {
+        QMutexLocker locker(&fMutex);
+        QHash<QByteArray, Entry>::iterator it = fEntries.find(key);
+        if (it != fEntries.end()) {
+            it->refs++;
+            return static_cast<T*>(it->resource);
+        }
+
+        T *resource = create();
+        if (!resource)
+            return nullptr;
+
+        Entry entry;
+        entry.resource = resource;
+        entry.destroy = [](void *p) { delete static_cast<T*>(p); };
+        entry.refs = 1;
+        fEntries.insert(key, entry);
+        return resource;
+    }
+
+    void release(const QByteArray &key);
+    int refCount(const QByteArray &key) const;
+    int count() const;
+
+private:
+    struct Entry {
+        void *resource;
+        std::function<void(void*)> destroy;
+        int refs;
+        Entry() : resource(nullptr), refs(0) {}
+    };
+
+    SceneResources() : fMutex(QMutex::Recursive) {}
+    ~SceneResources() { destroyAll(); }
+    Q_DISABLE_COPY(SceneResources)
+
+    mutable QMutex fMutex;
+    QHash<QByteArray, Entry> fEntries;
+
+    void destroyAll();      // remaining entries, whatever their references
+
+    static QMutex sGroupsMutex;
+    static QHash<QOpenGLContextGroup*, SceneResources*> sGroups;
+    static QSet<QOpenGLContext*> sContexts;     // contexts whose destruction is watched
+    static void contextDestroying(QOpenGLContext *ctx);
+    static void groupDestroyed(QOpenGLContextGroup *group);
+};
+
+#endif // SCENERESOURCES_H
@@ -0,0 +1,222 @@
+#include "serialingest.h"
+
+#include <QTimer>
+#include <QDebug>
+
+#define READ_CHUNK_SIZE (64 * 1024)
+#define PORT_BUFFER_SIZE (1024 * 1024)
+#define RETRY_INTERVAL 1 // ms
+
+SerialReader::SerialReader(SerialIngest *ingest) : fIngest(ingest), fPort(nullptr), fBatch(nullptr), fBatchNumber(0)
+{
+    fReadBuffer.resize(READ_CHUNK_SIZE);
+
+    fRetryTimer = new QTimer(this);
+    fRetryTimer->setSingleShot(true);
+    fRetryTimer->setInterval(RETRY_INTERVAL);
+    connect(fRetryTimer, SIGNAL(timeout()), this, SLOT(readAvailable()));
+}
+
+bool SerialReader::open(const QString &portName, qint32 baudRate)
+{
+    close();
+
+    fPort = new QSerialPort(portName, this);
+    fPort->setBaudRate(baudRate);
+    fPort->setDataBits(QSerialPort::Data8);
+    fPort->setParity(QSerialPort::NoParity);
+    fPort->setStopBits(QSerialPort::OneStop);
+    fPort->setFlowControl(QSerialPort::HardwareControl);
+    // при паузе данные остаются в драйвере, а не копятся в памяти процесса
+    fPort->setReadBufferSize(PORT_BUFFER_SIZE);
+
+    if (!fPort->open(QIODevice::ReadOnly)) {
+        emit fIngest->errorOccurred(fPort->errorString());
+        qDebug() << "SerialIngest: cannot open" << portName << fPort->errorString();
+        delete fPort;
+        fPort = nullptr;
+        return false;
+    }
+
+    fDecoder.reset();
+    fDropBatch.points.reserve(fIngest->fBatchSize);
+    connect(fPort, SIGNAL(readyRead()), this, SLOT(readAvailable()));
+    connect(fPort, SIGNAL(errorOccurred(QSerialPort::SerialPortError)), this, SLOT(portError(QSerialPort::SerialPortError)));
+    return true;
+}
+
+void SerialReader::close()
+{
+    fRetryTimer->stop();
+    if (!fPort)
+        return;
+
+    commitBatch();
+    fPort->close();
+    delete fPort;
+    fPort = nullptr;
+}
+
+bool SerialReader::startCapture(const QString &path)
+{
+    return fCapture.open(path);
+}
+
+void SerialReader::stopCapture()
+{
+    fCapture.close();
+}
+
+void SerialReader::readAvailable()
+{
+    if (!fPort)
+        return;
+
+    while (fPort->bytesAvailable() > 0) {
+        PointBatch *batch = fBatch;
+        if (!batch) {
+            batch = fIngest->fQueue.reserve();
+            if (batch) {
+                batch->points.clear();  // ёмкость сохраняется
+                batch->points.reserve(fIngest->fBatchSize);
+                fBatch = batch;
+            }
+            else if (fIngest->backpressure() == SerialIngest::bpPause) {
+                if (!fRetryTimer->isActive()) {
+                    fIngest->fPauses.fetchAndAddRelaxed(1);
+                    fRetryTimer->start();
+                }
+                return;
+            }
+            else {
+                fDropBatch.points.clear();
+                batch = &fDropBatch;
+            }
+        }
+
+        qint64 n = fPort->read(fReadBuffer.data(), fReadBuffer.size());
+        if (n <= 0)
+            break;
+        fIngest->fBytesRead.fetchAndAddRelaxed(quint64(n));
+
+        const int before = batch->points.count();
+        int decoded = fDecoder.feed(fReadBuffer.constData(), int(n), batch->points);
+        if (decoded > 0 && fCapture.isOpen())
+            fCapture.append(batch->points.constData() + before, decoded);
+        if (batch == &fDropBatch)
+            fIngest->fDroppedPoints.fetchAndAddRelaxed(quint64(decoded));
+        else if (batch->points.count() >= fIngest->fBatchSize)
+            commitBatch();
+    }
+
+    // неполный пакет отдаём сразу, чтобы не копить задержку
+    commitBatch();
+    updateDecoderStats();
+}
+
+void SerialReader::commitBatch()
+{
+    if (!fBatch || fBatch->points.isEmpty())
+        return;
+
+    fBatch->number = fBatchNumber++;
+    fIngest->fPoints.fetchAndAddRelaxed(quint64(fBatch->points.count()));
+    fIngest->fBatches.fetchAndAddRelaxed(1);
+    fBatch = nullptr;
+    fIngest->fQueue.commit();
+
+    if (fIngest->fNotified.testAndSetOrdered(0, 1))
+        emit fIngest->batchesReady();
+}
+
+void SerialReader::updateDecoderStats()
+{
+    fIngest->fFrames.storeRelease(fDecoder.frames());
+    fIngest->fCrcErrors.storeRelease(fDecoder.crcErrors());
+    fIngest->fSkippedBytes.storeRelease(fDecoder.skippedBytes());
+}
+
+void SerialReader::portError(QSerialPort::SerialPortError error)
+{
+    if (error == QSerialPort::NoError)
+        return;
+
+    qDebug() << "SerialIngest:" << fPort->errorString();
+    emit fIngest->errorOccurred(fPort->errorString());
+    if (error == QSerialPort::ResourceError)
+        close();    // устройство отключено
+}
+
+SerialIngest::SerialIngest(quint32 queueCapacity, int batchSize, QObject *parent) : QObject(parent),
+    fQueue(queueCapacity), fBatchSize(qMax(1, batchSize)), fBackpressure(bpDrop), fNotified(0),
+    fBytesRead(0), fFrames(0), fCrcErrors(0), fSkippedBytes(0), fPoints(0), fBatches(0), fDroppedPoints(0), fPauses(0)
+{
+    fReader = new SerialReader(this);
+    fReader->moveToThread(&fThread);
+    fThread.start();
+}
+
+SerialIngest::~SerialIngest()
+{
+    close();
+    stopCapture();
+    fThread.quit();
+    fThread.wait();
+    delete fReader;
+}
+
+bool SerialIngest::open(const QString &portName, qint32 baudRate)
+{
+    bool ok = false;
+    QMetaObject::invokeMethod(fReader, "open", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, ok),
+                              Q_ARG(QString, portName), Q_ARG(qint32, baudRate));
+    return ok;
+}
+
+void SerialIngest::close()
+{
+    QMetaObject::invokeMethod(fReader, "close", Qt::BlockingQueuedConnection);
+}
+
+bool SerialIngest::startCapture(const QString &path)
+{
+    bool ok = false;
+    QMetaObject::invokeMethod(fReader, "startCapture", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, ok), Q_ARG(QString, path));
+    return ok;
+}
+
+void SerialIngest::stopCapture()
+{
+    QMetaObject::invokeMethod(fReader, "stopCapture", Qt::BlockingQueuedConnection);
+}
+
+int SerialIngest::drain(std::function<void(const PointBatch &)> consumer, int maxBatches)
+{
+    // сброс до чтения: пакет, пришедший во время разбора, вызовет новый сигнал
+    fNotified.storeRelease(0);
+
+    int points = 0;
+    for (int i = 0; maxBatches < 0 || i < maxBatches; i++) {
+        PointBatch *batch = fQueue.front();
+        if (!batch)
+            break;
+        consumer(*batch);
+        points += batch->points.count();
+        fQueue.release();
+    }
+    return points;
+}
+
+SerialIngest::Stats SerialIngest::stats() const
+{
+    Stats s;
+    s.bytesRead = fBytesRead.loadAcquire();
+    s.frames = fFrames.loadAcquire();
+    s.crcErrors = fCrcErrors.loadAcquire();
+    s.skippedBytes = fSkippedBytes.loadAcquire();
+    s.points = fPoints.loadAcquire();
+    s.batches = fBatches.loadAcquire();
+    s.droppedPoints = fDroppedPoints.loadAcquire();
+    s.pauses = fPauses.loadAcquire();
+    return s;
+}
@@ -0,0 +1,126 @@
+#ifndef SERIALINGEST_H
+#define SERIALINGEST_H
+
+#include <QObject>
+#include <QThread>
+#include <QVector>
+#include <QVector3D>
+#include <QSerialPort>
+#include <QAtomicInteger>
+#include <functional>
+
+#include "spscqueue.h"
+#include "sampledecoder.h"
+#include "capturefile.h"
+
+class QTimer;
+
+struct PointBatch {
+    QVector<QVector3D> points;
+    quint64 number;
+    PointBatch() : number(0) {}
+};
+
+class SerialIngest;
+
+// Owns the port on the I/O thread: reads, decodes and commits batches to the queue.
+class SerialReader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SerialReader(SerialIngest *ingest);
+
+public slots:
+    bool open(const QString &portName, qint32 baudRate);
+    void close();
+    bool startCapture(const QString &path);
+    void stopCapture();
+
+private slots:
+    void readAvailable();
+    void portError(QSerialPort::SerialPortError error);
+
+private:
+    SerialIngest *fIngest;
+    QSerialPort *fPort;
+    QTimer *fRetryTimer;
+    SampleDecoder fDecoder;
+    QByteArray fReadBuffer;
+    PointBatch fDropBatch;      // приёмник точек, когда очередь заполнена
+    PointBatch *fBatch;         // зарезервированный, ещё не отданный слот очереди
+    quint64 fBatchNumber;
+    CaptureWriter fCapture;     // все декодированные точки, в том числе отброшенные
+
+    void commitBatch();
+    void updateDecoderStats();
+};
+
+// Streaming ingest of instrument samples from a serial port.
+// The port is read on a dedicated thread, decoded points are delivered in
+// batches through a lock-free queue; drain() is called by exactly one
+// consumer thread (GUI or render thread), the slots are reused without
+// allocations. When the consumer falls behind the reader either drops the
+// decoded points or stops reading and lets the port (flow control) push back.
+class SerialIngest : public QObject
+{
+    Q_OBJECT
+public:
+    enum Backpressure {
+        bpDrop,     // decode and count the points as dropped
+        bpPause     // stop reading until the consumer frees a slot
+    };
+
+    struct Stats {
+        quint64 bytesRead;
+        quint64 frames;
+        quint64 crcErrors;
+        quint64 skippedBytes;
+        quint64 points;
+        quint64 batches;
+        quint64 droppedPoints;
+        quint64 pauses;
+    };
+
+    explicit SerialIngest(quint32 queueCapacity = 64, int batchSize = 16384, QObject *parent = nullptr);
+    ~SerialIngest();
+
+    void setBackpressure(Backpressure mode) { fBackpressure.storeRelease(mode); }
+    Backpressure backpressure() const { return Backpressure(fBackpressure.loadAcquire()); }
+    int batchSize() const { return fBatchSize; }
+
+    bool open(const QString &portName, qint32 baudRate = 921600);
+    void close();
+
+    // запись принятых точек в файл CaptureWriter на потоке чтения
+    bool startCapture(const QString &path);
+    void stopCapture();
+
+    // consumer side, returns the number of delivered points
+    int drain(std::function<void(const PointBatch &)> consumer, int maxBatches = -1);
+    Stats stats() const;
+
+signals:
+    void batchesReady();    // emitted once until the next drain()
+    void errorOccurred(QString message);
+
+private:
+    friend class SerialReader;
+
+    QThread fThread;
+    SerialReader *fReader;
+    SpscQueue<PointBatch> fQueue;
+    int fBatchSize;
+    QAtomicInt fBackpressure;
+    QAtomicInt fNotified;
+
+    QAtomicInteger<quint64> fBytesRead;
+    QAtomicInteger<quint64> fFrames;
+    QAtomicInteger<quint64> fCrcErrors;
+    QAtomicInteger<quint64> fSkippedBytes;
+    QAtomicInteger<quint64> fPoints;
+    QAtomicInteger<quint64> fBatches;
+    QAtomicInteger<quint64> fDroppedPoints;
+    QAtomicInteger<quint64> fPauses;
+};
+
+#endif // SERIALINGEST_H
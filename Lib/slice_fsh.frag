@@ -0,0 +1,12 @@
+#version 120
+uniform sampler2D slice;
+varying vec2 texCoord;
+
+void main(void)
+{
+	// прозрачные тексели - вне объёма
+	vec4 texel = texture2D(slice, texCoord);
+	if (texel.a < 0.5)
+		discard;
+	gl_FragColor = vec4(texel.rgb, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 120
+attribute vec3 qt_Vertex;   // normalized volume coordinates
+attribute vec2 qt_TexCoord;
+uniform mat4 Matrix;        // with the volume box
+varying vec2 texCoord;
+
+void main(void)
+{
+	texCoord = qt_TexCoord;
+	gl_Position = Matrix * vec4( qt_Vertex, 1.0 );
+}
@@ -0,0 +1,125 @@
+#include "snapshotseries.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+
+#define POINT_BYTES (3 * sizeof(float))
+
+SnapshotSeries::SnapshotSeries(const QString &name) : DataSeries(name), fHasBounds(false), fDrawnVersion(0),
+    fUploadedVersion(0), fVboPoints(0), fVbo(0)
+{
+}
+
+SnapshotSeries::~SnapshotSeries()
+{
+}
+
+quint64 SnapshotSeries::publish()
+{
+    // границы считает производитель, отрисовка их не ждёт
+    const QVector<QVector3D> &points = fSnapshots.writeBuffer();
+    QVector3D lo, hi;
+    for (int i = 0; i < points.count(); i++) {
+        const QVector3D &p = points[i];
+        if (!i) {
+            lo = hi = p;
+            continue;
+        }
+        lo = QVector3D(qMin(lo.x(), p.x()), qMin(lo.y(), p.y()), qMin(lo.z(), p.z()));
+        hi = QVector3D(qMax(hi.x(), p.x()), qMax(hi.y(), p.y()), qMax(hi.z(), p.z()));
+    }
+    {
+        QMutexLocker locker(&fMutex);
+        fHasBounds = !points.isEmpty();
+        fMin = lo;
+        fMax = hi;
+    }
+    return fSnapshots.publish();
+}
+
+quint64 SnapshotSeries::drawnVersion() const
+{
+    QMutexLocker locker(&fMutex);
+    return fDrawnVersion;
+}
+
+bool SnapshotSeries::bounds(QVector3D *min, QVector3D *max) const
+{
+    QMutexLocker locker(&fMutex);
+    if (!fHasBounds)
+        return false;
+    *min = fMin;
+    *max = fMax;
+    return true;
+}
+
+void SnapshotSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx || !program)
+        return;
+
+    QColor color;
+    float pointSize;
+    {
+        QMutexLocker locker(&fMutex);
+        if (!fVisible)
+            return;
+        color = fColor;
+        pointSize = fPointSize;
+    }
+
+    // последний готовый снимок, без блокировки производителя
+    const QVector<QVector3D> &points = fSnapshots.read();
+    if (!fSnapshots.readVersion() || points.isEmpty())
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    if (!fVbo)
+        f->glGenBuffers(1, &fVbo);
+    f->glBindBuffer(GL_ARRAY_BUFFER, fVbo);
+    GLsizeiptr uploaded = 0;
+    if (fUploadedVersion != fSnapshots.readVersion()) {
+        const GLsizeiptr bytes = GLsizeiptr(points.count()) * GLsizeiptr(POINT_BYTES);
+        if (points.count() > fVboPoints) {
+            f->glBufferData(GL_ARRAY_BUFFER, bytes, points.constData(), GL_STREAM_DRAW);
+            fVboPoints = points.count();
+        }
+        else
+            f->glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, points.constData());
+        fUploadedVersion = fSnapshots.readVersion();
+        uploaded = bytes;
+    }
+
+    program->bind();
+    program->setUniformValue("color", QVector3D(color.redF(), color.greenF(), color.blueF()));
+    program->setUniformValue("Matrix", pmvMatrix);
+    const int location = program->attributeLocation("qt_Vertex");
+    program->enableAttributeArray(location);
+    program->setAttributeBuffer(location, GL_FLOAT, 0, 3);
+    f->glEnable(GL_DEPTH_TEST);
+    glPointSize(pointSize);
+    f->glDrawArrays(GL_POINTS, 0, points.count());
+
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    program->disableAttributeArray(location);
+    program->release();
+
+    QMutexLocker locker(&fMutex);
+    fUploadedBytes += quint64(uploaded);
+    fDrawnVersion = fSnapshots.readVersion();
+}
+
+void SnapshotSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    if (fVbo)
+        ctx->functions()->glDeleteBuffers(1, &fVbo);
+    fVbo = 0;
+    fVboPoints = 0;
+    fUploadedVersion = 0;
+}
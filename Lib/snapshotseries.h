@@ -0,0 +1,43 @@
+#ifndef SNAPSHOTSERIES_H
+#define SNAPSHOTSERIES_H
+
+#include <QVector>
+#include <QVector3D>
+
+#include "dataseries.h"
+#include "triplebuffer.h"
+
+// Point set that one producer thread replaces as a whole, e.g. a simulation
+// step or a decoded frame. The producer fills writeBuffer() (the three buffers
+// are reused, resize() keeps their capacity) and calls publish(); draw() takes
+// the latest complete version through a TripleBuffer without locks, so the render
+// path never waits for the producer and never sees a half-written set. A new
+// version is uploaded into one vertex buffer that grows only with the set.
+class SnapshotSeries : public DataSeries
+{
+public:
+    explicit SnapshotSeries(const QString &name);
+    ~SnapshotSeries();  // releaseGL() must be called before if the series was drawn
+
+    // producer thread only; holds an older version after publish(), overwrite it
+    QVector<QVector3D> &writeBuffer() { return fSnapshots.writeBuffer(); }
+    quint64 publish();                  // version of the published set
+
+    quint64 drawnVersion() const;       // 0 - nothing drawn yet
+    bool bounds(QVector3D *min, QVector3D *max) const override;     // of the last published set
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    TripleBuffer<QVector<QVector3D> > fSnapshots;
+    bool fHasBounds;        // fMutex
+    QVector3D fMin;
+    QVector3D fMax;
+    quint64 fDrawnVersion;  // fMutex
+    quint64 fUploadedVersion;   // only the render path
+    int fVboPoints;
+    GLuint fVbo;
+};
+
+#endif // SNAPSHOTSERIES_H
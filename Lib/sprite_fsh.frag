@@ -0,0 +1,13 @@
+#version 120
+uniform bool roundPoints;
+varying vec4 color;
+
+void main(void)
+{
+	if (roundPoints) {
+		vec2 d = gl_PointCoord * 2.0 - 1.0;
+		if (dot(d, d) > 1.0)
+			discard;
+	}
+	gl_FragColor = color;
+}
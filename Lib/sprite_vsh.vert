@@ -0,0 +1,19 @@
+#version 120
+attribute vec4 qt_Vertex;   // xyz - position in the cloud bounds 0..1, w - size / sizeScale
+attribute vec4 qt_Color;
+uniform mat4 Matrix;
+uniform vec3 origin;
+uniform vec3 extent;
+uniform float sizeScale;
+uniform float attenuation;  // eye distance of the nominal size, 0 - size in pixels
+varying vec4 color;
+
+void main(void)
+{
+	gl_Position = Matrix * vec4( origin + qt_Vertex.xyz * extent, 1.0 );
+	float size = qt_Vertex.w * sizeScale;
+	if (attenuation > 0.0)
+		size = size * attenuation / max(gl_Position.w, 0.001);
+	gl_PointSize = max(size, 1.0);
+	color = qt_Color;
+}
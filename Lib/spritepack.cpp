@@ -0,0 +1,36 @@
+#include "gl_pointsprites.h"
+
+Q_STATIC_ASSERT(sizeof(SpriteVertex) == 12);
+
+static inline quint16 quantize(float value)
+{
+    // value уже приведено к 0..65535
+    if (!(value > 0.0f))
+        return 0;
+    if (value >= 65535.0f)
+        return 65535;
+    return quint16(value + 0.5f);
+}
+
+void PointSprites::pack(const float *xyz, const QRgb *colors, const float *sizes, int count,
+                        QRgb color, float size, const QVector3D &origin, const QVector3D &extent, SpriteVertex *out)
+{
+    const float sx = extent.x() > 0.0f ? 65535.0f / extent.x() : 0.0f;
+    const float sy = extent.y() > 0.0f ? 65535.0f / extent.y() : 0.0f;
+    const float sz = extent.z() > 0.0f ? 65535.0f / extent.z() : 0.0f;
+    const float ss = 65535.0f / MaxSize;
+    const quint16 commonSize = quantize(size * ss);
+
+    for (int i = 0; i < count; i++, xyz += 3, out++) {
+        out->x = quantize((xyz[0] - origin.x()) * sx);
+        out->y = quantize((xyz[1] - origin.y()) * sy);
+        out->z = quantize((xyz[2] - origin.z()) * sz);
+        out->size = sizes ? quantize(sizes[i] * ss) : commonSize;
+
+        const QRgb c = colors ? colors[i] : color;
+        out->r = quint8(qRed(c));
+        out->g = quint8(qGreen(c));
+        out->b = quint8(qBlue(c));
+        out->a = quint8(qAlpha(c));
+    }
+}
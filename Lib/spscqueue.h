@@ -0,0 +1,85 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QVector>
+#include <QAtomicInteger>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Capacity is rounded up to a power of two. push() fails when the queue is full,
+// the caller decides whether to drop or retry (backpressure).
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(quint32 capacity = 1024) : fHead(0), fTail(0)
+    {
+        quint32 c = 1;
+        while (c < capacity)
+            c <<= 1;
+        fBuffer.resize(int(c));
+        fData = fBuffer.data();
+        fMask = c - 1;
+    }
+
+    quint32 capacity() const { return fMask + 1; }
+    quint32 size() const { return fTail.loadAcquire() - fHead.loadAcquire(); }
+    bool isEmpty() const { return size() == 0; }
+    bool isFull() const { return size() > fMask; }
+
+    // producer side
+    bool push(T value)
+    {
+        const quint32 tail = fTail.loadAcquire();
+        if (tail - fHead.loadAcquire() > fMask)
+            return false;
+        fData[tail & fMask] = std::move(value);
+        fTail.storeRelease(tail + 1);
+        return true;
+    }
+
+    // producer side: slot to fill in place, must be followed by commit()
+    T *reserve()
+    {
+        const quint32 tail = fTail.loadAcquire();
+        if (tail - fHead.loadAcquire() > fMask)
+            return nullptr;
+        return &fData[tail & fMask];
+    }
+
+    void commit() { fTail.storeRelease(fTail.loadAcquire() + 1); }
+
+    // consumer side
+    bool pop(T &value)
+    {
+        const quint32 head = fHead.loadAcquire();
+        if (head == fTail.loadAcquire())
+            return false;
+        value = std::move(fData[head & fMask]);
+        fHead.storeRelease(head + 1);
+        return true;
+    }
+
+    // consumer side: oldest element without removing it, must be followed by release()
+    T *front()
+    {
+        const quint32 head = fHead.loadAcquire();
+        if (head == fTail.loadAcquire())
+            return nullptr;
+        return &fData[head & fMask];
+    }
+
+    void release() { fHead.storeRelease(fHead.loadAcquire() + 1); }
+
+private:
+    Q_DISABLE_COPY(SpscQueue)
+
+    QVector<T> fBuffer;
+    T *fData;
+    quint32 fMask;
+    // голова и хвост в разных кэш-линиях, чтобы потоки не мешали друг другу
+    alignas(64) QAtomicInteger<quint32> fHead;
+    alignas(64) QAtomicInteger<quint32> fTail;
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,13 @@
+#version 120
+uniform sampler2D density;  // points per pixel
+uniform sampler1D colormap;
+uniform float logScale;     // 1 / log(1 + saturation)
+varying vec2 texCoord;
+
+void main(void)
+{
+	float count = texture2D(density, texCoord).r;
+	if (count < 0.01)
+		discard;
+	gl_FragColor = texture1D(colormap, clamp(log(1.0 + count) * logScale, 0.0, 1.0));
+}
@@ -0,0 +1,9 @@
+#version 120
+attribute vec2 qt_Vertex;   // full-screen quad -1..1
+varying vec2 texCoord;
+
+void main(void)
+{
+	texCoord = qt_Vertex * 0.5 + 0.5;
+	gl_Position = vec4( qt_Vertex, 0.0, 1.0 );
+}
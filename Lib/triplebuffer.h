@@ -0,0 +1,66 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QAtomicInteger>
+
+// Lock-free triple buffer for exactly one producer thread and one consumer thread.
+// The producer fills writeBuffer() and publish()es it; the consumer always gets
+// the latest complete version with read(). Neither side waits for the other and
+// the three buffers are reused, so containers keep their capacity between versions.
+// writeBuffer() holds an older version after publish(): overwrite or clear() it.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : fWrite(0), fPublished(0), fRead(2), fState(1) {}
+
+    // producer side
+    T &writeBuffer() { return fSlots[fWrite].data; }
+
+    quint64 publish()
+    {
+        fSlots[fWrite].version = ++fPublished;
+        // записанный буфер становится средним, прежний средний - новым буфером записи
+        const quint32 prev = fState.fetchAndStoreOrdered(fWrite | Fresh);
+        fWrite = prev & IndexMask;
+        return fPublished;
+    }
+
+    quint64 publishedVersion() const { return fPublished; }  // producer only
+
+    // consumer side
+    bool update()
+    {
+        if (!(fState.loadAcquire() & Fresh))
+            return false;
+        const quint32 prev = fState.fetchAndStoreOrdered(fRead);
+        fRead = prev & IndexMask;
+        return true;
+    }
+
+    const T &read() { update(); return fSlots[fRead].data; }
+    const T &current() const { return fSlots[fRead].data; }  // without taking a newer version
+    quint64 readVersion() const { return fSlots[fRead].version; }  // 0 - nothing published yet
+
+private:
+    Q_DISABLE_COPY(TripleBuffer)
+
+    enum {
+        IndexMask = 0x3,
+        Fresh = 0x4     // средний буфер ещё не прочитан
+    };
+
+    struct Slot {
+        T data;
+        quint64 version;
+        Slot() : version(0) {}
+    };
+
+    Slot fSlots[3];
+    quint32 fWrite;         // producer only
+    quint64 fPublished;     // producer only
+    alignas(64) quint32 fRead;  // consumer only
+    alignas(64) QAtomicInteger<quint32> fState;  // index of the middle buffer and the Fresh flag
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,605 @@
+#include "volumeslice.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QtConcurrent>
+#include <QDebug>
+#include <cstring>
+#include <cmath>
+
+#include "sceneresources.h"
+
+#define VOLUME_MAGIC "VBRK"
+#define SLICE_VERTEX_SHADER ":/BaseShaders/Lib/slice_vsh.vert"
+#define SLICE_FRAGMENT_SHADER ":/BaseShaders/Lib/slice_fsh.frag"
+#define DEFAULT_RESOLUTION 512
+#define DEFAULT_CACHE_SIZE (quint64(512) << 20)
+#define MAX_BRICKS 0x7fffffff   // ключ кэша - int
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+VolumeFile::VolumeFile() : fMap(nullptr), fBricked(false), fBrick(RawBrick), fDataOffset(0)
+{
+    fSize[0] = fSize[1] = fSize[2] = 0;
+}
+
+bool VolumeFile::openRaw(const QString &path, int nx, int ny, int nz)
+{
+    close();
+    if (nx < 2 || ny < 2 || nz < 2) {
+        qDebug() << "VolumeFile: volume must have at least 2 samples on each axis";
+        return false;
+    }
+
+    fFile.setFileName(path);
+    if (!fFile.open(QIODevice::ReadOnly)) {
+        qDebug() << "VolumeFile: cannot open" << path << fFile.errorString();
+        return false;
+    }
+
+    const qint64 size = fFile.size();
+    const quint64 bricks = quint64((nx + RawBrick - 1) / RawBrick) * quint64((ny + RawBrick - 1) / RawBrick) * quint64((nz + RawBrick - 1) / RawBrick);
+    if (bricks > MAX_BRICKS) {
+        qDebug() << "VolumeFile: too many bricks" << path;
+        close();
+        return false;
+    }
+    if (quint64(size) < quint64(nx) * quint64(ny) * quint64(nz) * sizeof(float)) {
+        qDebug() << "VolumeFile: file is smaller than the volume" << path;
+        close();
+        return false;
+    }
+    if (!(fMap = fFile.map(0, size))) {
+        qDebug() << "VolumeFile: cannot map" << path;
+        close();
+        return false;
+    }
+
+    fBricked = false;
+    fSize[0] = nx;
+    fSize[1] = ny;
+    fSize[2] = nz;
+    fBrick = RawBrick;
+    fDataOffset = 0;
+    return true;
+}
+
+bool VolumeFile::openBricked(const QString &path)
+{
+    close();
+
+    fFile.setFileName(path);
+    if (!fFile.open(QIODevice::ReadOnly)) {
+        qDebug() << "VolumeFile: cannot open" << path << fFile.errorString();
+        return false;
+    }
+
+    const qint64 size = fFile.size();
+    if (size < qint64(sizeof(VolumeFileHeader)) || !(fMap = fFile.map(0, size))) {
+        qDebug() << "VolumeFile: cannot map" << path;
+        close();
+        return false;
+    }
+
+    const VolumeFileHeader *header = reinterpret_cast<const VolumeFileHeader*>(fMap);
+    bool valid = memcmp(header->magic, VOLUME_MAGIC, 4) == 0 && header->version == Version
+            && header->brick >= 2 && header->brick <= 256;
+    quint64 bricks = 1;
+    for (int k = 0; k < 3 && valid; k++) {
+        valid = header->size[k] >= 2 && header->size[k] <= 1u << 20;
+        bricks *= (header->size[k] + header->brick - 1) / header->brick;
+    }
+    const quint64 brickBytes = quint64(header->brick) * header->brick * header->brick * sizeof(float);
+    if (!valid || bricks > MAX_BRICKS || header->dataOffset + bricks * brickBytes > quint64(size)) {
+        qDebug() << "VolumeFile: bad header" << path;
+        close();
+        return false;
+    }
+
+    fBricked = true;
+    for (int k = 0; k < 3; k++)
+        fSize[k] = int(header->size[k]);
+    fBrick = int(header->brick);
+    fDataOffset = header->dataOffset;
+    return true;
+}
+
+void VolumeFile::close()
+{
+    if (fMap)
+        fFile.unmap(fMap);
+    fMap = nullptr;
+    fFile.close();
+    fSize[0] = fSize[1] = fSize[2] = 0;
+}
+
+void VolumeFile::readBrick(int bx, int by, int bz, float *out) const
+{
+    const int b = fBrick;
+    const size_t brickFloats = size_t(b) * b * b;
+    if (fBricked) {
+        const quint64 index = (quint64(bz) * brickCount(1) + by) * brickCount(0) + bx;
+        memcpy(out, fMap + fDataOffset + index * brickFloats * sizeof(float), brickFloats * sizeof(float));
+        return;
+    }
+
+    // сырой файл: строки кирпича разбросаны по файлу, читаются только их страницы
+    const int x0 = bx * b;
+    const int y0 = by * b;
+    const int z0 = bz * b;
+    const int w = qMin(b, fSize[0] - x0);
+    const int h = qMin(b, fSize[1] - y0);
+    const int d = qMin(b, fSize[2] - z0);
+    if (w < b || h < b || d < b)
+        memset(out, 0, brickFloats * sizeof(float));
+
+    const float *values = reinterpret_cast<const float*>(fMap);
+    for (int z = 0; z < d; z++) {
+        for (int y = 0; y < h; y++) {
+            const quint64 row = (quint64(z0 + z) * fSize[1] + quint64(y0 + y)) * fSize[0] + x0;
+            memcpy(out + (size_t(z) * b + y) * b, values + row, size_t(w) * sizeof(float));
+        }
+    }
+}
+
+bool VolumeFile::writeBricked(const QString &rawPath, int nx, int ny, int nz, const QString &path, int brick)
+{
+    if (brick < 2 || brick > 256) {
+        qDebug() << "VolumeFile: bad brick size" << brick;
+        return false;
+    }
+
+    VolumeFile raw;
+    if (!raw.openRaw(rawPath, nx, ny, nz))
+        return false;
+    raw.fBrick = brick;
+
+    QFile output(path);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "VolumeFile: cannot create" << path << output.errorString();
+        return false;
+    }
+
+    VolumeFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VOLUME_MAGIC, 4);
+    header.version = Version;
+    header.size[0] = quint32(nx);
+    header.size[1] = quint32(ny);
+    header.size[2] = quint32(nz);
+    header.brick = quint32(brick);
+    header.dataOffset = sizeof(header);
+    if (output.write(reinterpret_cast<const char*>(&header), sizeof(header)) != qint64(sizeof(header))) {
+        qDebug() << "VolumeFile: cannot write" << path << output.errorString();
+        return false;
+    }
+
+    QVector<float> values(brick * brick * brick);
+    const qint64 brickBytes = qint64(values.count()) * qint64(sizeof(float));
+    for (int bz = 0; bz < raw.brickCount(2); bz++) {
+        for (int by = 0; by < raw.brickCount(1); by++) {
+            for (int bx = 0; bx < raw.brickCount(0); bx++) {
+                raw.readBrick(bx, by, bz, values.data());
+                if (output.write(reinterpret_cast<const char*>(values.constData()), brickBytes) != brickBytes) {
+                    qDebug() << "VolumeFile: cannot write" << path << output.errorString();
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+VolumeSliceSeries::VolumeSliceSeries(const QString &name) : DataSeries(name), fOrigin(0.0f, 0.0f, 0.0f), fBoxSize(1.0f, 1.0f, 1.0f),
+    fImageDirty(false), fScheduled(false), fRestart(false), fCacheSize(DEFAULT_CACHE_SIZE), fReportedBytes(0), fReportedReads(0),
+    fTexture(0), fTextureSize(0), fProgram(nullptr), fCacheBytes(0), fCacheLimit(DEFAULT_CACHE_SIZE), fUse(0), fBricksRead(0),
+    fLastBrick(-1), fLastValues(nullptr)
+{
+    fPlane.center = QVector3D(0.5f, 0.5f, 0.5f);
+    fPlane.u = QVector3D(0.5f, 0.0f, 0.0f);
+    fPlane.v = QVector3D(0.0f, 0.5f, 0.0f);
+    fPlane.resolution = DEFAULT_RESOLUTION;
+    fPlane.min = 0.0f;
+    fPlane.max = 1.0f;
+    fImagePlane = fPlane;
+    fWorker.setMaxThreadCount(1);
+}
+
+VolumeSliceSeries::~VolumeSliceSeries()
+{
+    fWorker.waitForDone();
+}
+
+bool VolumeSliceSeries::openRaw(const QString &path, int nx, int ny, int nz)
+{
+    close();
+    if (!fVolume.openRaw(path, nx, ny, nz))
+        return false;
+    QMutexLocker locker(&fMutex);
+    schedule();
+    return true;
+}
+
+bool VolumeSliceSeries::openBricked(const QString &path)
+{
+    close();
+    if (!fVolume.openBricked(path))
+        return false;
+    QMutexLocker locker(&fMutex);
+    schedule();
+    return true;
+}
+
+void VolumeSliceSeries::close()
+{
+    // файл и кэш принадлежат потоку выборки, пока он работает
+    fWorker.waitForDone();
+    fVolume.close();
+    fCache.clear();
+    fCacheBytes = 0;
+    fBricksRead = 0;
+    fLastBrick = -1;
+    fLastValues = nullptr;
+
+    QMutexLocker locker(&fMutex);
+    fImage.clear();
+    fImageDirty = false;
+    fReportedBytes = fReportedReads = 0;
+}
+
+void VolumeSliceSeries::setGeometry(const QVector3D &origin, const QVector3D &size)
+{
+    QMutexLocker locker(&fMutex);
+    fOrigin = origin;
+    fBoxSize = size;
+}
+
+void VolumeSliceSeries::setAxisSlice(int axis, float position)
+{
+    if (axis < 0 || axis > 2)
+        return;
+
+    QMutexLocker locker(&fMutex);
+    QVector3D center(0.5f, 0.5f, 0.5f);
+    center[axis] = qBound(0.0f, position, 1.0f);
+    QVector3D u, v;
+    u[(axis + 1) % 3] = 0.5f;
+    v[(axis + 2) % 3] = 0.5f;
+    fPlane.center = center;
+    fPlane.u = u;
+    fPlane.v = v;
+    schedule();
+}
+
+void VolumeSliceSeries::setPlane(const QVector3D &point, const QVector3D &normal)
+{
+    QMutexLocker locker(&fMutex);
+    if (fBoxSize.x() == 0.0f || fBoxSize.y() == 0.0f || fBoxSize.z() == 0.0f || normal.isNull())
+        return;
+
+    // в нормированных координатах объёма нормаль умножается на размер коробки
+    const QVector3D p = (point - fOrigin) / fBoxSize;
+    const QVector3D n = (normal * fBoxSize).normalized();
+    int least = 0;
+    for (int k = 1; k < 3; k++) {
+        if (qAbs(n[k]) < qAbs(n[least]))
+            least = k;
+    }
+    QVector3D axis;
+    axis[least] = 1.0f;
+    const QVector3D u = QVector3D::crossProduct(n, axis).normalized();
+    const QVector3D v = QVector3D::crossProduct(n, u);
+
+    // квадрат с центром в проекции центра коробки накрывает всё её сечение
+    const QVector3D middle(0.5f, 0.5f, 0.5f);
+    const float half = 0.5f * std::sqrt(3.0f);
+    fPlane.center = middle - n * QVector3D::dotProduct(middle - p, n);
+    fPlane.u = u * half;
+    fPlane.v = v * half;
+    schedule();
+}
+
+void VolumeSliceSeries::setResolution(int texels)
+{
+    QMutexLocker locker(&fMutex);
+    fPlane.resolution = qBound(16, texels, 4096);
+    schedule();
+}
+
+void VolumeSliceSeries::setValueRange(float min, float max)
+{
+    QMutexLocker locker(&fMutex);
+    fPlane.min = min;
+    fPlane.max = max;
+    schedule();
+}
+
+void VolumeSliceSeries::setCacheSize(quint64 bytes)
+{
+    QMutexLocker locker(&fMutex);
+    fCacheSize = bytes;
+}
+
+void VolumeSliceSeries::setLoadedCallback(std::function<void()> callback)
+{
+    QMutexLocker locker(&fMutex);
+    fLoadedCallback = callback;
+}
+
+quint64 VolumeSliceSeries::cacheBytes() const
+{
+    QMutexLocker locker(&fMutex);
+    return fReportedBytes;
+}
+
+quint64 VolumeSliceSeries::bricksRead() const
+{
+    QMutexLocker locker(&fMutex);
+    return fReportedReads;
+}
+
+bool VolumeSliceSeries::bounds(QVector3D *min, QVector3D *max) const
+{
+    QMutexLocker locker(&fMutex);
+    if (!fVolume.isOpen())
+        return false;
+    const QVector3D end = fOrigin + fBoxSize;
+    *min = QVector3D(qMin(fOrigin.x(), end.x()), qMin(fOrigin.y(), end.y()), qMin(fOrigin.z(), end.z()));
+    *max = QVector3D(qMax(fOrigin.x(), end.x()), qMax(fOrigin.y(), end.y()), qMax(fOrigin.z(), end.z()));
+    return true;
+}
+
+void VolumeSliceSeries::schedule()
+{
+    // fMutex захвачен вызывающим
+    if (!fVolume.isOpen())
+        return;
+    if (fScheduled) {
+        fRestart = true;
+        return;
+    }
+    fScheduled = true;
+    fRestart = false;
+    QtConcurrent::run(&fWorker, this, &VolumeSliceSeries::sample);
+}
+
+void VolumeSliceSeries::sample()
+{
+    forever {
+        Plane plane;
+        {
+            QMutexLocker locker(&fMutex);
+            fRestart = false;
+            plane = fPlane;
+            fCacheLimit = fCacheSize;
+        }
+
+        QVector<QRgb> image(plane.resolution * plane.resolution);
+        const bool done = render(plane, image);
+        evict();
+
+        std::function<void()> callback;
+        bool restart;
+        {
+            QMutexLocker locker(&fMutex);
+            fReportedBytes = fCacheBytes;
+            fReportedReads = fBricksRead;
+            if (done) {
+                fImage.swap(image);
+                fImagePlane = plane;
+                fImageDirty = true;
+                callback = fLoadedCallback;
+            }
+            restart = fRestart;
+            if (!restart)
+                fScheduled = false;
+        }
+        if (callback)
+            callback();
+        if (!restart)
+            return;
+    }
+}
+
+bool VolumeSliceSeries::render(const Plane &plane, QVector<QRgb> &image)
+{
+    const int n = plane.resolution;
+    const QVector3D scale(fVolume.size(0) - 1, fVolume.size(1) - 1, fVolume.size(2) - 1);
+    const float valueScale = plane.max != plane.min ? 255.0f / (plane.max - plane.min) : 0.0f;
+    const float epsilon = 1e-5f;
+    QRgb *out = image.data();
+
+    for (int j = 0; j < n; j++) {
+        // новая плоскость отменяет устаревшую выборку
+        {
+            QMutexLocker locker(&fMutex);
+            if (fRestart)
+                return false;
+        }
+
+        const QVector3D row = plane.center + plane.v * ((2.0f * j + 1.0f) / n - 1.0f);
+        for (int i = 0; i < n; i++) {
+            const QVector3D t = row + plane.u * ((2.0f * i + 1.0f) / n - 1.0f);
+            if (t.x() < -epsilon || t.y() < -epsilon || t.z() < -epsilon
+                    || t.x() > 1.0f + epsilon || t.y() > 1.0f + epsilon || t.z() > 1.0f + epsilon) {
+                *out++ = 0;
+                continue;
+            }
+            const QVector3D s = t * scale;
+            const int gray = qBound(0, int((value(s.x(), s.y(), s.z()) - plane.min) * valueScale + 0.5f), 255);
+            *out++ = qRgba(gray, gray, gray, 255);
+        }
+    }
+    return true;
+}
+
+float VolumeSliceSeries::voxel(int x, int y, int z)
+{
+    const int b = fVolume.brickSize();
+    const int bx = x / b;
+    const int by = y / b;
+    const int bz = z / b;
+    const int key = (bz * fVolume.brickCount(1) + by) * fVolume.brickCount(0) + bx;
+    if (key != fLastBrick) {
+        QHash<int, CachedBrick>::iterator it = fCache.find(key);
+        if (it == fCache.end()) {
+            // кирпич читается из файла один раз, пока его не вытеснят
+            evict();
+            CachedBrick brick;
+            brick.values.resize(b * b * b);
+            fVolume.readBrick(bx, by, bz, brick.values.data());
+            it = fCache.insert(key, brick);
+            fCacheBytes += quint64(brick.values.count()) * sizeof(float);
+            fBricksRead++;
+        }
+        it->lastUse = ++fUse;
+        fLastBrick = key;
+        fLastValues = it->values.constData();
+    }
+    return fLastValues[((z - bz * b) * b + (y - by * b)) * b + (x - bx * b)];
+}
+
+float VolumeSliceSeries::value(float x, float y, float z)
+{
+    const int x0 = qBound(0, int(x), fVolume.size(0) - 2);
+    const int y0 = qBound(0, int(y), fVolume.size(1) - 2);
+    const int z0 = qBound(0, int(z), fVolume.size(2) - 2);
+    const float fx = qBound(0.0f, x - x0, 1.0f);
+    const float fy = qBound(0.0f, y - y0, 1.0f);
+    const float fz = qBound(0.0f, z - z0, 1.0f);
+
+    const float c00 = voxel(x0, y0, z0) + (voxel(x0 + 1, y0, z0) - voxel(x0, y0, z0)) * fx;
+    const float c10 = voxel(x0, y0 + 1, z0) + (voxel(x0 + 1, y0 + 1, z0) - voxel(x0, y0 + 1, z0)) * fx;
+    const float c01 = voxel(x0, y0, z0 + 1) + (voxel(x0 + 1, y0, z0 + 1) - voxel(x0, y0, z0 + 1)) * fx;
+    const float c11 = voxel(x0, y0 + 1, z0 + 1) + (voxel(x0 + 1, y0 + 1, z0 + 1) - voxel(x0, y0 + 1, z0 + 1)) * fx;
+    const float c0 = c00 + (c10 - c00) * fy;
+    const float c1 = c01 + (c11 - c01) * fy;
+    return c0 + (c1 - c0) * fz;
+}
+
+void VolumeSliceSeries::evict()
+{
+    const quint64 brickBytes = quint64(fVolume.brickSize()) * fVolume.brickSize() * fVolume.brickSize() * sizeof(float);
+    while (!fCache.isEmpty() && fCacheBytes + brickBytes > fCacheLimit) {
+        QHash<int, CachedBrick>::iterator oldest = fCache.begin();
+        for (QHash<int, CachedBrick>::iterator it = fCache.begin(); it != fCache.end(); ++it) {
+            if (it->lastUse < oldest->lastUse)
+                oldest = it;
+        }
+        if (oldest.key() == fLastBrick) {
+            fLastBrick = -1;
+            fLastValues = nullptr;
+        }
+        fCacheBytes -= quint64(oldest->values.count()) * sizeof(float);
+        fCache.erase(oldest);
+    }
+}
+
+static QOpenGLShaderProgram *createSliceProgram()
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, SLICE_VERTEX_SHADER))
+        qDebug() << "VertexShader:" << program->log();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, SLICE_FRAGMENT_SHADER))
+        qDebug() << "FragmentShader:" << program->log();
+    program->link();
+    return program;
+}
+
+void VolumeSliceSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    Q_UNUSED(program);
+
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    SceneResources *resources = SceneResources::current();
+    if (!ctx || !resources)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fVisible || fImage.isEmpty())
+        return;
+
+    if (!fProgram)
+        fProgram = resources->acquire<QOpenGLShaderProgram>("program:" SLICE_VERTEX_SHADER ":" SLICE_FRAGMENT_SHADER, createSliceProgram);
+
+    f->glActiveTexture(GL_TEXTURE0);
+    if (!fTexture) {
+        f->glGenTextures(1, &fTexture);
+        f->glBindTexture(GL_TEXTURE_2D, fTexture);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        fTextureSize = 0;
+        fImageDirty = true;
+    }
+    else
+        f->glBindTexture(GL_TEXTURE_2D, fTexture);
+
+    const int n = fImagePlane.resolution;
+    if (fImageDirty) {
+        if (fTextureSize != n) {
+            f->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, n, n, 0, GL_BGRA, GL_UNSIGNED_BYTE, fImage.constData());
+            fTextureSize = n;
+        }
+        else
+            f->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_BGRA, GL_UNSIGNED_BYTE, fImage.constData());
+        fUploadedBytes += quint64(n) * n * sizeof(QRgb);
+        fImageDirty = false;
+    }
+
+    // квадрат в нормированных координатах объёма, коробка переносится в матрицу
+    const QVector3D &c = fImagePlane.center;
+    const QVector3D &u = fImagePlane.u;
+    const QVector3D &v = fImagePlane.v;
+    const QVector3D corners[4] = { c - u - v, c + u - v, c + u + v, c - u + v };
+    const GLfloat texCoords[8] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+    QMatrix4x4 box;
+    box.translate(fOrigin);
+    box.scale(fBoxSize);
+
+    fProgram->bind();
+    fProgram->setUniformValue("Matrix", pmvMatrix * box);
+    fProgram->setUniformValue("slice", 0);
+    const int vertexLocation = fProgram->attributeLocation("qt_Vertex");
+    const int texCoordLocation = fProgram->attributeLocation("qt_TexCoord");
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    fProgram->enableAttributeArray(vertexLocation);
+    fProgram->enableAttributeArray(texCoordLocation);
+    fProgram->setAttributeArray(vertexLocation, reinterpret_cast<const GLfloat*>(corners), 3);
+    fProgram->setAttributeArray(texCoordLocation, texCoords, 2);
+    f->glEnable(GL_DEPTH_TEST);
+    f->glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    fProgram->disableAttributeArray(vertexLocation);
+    fProgram->disableAttributeArray(texCoordLocation);
+    fProgram->release();
+    f->glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void VolumeSliceSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QMutexLocker locker(&fMutex);
+    if (fTexture)
+        ctx->functions()->glDeleteTextures(1, &fTexture);
+    fTexture = 0;
+    fTextureSize = 0;
+    fImageDirty = !fImage.isEmpty();    // срез остаётся в памяти
+
+    if (fProgram) {
+        SceneResources *resources = SceneResources::current();
+        if (resources)
+            resources->release("program:" SLICE_VERTEX_SHADER ":" SLICE_FRAGMENT_SHADER);
+        fProgram = nullptr;
+    }
+}
@@ -0,0 +1,143 @@
+#ifndef VOLUMESLICE_H
+#define VOLUMESLICE_H
+
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QVector3D>
+#include <QThreadPool>
+#include <functional>
+
+#include "dataseries.h"
+
+// Bricked volume file, little-endian: VolumeFileHeader, then the bricks of
+// brick^3 floats (x-fastest inside a brick), bricks x-fastest over the grid.
+// Bricks on the far edges are padded to the full size.
+struct VolumeFileHeader {
+    char magic[4];              // "VBRK"
+    quint32 version;
+    quint32 size[3];            // samples
+    quint32 brick;              // samples per brick edge
+    quint64 dataOffset;
+};
+
+// Scalar float grid on disk, memory-mapped. Either raw (x-fastest floats, the
+// size is given by the caller) or bricked. Reading is done brick by brick: a
+// raw brick is gathered from its rows, a bricked one is one contiguous read, so
+// only the pages of the requested bricks are touched.
+class VolumeFile
+{
+public:
+    enum {
+        Version = 1,
+        RawBrick = 32
+    };
+
+    VolumeFile();
+    ~VolumeFile() { close(); }
+
+    bool openRaw(const QString &path, int nx, int ny, int nz);
+    bool openBricked(const QString &path);
+    void close();
+    bool isOpen() const { return fMap != nullptr; }
+
+    int size(int axis) const { return fSize[axis]; }
+    int brickSize() const { return fBrick; }
+    int brickCount(int axis) const { return (fSize[axis] + fBrick - 1) / fBrick; }
+    void readBrick(int bx, int by, int bz, float *out) const;  // brick^3 floats, padding is 0
+
+    static bool writeBricked(const QString &rawPath, int nx, int ny, int nz, const QString &path, int brick = RawBrick);
+
+private:
+    QFile fFile;
+    uchar *fMap;
+    bool fBricked;
+    int fSize[3];
+    int fBrick;
+    quint64 fDataOffset;
+
+    Q_DISABLE_COPY(VolumeFile)
+};
+
+// Slice plane through a volume placed into a box of the scene (the SpaceData box
+// by default), drawn as a textured quad. The slice texture is sampled on a worker
+// thread through an LRU cache of bricks with a memory cap: a moved plane reads from
+// the file only the bricks it newly intersects. A plane change during sampling is
+// coalesced, the worker takes the latest plane when it is done. Samples outside the
+// volume are transparent, values are mapped to gray through the value range.
+class VolumeSliceSeries : public DataSeries
+{
+public:
+    explicit VolumeSliceSeries(const QString &name);
+    ~VolumeSliceSeries();   // releaseGL() must be called before if the series was drawn
+
+    bool openRaw(const QString &path, int nx, int ny, int nz);
+    bool openBricked(const QString &path);
+    void close();
+
+    void setGeometry(const QVector3D &origin, const QVector3D &size);
+    void setAxisSlice(int axis, float position);                        // position 0..1 across the box
+    void setPlane(const QVector3D &point, const QVector3D &normal);     // scene coordinates
+    void setResolution(int texels);             // of the slice texture side, 512 by default
+    void setValueRange(float min, float max);
+    void setCacheSize(quint64 bytes);           // 512 MB by default
+    void setLoadedCallback(std::function<void()> callback);    // called on the worker thread, e.g. postDataChanged()
+
+    quint64 cacheBytes() const;
+    quint64 bricksRead() const;                 // from the file since open
+    bool bounds(QVector3D *min, QVector3D *max) const override;
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    struct Plane {
+        QVector3D center;   // normalized volume coordinates 0..1
+        QVector3D u;        // half sides of the quad
+        QVector3D v;
+        int resolution;
+        float min;
+        float max;
+    };
+
+    struct CachedBrick {
+        QVector<float> values;
+        quint64 lastUse;
+    };
+
+    VolumeFile fVolume;
+    QVector3D fOrigin;
+    QVector3D fBoxSize;
+    Plane fPlane;
+    Plane fImagePlane;      // plane of fImage
+    QVector<QRgb> fImage;   // resolution^2, alpha 0 outside the volume
+    bool fImageDirty;
+    bool fScheduled;        // worker is busy
+    bool fRestart;          // plane changed while sampling
+    std::function<void()> fLoadedCallback;
+    QThreadPool fWorker;
+    quint64 fCacheSize;
+    quint64 fReportedBytes; // counters of the last finished slice
+    quint64 fReportedReads;
+    GLuint fTexture;
+    int fTextureSize;
+    QOpenGLShaderProgram *fProgram;
+
+    // только поток выборки
+    QHash<int, CachedBrick> fCache;
+    quint64 fCacheBytes;
+    quint64 fCacheLimit;
+    quint64 fUse;
+    quint64 fBricksRead;
+    int fLastBrick;
+    const float *fLastValues;
+
+    void schedule();        // fMutex locked
+    void sample();
+    bool render(const Plane &plane, QVector<QRgb> &image);     // false if the plane changed meanwhile
+    float voxel(int x, int y, int z);
+    float value(float x, float y, float z);    // trilinear, sample coordinates
+    void evict();
+};
+
+#endif // VOLUMESLICE_H
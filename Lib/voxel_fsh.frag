@@ -0,0 +1,9 @@
+#version 120
+uniform sampler1D colormap;
+varying float level;
+varying float shade;
+
+void main(void)
+{
+	gl_FragColor = vec4(texture1D(colormap, level).rgb * shade, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 120
+attribute vec3 qt_Vertex;   // cube corner -0.5..0.5
+attribute vec3 qt_Normal;
+attribute vec4 qt_Voxel;    // per instance: voxel x, y, z and the count
+uniform mat4 Matrix;        // with the box, units - voxels
+uniform float fill;         // cube side, voxels
+uniform float logScale;     // 1 / log(largest count)
+varying float level;
+varying float shade;
+
+void main(void)
+{
+	level = clamp(log(max(qt_Voxel.w, 1.0)) * logScale, 0.0, 1.0);
+	// свет сверху-сбоку, грани куба различимы
+	shade = 0.55 + 0.45 * abs(dot(qt_Normal, normalize(vec3(0.3, 0.5, 1.0))));
+	gl_Position = Matrix * vec4( qt_Voxel.xyz + vec3(0.5) + qt_Vertex * fill, 1.0 );
+}
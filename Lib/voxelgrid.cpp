@@ -0,0 +1,484 @@
+#include "voxelgrid.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QtConcurrent>
+#include <QDebug>
+#include <cstring>
+#include <cmath>
+
+#include "sceneresources.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VOXEL_SSE2
+#endif
+
+#define VOXEL_VERTEX_SHADER ":/BaseShaders/Lib/voxel_vsh.vert"
+#define VOXEL_FRAGMENT_SHADER ":/BaseShaders/Lib/voxel_fsh.frag"
+#define VOXEL_MAX_CELLS (1 << 24)
+#define VOXEL_TASK_POINTS 65536     // точек на задачу addParallel()
+#define CUBE_VERTICES 36
+#define INSTANCE_FLOATS 4
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+// раскладывает точки по вокселам, возвращает число попавших в коробку
+static quint64 binPoints(const float *xyz, size_t n, const float *origin, const float *scale, const int *size, quint32 *counts)
+{
+    quint64 binned = 0;
+    size_t i = 0;
+#ifdef VOXEL_SSE2
+    // 4 точки - 3 регистра, дорожка j регистра r хранит ось (4r + j) % 3
+    const __m128 o0 = _mm_setr_ps(origin[0], origin[1], origin[2], origin[0]);
+    const __m128 o1 = _mm_setr_ps(origin[1], origin[2], origin[0], origin[1]);
+    const __m128 o2 = _mm_setr_ps(origin[2], origin[0], origin[1], origin[2]);
+    const __m128 s0 = _mm_setr_ps(scale[0], scale[1], scale[2], scale[0]);
+    const __m128 s1 = _mm_setr_ps(scale[1], scale[2], scale[0], scale[1]);
+    const __m128 s2 = _mm_setr_ps(scale[2], scale[0], scale[1], scale[2]);
+    const __m128 n0 = _mm_setr_ps(float(size[0]), float(size[1]), float(size[2]), float(size[0]));
+    const __m128 n1 = _mm_setr_ps(float(size[1]), float(size[2]), float(size[0]), float(size[1]));
+    const __m128 n2 = _mm_setr_ps(float(size[2]), float(size[0]), float(size[1]), float(size[2]));
+    const __m128 zero = _mm_setzero_ps();
+    int voxel[12];
+    for (; i + 4 <= n; i += 4) {
+        const float *p = xyz + i * 3;
+        const __m128 v0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p), o0), s0);
+        const __m128 v1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p + 4), o1), s1);
+        const __m128 v2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p + 8), o2), s2);
+        // NaN не проходит ни одно сравнение
+        const int inside = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(v0, zero), _mm_cmplt_ps(v0, n0)))
+                | _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(v1, zero), _mm_cmplt_ps(v1, n1))) << 4
+                | _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(v2, zero), _mm_cmplt_ps(v2, n2))) << 8;
+        if (!inside)
+            continue;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(voxel), _mm_cvttps_epi32(v0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(voxel + 4), _mm_cvttps_epi32(v1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(voxel + 8), _mm_cvttps_epi32(v2));
+        for (int k = 0; k < 4; k++) {
+            if (((inside >> (k * 3)) & 7) != 7)
+                continue;
+            counts[(voxel[k * 3 + 2] * size[1] + voxel[k * 3 + 1]) * size[0] + voxel[k * 3]]++;
+            binned++;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        const float x = (xyz[i * 3] - origin[0]) * scale[0];
+        const float y = (xyz[i * 3 + 1] - origin[1]) * scale[1];
+        const float z = (xyz[i * 3 + 2] - origin[2]) * scale[2];
+        if (!(x >= 0.0f && x < size[0] && y >= 0.0f && y < size[1] && z >= 0.0f && z < size[2]))
+            continue;
+        counts[(int(z) * size[1] + int(y)) * size[0] + int(x)]++;
+        binned++;
+    }
+    return binned;
+}
+
+VoxelHistogram::VoxelHistogram(int nx, int ny, int nz)
+{
+    fSize[0] = qMax(1, nx);
+    fSize[1] = qMax(1, ny);
+    fSize[2] = qMax(1, nz);
+    if (qint64(fSize[0]) * fSize[1] * fSize[2] > VOXEL_MAX_CELLS) {
+        qDebug() << "VoxelHistogram: grid" << nx << ny << nz << "is too large, reduced to 256^3";
+        fSize[0] = qMin(fSize[0], 256);
+        fSize[1] = qMin(fSize[1], 256);
+        fSize[2] = qMin(fSize[2], 256);
+    }
+    for (int k = 0; k < 3; k++) {
+        fOrigin[k] = 0.0f;
+        fScale[k] = float(fSize[k]);
+    }
+}
+
+VoxelHistogram::~VoxelHistogram()
+{
+    qDeleteAll(fGrids);
+}
+
+void VoxelHistogram::setBox(const QVector3D &origin, const QVector3D &size)
+{
+    QMutexLocker locker(&fGridsMutex);
+    for (int k = 0; k < 3; k++) {
+        fOrigin[k] = origin[k];
+        fScale[k] = size[k] != 0.0f ? fSize[k] / size[k] : 0.0f;
+    }
+}
+
+VoxelHistogram::Grid *VoxelHistogram::takeGrid(float *origin, float *scale)
+{
+    QMutexLocker locker(&fGridsMutex);
+    for (int k = 0; k < 3; k++) {
+        origin[k] = fOrigin[k];
+        scale[k] = fScale[k];
+    }
+    // свободная сетка или новая, если все заняты другими потоками
+    for (Grid *grid : fGrids) {
+        if (grid->lock.tryLock())
+            return grid;
+    }
+    Grid *grid = new Grid();
+    grid->counts.fill(0, fSize[0] * fSize[1] * fSize[2]);
+    grid->total = 0;
+    grid->lock.lock();
+    fGrids.append(grid);
+    return grid;
+}
+
+void VoxelHistogram::add(const float *xyz, size_t n)
+{
+    if (!n)
+        return;
+    float origin[3];
+    float scale[3];
+    Grid *grid = takeGrid(origin, scale);
+    grid->total += binPoints(xyz, n, origin, scale, fSize, grid->counts.data());
+    grid->lock.unlock();
+}
+
+void VoxelHistogram::addParallel(const float *xyz, size_t n)
+{
+    if (n < 2 * VOXEL_TASK_POINTS) {
+        add(xyz, n);
+        return;
+    }
+
+    struct Range {
+        size_t first;
+        size_t count;
+    };
+    QVector<Range> ranges;
+    for (size_t first = 0; first < n; first += VOXEL_TASK_POINTS) {
+        const Range range = { first, qMin(size_t(VOXEL_TASK_POINTS), n - first) };
+        ranges.append(range);
+    }
+    QtConcurrent::blockingMap(ranges, [=](Range &range) {
+        add(xyz + range.first * 3, range.count);
+    });
+}
+
+void VoxelHistogram::clear()
+{
+    QMutexLocker locker(&fGridsMutex);
+    for (Grid *grid : fGrids) {
+        QMutexLocker gridLocker(&grid->lock);
+        grid->counts.fill(0);
+        grid->total = 0;
+    }
+}
+
+quint64 VoxelHistogram::total() const
+{
+    QMutexLocker locker(&fGridsMutex);
+    quint64 total = 0;
+    for (Grid *grid : fGrids) {
+        QMutexLocker gridLocker(&grid->lock);
+        total += grid->total;
+    }
+    return total;
+}
+
+void VoxelHistogram::merge(quint32 *counts) const
+{
+    const int cells = fSize[0] * fSize[1] * fSize[2];
+    memset(counts, 0, size_t(cells) * sizeof(quint32));
+
+    QMutexLocker locker(&fGridsMutex);
+    for (Grid *grid : fGrids) {
+        QMutexLocker gridLocker(&grid->lock);
+        const quint32 *from = grid->counts.constData();
+        int i = 0;
+#ifdef VOXEL_SSE2
+        for (; i + 4 <= cells; i += 4) {
+            __m128i *to = reinterpret_cast<__m128i*>(counts + i);
+            _mm_storeu_si128(to, _mm_add_epi32(_mm_loadu_si128(to), _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i))));
+        }
+#endif
+        for (; i < cells; i++)
+            counts[i] += from[i];
+    }
+}
+
+QVector<quint32> VoxelHistogram::counts() const
+{
+    QVector<quint32> counts(fSize[0] * fSize[1] * fSize[2]);
+    merge(counts.data());
+    return counts;
+}
+
+QVector<VoxelHistogram::Cell> VoxelHistogram::occupied(quint32 minCount, quint32 *maxCount) const
+{
+    const QVector<quint32> merged = counts();
+    QVector<Cell> cells;
+    quint32 max = 0;
+    minCount = qMax(minCount, 1u);
+    for (int i = 0; i < merged.count(); i++) {
+        if (merged[i] < minCount)
+            continue;
+        const Cell cell = { quint32(i), merged[i] };
+        cells.append(cell);
+        max = qMax(max, merged[i]);
+    }
+    if (maxCount)
+        *maxCount = max;
+    return cells;
+}
+
+VoxelGridSeries::VoxelGridSeries(const QString &name, int nx, int ny, int nz) : DataSeries(name), fHistogram(nx, ny, nz), fStale(1),
+    fOrigin(0.0f, 0.0f, 0.0f), fBoxSize(1.0f, 1.0f, 1.0f), fMinCount(1), fFill(0.8f), fColormapDirty(true), fOccupied(0), fMaxCount(0),
+    fCubeVbo(0), fInstanceVbo(0), fColormapTexture(0), fProgram(nullptr)
+{
+    fColormap = defaultColormap();
+    fHistogram.setBox(fOrigin, fBoxSize);
+}
+
+VoxelGridSeries::~VoxelGridSeries()
+{
+}
+
+void VoxelGridSeries::append(const float *xyz, size_t n)
+{
+    // без fMutex: потоки приёма пишут в свои сетки, отрисовка их не ждёт
+    fHistogram.addParallel(xyz, n);
+    fStale.storeRelease(1);
+}
+
+void VoxelGridSeries::clear()
+{
+    fHistogram.clear();
+    fStale.storeRelease(1);
+}
+
+int VoxelGridSeries::occupiedCount() const
+{
+    QMutexLocker locker(&fMutex);
+    return fOccupied;
+}
+
+void VoxelGridSeries::setGeometry(const QVector3D &origin, const QVector3D &size)
+{
+    QMutexLocker locker(&fMutex);
+    fOrigin = origin;
+    fBoxSize = size;
+    fHistogram.setBox(origin, size);
+}
+
+void VoxelGridSeries::setMinCount(quint32 count)
+{
+    QMutexLocker locker(&fMutex);
+    fMinCount = qMax(count, 1u);
+    fStale.storeRelease(1);
+}
+
+void VoxelGridSeries::setFill(float fraction)
+{
+    QMutexLocker locker(&fMutex);
+    fFill = qBound(0.05f, fraction, 1.0f);
+}
+
+void VoxelGridSeries::setColormap(const QVector<QRgb> &colors)
+{
+    if (colors.isEmpty())
+        return;
+    QMutexLocker locker(&fMutex);
+    fColormap = colors;
+    fColormapDirty = true;
+}
+
+bool VoxelGridSeries::bounds(QVector3D *min, QVector3D *max) const
+{
+    if (!fHistogram.total())
+        return false;
+    QMutexLocker locker(&fMutex);
+    const QVector3D end = fOrigin + fBoxSize;
+    *min = QVector3D(qMin(fOrigin.x(), end.x()), qMin(fOrigin.y(), end.y()), qMin(fOrigin.z(), end.z()));
+    *max = QVector3D(qMax(fOrigin.x(), end.x()), qMax(fOrigin.y(), end.y()), qMax(fOrigin.z(), end.z()));
+    return true;
+}
+
+void VoxelGridSeries::createCube()
+{
+    // 6 граней по 2 треугольника: угол -0.5..0.5 и нормаль грани
+    float vertices[CUBE_VERTICES * 6];
+    static const float corners[6][2] = { {-1, -1}, {1, -1}, {1, 1}, {-1, -1}, {1, 1}, {-1, 1} };
+    float *out = vertices;
+    for (int axis = 0; axis < 3; axis++) {
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+        for (int side = -1; side <= 1; side += 2) {
+            for (int c = 0; c < 6; c++) {
+                out[axis] = 0.5f * side;
+                out[u] = 0.5f * corners[c][0];
+                out[v] = 0.5f * corners[c][1];
+                out[3 + axis] = float(side);
+                out[3 + u] = 0.0f;
+                out[3 + v] = 0.0f;
+                out += 6;
+            }
+        }
+    }
+
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    f->glGenBuffers(1, &fCubeVbo);
+    f->glBindBuffer(GL_ARRAY_BUFFER, fCubeVbo);
+    f->glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    fUploadedBytes += sizeof(vertices);
+}
+
+static QOpenGLShaderProgram *createVoxelProgram()
+{
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, VOXEL_VERTEX_SHADER))
+        qDebug() << "VertexShader:" << program->log();
+    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, VOXEL_FRAGMENT_SHADER))
+        qDebug() << "FragmentShader:" << program->log();
+    // атрибут 0 в профиле совместимости не делится между экземплярами
+    program->bindAttributeLocation("qt_Vertex", 0);
+    program->link();
+    return program;
+}
+
+void VoxelGridSeries::draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix)
+{
+    Q_UNUSED(program);
+
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    SceneResources *resources = SceneResources::current();
+    if (!ctx || !resources)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (!fVisible)
+        return;
+
+    if (!fProgram)
+        fProgram = resources->acquire<QOpenGLShaderProgram>("program:" VOXEL_VERTEX_SHADER ":" VOXEL_FRAGMENT_SHADER, createVoxelProgram);
+    if (!fCubeVbo)
+        createCube();
+    if (!fInstanceVbo) {
+        f->glGenBuffers(1, &fInstanceVbo);
+        fStale.storeRelease(1);
+    }
+
+    // слияние частных сеток - не чаще раза в кадр и только после новых точек
+    if (fStale.testAndSetOrdered(1, 0)) {
+        quint32 maxCount = 0;
+        const QVector<VoxelHistogram::Cell> cells = fHistogram.occupied(fMinCount, &maxCount);
+        const int nx = fHistogram.size(0);
+        const int ny = fHistogram.size(1);
+        QVector<float> instances(cells.count() * INSTANCE_FLOATS);
+        float *out = instances.data();
+        for (const VoxelHistogram::Cell &cell : cells) {
+            *out++ = float(cell.index % quint32(nx));
+            *out++ = float(cell.index / quint32(nx) % quint32(ny));
+            *out++ = float(cell.index / quint32(nx * ny));
+            *out++ = float(cell.count);
+        }
+        const GLsizeiptr bytes = GLsizeiptr(instances.count()) * GLsizeiptr(sizeof(float));
+        f->glBindBuffer(GL_ARRAY_BUFFER, fInstanceVbo);
+        f->glBufferData(GL_ARRAY_BUFFER, bytes, instances.constData(), GL_DYNAMIC_DRAW);
+        fUploadedBytes += quint64(bytes);
+        fOccupied = cells.count();
+        fMaxCount = maxCount;
+    }
+    if (!fOccupied) {
+        f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return;
+    }
+
+    f->glActiveTexture(GL_TEXTURE0);
+    if (!fColormapTexture) {
+        f->glGenTextures(1, &fColormapTexture);
+        glBindTexture(GL_TEXTURE_1D, fColormapTexture);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        fColormapDirty = true;
+    }
+    else
+        glBindTexture(GL_TEXTURE_1D, fColormapTexture);
+    if (fColormapDirty) {
+        uploadColormap(fColormap);
+        fColormapDirty = false;
+    }
+
+    // вершины в единицах вокселов, коробка переносится в матрицу
+    const QVector3D cells(fHistogram.size(0), fHistogram.size(1), fHistogram.size(2));
+    QMatrix4x4 box;
+    box.translate(fOrigin);
+    box.scale(fBoxSize / cells);
+    const bool instanced = !ctx->isOpenGLES() && ctx->format().version() >= qMakePair(3, 3);
+
+    fProgram->bind();
+    fProgram->setUniformValue("Matrix", pmvMatrix * box);
+    fProgram->setUniformValue("colormap", 0);
+    fProgram->setUniformValue("logScale", fMaxCount > 1 ? 1.0f / std::log(float(fMaxCount)) : 0.0f);
+    const int vertexLocation = fProgram->attributeLocation("qt_Vertex");
+    const int normalLocation = fProgram->attributeLocation("qt_Normal");
+    const int voxelLocation = fProgram->attributeLocation("qt_Voxel");
+    f->glBindBuffer(GL_ARRAY_BUFFER, fInstanceVbo);
+    fProgram->enableAttributeArray(voxelLocation);
+    fProgram->setAttributeBuffer(voxelLocation, GL_FLOAT, 0, INSTANCE_FLOATS, INSTANCE_FLOATS * sizeof(float));
+    f->glEnable(GL_DEPTH_TEST);
+
+    if (instanced) {
+        QOpenGLExtraFunctions *ef = ctx->extraFunctions();
+        fProgram->setUniformValue("fill", fFill);
+        ef->glVertexAttribDivisor(GLuint(voxelLocation), 1);
+        f->glBindBuffer(GL_ARRAY_BUFFER, fCubeVbo);
+        fProgram->enableAttributeArray(vertexLocation);
+        fProgram->enableAttributeArray(normalLocation);
+        fProgram->setAttributeBuffer(vertexLocation, GL_FLOAT, 0, 3, 6 * sizeof(float));
+        fProgram->setAttributeBuffer(normalLocation, GL_FLOAT, 3 * sizeof(float), 3, 6 * sizeof(float));
+        ef->glDrawArraysInstanced(GL_TRIANGLES, 0, CUBE_VERTICES, fOccupied);
+        ef->glVertexAttribDivisor(GLuint(voxelLocation), 0);
+        fProgram->disableAttributeArray(normalLocation);
+    }
+    else {
+        // центры вокселов точками: атрибут 0 должен быть массивом, fill = 0 его обнуляет
+        fProgram->setUniformValue("fill", 0.0f);
+        fProgram->enableAttributeArray(vertexLocation);
+        fProgram->setAttributeBuffer(vertexLocation, GL_FLOAT, 0, 3, INSTANCE_FLOATS * sizeof(float));
+        fProgram->setAttributeValue(normalLocation, 0.0f, 0.0f, 1.0f);
+        glPointSize(fPointSize);
+        f->glDrawArrays(GL_POINTS, 0, fOccupied);
+    }
+
+    fProgram->disableAttributeArray(vertexLocation);
+    fProgram->disableAttributeArray(voxelLocation);
+    fProgram->release();
+    glBindTexture(GL_TEXTURE_1D, 0);
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VoxelGridSeries::releaseGL()
+{
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return;
+
+    QOpenGLFunctions *f = ctx->functions();
+    QMutexLocker locker(&fMutex);
+    if (fCubeVbo)
+        f->glDeleteBuffers(1, &fCubeVbo);
+    if (fInstanceVbo)
+        f->glDeleteBuffers(1, &fInstanceVbo);
+    if (fColormapTexture)
+        f->glDeleteTextures(1, &fColormapTexture);
+    fCubeVbo = fInstanceVbo = fColormapTexture = 0;
+    fOccupied = 0;
+    fColormapDirty = true;
+
+    if (fProgram) {
+        SceneResources *resources = SceneResources::current();
+        if (resources)
+            resources->release("program:" VOXEL_VERTEX_SHADER ":" VOXEL_FRAGMENT_SHADER);
+        fProgram = nullptr;
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef VOXELGRID_H
+#define VOXELGRID_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "dataseries.h"
+
+// Counts of points per voxel of a nx * ny * nz grid over a box. add() may be
+// called from any number of threads at once: each call bins into a private grid
+// of its own (a free one is taken, a new one is made when all are busy), so the
+// ingest threads never contend on the counters. Coordinates are converted to
+// voxels with SSE2, 4 points in 3 registers. The private grids are summed only
+// when the result is asked for. Points outside the box are not counted.
+class VoxelHistogram
+{
+public:
+    struct Cell {
+        quint32 index;      // (z * ny + y) * nx + x
+        quint32 count;
+    };
+
+    VoxelHistogram(int nx, int ny, int nz);     // at most 2^24 voxels
+    ~VoxelHistogram();
+
+    int size(int axis) const { return fSize[axis]; }
+    void setBox(const QVector3D &origin, const QVector3D &size);    // applies to the next points
+    void add(const float *xyz, size_t n);           // on the calling thread
+    void addParallel(const float *xyz, size_t n);   // a large batch split over the global pool, blocks
+    void clear();
+
+    quint64 total() const;                  // points counted
+    QVector<quint32> counts() const;        // merged, x-fastest
+    QVector<Cell> occupied(quint32 minCount, quint32 *maxCount) const;  // merged voxels with count >= minCount
+
+private:
+    struct Grid {
+        QMutex lock;        // held by the binning thread
+        QVector<quint32> counts;
+        quint64 total;
+    };
+
+    int fSize[3];
+    mutable QMutex fGridsMutex;
+    QVector<Grid*> fGrids;
+    float fOrigin[3];
+    float fScale[3];        // voxels per unit
+
+    Grid *takeGrid(float *origin, float *scale);   // locked, with the box of the moment
+    void merge(quint32 *counts) const;
+
+    Q_DISABLE_COPY(VoxelHistogram)
+};
+
+// Occupancy / heat view of a VoxelHistogram over a box of the scene (the
+// SpaceData box by default). Voxels with at least minCount points are drawn as
+// cubes colored by the log of the count, one instanced draw call: a cube mesh
+// and a buffer of the occupied voxels only, empty ones cost nothing. The
+// histogram is merged by draw() when points were added since the previous frame.
+// Needs instanced arrays (GL 3.3), without them the voxels are drawn as points.
+// append() and clear() may be called from any thread.
+class VoxelGridSeries : public DataSeries
+{
+public:
+    VoxelGridSeries(const QString &name, int nx, int ny, int nz);
+    ~VoxelGridSeries();     // releaseGL() must be called before if the series was drawn
+
+    void append(const float *xyz, size_t n);
+    void append(const QVector<QVector3D> &points) { append(reinterpret_cast<const float*>(points.constData()), size_t(points.count())); }
+    void clear();
+
+    const VoxelHistogram &histogram() const { return fHistogram; }
+    quint64 count() const { return fHistogram.total(); }
+    int occupiedCount() const;              // voxels drawn in the last frame
+    void setGeometry(const QVector3D &origin, const QVector3D &size);
+    void setMinCount(quint32 count);        // 1 by default
+    void setFill(float fraction);           // cube side, part of the voxel, 0.8 by default
+    void setColormap(const QVector<QRgb> &colors);  // from 1 point to the largest count, log scale
+    bool bounds(QVector3D *min, QVector3D *max) const override;
+
+    void draw(QOpenGLShaderProgram *program, const QMatrix4x4 &pmvMatrix) override;
+    void releaseGL() override;
+
+private:
+    VoxelHistogram fHistogram;
+    QAtomicInt fStale;      // points added after the last merge
+    QVector3D fOrigin;
+    QVector3D fBoxSize;
+    quint32 fMinCount;
+    float fFill;
+    QVector<QRgb> fColormap;
+    bool fColormapDirty;
+    int fOccupied;          // instances in fInstanceVbo
+    quint32 fMaxCount;
+    GLuint fCubeVbo;
+    GLuint fInstanceVbo;
+    GLuint fColormapTexture;
+    QOpenGLShaderProgram *fProgram;
+
+    void createCube();
+};
+
+#endif // VOXELGRID_H
@@ -0,0 +1,8 @@
+#version 120
+uniform sampler1D colormap;
+varying float level;
+
+void main(void)
+{
+	gl_FragColor = texture1D(colormap, level);
+}
@@ -0,0 +1,22 @@
+#version 120
+attribute vec2 qt_Vertex;   // x - column, y - age of the row (0 - the newest)
+uniform mat4 Matrix;
+uniform sampler2D heights;  // ring of rows, one texture row per data row
+uniform float columns;
+uniform float rows;
+uniform float head;         // texture row of the newest data row
+uniform vec3 origin;
+uniform vec3 size;
+uniform float valueMin;
+uniform float valueScale;   // 1 / (max - min)
+varying float level;
+
+void main(void)
+{
+	float row = mod(head - qt_Vertex.y + rows, rows);
+	vec2 texel = vec2((qt_Vertex.x + 0.5) / columns, (row + 0.5) / rows);
+	float value = texture2DLod(heights, texel, 0.0).r;
+	level = clamp((value - valueMin) * valueScale, 0.0, 1.0);
+	vec3 position = vec3(qt_Vertex.x / max(columns - 1.0, 1.0), qt_Vertex.y / max(rows - 1.0, 1.0), level);
+	gl_Position = Matrix * vec4( origin + position * size, 1.0 );
+}
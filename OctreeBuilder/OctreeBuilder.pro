@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Offline builder of the tiled point octree
+# (Lib/pointoctreefile.h) from raw point files,
+# links only the GL-free part of Lib
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       -= widgets
+
+TARGET = OctreeBuilder
+TEMPLATE = app
+CONFIG += console c++11 release
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+        ../Lib/pointoctreefile.cpp \
+        ../Lib/spritepack.cpp \
+        main.cpp
+
+HEADERS += \
+        ../Lib/gl_pointsprites.h \
+        ../Lib/pointoctreefile.h
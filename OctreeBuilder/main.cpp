@@ -0,0 +1,77 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QVector>
+#include <cstdio>
+#include <cstring>
+
+#include "../Lib/pointoctreefile.h"
+
+#define READ_POINTS (1024 * 1024)
+
+// Input files are raw little-endian records: float x, y, z and, with --rgba,
+// four color bytes r, g, b, a after them.
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("OctreeBuilder");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Builds a point octree file from raw point files");
+    parser.addHelpOption();
+    parser.addPositionalArgument("output", "Octree file to write");
+    parser.addPositionalArgument("inputs", "Raw point files", "inputs...");
+    QCommandLineOption rgbaOption("rgba", "Records have an RGBA color after xyz");
+    QCommandLineOption sizeOption("point-size", "Point size in pixels", "px", "2");
+    parser.addOption(rgbaOption);
+    parser.addOption(sizeOption);
+    parser.process(a);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.count() < 2)
+        parser.showHelp(1);
+
+    const bool rgba = parser.isSet(rgbaOption);
+    const int recordSize = rgba ? 16 : 12;
+    PointOctreeBuilder builder(parser.value(sizeOption).toFloat());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray buffer(READ_POINTS * recordSize, Qt::Uninitialized);
+    QVector<float> xyz(READ_POINTS * 3);
+    QVector<QRgb> colors(READ_POINTS);
+    for (int i = 1; i < args.count(); i++) {
+        QFile input(args[i]);
+        if (!input.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "cannot open %s: %s\n", qPrintable(args[i]), qPrintable(input.errorString()));
+            return 1;
+        }
+
+        qint64 read;
+        while ((read = input.read(buffer.data(), buffer.size())) > 0) {
+            const int n = int(read / recordSize);
+            const char *record = buffer.constData();
+            for (int p = 0; p < n; p++, record += recordSize) {
+                memcpy(&xyz[p * 3], record, 12);
+                if (rgba) {
+                    const uchar *c = reinterpret_cast<const uchar*>(record + 12);
+                    colors[p] = qRgba(c[0], c[1], c[2], c[3]);
+                }
+            }
+            if (!builder.add(xyz.constData(), rgba ? colors.constData() : nullptr, n)) {
+                fprintf(stderr, "%s\n", qPrintable(builder.errorString()));
+                return 1;
+            }
+        }
+    }
+
+    printf("%llu points read in %.1f s\n", builder.count(), timer.elapsed() / 1000.0);
+    if (!builder.build(args[0])) {
+        fprintf(stderr, "%s\n", qPrintable(builder.errorString()));
+        return 1;
+    }
+    printf("%d nodes written in %.1f s\n", builder.nodeCount(), timer.elapsed() / 1000.0);
+    return 0;
+}
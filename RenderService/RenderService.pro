@@ -0,0 +1,48 @@
+#-------------------------------------------------
+#
+# Local render service: serves BaseScene3D snapshots
+# rendered offscreen over a local socket
+#
+#-------------------------------------------------
+
+QT       += core gui network
+
+TARGET = RenderService
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += \
+        ../Lib/basescenecore.cpp \
+        ../Lib/gl_pointsprites.cpp \
+        ../Lib/gl_primitives.cpp \
+        ../Lib/gl_streambuffer.cpp \
+        ../Lib/offscreenscene3d.cpp \
+        ../Lib/sceneresources.cpp \
+        ../Lib/spritepack.cpp \
+        main.cpp \
+        renderprotocol.cpp \
+        renderserver.cpp \
+        renderworker.cpp
+
+HEADERS += \
+        ../Lib/basescenecore.h \
+        ../Lib/gl_pointsprites.h \
+        ../Lib/gl_primitives.h \
+        ../Lib/gl_streambuffer.h \
+        ../Lib/offscreenscene3d.h \
+        ../Lib/sceneresources.h \
+        renderprotocol.h \
+        renderserver.h \
+        renderworker.h
+
+win32 {
+   LIBS += -lopengl32
+} else {
+    LIBS += -lGLU
+}
+
+RESOURCES += \
+    ../shaders.qrc
@@ -0,0 +1,29 @@
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QThread>
+
+#include "renderserver.h"
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication a(argc, argv);
+    a.setApplicationName("RenderService");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders scene snapshots on request over a local socket");
+    parser.addHelpOption();
+    QCommandLineOption nameOption(QStringList() << "n" << "name", "Local socket name.", "name", "scene3d-render");
+    QCommandLineOption workersOption(QStringList() << "w" << "workers", "Number of render threads.", "count", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption statsOption(QStringList() << "s" << "stats", "Throughput report interval, ms.", "ms", "5000");
+    parser.addOption(nameOption);
+    parser.addOption(workersOption);
+    parser.addOption(statsOption);
+    parser.process(a);
+
+    RenderServer server(parser.value(nameOption), parser.value(workersOption).toInt());
+    server.setStatsInterval(parser.value(statsOption).toInt());
+    if (!server.listen())
+        return 1;
+
+    return a.exec();
+}
@@ -0,0 +1,140 @@
+#include "renderprotocol.h"
+
+#include <QtEndian>
+#include <QCryptographicHash>
+
+// type, drawType, segments, size, pos, direction и QColor (spec и 5 компонент)
+#define RENDER_PRIMITIVE_MIN_SIZE (1 + 1 + 4 + 3 * 4 + 2 * 3 * 4 + 1 + 5 * 2)
+
+void initRenderStream(QDataStream &stream)
+{
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+}
+
+QDataStream &operator<<(QDataStream &out, const RenderPrimitive &p)
+{
+    out << p.type << p.drawType << p.segments << p.size[0] << p.size[1] << p.size[2] << p.pos << p.direction << p.color;
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, RenderPrimitive &p)
+{
+    in >> p.type >> p.drawType >> p.segments >> p.size[0] >> p.size[1] >> p.size[2] >> p.pos >> p.direction >> p.color;
+    return in;
+}
+
+static void writeScales(QDataStream &out, const RenderRequest &r)
+{
+    out << r.space.x << r.space.y << r.space.z << r.space.xLength << r.space.yLength << r.space.zLength;
+    for (int i = 0; i < BaseSceneCore::slCount; i++)
+        out << r.scales[i].start << r.scales[i].length << r.scales[i].step << qint32(r.scales[i].precision);
+}
+
+QDataStream &operator<<(QDataStream &out, const RenderRequest &r)
+{
+    const BaseSceneCore::CameraState &c = r.camera;
+    out << quint8(RENDER_PROTOCOL_VERSION) << r.id << r.size << r.format;
+    out << c.xRotate << c.yRotate << c.zRotate << c.xTransl << c.yTransl << c.zTransl << c.nScale << c.zCam;
+    writeScales(out, r);
+    out << r.primitives;
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, RenderRequest &r)
+{
+    quint8 version;
+    in >> version;
+    if (version != RENDER_PROTOCOL_VERSION) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return in;
+    }
+
+    BaseSceneCore::CameraState &c = r.camera;
+    in >> r.id >> r.size >> r.format;
+    in >> c.xRotate >> c.yRotate >> c.zRotate >> c.xTransl >> c.yTransl >> c.zTransl >> c.nScale >> c.zCam;
+    in >> r.space.x >> r.space.y >> r.space.z >> r.space.xLength >> r.space.yLength >> r.space.zLength;
+    for (int i = 0; i < BaseSceneCore::slCount; i++) {
+        qint32 precision;
+        in >> r.scales[i].start >> r.scales[i].length >> r.scales[i].step >> precision;
+        r.scales[i].precision = precision;
+    }
+
+    // число элементов приходит от клиента: проверяется до выделения памяти
+    quint32 count;
+    in >> count;
+    if (in.status() != QDataStream::Ok)
+        return in;
+    if (count > RENDER_MAX_MESSAGE_SIZE / RENDER_PRIMITIVE_MIN_SIZE) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return in;
+    }
+    r.primitives.clear();
+    for (quint32 i = 0; i < count; i++) {
+        RenderPrimitive p;
+        in >> p;
+        if (in.status() != QDataStream::Ok)
+            break;
+        r.primitives.append(p);
+    }
+    return in;
+}
+
+QDataStream &operator<<(QDataStream &out, const RenderResponse &r)
+{
+    out << r.id << r.status << r.renderTime << r.image;
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, RenderResponse &r)
+{
+    in >> r.id >> r.status >> r.renderTime >> r.image;
+    return in;
+}
+
+QByteArray RenderRequest::scalesKey() const
+{
+    QByteArray key;
+    QDataStream out(&key, QIODevice::WriteOnly);
+    initRenderStream(out);
+    writeScales(out, *this);
+    return key;
+}
+
+QByteArray RenderRequest::primitivesKey() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    initRenderStream(out);
+    out << primitives;
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+QByteArray packMessage(const QByteArray &payload)
+{
+    QByteArray message(4, Qt::Uninitialized);
+    qToBigEndian<quint32>(quint32(payload.size()), reinterpret_cast<uchar*>(message.data()));
+    message.append(payload);
+    return message;
+}
+
+bool unpackMessage(QByteArray &buffer, QByteArray &payload, bool *error)
+{
+    if (error)
+        *error = false;
+    if (buffer.size() < 4)
+        return false;
+
+    quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(buffer.constData()));
+    if (size > RENDER_MAX_MESSAGE_SIZE) {
+        if (error)
+            *error = true;
+        return false;
+    }
+    if (quint32(buffer.size()) < size + 4)
+        return false;
+
+    payload = buffer.mid(4, int(size));
+    buffer.remove(0, int(size) + 4);
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef RENDERPROTOCOL_H
+#define RENDERPROTOCOL_H
+
+#include <QDataStream>
+#include <QVector>
+#include <QVector3D>
+#include <QColor>
+#include <QSize>
+
+#include "../Lib/basescenecore.h"
+
+// Every message on the socket is a quint32 payload length followed by the payload.
+// Payloads are QDataStream (Qt_5_6) serialized RenderRequest / RenderResponse.
+#define RENDER_PROTOCOL_VERSION 1
+#define RENDER_MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+
+struct RenderPrimitive {
+    enum Type {
+        rpSphere,
+        rpCone,
+        rpCylinder,
+        rpSimpleArrow
+    };
+
+    quint8 type;
+    quint8 drawType;    // DrawType
+    qint32 segments;
+    float size[3];      // sphere: radiusX, radiusY, radiusZ; cone, cylinder: height, radius; arrow: height, arrowHeight, radius
+    QVector3D pos;
+    QVector3D direction;
+    QColor color;
+    RenderPrimitive() : type(rpSphere), drawType(dtSurface), segments(12), direction(0.0f, 0.0f, 1.0f), color(Qt::black) { size[0] = size[1] = size[2] = 1.0f; }
+};
+
+struct RenderRequest {
+    enum ImageFormat {
+        ifPng,
+        ifJpeg,
+        ifRaw       // QImage::Format_ARGB32_Premultiplied bits
+    };
+
+    quint32 id;
+    QSize size;
+    quint8 format;
+    BaseSceneCore::CameraState camera;
+    BaseSceneCore::SpaceData space;
+    BaseSceneCore::ScaleSettings scales[BaseSceneCore::slCount];
+    QVector<RenderPrimitive> primitives;
+    RenderRequest() : id(0), size(640, 480), format(ifPng) {}
+
+    QByteArray scalesKey() const;       // одинаковые ключи - одинаковые подписи шкал
+    QByteArray primitivesKey() const;   // одинаковые ключи - одинаковые сетки примитивов
+};
+
+struct RenderResponse {
+    enum Status {
+        rsOk,
+        rsBadRequest,
+        rsRenderFailed
+    };
+
+    quint32 id;
+    quint8 status;
+    qint32 renderTime;  // ms
+    QByteArray image;
+    RenderResponse() : id(0), status(rsOk), renderTime(0) {}
+};
+
+QDataStream &operator<<(QDataStream &out, const RenderPrimitive &p);
+QDataStream &operator>>(QDataStream &in, RenderPrimitive &p);
+QDataStream &operator<<(QDataStream &out, const RenderRequest &r);
+QDataStream &operator>>(QDataStream &in, RenderRequest &r);
+QDataStream &operator<<(QDataStream &out, const RenderResponse &r);
+QDataStream &operator>>(QDataStream &in, RenderResponse &r);
+
+void initRenderStream(QDataStream &stream);
+QByteArray packMessage(const QByteArray &payload);
+bool unpackMessage(QByteArray &buffer, QByteArray &payload, bool *error = nullptr); // false - message is not complete yet
+
+#endif // RENDERPROTOCOL_H
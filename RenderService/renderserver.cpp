@@ -0,0 +1,152 @@
+#include "renderserver.h"
+#include "renderworker.h"
+#include "renderprotocol.h"
+
+#include <QLocalSocket>
+#include <QThread>
+#include <QDebug>
+
+RenderServer::RenderServer(const QString &name, int workerCount, QObject *parent) : QObject(parent), fName(name),
+    fRequests(0), fFailed(0), fRenderTime(0)
+{
+    qRegisterMetaType<quintptr>("quintptr");
+
+    for (int i = 0; i < qMax(1, workerCount); i++) {
+        QThread *thread = new QThread(this);
+        RenderWorker *worker = new RenderWorker();   // offscreen surface is created here, on the GUI thread
+        worker->moveToThread(thread);
+        connect(worker, SIGNAL(rendered(QByteArray,quintptr,qint64,bool)), this, SLOT(rendered(QByteArray,quintptr,qint64,bool)));
+        thread->start();
+        QMetaObject::invokeMethod(worker, "initialize", Qt::QueuedConnection);
+
+        fThreads.append(thread);
+        fWorkers.append(worker);
+        fIdleWorkers.append(worker);
+    }
+
+    connect(&fServer, SIGNAL(newConnection()), this, SLOT(newConnection()));
+
+    fStatsTimer.setInterval(5000);
+    connect(&fStatsTimer, SIGNAL(timeout()), this, SLOT(reportStats()));
+}
+
+RenderServer::~RenderServer()
+{
+    fServer.close();
+    for (int i = 0; i < fWorkers.count(); i++) {
+        QMetaObject::invokeMethod(fWorkers[i], "release", Qt::BlockingQueuedConnection);
+        fThreads[i]->quit();
+        fThreads[i]->wait();
+        delete fWorkers[i];
+    }
+}
+
+bool RenderServer::listen()
+{
+    QLocalServer::removeServer(fName);
+    if (!fServer.listen(fName)) {
+        qWarning() << "RenderServer: cannot listen on" << fName << fServer.errorString();
+        return false;
+    }
+
+    qInfo() << "RenderServer: listening on" << fServer.fullServerName() << "with" << fWorkers.count() << "workers";
+    fStatsClock.start();
+    fStatsTimer.start();
+    return true;
+}
+
+void RenderServer::newConnection()
+{
+    while (QLocalSocket *socket = fServer.nextPendingConnection()) {
+        quintptr tag = quintptr(socket);
+        fSockets.insert(tag, socket);
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(disconnected()));
+    }
+}
+
+void RenderServer::readyRead()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket)
+        return;
+
+    quintptr tag = quintptr(socket);
+    QByteArray &buffer = fBuffers[tag];
+    buffer.append(socket->readAll());
+
+    QByteArray payload;
+    bool error = false;
+    while (unpackMessage(buffer, payload, &error)) {
+        Job job;
+        job.tag = tag;
+        job.payload = payload;
+        fJobs.enqueue(job);
+    }
+
+    if (error) {
+        qWarning() << "RenderServer: message is too large, closing connection";
+        socket->abort();
+        return;
+    }
+
+    dispatch();
+}
+
+void RenderServer::disconnected()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket)
+        return;
+
+    quintptr tag = quintptr(socket);
+    fSockets.remove(tag);
+    fBuffers.remove(tag);
+    socket->deleteLater();
+}
+
+void RenderServer::rendered(QByteArray payload, quintptr tag, qint64 renderTime, bool ok)
+{
+    RenderWorker *worker = qobject_cast<RenderWorker*>(sender());
+    if (worker)
+        fIdleWorkers.append(worker);
+
+    fRequests++;
+    if (!ok)
+        fFailed++;
+    fRenderTime += renderTime;
+
+    QLocalSocket *socket = fSockets.value(tag);
+    if (socket)
+        socket->write(packMessage(payload));
+
+    dispatch();
+}
+
+void RenderServer::dispatch()
+{
+    while (!fJobs.isEmpty() && !fIdleWorkers.isEmpty()) {
+        Job job = fJobs.dequeue();
+        if (!fSockets.contains(job.tag))
+            continue;   // client is gone
+
+        RenderWorker *worker = fIdleWorkers.takeFirst();
+        QMetaObject::invokeMethod(worker, "render", Qt::QueuedConnection, Q_ARG(QByteArray, job.payload), Q_ARG(quintptr, job.tag));
+    }
+}
+
+void RenderServer::reportStats()
+{
+    qint64 elapsed = fStatsClock.restart();
+    if (elapsed <= 0)
+        return;
+
+    double rps = fRequests * 1000.0 / elapsed;
+    double avg = fRequests ? double(fRenderTime) / fRequests : 0.0;
+    qInfo("RenderServer: %.1f requests/s, %.1f ms average render, %llu failed, %d queued",
+          rps, avg, (unsigned long long)fFailed, fJobs.count());
+
+    fRequests = 0;
+    fFailed = 0;
+    fRenderTime = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef RENDERSERVER_H
+#define RENDERSERVER_H
+
+#include <QObject>
+#include <QLocalServer>
+#include <QQueue>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class QLocalSocket;
+class QThread;
+class RenderWorker;
+
+// Accepts render requests on a local (UNIX domain) socket and distributes
+// them to a pool of render workers, each with its own thread and context.
+class RenderServer : public QObject
+{
+    Q_OBJECT
+public:
+    RenderServer(const QString &name, int workerCount, QObject *parent = nullptr);
+    ~RenderServer();
+
+    bool listen();
+    void setStatsInterval(int ms) { fStatsTimer.setInterval(ms); }
+
+private slots:
+    void newConnection();
+    void readyRead();
+    void disconnected();
+    void rendered(QByteArray payload, quintptr tag, qint64 renderTime, bool ok);
+    void reportStats();
+
+private:
+    struct Job {
+        quintptr tag;
+        QByteArray payload;
+    };
+
+    QString fName;
+    QLocalServer fServer;
+    QList<QThread*> fThreads;
+    QList<RenderWorker*> fWorkers;
+    QList<RenderWorker*> fIdleWorkers;
+    QQueue<Job> fJobs;
+    QHash<quintptr, QLocalSocket*> fSockets;
+    QHash<quintptr, QByteArray> fBuffers;
+
+    QTimer fStatsTimer;
+    QElapsedTimer fStatsClock;
+    quint64 fRequests;
+    quint64 fFailed;
+    qint64 fRenderTime;
+
+    void dispatch();
+};
+
+#endif // RENDERSERVER_H
@@ -0,0 +1,166 @@
+#include "renderworker.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#define MAX_IMAGE_SIDE 8192
+
+ServiceScene::ServiceScene() : fPrimitives(nullptr), fCacheHits(0), fCacheMisses(0)
+{
+}
+
+ServiceScene::~ServiceScene()
+{
+    // GL resources are freed by releaseResources() on the render thread
+}
+
+void ServiceScene::releaseResources()
+{
+    if (makeCurrent()) {
+        delete fPrimitives;
+        fPrimitives = nullptr;
+    }
+    release();
+}
+
+QImage ServiceScene::render(const RenderRequest &request)
+{
+    if (!makeCurrent())
+        return QImage();
+
+    applyScales(request);
+    applyPrimitives(request);
+
+    return renderToImage(request.size, request.camera);
+}
+
+void ServiceScene::paintData(const QMatrix4x4 &pmvMatrix)
+{
+    if (fPrimitives)
+        fPrimitives->drawPrimitives(pmvMatrix);
+}
+
+void ServiceScene::applyScales(const RenderRequest &request)
+{
+    QByteArray key = request.scalesKey();
+    if (key == fScalesKey) {
+        fCacheHits++;
+        return;
+    }
+    fCacheMisses++;
+    fScalesKey = key;
+
+    const SpaceData &s = request.space;
+    setSpaceData(s.x, s.y, s.z, s.xLength, s.yLength, s.zLength);
+
+    const ScaleSettings *sc = request.scales;
+    updateXScaleValues(sc[slX].start, sc[slX].start + sc[slX].length, sc[slX].step, sc[slX].precision);
+    updateYScaleValues(sc[slY].start, sc[slY].start + sc[slY].length, sc[slY].step, sc[slY].precision);
+    updateZScaleValues(sc[slZ].start, sc[slZ].start + sc[slZ].length, sc[slZ].step, sc[slZ].precision);
+}
+
+void ServiceScene::applyPrimitives(const RenderRequest &request)
+{
+    QByteArray key = request.primitivesKey();
+    if (key == fPrimitivesKey) {
+        fCacheHits++;
+        return;
+    }
+    fCacheMisses++;
+    fPrimitivesKey = key;
+
+    if (!fPrimitives) {
+        fPrimitives = new PrimitiveManager();
+        fPrimitives->compileShaders(":/BaseShaders/Lib/base_vsh.vert", ":/BaseShaders/Lib/base_fsh.frag");
+    }
+    fPrimitives->clear();
+
+    foreach (const RenderPrimitive &rp, request.primitives) {
+        int segments = qBound(3, int(rp.segments), 256);
+        Primitive *p = nullptr;
+        switch (rp.type) {
+        case RenderPrimitive::rpSphere:
+            p = fPrimitives->addSphere(segments, rp.size[0], rp.size[1], rp.size[2], rp.direction);
+            break;
+        case RenderPrimitive::rpCone:
+            p = fPrimitives->addCone(segments, rp.size[0], rp.size[1], rp.direction);
+            break;
+        case RenderPrimitive::rpCylinder:
+            p = fPrimitives->addCylinder(segments, rp.size[0], rp.size[1], rp.direction);
+            break;
+        case RenderPrimitive::rpSimpleArrow:
+            p = fPrimitives->addSimpleArrow(segments, rp.size[0], rp.size[1], rp.size[2], rp.direction);
+            break;
+        default:
+            continue;
+        }
+        p->setPos(rp.pos);
+        p->setColor(rp.color);
+        if (rp.drawType <= dtPoints)
+            p->setDrawType(DrawType(rp.drawType));
+    }
+}
+
+RenderWorker::RenderWorker(QObject *parent) : QObject(parent)
+{
+    fScene = new ServiceScene();
+}
+
+RenderWorker::~RenderWorker()
+{
+    delete fScene;
+}
+
+void RenderWorker::initialize()
+{
+    if (!fScene->initialize())
+        qWarning() << "RenderWorker: cannot initialize offscreen scene";
+}
+
+void RenderWorker::render(QByteArray payload, quintptr tag)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    RenderRequest request;
+    RenderResponse response;
+    {
+        QDataStream in(payload);
+        initRenderStream(in);
+        in >> request;
+        if (in.status() != QDataStream::Ok || request.size.isEmpty()
+                || request.size.width() > MAX_IMAGE_SIDE || request.size.height() > MAX_IMAGE_SIDE)
+            response.status = RenderResponse::rsBadRequest;
+    }
+    response.id = request.id;
+
+    if (response.status == RenderResponse::rsOk) {
+        QImage image = fScene->render(request);
+        if (image.isNull())
+            response.status = RenderResponse::rsRenderFailed;
+        else if (request.format == RenderRequest::ifRaw) {
+            image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            response.image = QByteArray(reinterpret_cast<const char*>(image.constBits()), int(image.sizeInBytes()));
+        }
+        else {
+            QBuffer buffer(&response.image);
+            buffer.open(QIODevice::WriteOnly);
+            image.save(&buffer, request.format == RenderRequest::ifJpeg ? "JPG" : "PNG");
+        }
+    }
+    response.renderTime = qint32(timer.elapsed());
+
+    QByteArray out;
+    {
+        QDataStream stream(&out, QIODevice::WriteOnly);
+        initRenderStream(stream);
+        stream << response;
+    }
+    emit rendered(out, tag, timer.elapsed(), response.status == RenderResponse::rsOk);
+}
+
+void RenderWorker::release()
+{
+    fScene->releaseResources();
+}
@@ -0,0 +1,56 @@
+#ifndef RENDERWORKER_H
+#define RENDERWORKER_H
+
+#include <QObject>
+
+#include "../Lib/offscreenscene3d.h"
+#include "renderprotocol.h"
+
+// Offscreen scene of one worker. Scale labels and primitive meshes are kept
+// between requests and rebuilt only when the request settings change.
+class ServiceScene : public OffscreenScene3D
+{
+public:
+    ServiceScene();
+    ~ServiceScene();
+
+    QImage render(const RenderRequest &request);
+    void releaseResources();
+    quint64 cacheHits() const { return fCacheHits; }
+    quint64 cacheMisses() const { return fCacheMisses; }
+
+protected:
+    void paintData(const QMatrix4x4 &pmvMatrix) override;
+
+private:
+    PrimitiveManager *fPrimitives;
+    QByteArray fScalesKey;
+    QByteArray fPrimitivesKey;
+    quint64 fCacheHits;
+    quint64 fCacheMisses;
+
+    void applyScales(const RenderRequest &request);
+    void applyPrimitives(const RenderRequest &request);
+};
+
+// Lives on its own thread with its own GL context.
+class RenderWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RenderWorker(QObject *parent = nullptr);   // GUI thread
+    ~RenderWorker();                                     // GUI thread, after release()
+
+public slots:
+    void initialize();
+    void render(QByteArray payload, quintptr tag);
+    void release();
+
+signals:
+    void rendered(QByteArray payload, quintptr tag, qint64 renderTime, bool ok);
+
+private:
+    ServiceScene *fScene;
+};
+
+#endif // RENDERWORKER_H
@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# Loopback check of the serial ingest over a
+# pseudo-terminal pair (openpty), Unix only
+#
+#-------------------------------------------------
+
+QT       += core gui serialport
+QT       -= widgets
+
+TARGET = SerialLoopback
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+!unix: error("SerialLoopback needs openpty()")
+linux: LIBS += -lutil
+
+SOURCES += \
+        ../Lib/capturefile.cpp \
+        ../Lib/sampledecoder.cpp \
+        ../Lib/serialingest.cpp \
+        main.cpp
+
+HEADERS += \
+        ../Lib/capturefile.h \
+        ../Lib/sampledecoder.h \
+        ../Lib/serialingest.h \
+        ../Lib/spscqueue.h
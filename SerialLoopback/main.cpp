@@ -0,0 +1,208 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include <QVector3D>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#if defined(Q_OS_MACOS)
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+#include "../Lib/sampledecoder.h"
+#include "../Lib/serialingest.h"
+
+#define FRAME_POINTS 256
+#define QUEUE_CAPACITY 4
+#define BATCH_SIZE 256
+#define DROP_FRAMES 400         // ~1.2 MB, очередь переполняется без разбора
+#define PAUSE_FRAMES 800        // ~2.4 MB, больше буфера порта
+#define STALL_TIME 200          // ms без записи - писатель упёрся в паузу
+#define TIMEOUT 20000           // ms
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok)
+        failures++;
+}
+
+// Master side of a pseudo-terminal; the ingest opens the slave by its name.
+struct Pty {
+    int master;
+    int slave;
+    QString name;
+    Pty() : master(-1), slave(-1) {}
+    ~Pty() { if (master >= 0) ::close(master); if (slave >= 0) ::close(slave); }
+};
+
+static bool openPty(Pty *pty)
+{
+    char name[256];
+    if (openpty(&pty->master, &pty->slave, name, nullptr, nullptr) < 0) {
+        printf("openpty: %s\n", strerror(errno));
+        return false;
+    }
+
+    // без эха и обработки строк байты проходят как есть
+    termios tio;
+    tcgetattr(pty->slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(pty->slave, TCSANOW, &tio);
+    fcntl(pty->master, F_SETFL, fcntl(pty->master, F_GETFL) | O_NONBLOCK);
+    pty->name = QString::fromLocal8Bit(name);
+    return true;
+}
+
+// кадры подряд, x точки - её сквозной номер
+static QByteArray makeStream(int frames)
+{
+    QByteArray stream;
+    QVector<QVector3D> frame(FRAME_POINTS);
+    int number = 0;
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < FRAME_POINTS; i++, number++)
+            frame[i] = QVector3D(float(number), float(f), 0.5f);
+        stream.append(SampleDecoder::encodeFrame(frame.constData(), FRAME_POINTS));
+    }
+    return stream;
+}
+
+// writes from offset until everything is written or the pty stays full for stallMs
+static int writeSome(int fd, const QByteArray &data, int offset, int stallMs)
+{
+    QElapsedTimer stall;
+    stall.start();
+    while (offset < data.size()) {
+        const ssize_t n = ::write(fd, data.constData() + offset, size_t(data.size() - offset));
+        if (n > 0) {
+            offset += int(n);
+            stall.restart();
+        }
+        else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            printf("write: %s\n", strerror(errno));
+            break;
+        }
+        else if (stall.elapsed() >= stallMs)
+            break;
+        else
+            QThread::msleep(1);
+    }
+    return offset;
+}
+
+static bool waitFor(std::function<bool()> done, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() >= timeoutMs)
+            return false;
+        QCoreApplication::processEvents();
+        QThread::msleep(1);
+    }
+    return true;
+}
+
+static void testDrop()
+{
+    printf("bpDrop\n");
+    Pty pty;
+    if (!openPty(&pty)) {
+        check(false, "pseudo-terminal pair");
+        return;
+    }
+
+    SerialIngest ingest(QUEUE_CAPACITY, BATCH_SIZE);
+    ingest.setBackpressure(SerialIngest::bpDrop);
+    check(ingest.open(pty.name), "slave opened by SerialIngest");
+
+    // без разбора очередь переполняется, лишние точки считаются отброшенными
+    const QByteArray stream = makeStream(DROP_FRAMES);
+    const quint64 total = quint64(DROP_FRAMES) * FRAME_POINTS;
+    check(writeSome(pty.master, stream, 0, TIMEOUT) == stream.size(), "stream written, the reader never pauses");
+    check(waitFor([&]() { const SerialIngest::Stats s = ingest.stats(); return s.points + s.droppedPoints >= total; }, TIMEOUT),
+          "all frames decoded");
+
+    const SerialIngest::Stats s = ingest.stats();
+    check(s.frames == DROP_FRAMES, "frame count");
+    check(s.crcErrors == 0 && s.skippedBytes == 0, "no crc errors or skipped bytes");
+    check(s.droppedPoints > 0, "queue overflow counted in droppedPoints");
+    check(s.points + s.droppedPoints == total, "queued + dropped == written");
+    check(s.pauses == 0, "no pauses");
+
+    quint64 drained = 0;
+    ingest.drain([&](const PointBatch &batch) { drained += quint64(batch.points.count()); });
+    check(drained == s.points, "drained points == queued points");
+    ingest.close();
+}
+
+static void testPause()
+{
+    printf("bpPause\n");
+    Pty pty;
+    if (!openPty(&pty)) {
+        check(false, "pseudo-terminal pair");
+        return;
+    }
+
+    SerialIngest ingest(QUEUE_CAPACITY, BATCH_SIZE);
+    ingest.setBackpressure(SerialIngest::bpPause);
+    check(ingest.open(pty.name), "slave opened by SerialIngest");
+
+    const QByteArray stream = makeStream(PAUSE_FRAMES);
+    const quint64 total = quint64(PAUSE_FRAMES) * FRAME_POINTS;
+    quint64 received = 0;
+    bool ordered = true;
+    auto consumer = [&](const PointBatch &batch) {
+        for (const QVector3D &p : batch.points) {
+            if (p.x() != float(received))
+                ordered = false;
+            received++;
+        }
+    };
+
+    // без разбора чтение встаёт, буфер порта и pty заполняются и запись упирается
+    int written = writeSome(pty.master, stream, 0, STALL_TIME);
+    SerialIngest::Stats s = ingest.stats();
+    check(written < stream.size(), "writer pushed back while the queue is full");
+    check(s.pauses > 0, "reader paused");
+    check(s.droppedPoints == 0, "nothing dropped while paused");
+
+    QElapsedTimer timer;
+    timer.start();
+    while ((written < stream.size() || received < total) && timer.elapsed() < TIMEOUT) {
+        ingest.drain(consumer);
+        written = writeSome(pty.master, stream, written, 1);
+        QCoreApplication::processEvents();
+    }
+
+    s = ingest.stats();
+    check(written == stream.size(), "stream written after draining");
+    check(received == total, "every point delivered");
+    check(ordered, "points delivered in order");
+    check(s.droppedPoints == 0, "no drops in bpPause");
+    check(s.crcErrors == 0, "no crc errors");
+    ingest.close();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("SerialLoopback");
+
+    testDrop();
+    testPause();
+
+    printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -3,6 +3,8 @@
 
 int main(int argc, char *argv[])
 {
+    // все сцены в одной группе контекстов делят программы, оси и подписи шкал
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
     QApplication a(argc, argv);
     Window w;
     w.show();
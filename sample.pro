@@ -26,15 +26,58 @@ CONFIG += c++11
 
 SOURCES += \
         Lib/basescene3d.cpp \
+        Lib/basescenecore.cpp \
+        Lib/capturefile.cpp \
+        Lib/dataseries.cpp \
+        Lib/framecapture.cpp \
+        Lib/framescheduler.cpp \
+        Lib/gl_pointsprites.cpp \
         Lib/gl_primitives.cpp \
+        Lib/gl_streambuffer.cpp \
+        Lib/isosurface.cpp \
+        Lib/offscreenscene3d.cpp \
+        Lib/pointcodec.cpp \
+        Lib/pointoctree.cpp \
+        Lib/pointoctreefile.cpp \
+        Lib/polylinelod.cpp \
+        Lib/sampledecoder.cpp \
+        Lib/scenerenderer.cpp \
+        Lib/sceneresources.cpp \
+        Lib/serialingest.cpp \
+        Lib/snapshotseries.cpp \
+        Lib/spritepack.cpp \
         Lib/varianteditor.cpp \
+        Lib/volumeslice.cpp \
+        Lib/voxelgrid.cpp \
         main.cpp \
         window.cpp
 
 HEADERS += \
         Lib/basescene3d.h \
+        Lib/basescenecore.h \
+        Lib/capturefile.h \
+        Lib/dataseries.h \
+        Lib/framecapture.h \
+        Lib/framescheduler.h \
+        Lib/gl_pointsprites.h \
         Lib/gl_primitives.h \
+        Lib/gl_streambuffer.h \
+        Lib/isosurface.h \
+        Lib/offscreenscene3d.h \
+        Lib/pointcodec.h \
+        Lib/pointoctree.h \
+        Lib/pointoctreefile.h \
+        Lib/polylinelod.h \
+        Lib/sampledecoder.h \
+        Lib/scenerenderer.h \
+        Lib/sceneresources.h \
+        Lib/serialingest.h \
+        Lib/snapshotseries.h \
+        Lib/spscqueue.h \
+        Lib/triplebuffer.h \
         Lib/varianteditor.h \
+        Lib/volumeslice.h \
+        Lib/voxelgrid.h \
         window.h
 
 FORMS += \
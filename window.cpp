@@ -1,15 +1,48 @@
 #include "window.h"
 #include "ui_window.h"
 
+#include <QThread>
+#include <QElapsedTimer>
+#include <cmath>
+
+#define CLOUD_POINTS 20000
+#define CLOUD_INTERVAL 16   // ms между снимками
+
 Window::Window(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::Window)
 {
     ui->setupUi(this);
-    ui->verticalLayout->addWidget(new BaseScene3D);
+    fScene = new BaseScene3D;
+    ui->verticalLayout->addWidget(fScene);
+
+    // облако пересчитывается целиком в своём потоке, сцена рисует последний готовый снимок
+    SnapshotSeries *cloud = fScene->addSnapshotSeries("cloud");
+    cloud->setColor(Qt::darkBlue);
+    BaseScene3D *scene = fScene;
+    fProducer = QThread::create([scene, cloud]() {
+        QElapsedTimer clock;
+        clock.start();
+        while (!QThread::currentThread()->isInterruptionRequested()) {
+            const float t = clock.elapsed() / 1000.0f;
+            QVector<QVector3D> &points = cloud->writeBuffer();
+            points.resize(CLOUD_POINTS);
+            for (int i = 0; i < CLOUD_POINTS; i++) {
+                const float a = float(i) * 2.0f * float(M_PI) / CLOUD_POINTS;
+                points[i] = QVector3D(2.5f * std::sin(3.0f * a + t), 2.5f * std::sin(2.0f * a), 2.5f * std::cos(5.0f * a + 0.5f * t));
+            }
+            cloud->publish();
+            scene->postDataChanged();
+            QThread::msleep(CLOUD_INTERVAL);
+        }
+    });
+    fProducer->start();
 }
 
 Window::~Window()
 {
+    fProducer->requestInterruption();
+    fProducer->wait();
+    delete fProducer;
     delete ui;
 }
@@ -4,6 +4,8 @@
 #include <QMainWindow>
 #include "Lib/basescene3d.h"
 
+class QThread;
+
 namespace Ui {
 class Window;
 }
@@ -18,6 +20,8 @@ public:
 
 private:
     Ui::Window *ui;
+    BaseScene3D *fScene;
+    QThread *fProducer;     // публикует снимки облака "cloud"
 };
 
 #endif // WINDOW_H